@@ -0,0 +1,323 @@
+#include "Animation.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define ANIMATION_SSE 1
+#endif
+
+#include "Trace.h"
+
+static ModelTransform ToTransform(const aiMatrix4x4& matrix)
+{
+	aiVector3D scaling;
+	aiQuaternion rotation;
+	aiVector3D position;
+	matrix.Decompose(scaling, rotation, position);
+
+	ModelTransform transform;
+	transform.Translation = glm::vec3(position.x, position.y, position.z);
+	transform.Rotation = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+	transform.Scale = glm::vec3(scaling.x, scaling.y, scaling.z);
+	return transform;
+}
+
+// Value of a key track at time (clamped to the first and last key)
+template <typename T, typename Interpolate>
+static T SampleKeys(const std::vector<float>& times, const std::vector<T>& values, float time, const T& fallback, Interpolate interpolate)
+{
+	if (values.empty())
+	{
+		return fallback;
+	}
+	if (values.size() == 1 || time <= times.front())
+	{
+		return values.front();
+	}
+	if (time >= times.back())
+	{
+		return values.back();
+	}
+
+	size_t next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+	size_t previous = next - 1;
+	float t = (time - times[previous]) / (times[next] - times[previous]);
+	return interpolate(values[previous], values[next], t);
+}
+
+int32_t Skeleton::FindJoint(const std::string& name) const
+{
+	for (size_t i = 0; i < JointNames.size(); i++)
+	{
+		if (JointNames[i] == name)
+		{
+			return static_cast<int32_t>(i);
+		}
+	}
+
+	return -1;
+}
+
+uint32_t Skeleton::AddBone(const std::string& jointName, const glm::mat4& inverseBindMatrix)
+{
+	int32_t joint = FindJoint(jointName);
+	if (joint < 0)
+	{
+		throw std::runtime_error("Skinned mesh bone '" + jointName + "' has no node!");
+	}
+
+	for (size_t i = 0; i < BoneJoints.size(); i++)
+	{
+		if (BoneJoints[i] == static_cast<uint32_t>(joint))
+		{
+			return static_cast<uint32_t>(i);
+		}
+	}
+
+	BoneJoints.push_back(static_cast<uint32_t>(joint));
+	InverseBindMatrices.push_back(inverseBindMatrix);
+	return static_cast<uint32_t>(BoneJoints.size() - 1);
+}
+
+Skeleton Skeleton::Load(const aiScene* scene)
+{
+	TRACE_FUNCTION();
+
+	Skeleton skeleton;
+
+	// Depth first, a node is always listed after its parent
+	std::vector<std::pair<const aiNode*, int32_t>> stack = { { scene->mRootNode, -1 } };
+	while (!stack.empty())
+	{
+		const aiNode* node = stack.back().first;
+		int32_t parent = stack.back().second;
+		stack.pop_back();
+
+		int32_t joint = static_cast<int32_t>(skeleton.JointNames.size());
+		skeleton.JointNames.push_back(node->mName.C_Str());
+		skeleton.Parents.push_back(parent);
+		skeleton.BindPose.push_back(ToTransform(node->mTransformation));
+
+		for (uint32_t i = node->mNumChildren; i > 0; i--)
+		{
+			stack.push_back({ node->mChildren[i - 1], joint });
+		}
+	}
+
+	return skeleton;
+}
+
+std::vector<AnimationClip> AnimationClip::Load(const aiScene* scene, const Skeleton& skeleton)
+{
+	TRACE_FUNCTION();
+
+	std::vector<AnimationClip> clips;
+	for (uint32_t a = 0; a < scene->mNumAnimations; a++)
+	{
+		const aiAnimation* animation = scene->mAnimations[a];
+		float ticksPerSecond = animation->mTicksPerSecond > 0.0 ? static_cast<float>(animation->mTicksPerSecond) : 25.0f;
+
+		AnimationClip clip;
+		clip.Name = animation->mName.C_Str();
+		clip.Duration = static_cast<float>(animation->mDuration) / ticksPerSecond;
+
+		for (uint32_t c = 0; c < animation->mNumChannels; c++)
+		{
+			const aiNodeAnim* nodeAnimation = animation->mChannels[c];
+			int32_t joint = skeleton.FindJoint(nodeAnimation->mNodeName.C_Str());
+			if (joint < 0)
+			{
+				continue;
+			}
+
+			AnimationChannel channel;
+			channel.Joint = static_cast<uint32_t>(joint);
+			for (uint32_t k = 0; k < nodeAnimation->mNumPositionKeys; k++)
+			{
+				const aiVectorKey& key = nodeAnimation->mPositionKeys[k];
+				channel.PositionTimes.push_back(static_cast<float>(key.mTime) / ticksPerSecond);
+				channel.Positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			for (uint32_t k = 0; k < nodeAnimation->mNumRotationKeys; k++)
+			{
+				const aiQuatKey& key = nodeAnimation->mRotationKeys[k];
+				channel.RotationTimes.push_back(static_cast<float>(key.mTime) / ticksPerSecond);
+				channel.Rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			for (uint32_t k = 0; k < nodeAnimation->mNumScalingKeys; k++)
+			{
+				const aiVectorKey& key = nodeAnimation->mScalingKeys[k];
+				channel.ScaleTimes.push_back(static_cast<float>(key.mTime) / ticksPerSecond);
+				channel.Scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+
+			clip.Channels.push_back(channel);
+		}
+
+		clips.push_back(clip);
+	}
+
+	return clips;
+}
+
+void AnimationPose::Resize(uint32_t jointCount)
+{
+	// Padding joints are identities
+	uint32_t paddedCount = (jointCount + 3) & ~3u;
+	TranslationX.resize(paddedCount, 0.0f);
+	TranslationY.resize(paddedCount, 0.0f);
+	TranslationZ.resize(paddedCount, 0.0f);
+	RotationX.resize(paddedCount, 0.0f);
+	RotationY.resize(paddedCount, 0.0f);
+	RotationZ.resize(paddedCount, 0.0f);
+	RotationW.resize(paddedCount, 1.0f);
+	ScaleX.resize(paddedCount, 1.0f);
+	ScaleY.resize(paddedCount, 1.0f);
+	ScaleZ.resize(paddedCount, 1.0f);
+}
+
+void AnimationPose::Set(uint32_t joint, const ModelTransform& transform)
+{
+	TranslationX[joint] = transform.Translation.x;
+	TranslationY[joint] = transform.Translation.y;
+	TranslationZ[joint] = transform.Translation.z;
+	RotationX[joint] = transform.Rotation.x;
+	RotationY[joint] = transform.Rotation.y;
+	RotationZ[joint] = transform.Rotation.z;
+	RotationW[joint] = transform.Rotation.w;
+	ScaleX[joint] = transform.Scale.x;
+	ScaleY[joint] = transform.Scale.y;
+	ScaleZ[joint] = transform.Scale.z;
+}
+
+ModelTransform AnimationPose::Get(uint32_t joint) const
+{
+	ModelTransform transform;
+	transform.Translation = glm::vec3(TranslationX[joint], TranslationY[joint], TranslationZ[joint]);
+	transform.Rotation = glm::quat(RotationW[joint], RotationX[joint], RotationY[joint], RotationZ[joint]);
+	transform.Scale = glm::vec3(ScaleX[joint], ScaleY[joint], ScaleZ[joint]);
+	return transform;
+}
+
+void SampleAnimation(const Skeleton& skeleton, const AnimationClip& clip, float time, AnimationPose& pose)
+{
+	uint32_t jointCount = static_cast<uint32_t>(skeleton.BindPose.size());
+	pose.Resize(jointCount);
+	for (uint32_t joint = 0; joint < jointCount; joint++)
+	{
+		pose.Set(joint, skeleton.BindPose[joint]);
+	}
+
+	if (clip.Duration > 0.0f)
+	{
+		time = std::fmod(time, clip.Duration);
+		if (time < 0.0f)
+		{
+			time += clip.Duration;
+		}
+	}
+
+	for (const AnimationChannel& channel : clip.Channels)
+	{
+		ModelTransform transform = skeleton.BindPose[channel.Joint];
+		transform.Translation = SampleKeys(channel.PositionTimes, channel.Positions, time, transform.Translation,
+			[](const glm::vec3& a, const glm::vec3& b, float t) { return glm::mix(a, b, t); });
+		transform.Rotation = SampleKeys(channel.RotationTimes, channel.Rotations, time, transform.Rotation,
+			[](const glm::quat& a, const glm::quat& b, float t) { return glm::slerp(a, b, t); });
+		transform.Scale = SampleKeys(channel.ScaleTimes, channel.Scales, time, transform.Scale,
+			[](const glm::vec3& a, const glm::vec3& b, float t) { return glm::mix(a, b, t); });
+		pose.Set(channel.Joint, transform);
+	}
+}
+
+void BlendAnimationPoses(const AnimationPose& a, const AnimationPose& b, float weight, AnimationPose& result)
+{
+	uint32_t paddedCount = static_cast<uint32_t>(a.RotationW.size());
+	result.Resize(paddedCount);
+
+#ifdef ANIMATION_SSE
+	const __m128 blend = _mm_set1_ps(weight);
+	const __m128 keep = _mm_set1_ps(1.0f - weight);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	for (uint32_t i = 0; i < paddedCount; i += 4)
+	{
+		// Translation and scale: a + (b - a) * weight
+		const std::vector<float>* linearA[6] = { &a.TranslationX, &a.TranslationY, &a.TranslationZ, &a.ScaleX, &a.ScaleY, &a.ScaleZ };
+		const std::vector<float>* linearB[6] = { &b.TranslationX, &b.TranslationY, &b.TranslationZ, &b.ScaleX, &b.ScaleY, &b.ScaleZ };
+		std::vector<float>* linearResult[6] = { &result.TranslationX, &result.TranslationY, &result.TranslationZ,
+			&result.ScaleX, &result.ScaleY, &result.ScaleZ };
+		for (uint32_t c = 0; c < 6; c++)
+		{
+			__m128 valueA = _mm_loadu_ps(&(*linearA[c])[i]);
+			__m128 valueB = _mm_loadu_ps(&(*linearB[c])[i]);
+			_mm_storeu_ps(&(*linearResult[c])[i], _mm_add_ps(valueA, _mm_mul_ps(_mm_sub_ps(valueB, valueA), blend)));
+		}
+
+		// Rotation: normalized lerp, b flipped where it is on the other hemisphere of a
+		__m128 ax = _mm_loadu_ps(&a.RotationX[i]), ay = _mm_loadu_ps(&a.RotationY[i]);
+		__m128 az = _mm_loadu_ps(&a.RotationZ[i]), aw = _mm_loadu_ps(&a.RotationW[i]);
+		__m128 bx = _mm_loadu_ps(&b.RotationX[i]), by = _mm_loadu_ps(&b.RotationY[i]);
+		__m128 bz = _mm_loadu_ps(&b.RotationZ[i]), bw = _mm_loadu_ps(&b.RotationW[i]);
+
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), signBit);
+		__m128 blendB = _mm_xor_ps(blend, flip);
+
+		__m128 rx = _mm_add_ps(_mm_mul_ps(ax, keep), _mm_mul_ps(bx, blendB));
+		__m128 ry = _mm_add_ps(_mm_mul_ps(ay, keep), _mm_mul_ps(by, blendB));
+		__m128 rz = _mm_add_ps(_mm_mul_ps(az, keep), _mm_mul_ps(bz, blendB));
+		__m128 rw = _mm_add_ps(_mm_mul_ps(aw, keep), _mm_mul_ps(bw, blendB));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)),
+			_mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw))));
+
+		_mm_storeu_ps(&result.RotationX[i], _mm_div_ps(rx, length));
+		_mm_storeu_ps(&result.RotationY[i], _mm_div_ps(ry, length));
+		_mm_storeu_ps(&result.RotationZ[i], _mm_div_ps(rz, length));
+		_mm_storeu_ps(&result.RotationW[i], _mm_div_ps(rw, length));
+	}
+#else
+	for (uint32_t i = 0; i < paddedCount; i++)
+	{
+		ModelTransform transformA = a.Get(i);
+		ModelTransform transformB = b.Get(i);
+		if (glm::dot(transformA.Rotation, transformB.Rotation) < 0.0f)
+		{
+			transformB.Rotation = -transformB.Rotation;
+		}
+
+		ModelTransform transform;
+		transform.Translation = glm::mix(transformA.Translation, transformB.Translation, weight);
+		transform.Rotation = glm::normalize(transformA.Rotation * (1.0f - weight) + transformB.Rotation * weight);
+		transform.Scale = glm::mix(transformA.Scale, transformB.Scale, weight);
+		result.Set(i, transform);
+	}
+#endif
+}
+
+void ComputeSkinMatrices(const Skeleton& skeleton, const AnimationPose& pose, std::vector<glm::mat4>& worldTransforms,
+	std::vector<glm::mat4>& skinMatrices)
+{
+	// Parents come first, their world transform is ready when a child needs it
+	uint32_t jointCount = static_cast<uint32_t>(skeleton.Parents.size());
+	worldTransforms.resize(jointCount);
+	for (uint32_t joint = 0; joint < jointCount; joint++)
+	{
+		ModelTransform transform = pose.Get(joint);
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), transform.Translation) * glm::mat4_cast(transform.Rotation)
+			* glm::scale(glm::mat4(1.0f), transform.Scale);
+
+		int32_t parent = skeleton.Parents[joint];
+		worldTransforms[joint] = parent < 0 ? local : worldTransforms[parent] * local;
+	}
+
+	skinMatrices.resize(skeleton.BoneJoints.size());
+	for (size_t bone = 0; bone < skeleton.BoneJoints.size(); bone++)
+	{
+		skinMatrices[bone] = worldTransforms[skeleton.BoneJoints[bone]] * skeleton.InverseBindMatrices[bone];
+	}
+}
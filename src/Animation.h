@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <assimp/scene.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "TransformStore.h"
+
+// Joints of a skinned model: every node of the imported hierarchy, parents before children
+struct Skeleton
+{
+	std::vector<std::string> JointNames;
+	std::vector<int32_t> Parents;				// -1 = root
+	std::vector<ModelTransform> BindPose;		// local transforms of the file, kept by joints a clip doesn't animate
+
+	// Bones: joints vertices are attached to, with the inverse bind (mesh to joint space) matrices
+	std::vector<uint32_t> BoneJoints;
+	std::vector<glm::mat4> InverseBindMatrices;
+
+	int32_t FindJoint(const std::string& name) const;
+	// Bone of a joint, added on first use (the bones of all mesh parts share one list)
+	uint32_t AddBone(const std::string& jointName, const glm::mat4& inverseBindMatrix);
+
+	static Skeleton Load(const aiScene* scene);
+};
+
+// Keys of one joint, times in seconds
+struct AnimationChannel
+{
+	uint32_t Joint;
+	std::vector<float> PositionTimes;
+	std::vector<glm::vec3> Positions;
+	std::vector<float> RotationTimes;
+	std::vector<glm::quat> Rotations;
+	std::vector<float> ScaleTimes;
+	std::vector<glm::vec3> Scales;
+};
+
+struct AnimationClip
+{
+	std::string Name;
+	float Duration = 0.0f;		// seconds, sampling wraps around
+	std::vector<AnimationChannel> Channels;
+
+	static std::vector<AnimationClip> Load(const aiScene* scene, const Skeleton& skeleton);
+};
+
+// What a skinned model plays: one clip, or two blended (BlendWeight = share of the blend clip)
+struct AnimationState
+{
+	uint32_t Clip = 0;
+	float Time = 0.0f;
+	uint32_t BlendClip = UINT32_MAX;		// UINT32_MAX = no blend
+	float BlendTime = 0.0f;
+	float BlendWeight = 0.0f;
+};
+
+// Local joint transforms as structure of arrays (padded to a multiple of 4), so blends run 4 joints at a time
+struct AnimationPose
+{
+	std::vector<float> TranslationX, TranslationY, TranslationZ;
+	std::vector<float> RotationX, RotationY, RotationZ, RotationW;
+	std::vector<float> ScaleX, ScaleY, ScaleZ;
+
+	void Resize(uint32_t jointCount);
+	void Set(uint32_t joint, const ModelTransform& transform);
+	ModelTransform Get(uint32_t joint) const;
+};
+
+// Bind pose with the clip's channels sampled at time (keys interpolated, rotations slerped)
+void SampleAnimation(const Skeleton& skeleton, const AnimationClip& clip, float time, AnimationPose& pose);
+// result = a * (1 - weight) + b * weight (rotations take the shorter way and are renormalized), SSE 4 joints at a time
+void BlendAnimationPoses(const AnimationPose& a, const AnimationPose& b, float weight, AnimationPose& result);
+// Skin matrix of every bone (mesh space bind pose to posed in the space of the root node's parent, like the static
+// parts whose node transforms are baked), worldTransforms is scratch space
+void ComputeSkinMatrices(const Skeleton& skeleton, const AnimationPose& pose, std::vector<glm::mat4>& worldTransforms,
+	std::vector<glm::mat4>& skinMatrices);
@@ -0,0 +1,293 @@
+#include "Benchmark.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+BenchmarkScene BenchmarkScene::Load(const std::string& filepath)
+{
+	std::ifstream file(filepath);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open benchmark scene: " + filepath);
+	}
+
+	BenchmarkScene scene;
+	scene.Path = filepath;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string keyword;
+		if (!(stream >> keyword) || keyword[0] == '#')
+		{
+			continue;
+		}
+
+		if (keyword == "timestep")
+		{
+			if (!(stream >> scene.TimeStep) || scene.TimeStep <= 0.0f)
+			{
+				throw std::runtime_error("Invalid timestep in benchmark scene: " + line);
+			}
+		}
+		else if (keyword == "model")
+		{
+			BenchmarkModel model;
+			if (!(stream >> model.Path >> model.Translation.x >> model.Translation.y >> model.Translation.z >> model.Scale >> model.SpinSpeed))
+			{
+				throw std::runtime_error("Invalid model in benchmark scene: " + line);
+			}
+			if (scene.Models.size() >= MAX_OBJECTS)
+			{
+				throw std::runtime_error("Too many models in benchmark scene (at most " + std::to_string(MAX_OBJECTS) + "): " + line);
+			}
+			scene.Models.push_back(model);
+		}
+		else
+		{
+			throw std::runtime_error("Unknown keyword in benchmark scene: " + line);
+		}
+	}
+
+	if (scene.Models.empty())
+	{
+		throw std::runtime_error("Benchmark scene has no models: " + filepath);
+	}
+
+	return scene;
+}
+
+Benchmark::Benchmark(uint32_t warmupFrames, uint32_t measuredFrames)
+	: m_WarmupFrames(warmupFrames), m_MeasuredFrames(measuredFrames)
+{
+}
+
+void Benchmark::Run(VulkanRenderer& renderer, const BenchmarkScene& scene, GLFWwindow* window)
+{
+	m_FrameTimes.clear();
+	m_PrepareTimes.clear();
+	m_WaitTimes.clear();
+	m_RecordTimes.clear();
+	m_SubmitTimes.clear();
+	m_GpuFrameTimes.clear();
+	m_GpuScopeNames.clear();
+	m_GpuScopeTimes.clear();
+	m_LastGpuFrame = UINT64_MAX;
+	m_StatisticsFrames = 0;
+	m_VertexInvocations = 0;
+	m_ClippingInvocations = 0;
+	m_ClippingPrimitives = 0;
+	m_FragmentInvocations = 0;
+
+	m_FrameTimes.reserve(m_MeasuredFrames);
+	m_PrepareTimes.reserve(m_MeasuredFrames);
+	m_WaitTimes.reserve(m_MeasuredFrames);
+	m_RecordTimes.reserve(m_MeasuredFrames);
+	m_SubmitTimes.reserve(m_MeasuredFrames);
+	m_GpuFrameTimes.reserve(m_MeasuredFrames);
+
+	for (uint32_t frame = 0; frame < m_WarmupFrames + m_MeasuredFrames; frame++)
+	{
+		if (window != nullptr)
+		{
+			glfwPollEvents();
+			if (glfwWindowShouldClose(window))
+			{
+				break;
+			}
+		}
+
+		auto frameStart = std::chrono::high_resolution_clock::now();
+		UpdateScene(renderer, scene, frame);
+		renderer.Draw();
+		auto frameEnd = std::chrono::high_resolution_clock::now();
+
+		// Warm-up frames fill the pipeline cache, the driver's upload heaps and the dynamic resolution history
+		if (frame < m_WarmupFrames)
+		{
+			continue;
+		}
+
+		const FrameTimings& timings = renderer.GetLastFrameTimings();
+		m_FrameTimes.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+		m_PrepareTimes.push_back(timings.PrepareMs);
+		m_WaitTimes.push_back(timings.WaitMs);
+		m_RecordTimes.push_back(timings.RecordMs);
+		m_SubmitTimes.push_back(timings.SubmitMs);
+
+		RecordGpuStats(renderer.GetGpuFrameStats());
+	}
+}
+
+void Benchmark::RecordGpuStats(const GpuFrameStats& stats)
+{
+	// Skip frames without a new read back (results not ready yet, or no timestamp support)
+	if (!stats.Valid || stats.FrameNumber == m_LastGpuFrame)
+	{
+		return;
+	}
+	m_LastGpuFrame = stats.FrameNumber;
+
+	m_GpuFrameTimes.push_back(stats.FrameMs);
+	for (const GpuScopeTime& scope : stats.Scopes)
+	{
+		auto it = std::find(m_GpuScopeNames.begin(), m_GpuScopeNames.end(), scope.Name);
+		if (it == m_GpuScopeNames.end())
+		{
+			m_GpuScopeNames.push_back(scope.Name);
+			m_GpuScopeTimes.emplace_back();
+			it = m_GpuScopeNames.end() - 1;
+		}
+		m_GpuScopeTimes[it - m_GpuScopeNames.begin()].push_back(scope.Milliseconds);
+	}
+
+	if (stats.HasPipelineStatistics)
+	{
+		m_StatisticsFrames++;
+		m_VertexInvocations += stats.VertexInvocations;
+		m_ClippingInvocations += stats.ClippingInvocations;
+		m_ClippingPrimitives += stats.ClippingPrimitives;
+		m_FragmentInvocations += stats.FragmentInvocations;
+	}
+}
+
+void Benchmark::UpdateScene(VulkanRenderer& renderer, const BenchmarkScene& scene, uint32_t frameIndex)
+{
+	float time = frameIndex * scene.TimeStep;
+
+	// Spin about the world y axis: rotate(angle) * translate(t) * scale(s) = translate(rotated t) * rotate(angle) * scale(s)
+	std::vector<uint32_t> ids(scene.Models.size());
+	std::vector<ModelTransform> transforms(scene.Models.size());
+	for (size_t i = 0; i < scene.Models.size(); i++)
+	{
+		const BenchmarkModel& model = scene.Models[i];
+		float angle = std::fmod(model.SpinSpeed * time, 360.0f);
+
+		ids[i] = static_cast<uint32_t>(i);
+		transforms[i].Rotation = glm::angleAxis(glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+		transforms[i].Translation = transforms[i].Rotation * model.Translation;
+		transforms[i].Scale = glm::vec3(model.Scale);
+	}
+	renderer.UpdateModels(ids.data(), transforms.data(), static_cast<uint32_t>(ids.size()));
+}
+
+Benchmark::Percentiles Benchmark::ComputePercentiles(std::vector<double> samples)
+{
+	Percentiles percentiles;
+	if (samples.empty())
+	{
+		return percentiles;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	// Nearest rank
+	auto rank = [&samples](double percentile)
+	{
+		size_t index = static_cast<size_t>(std::ceil(percentile / 100.0 * samples.size()));
+		return samples[std::min(std::max(index, static_cast<size_t>(1)), samples.size()) - 1];
+	};
+
+	double sum = 0.0;
+	for (double sample : samples)
+	{
+		sum += sample;
+	}
+
+	percentiles.P50 = rank(50.0);
+	percentiles.P95 = rank(95.0);
+	percentiles.P99 = rank(99.0);
+	percentiles.Max = samples.back();
+	percentiles.Average = sum / samples.size();
+	return percentiles;
+}
+
+// Paths may contain backslashes on Windows
+static std::string EscapeJson(const std::string& text)
+{
+	std::string escaped;
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+void Benchmark::WritePercentiles(std::ofstream& file, const char* name, const std::vector<double>& samples, bool last)
+{
+	Percentiles percentiles = ComputePercentiles(samples);
+	file << "\t\t\"" << name << "\": { \"p50\": " << percentiles.P50 << ", \"p95\": " << percentiles.P95 << ", \"p99\": " << percentiles.P99
+		<< ", \"max\": " << percentiles.Max << ", \"avg\": " << percentiles.Average << " }" << (last ? "\n" : ",\n");
+}
+
+bool Benchmark::WriteResults(const std::string& filepath, const BenchmarkScene& scene, const VulkanRenderer& renderer) const
+{
+	std::ofstream file(filepath, std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	file << "{\n";
+	file << "\t\"scene\": \"" << EscapeJson(scene.Path) << "\",\n";
+	file << "\t\"timestep\": " << scene.TimeStep << ",\n";
+	file << "\t\"warmup_frames\": " << m_WarmupFrames << ",\n";
+	file << "\t\"measured_frames\": " << m_FrameTimes.size() << ",\n";
+
+	file << "\t\"cpu_ms\": {\n";
+	WritePercentiles(file, "frame", m_FrameTimes, false);
+	WritePercentiles(file, "prepare", m_PrepareTimes, false);
+	WritePercentiles(file, "wait", m_WaitTimes, false);
+	WritePercentiles(file, "record", m_RecordTimes, false);
+	WritePercentiles(file, "submit", m_SubmitTimes, true);
+	file << "\t},\n";
+
+	file << "\t\"gpu_ms\": {\n";
+	WritePercentiles(file, "frame", m_GpuFrameTimes, m_GpuScopeNames.empty());
+	for (size_t i = 0; i < m_GpuScopeNames.size(); i++)
+	{
+		WritePercentiles(file, m_GpuScopeNames[i].c_str(), m_GpuScopeTimes[i], i + 1 == m_GpuScopeNames.size());
+	}
+	file << "\t},\n";
+
+	// Averages per frame
+	uint32_t statisticsFrames = std::max(m_StatisticsFrames, 1u);
+	file << "\t\"pipeline_statistics\": { \"frames\": " << m_StatisticsFrames
+		<< ", \"vertex_invocations\": " << m_VertexInvocations / statisticsFrames
+		<< ", \"clipping_invocations\": " << m_ClippingInvocations / statisticsFrames
+		<< ", \"clipping_primitives\": " << m_ClippingPrimitives / statisticsFrames
+		<< ", \"fragment_invocations\": " << m_FragmentInvocations / statisticsFrames << " },\n";
+
+	const std::vector<AssetLoadTime>& loadTimes = renderer.GetAssetLoadTimes();
+	file << "\t\"asset_load_ms\": [\n";
+	for (size_t i = 0; i < loadTimes.size(); i++)
+	{
+		file << "\t\t{ \"path\": \"" << EscapeJson(loadTimes[i].Path) << "\", \"ms\": " << loadTimes[i].Milliseconds << " }"
+			<< (i + 1 < loadTimes.size() ? ",\n" : "\n");
+	}
+	file << "\t],\n";
+
+	const std::vector<GpuUploadTime>& uploadTimes = renderer.GetGpuUploadTimes();
+	file << "\t\"gpu_upload_ms\": [\n";
+	for (size_t i = 0; i < uploadTimes.size(); i++)
+	{
+		file << "\t\t{ \"path\": \"" << EscapeJson(uploadTimes[i].Name) << "\", \"ms\": " << uploadTimes[i].Milliseconds
+			<< ", \"submits\": " << uploadTimes[i].Submits << " }" << (i + 1 < uploadTimes.size() ? ",\n" : "\n");
+	}
+	file << "\t]\n";
+	file << "}\n";
+
+	file.close();
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#include "VulkanRenderer.h"
+
+// Model of a benchmark scene, animated only from the frame index (no wall clock)
+struct BenchmarkModel
+{
+	std::string Path;
+	glm::vec3 Translation = glm::vec3(0.0f);
+	float Scale = 1.0f;
+	float SpinSpeed = 0.0f;			// degrees per second around the Y axis
+};
+
+// Fixed scene definition loaded from a text file (see src/Scenes/benchmark.scene)
+struct BenchmarkScene
+{
+	std::string Path;
+	float TimeStep = 1.0f / 60.0f;	// simulated seconds per frame
+	std::vector<BenchmarkModel> Models;
+
+	static BenchmarkScene Load(const std::string& filepath);
+};
+
+// Renders warm-up frames, then measured frames with a fixed timestep, and writes the timings as JSON
+class Benchmark
+{
+public:
+	Benchmark(uint32_t warmupFrames, uint32_t measuredFrames);
+
+	// Window may be nullptr (headless), otherwise closing it stops the run early
+	void Run(VulkanRenderer& renderer, const BenchmarkScene& scene, GLFWwindow* window);
+
+	bool WriteResults(const std::string& filepath, const BenchmarkScene& scene, const VulkanRenderer& renderer) const;
+
+private:
+	struct Percentiles
+	{
+		double P50 = 0.0;
+		double P95 = 0.0;
+		double P99 = 0.0;
+		double Max = 0.0;
+		double Average = 0.0;
+	};
+
+	static void UpdateScene(VulkanRenderer& renderer, const BenchmarkScene& scene, uint32_t frameIndex);
+	static Percentiles ComputePercentiles(std::vector<double> samples);
+	static void WritePercentiles(std::ofstream& file, const char* name, const std::vector<double>& samples, bool last);
+
+	void RecordGpuStats(const GpuFrameStats& stats);
+
+private:
+	uint32_t m_WarmupFrames;
+	uint32_t m_MeasuredFrames;
+
+	// Milliseconds, one entry per measured frame
+	std::vector<double> m_FrameTimes;
+	std::vector<double> m_PrepareTimes;
+	std::vector<double> m_WaitTimes;
+	std::vector<double> m_RecordTimes;
+	std::vector<double> m_SubmitTimes;
+
+	// GPU results arrive a few frames late, one entry per new result read back during the measured frames
+	std::vector<double> m_GpuFrameTimes;
+	std::vector<std::string> m_GpuScopeNames;
+	std::vector<std::vector<double>> m_GpuScopeTimes;		// parallel to m_GpuScopeNames
+	uint64_t m_LastGpuFrame = UINT64_MAX;
+
+	// Pipeline statistics summed over the frames above
+	uint32_t m_StatisticsFrames = 0;
+	uint64_t m_VertexInvocations = 0;
+	uint64_t m_ClippingInvocations = 0;
+	uint64_t m_ClippingPrimitives = 0;
+	uint64_t m_FragmentInvocations = 0;
+};
@@ -0,0 +1,144 @@
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Trace.h"
+#include "Utils.h"
+
+// Cluster index of a normalized screen coordinate (0..1) along an axis of `count` clusters
+static uint32_t ToCluster(float normalized, uint32_t count)
+{
+	float cluster = std::floor(normalized * static_cast<float>(count));
+	return static_cast<uint32_t>(std::min(std::max(cluster, 0.0f), static_cast<float>(count - 1)));
+}
+
+void ClusteredLighting::Cull(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+	float nearPlane, float farPlane)
+{
+	TRACE_FUNCTION();
+
+	const uint32_t clusterCount = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+	// Exponential depth slices: every slice covers the same depth ratio, near slices stay thin
+	float logDepthRange = std::log(farPlane / nearPlane);
+	float sliceScale = static_cast<float>(CLUSTER_GRID_Z) / logDepthRange;
+	float sliceBias = -static_cast<float>(CLUSTER_GRID_Z) * std::log(nearPlane) / logDepthRange;
+
+	m_Header.GridSize = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, 0);
+	m_Header.SliceParams.x = sliceScale;
+	m_Header.SliceParams.y = sliceBias;
+
+	m_Lights.clear();
+	m_Bounds.clear();
+	m_Stats = ClusterStats();
+
+	// 1. View space bounds of every light, in clusters (x/d and y/d are monotonic, so the corners of the bounding box
+	// at the nearest and farthest depth give the screen rectangle)
+	float xScale = projection[0][0];
+	float yScale = projection[1][1];		// negative, the projection is flipped for Vulkan
+	for (const PointLight& light : lights)
+	{
+		if (m_Lights.size() >= MAX_LIGHTS)
+		{
+			m_Stats.Overflowed = true;
+			break;
+		}
+
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.Position, 1.0f));
+		float depth = -center.z;
+		float minDepth = std::max(depth - light.Radius, nearPlane);
+		float maxDepth = std::min(depth + light.Radius, farPlane);
+		if (minDepth > maxDepth)
+		{
+			continue;
+		}
+
+		float ndcX[4] = {
+			xScale * (center.x - light.Radius) / minDepth, xScale * (center.x - light.Radius) / maxDepth,
+			xScale * (center.x + light.Radius) / minDepth, xScale * (center.x + light.Radius) / maxDepth };
+		float ndcY[4] = {
+			yScale * (center.y - light.Radius) / minDepth, yScale * (center.y - light.Radius) / maxDepth,
+			yScale * (center.y + light.Radius) / minDepth, yScale * (center.y + light.Radius) / maxDepth };
+
+		float minX = *std::min_element(ndcX, ndcX + 4);
+		float maxX = *std::max_element(ndcX, ndcX + 4);
+		float minY = *std::min_element(ndcY, ndcY + 4);
+		float maxY = *std::max_element(ndcY, ndcY + 4);
+		if (minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f)
+		{
+			continue;
+		}
+
+		LightBounds bounds;
+		bounds.MinX = ToCluster(minX * 0.5f + 0.5f, CLUSTER_GRID_X);
+		bounds.MaxX = ToCluster(maxX * 0.5f + 0.5f, CLUSTER_GRID_X);
+		bounds.MinY = ToCluster(minY * 0.5f + 0.5f, CLUSTER_GRID_Y);
+		bounds.MaxY = ToCluster(maxY * 0.5f + 0.5f, CLUSTER_GRID_Y);
+		bounds.MinZ = ToCluster((std::log(minDepth) * sliceScale + sliceBias) / CLUSTER_GRID_Z, CLUSTER_GRID_Z);
+		bounds.MaxZ = ToCluster((std::log(maxDepth) * sliceScale + sliceBias) / CLUSTER_GRID_Z, CLUSTER_GRID_Z);
+		m_Bounds.push_back(bounds);
+
+		GpuPointLight gpuLight;
+		gpuLight.PositionRadius = glm::vec4(center, light.Radius);
+		gpuLight.ColorIntensity = glm::vec4(light.Color, light.Intensity);
+		m_Lights.push_back(gpuLight);
+	}
+
+	// 2. Lights per cluster, then offsets into one compact index list
+	m_Clusters.assign(clusterCount, ClusterRange{ 0, 0 });
+	for (const LightBounds& bounds : m_Bounds)
+	{
+		for (uint32_t z = bounds.MinZ; z <= bounds.MaxZ; z++)
+		{
+			for (uint32_t y = bounds.MinY; y <= bounds.MaxY; y++)
+			{
+				for (uint32_t x = bounds.MinX; x <= bounds.MaxX; x++)
+				{
+					m_Clusters[(z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x].Count++;
+				}
+			}
+		}
+	}
+
+	uint32_t offset = 0;
+	for (ClusterRange& cluster : m_Clusters)
+	{
+		// Clusters past the index list capacity lose their lights (reported, never written out of bounds)
+		if (offset + cluster.Count > MAX_CLUSTER_LIGHT_INDICES)
+		{
+			cluster.Count = MAX_CLUSTER_LIGHT_INDICES - offset;
+			m_Stats.Overflowed = true;
+		}
+
+		cluster.Offset = offset;
+		offset += cluster.Count;
+		m_Stats.MaxClusterLights = std::max(m_Stats.MaxClusterLights, cluster.Count);
+	}
+
+	// 3. Fill (visible light order, so every cluster lists its lights in the same order)
+	m_LightIndices.resize(offset);
+	std::vector<uint32_t> written(clusterCount, 0);
+	for (uint32_t light = 0; light < m_Bounds.size(); light++)
+	{
+		const LightBounds& bounds = m_Bounds[light];
+		for (uint32_t z = bounds.MinZ; z <= bounds.MaxZ; z++)
+		{
+			for (uint32_t y = bounds.MinY; y <= bounds.MaxY; y++)
+			{
+				for (uint32_t x = bounds.MinX; x <= bounds.MaxX; x++)
+				{
+					uint32_t cluster = (z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x;
+					if (written[cluster] < m_Clusters[cluster].Count)
+					{
+						m_LightIndices[m_Clusters[cluster].Offset + written[cluster]++] = light;
+					}
+				}
+			}
+		}
+	}
+
+	m_Header.GridSize.w = static_cast<uint32_t>(m_Lights.size());
+	m_Stats.VisibleLights = static_cast<uint32_t>(m_Lights.size());
+	m_Stats.LightIndices = offset;
+}
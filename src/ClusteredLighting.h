@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// Point light in world space, no contribution past Radius
+struct PointLight
+{
+	glm::vec3 Position;
+	float Radius;
+	glm::vec3 Color;
+	float Intensity;
+};
+
+// GPU layouts (std430, match shader.frag)
+struct GpuPointLight
+{
+	glm::vec4 PositionRadius;		// view space position, radius
+	glm::vec4 ColorIntensity;
+};
+
+struct ClusterHeader
+{
+	glm::uvec4 GridSize;			// clusters in x, y, z and the visible light count
+	glm::vec4 SliceParams;			// depth slice = log(view depth) * x + y, z/w = 1 / render extent (set at upload)
+};
+
+// Offset and count of a cluster's lights in the light index list
+struct ClusterRange
+{
+	uint32_t Offset;
+	uint32_t Count;
+};
+
+struct ClusterStats
+{
+	uint32_t VisibleLights = 0;		// lights overlapping the view frustum
+	uint32_t LightIndices = 0;		// cluster-light pairs
+	uint32_t MaxClusterLights = 0;
+	bool Overflowed = false;		// index list full, some cluster-light pairs were dropped
+};
+
+// Bins point lights into a froxel grid (screen tiles x exponential depth slices) every frame, so the fragment shader
+// only loops over the lights of its cluster. Lights are binned by the screen rectangle and depth range of their
+// bounding sphere (conservative, a light may land in a few clusters it doesn't touch)
+class ClusteredLighting
+{
+public:
+	ClusteredLighting() = default;
+
+	void Cull(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane);
+
+	const ClusterHeader& GetHeader() const { return m_Header; }
+	const std::vector<GpuPointLight>& GetLights() const { return m_Lights; }
+	const std::vector<ClusterRange>& GetClusters() const { return m_Clusters; }
+	const std::vector<uint32_t>& GetLightIndices() const { return m_LightIndices; }
+	const ClusterStats& GetStats() const { return m_Stats; }
+
+private:
+	// Cluster bounds of a visible light (inclusive)
+	struct LightBounds
+	{
+		uint32_t MinX, MaxX;
+		uint32_t MinY, MaxY;
+		uint32_t MinZ, MaxZ;
+	};
+
+	ClusterHeader m_Header = {};
+	std::vector<GpuPointLight> m_Lights;		// visible lights only
+	std::vector<LightBounds> m_Bounds;			// one per visible light
+	std::vector<ClusterRange> m_Clusters;
+	std::vector<uint32_t> m_LightIndices;
+	ClusterStats m_Stats;
+};
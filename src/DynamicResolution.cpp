@@ -0,0 +1,73 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Exponential smoothing of the GPU time, filters out single slow frames
+static const float s_SmoothingFactor = 0.1f;
+// Above the budget scale down right away, below this share of it grow back slowly
+static const float s_GrowThreshold = 0.85f;
+static const float s_GrowStep = 0.02f;
+// Ignore changes smaller than this, avoids resizing the viewport every frame
+static const float s_MinScaleChange = 0.01f;
+static const uint32_t s_CooldownFrames = 8;
+
+void DynamicResolution::Init(float gpuFrameBudgetMs, float minScale, float maxScale)
+{
+	m_BudgetMs = gpuFrameBudgetMs;
+	m_MinScale = std::min(minScale, maxScale);
+	m_MaxScale = maxScale;
+
+	m_Scale = m_MaxScale;
+	m_SmoothedGpuTimeMs = 0.0f;
+	m_HasSample = false;
+	m_Cooldown = 0;
+}
+
+void DynamicResolution::Update(float gpuFrameTimeMs)
+{
+	if (!m_HasSample)
+	{
+		m_SmoothedGpuTimeMs = gpuFrameTimeMs;
+		m_HasSample = true;
+	}
+	else
+	{
+		m_SmoothedGpuTimeMs += (gpuFrameTimeMs - m_SmoothedGpuTimeMs) * s_SmoothingFactor;
+	}
+
+	if (m_Cooldown > 0)
+	{
+		m_Cooldown--;
+		return;
+	}
+
+	float newScale = m_Scale;
+	if (m_SmoothedGpuTimeMs > m_BudgetMs)
+	{
+		// GPU time grows with the pixel count, i.e. with the square of the per axis scale
+		newScale = m_Scale * std::sqrt(m_BudgetMs / m_SmoothedGpuTimeMs);
+	}
+	else if (m_SmoothedGpuTimeMs < m_BudgetMs * s_GrowThreshold)
+	{
+		newScale = m_Scale + s_GrowStep;
+	}
+
+	newScale = std::min(std::max(newScale, m_MinScale), m_MaxScale);
+	if (std::fabs(newScale - m_Scale) >= s_MinScaleChange)
+	{
+		m_Scale = newScale;
+		m_Cooldown = s_CooldownFrames;
+	}
+}
+
+VkExtent2D DynamicResolution::GetRenderExtent(VkExtent2D fullExtent) const
+{
+	VkExtent2D extent;
+	extent.width = std::max(1u, static_cast<uint32_t>(fullExtent.width * m_Scale + 0.5f));
+	extent.height = std::max(1u, static_cast<uint32_t>(fullExtent.height * m_Scale + 0.5f));
+
+	extent.width = std::min(extent.width, fullExtent.width);
+	extent.height = std::min(extent.height, fullExtent.height);
+	return extent;
+}
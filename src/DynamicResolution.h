@@ -0,0 +1,37 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+
+// Picks the resolution scale of the scene target from measured GPU frame times,
+// so the frame time stays inside a fixed budget under varying load
+class DynamicResolution
+{
+public:
+	DynamicResolution() = default;
+
+	void Init(float gpuFrameBudgetMs, float minScale, float maxScale);
+
+	// Feed the GPU time of a finished frame (milliseconds)
+	void Update(float gpuFrameTimeMs);
+
+	float GetScale() const { return m_Scale; }
+	float GetSmoothedGpuTime() const { return m_SmoothedGpuTimeMs; }
+
+	// Scaled size of the render target (same aspect ratio, never empty)
+	VkExtent2D GetRenderExtent(VkExtent2D fullExtent) const;
+
+private:
+	float m_BudgetMs = 16.0f;
+	float m_MinScale = 0.5f;
+	float m_MaxScale = 1.0f;
+
+	float m_Scale = 1.0f;
+	float m_SmoothedGpuTimeMs = 0.0f;
+	bool m_HasSample = false;
+
+	// Frames to wait after a change before reacting again (the new scale needs a few frames to show in the timings)
+	uint32_t m_Cooldown = 0;
+};
@@ -0,0 +1,166 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+FrameStats::FrameStats()
+{
+	for (auto& history : m_History)
+	{
+		history.fill(0.0);
+	}
+	m_Scratch.reserve(FRAME_STATS_HISTORY);
+}
+
+void FrameStats::Push(const FrameSample& sample)
+{
+	uint32_t index = static_cast<uint32_t>(m_FrameCount % FRAME_STATS_HISTORY);
+	for (size_t i = 0; i < sample.Values.size(); i++)
+	{
+		m_History[i][index] = sample.Values[i];
+	}
+	m_FrameCount++;
+}
+
+uint32_t FrameStats::GetSampleCount() const
+{
+	return static_cast<uint32_t>(std::min<uint64_t>(m_FrameCount, FRAME_STATS_HISTORY));
+}
+
+double FrameStats::GetLast(FrameMetric metric) const
+{
+	if (m_FrameCount == 0)
+	{
+		return 0.0;
+	}
+	return m_History[static_cast<size_t>(metric)][RingIndex(0)];
+}
+
+double FrameStats::GetMin(FrameMetric metric, uint32_t window) const
+{
+	window = ClampWindow(window);
+	if (window == 0)
+	{
+		return 0.0;
+	}
+
+	const auto& history = m_History[static_cast<size_t>(metric)];
+	double minimum = std::numeric_limits<double>::max();
+	for (uint32_t age = 0; age < window; age++)
+	{
+		minimum = std::min(minimum, history[RingIndex(age)]);
+	}
+	return minimum;
+}
+
+double FrameStats::GetMax(FrameMetric metric, uint32_t window) const
+{
+	window = ClampWindow(window);
+	if (window == 0)
+	{
+		return 0.0;
+	}
+
+	const auto& history = m_History[static_cast<size_t>(metric)];
+	double maximum = std::numeric_limits<double>::lowest();
+	for (uint32_t age = 0; age < window; age++)
+	{
+		maximum = std::max(maximum, history[RingIndex(age)]);
+	}
+	return maximum;
+}
+
+double FrameStats::GetAverage(FrameMetric metric, uint32_t window) const
+{
+	window = ClampWindow(window);
+	if (window == 0)
+	{
+		return 0.0;
+	}
+
+	const auto& history = m_History[static_cast<size_t>(metric)];
+	double sum = 0.0;
+	for (uint32_t age = 0; age < window; age++)
+	{
+		sum += history[RingIndex(age)];
+	}
+	return sum / window;
+}
+
+double FrameStats::GetPercentile(FrameMetric metric, double percentile, uint32_t window) const
+{
+	window = ClampWindow(window);
+	if (window == 0)
+	{
+		return 0.0;
+	}
+
+	const auto& history = m_History[static_cast<size_t>(metric)];
+	m_Scratch.clear();
+	for (uint32_t age = 0; age < window; age++)
+	{
+		m_Scratch.push_back(history[RingIndex(age)]);
+	}
+
+	// Nearest rank, only the selected element has to be in place
+	size_t rank = static_cast<size_t>(std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100.0 * window));
+	size_t index = std::min(std::max(rank, static_cast<size_t>(1)), m_Scratch.size()) - 1;
+	std::nth_element(m_Scratch.begin(), m_Scratch.begin() + index, m_Scratch.end());
+	return m_Scratch[index];
+}
+
+bool FrameStats::LogSummary(std::ostream& out, double intervalSeconds, uint32_t window)
+{
+	auto now = std::chrono::steady_clock::now();
+	if (m_HasLogged && std::chrono::duration<double>(now - m_LastLogTime).count() < intervalSeconds)
+	{
+		return false;
+	}
+	if (ClampWindow(window) == 0)
+	{
+		return false;
+	}
+
+	m_LastLogTime = now;
+	m_HasLogged = true;
+
+	double averageFrameMs = GetAverage(FrameMetric::CpuFrameMs, window);
+	out << "Frame: " << averageFrameMs << "ms avg (" << (averageFrameMs > 0.0 ? 1000.0 / averageFrameMs : 0.0) << " FPS) p99: "
+		<< GetPercentile(FrameMetric::CpuFrameMs, 99.0, window) << "ms max: " << GetMax(FrameMetric::CpuFrameMs, window) << "ms"
+		<< "  / Wait frame: " << GetAverage(FrameMetric::FrameWaitMs, window) << "ms acquire: " << GetAverage(FrameMetric::AcquireWaitMs, window) << "ms"
+		<< "  / GPU: " << GetAverage(FrameMetric::GpuFrameMs, window) << "ms"
+		<< "  / Draws: " << GetAverage(FrameMetric::DrawCalls, window) << " occluded: " << GetAverage(FrameMetric::OccludedDraws, window)
+		<< " binds: " << GetAverage(FrameMetric::Binds, window)
+		<< " triangles: " << GetAverage(FrameMetric::Triangles, window)
+		<< "  / Uploaded: " << GetAverage(FrameMetric::BytesUploaded, window) / 1024.0 << "KB" << std::endl;
+	return true;
+}
+
+const char* FrameStats::GetMetricName(FrameMetric metric)
+{
+	switch (metric)
+	{
+	case FrameMetric::CpuFrameMs:		return "cpu_frame_ms";
+	case FrameMetric::FrameWaitMs:		return "frame_wait_ms";
+	case FrameMetric::AcquireWaitMs:	return "acquire_wait_ms";
+	case FrameMetric::GpuFrameMs:		return "gpu_frame_ms";
+	case FrameMetric::DrawCalls:		return "draw_calls";
+	case FrameMetric::OccludedDraws:	return "occluded_draws";
+	case FrameMetric::Binds:			return "binds";
+	case FrameMetric::Triangles:		return "triangles";
+	case FrameMetric::BytesUploaded:	return "bytes_uploaded";
+	default:							return "unknown";
+	}
+}
+
+uint32_t FrameStats::ClampWindow(uint32_t window) const
+{
+	uint32_t sampleCount = GetSampleCount();
+	return window == 0 ? sampleCount : std::min(window, sampleCount);
+}
+
+uint32_t FrameStats::RingIndex(uint32_t age) const
+{
+	return static_cast<uint32_t>((m_FrameCount - 1 - age) % FRAME_STATS_HISTORY);
+}
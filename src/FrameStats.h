@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+// Frames kept per metric, queries look at most this far back
+const uint32_t FRAME_STATS_HISTORY = 512;
+
+enum class FrameMetric
+{
+	CpuFrameMs,			// time between two Draw calls
+	FrameWaitMs,		// frame in flight timeline value
+	AcquireWaitMs,		// swapchain acquire and the timeline value of the acquired image
+	GpuFrameMs,			// last GPU frame time read back (a few frames late)
+	DrawCalls,
+	OccludedDraws,		// mesh parts skipped by occlusion culling
+	Binds,				// pipeline, descriptor set, buffer binds and push constants issued
+	Triangles,
+	BytesUploaded,		// host to device writes of the frame (uniform buffers)
+	Count
+};
+
+// One value per metric
+struct FrameSample
+{
+	std::array<double, static_cast<size_t>(FrameMetric::Count)> Values = {};
+
+	double& operator[](FrameMetric metric) { return Values[static_cast<size_t>(metric)]; }
+	double operator[](FrameMetric metric) const { return Values[static_cast<size_t>(metric)]; }
+};
+
+// Rolling per frame counters in fixed size ring buffers (no allocation after construction).
+// Window queries cover the last `window` frames (0 = the whole history).
+class FrameStats
+{
+public:
+	FrameStats();
+
+	void Push(const FrameSample& sample);
+
+	uint64_t GetFrameCount() const { return m_FrameCount; }
+	uint32_t GetSampleCount() const;
+
+	double GetLast(FrameMetric metric) const;
+	double GetMin(FrameMetric metric, uint32_t window = 0) const;
+	double GetMax(FrameMetric metric, uint32_t window = 0) const;
+	double GetAverage(FrameMetric metric, uint32_t window = 0) const;
+	// Nearest rank, percentile in [0, 100]
+	double GetPercentile(FrameMetric metric, double percentile, uint32_t window = 0) const;
+
+	// Write a one line summary of the last `window` frames, at most once per interval. True if written.
+	bool LogSummary(std::ostream& out, double intervalSeconds, uint32_t window = 0);
+
+	static const char* GetMetricName(FrameMetric metric);
+
+private:
+	uint32_t ClampWindow(uint32_t window) const;
+	// Index into the ring of the sample `age` frames back (0 = last)
+	uint32_t RingIndex(uint32_t age) const;
+
+private:
+	// One ring per metric, so window queries read contiguous memory
+	std::array<std::array<double, FRAME_STATS_HISTORY>, static_cast<size_t>(FrameMetric::Count)> m_History;
+	uint64_t m_FrameCount = 0;
+
+	// Percentile scratch space, sized once
+	mutable std::vector<double> m_Scratch;
+
+	std::chrono::steady_clock::time_point m_LastLogTime;
+	bool m_HasLogged = false;
+};
@@ -0,0 +1,713 @@
+#include "GltfModel.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cfloat>
+#include <cctype>
+
+#include "Trace.h"
+
+// GLB container
+static const uint32_t GLB_MAGIC = 0x46546C67;			// "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;		// "JSON"
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;		// "BIN\0"
+
+// Accessor component types
+static const uint32_t COMPONENT_BYTE = 5120;
+static const uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+static const uint32_t COMPONENT_SHORT = 5122;
+static const uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+static const uint32_t COMPONENT_UNSIGNED_INT = 5125;
+static const uint32_t COMPONENT_FLOAT = 5126;
+
+static const uint32_t PRIMITIVE_TRIANGLES = 4;
+static const uint32_t MAX_NODE_DEPTH = 256;
+
+static uint32_t GetComponentSize(uint32_t componentType)
+{
+	switch (componentType)
+	{
+	case COMPONENT_BYTE:
+	case COMPONENT_UNSIGNED_BYTE:
+		return 1;
+	case COMPONENT_SHORT:
+	case COMPONENT_UNSIGNED_SHORT:
+		return 2;
+	case COMPONENT_UNSIGNED_INT:
+	case COMPONENT_FLOAT:
+		return 4;
+	default:
+		throw std::runtime_error("Invalid glTF accessor component type!");
+	}
+}
+
+static uint32_t GetComponentCount(const std::string& type)
+{
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	if (type == "MAT2") return 4;
+	if (type == "MAT3") return 9;
+	if (type == "MAT4") return 16;
+	throw std::runtime_error("Invalid glTF accessor type: " + type);
+}
+
+// First count components of an element as floats (normalized integers mapped to [0, 1] or [-1, 1], missing ones zero)
+static void ReadElement(const GltfAccessor& accessor, uint32_t index, float* values, uint32_t count)
+{
+	uint32_t available = std::min(count, accessor.ComponentCount);
+	const uint8_t* element = accessor.Data ? accessor.Data + static_cast<size_t>(index) * accessor.Stride : nullptr;
+
+	if (element && accessor.ComponentType == COMPONENT_FLOAT)
+	{
+		memcpy(values, element, sizeof(float) * available);
+	}
+	else
+	{
+		for (uint32_t c = 0; c < available; c++)
+		{
+			float value = 0.0f;
+			if (element)
+			{
+				switch (accessor.ComponentType)
+				{
+				case COMPONENT_BYTE:
+				{
+					int8_t component = static_cast<int8_t>(element[c]);
+					value = accessor.Normalized ? std::max(component / 127.0f, -1.0f) : component;
+					break;
+				}
+				case COMPONENT_UNSIGNED_BYTE:
+					value = accessor.Normalized ? element[c] / 255.0f : element[c];
+					break;
+				case COMPONENT_SHORT:
+				{
+					int16_t component;
+					memcpy(&component, element + c * 2, sizeof(component));
+					value = accessor.Normalized ? std::max(component / 32767.0f, -1.0f) : component;
+					break;
+				}
+				case COMPONENT_UNSIGNED_SHORT:
+				{
+					uint16_t component;
+					memcpy(&component, element + c * 2, sizeof(component));
+					value = accessor.Normalized ? component / 65535.0f : component;
+					break;
+				}
+				case COMPONENT_UNSIGNED_INT:
+				{
+					uint32_t component;
+					memcpy(&component, element + c * 4, sizeof(component));
+					value = static_cast<float>(component);
+					break;
+				}
+				}
+			}
+			values[c] = value;
+		}
+	}
+
+	for (uint32_t c = available; c < count; c++)
+	{
+		values[c] = 0.0f;
+	}
+}
+
+static uint32_t ReadIndex(const GltfAccessor& accessor, uint32_t index)
+{
+	const uint8_t* element = accessor.Data + static_cast<size_t>(index) * accessor.Stride;
+	switch (accessor.ComponentType)
+	{
+	case COMPONENT_UNSIGNED_BYTE:
+		return element[0];
+	case COMPONENT_UNSIGNED_SHORT:
+	{
+		uint16_t value;
+		memcpy(&value, element, sizeof(value));
+		return value;
+	}
+	default:
+	{
+		uint32_t value;
+		memcpy(&value, element, sizeof(value));
+		return value;
+	}
+	}
+}
+
+// Every index has to name a vertex of its primitive
+static void ValidateIndices(const GltfAccessor& accessor, uint32_t indexCount, uint32_t vertexCount)
+{
+	// Accessors without a buffer view read as zeros
+	if (accessor.Data == nullptr)
+	{
+		if (indexCount > 0 && vertexCount == 0)
+		{
+			throw std::runtime_error("glTF index out of its primitive's vertices!");
+		}
+		return;
+	}
+
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		if (ReadIndex(accessor, i) >= vertexCount)
+		{
+			throw std::runtime_error("glTF index out of its primitive's vertices!");
+		}
+	}
+}
+
+static bool IsTightFloat(const GltfAccessor& accessor, uint32_t componentCount)
+{
+	return accessor.Data && accessor.ComponentType == COMPONENT_FLOAT && accessor.ComponentCount == componentCount
+		&& accessor.Stride == sizeof(float) * componentCount;
+}
+
+static std::vector<uint8_t> DecodeBase64(const char* text, size_t length)
+{
+	std::vector<uint8_t> data;
+	data.reserve(length / 4 * 3);
+
+	uint32_t bits = 0;
+	int bitCount = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		char character = text[i];
+		int value;
+		if (character >= 'A' && character <= 'Z') value = character - 'A';
+		else if (character >= 'a' && character <= 'z') value = character - 'a' + 26;
+		else if (character >= '0' && character <= '9') value = character - '0' + 52;
+		else if (character == '+' || character == '-') value = 62;
+		else if (character == '/' || character == '_') value = 63;
+		else if (character == '=') break;
+		else continue;
+
+		bits = (bits << 6) | static_cast<uint32_t>(value);
+		bitCount += 6;
+		if (bitCount >= 8)
+		{
+			bitCount -= 8;
+			data.push_back(static_cast<uint8_t>((bits >> bitCount) & 0xFF));
+		}
+	}
+
+	return data;
+}
+
+// Relative URIs may be percent encoded ("my%20model.bin")
+static std::string DecodeUri(const std::string& uri)
+{
+	std::string path;
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size())
+		{
+			path.push_back(static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16)));
+			i += 2;
+		}
+		else
+		{
+			path.push_back(uri[i]);
+		}
+	}
+	return path;
+}
+
+static bool IsDataUri(const std::string& uri)
+{
+	return uri.compare(0, 5, "data:") == 0;
+}
+
+static std::vector<uint8_t> DecodeDataUri(const std::string& uri)
+{
+	size_t comma = uri.find(',');
+	if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos)
+	{
+		throw std::runtime_error("Unsupported glTF data URI!");
+	}
+	return DecodeBase64(uri.data() + comma + 1, uri.size() - comma - 1);
+}
+
+bool GltfModel::IsGltfFile(const std::string& filepath)
+{
+	size_t dot = filepath.rfind('.');
+	if (dot == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string extension = filepath.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+	return extension == "gltf" || extension == "glb";
+}
+
+void GltfModel::Load(const std::string& filepath)
+{
+	TRACE_FUNCTION();
+
+	if (!m_File.Open(filepath))
+	{
+		throw std::runtime_error("Failed to open glTF file: " + filepath);
+	}
+
+	std::string directory;
+	size_t lastSlash = filepath.find_last_of("/\\");
+	if (lastSlash != std::string::npos)
+	{
+		directory = filepath.substr(0, lastSlash + 1);
+	}
+
+	// GLB: 12 byte header, then the JSON chunk and an optional binary chunk (the first buffer)
+	const uint8_t* fileData = m_File.GetData();
+	size_t fileSize = m_File.GetSize();
+	const char* json = reinterpret_cast<const char*>(fileData);
+	size_t jsonSize = fileSize;
+	BufferRange binaryChunk = { nullptr, 0 };
+
+	uint32_t magic = 0;
+	if (fileSize >= 12)
+	{
+		memcpy(&magic, fileData, sizeof(magic));
+	}
+	if (magic == GLB_MAGIC)
+	{
+		json = nullptr;
+		size_t offset = 12;
+		while (offset + 8 <= fileSize)
+		{
+			uint32_t chunkHeader[2];
+			memcpy(chunkHeader, fileData + offset, sizeof(chunkHeader));
+			offset += 8;
+			if (chunkHeader[0] > fileSize - offset)
+			{
+				throw std::runtime_error("Truncated GLB chunk: " + filepath);
+			}
+
+			if (chunkHeader[1] == GLB_CHUNK_JSON && json == nullptr)
+			{
+				json = reinterpret_cast<const char*>(fileData + offset);
+				jsonSize = chunkHeader[0];
+			}
+			else if (chunkHeader[1] == GLB_CHUNK_BIN && binaryChunk.Data == nullptr)
+			{
+				binaryChunk = { fileData + offset, chunkHeader[0] };
+			}
+			offset += (chunkHeader[0] + 3) & ~3u;
+		}
+
+		if (json == nullptr)
+		{
+			throw std::runtime_error("GLB file without a JSON chunk: " + filepath);
+		}
+	}
+
+	m_Document = JsonValue::Parse(json, jsonSize);
+	const std::string& version = m_Document["asset"]["version"].GetString();
+	if (version.empty() || version[0] != '2')
+	{
+		throw std::runtime_error("Unsupported glTF version (" + version + "): " + filepath);
+	}
+
+	LoadBuffers(directory, binaryChunk);
+	LoadImages(directory);
+
+	// Nodes of the default scene (scene 0 when none is set)
+	const JsonValue& scene = m_Document["scenes"].At(m_Document["scene"].GetUint(0));
+	const JsonValue& sceneNodes = scene["nodes"];
+	for (size_t i = 0; i < sceneNodes.Size(); i++)
+	{
+		LoadNode(sceneNodes.At(i).GetUint(), glm::mat4(1.0f), 0);
+	}
+}
+
+void GltfModel::LoadBuffers(const std::string& directory, BufferRange binaryChunk)
+{
+	const JsonValue& buffers = m_Document["buffers"];
+	m_DecodedData.reserve(buffers.Size());
+	for (size_t i = 0; i < buffers.Size(); i++)
+	{
+		const JsonValue& buffer = buffers.At(i);
+		size_t byteLength = static_cast<size_t>(buffer["byteLength"].GetNumber());
+
+		BufferRange range = { nullptr, 0 };
+		if (!buffer.Has("uri"))
+		{
+			// Binary chunk of the GLB (may be padded past byteLength)
+			range = binaryChunk;
+		}
+		else if (IsDataUri(buffer["uri"].GetString()))
+		{
+			m_DecodedData.push_back(DecodeDataUri(buffer["uri"].GetString()));
+			range = { m_DecodedData.back().data(), m_DecodedData.back().size() };
+		}
+		else
+		{
+			std::string path = directory + DecodeUri(buffer["uri"].GetString());
+			std::unique_ptr<MappedFile> bufferFile(new MappedFile());
+			if (!bufferFile->Open(path))
+			{
+				throw std::runtime_error("Failed to open glTF buffer: " + path);
+			}
+			range = { bufferFile->GetData(), bufferFile->GetSize() };
+			m_BufferFiles.push_back(std::move(bufferFile));
+		}
+
+		if (range.Data == nullptr || range.Size < byteLength)
+		{
+			throw std::runtime_error("glTF buffer " + std::to_string(i) + " is missing or too short!");
+		}
+		m_Buffers.push_back(range);
+	}
+}
+
+void GltfModel::LoadImages(const std::string& directory)
+{
+	const JsonValue& images = m_Document["images"];
+	for (size_t i = 0; i < images.Size(); i++)
+	{
+		const JsonValue& image = images.At(i);
+
+		GltfImage gltfImage;
+		if (image.Has("bufferView"))
+		{
+			BufferRange range = GetBufferView(image["bufferView"].GetUint());
+			gltfImage.Data = range.Data;
+			gltfImage.Size = range.Size;
+		}
+		else if (IsDataUri(image["uri"].GetString()))
+		{
+			m_DecodedData.push_back(DecodeDataUri(image["uri"].GetString()));
+			gltfImage.Data = m_DecodedData.back().data();
+			gltfImage.Size = m_DecodedData.back().size();
+		}
+		else
+		{
+			gltfImage.Path = directory + DecodeUri(image["uri"].GetString());
+		}
+
+		m_Images.push_back(gltfImage);
+	}
+}
+
+void GltfModel::LoadNode(uint32_t node, const glm::mat4& parentTransform, uint32_t depth)
+{
+	// Nodes form trees, a deeper chain can only come from a cycle
+	if (depth > MAX_NODE_DEPTH)
+	{
+		throw std::runtime_error("glTF node hierarchy is too deep (or has a cycle)!");
+	}
+
+	const JsonValue& nodeValue = m_Document["nodes"].At(node);
+	if (nodeValue.IsNull())
+	{
+		throw std::runtime_error("Invalid glTF node index!");
+	}
+
+	// Matrix (column major, like glm) or translation, rotation (x, y, z, w) and scale
+	glm::mat4 localTransform(1.0f);
+	const JsonValue& matrix = nodeValue["matrix"];
+	if (matrix.Size() == 16)
+	{
+		float values[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			values[i] = static_cast<float>(matrix.At(i).GetNumber());
+		}
+		localTransform = glm::make_mat4(values);
+	}
+	else
+	{
+		const JsonValue& translation = nodeValue["translation"];
+		const JsonValue& rotation = nodeValue["rotation"];
+		const JsonValue& scale = nodeValue["scale"];
+		glm::vec3 t(translation.At(0).GetNumber(), translation.At(1).GetNumber(), translation.At(2).GetNumber());
+		glm::quat r(static_cast<float>(rotation.At(3).GetNumber(1.0)), static_cast<float>(rotation.At(0).GetNumber()),
+			static_cast<float>(rotation.At(1).GetNumber()), static_cast<float>(rotation.At(2).GetNumber()));
+		glm::vec3 s(scale.At(0).GetNumber(1.0), scale.At(1).GetNumber(1.0), scale.At(2).GetNumber(1.0));
+		localTransform = glm::translate(glm::mat4(1.0f), t) * glm::mat4_cast(r) * glm::scale(glm::mat4(1.0f), s);
+	}
+	glm::mat4 transform = parentTransform * localTransform;
+
+	if (nodeValue.Has("mesh"))
+	{
+		uint32_t mesh = nodeValue["mesh"].GetUint();
+		const JsonValue& primitives = m_Document["meshes"].At(mesh)["primitives"];
+		for (size_t p = 0; p < primitives.Size(); p++)
+		{
+			const JsonValue& primitiveValue = primitives.At(p);
+			const JsonValue& attributes = primitiveValue["attributes"];
+			if (primitiveValue["mode"].GetUint(PRIMITIVE_TRIANGLES) != PRIMITIVE_TRIANGLES || !attributes.Has("POSITION"))
+			{
+				continue;
+			}
+
+			GltfPrimitive primitive = {};
+			primitive.Mesh = mesh;
+			primitive.Primitive = static_cast<uint32_t>(p);
+			primitive.Transform = transform;
+			primitive.FlipWinding = glm::determinant(glm::mat3(transform)) < 0.0f;
+			primitive.Material = primitiveValue.Has("material") ? static_cast<int32_t>(primitiveValue["material"].GetUint()) : -1;
+
+			GltfAccessor positions = GetAccessor(attributes["POSITION"].GetUint());
+			primitive.VertexCount = positions.Count;
+			primitive.IndexCount = primitiveValue.Has("indices") ? GetAccessor(primitiveValue["indices"].GetUint()).Count : positions.Count;
+			primitive.IndexCount -= primitive.IndexCount % 3;
+
+			// The occluder rasterizer and the GPU read the indices unchecked, so a bad file is rejected here (before any buffer exists)
+			if (primitiveValue.Has("indices"))
+			{
+				ValidateIndices(GetAccessor(primitiveValue["indices"].GetUint()), primitive.IndexCount, primitive.VertexCount);
+			}
+
+			// Model space box of the corners of the accessor bounds (required for positions, scanned when missing)
+			const JsonValue& accessorValue = m_Document["accessors"].At(attributes["POSITION"].GetUint());
+			glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+			if (accessorValue["min"].Size() == 3 && accessorValue["max"].Size() == 3)
+			{
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					boundsMin[c] = static_cast<float>(accessorValue["min"].At(c).GetNumber());
+					boundsMax[c] = static_cast<float>(accessorValue["max"].At(c).GetNumber());
+				}
+			}
+			else
+			{
+				for (uint32_t i = 0; i < positions.Count; i++)
+				{
+					glm::vec3 position;
+					ReadElement(positions, i, &position.x, 3);
+					boundsMin = glm::min(boundsMin, position);
+					boundsMax = glm::max(boundsMax, position);
+				}
+			}
+
+			primitive.BoundsMin = glm::vec3(FLT_MAX);
+			primitive.BoundsMax = glm::vec3(-FLT_MAX);
+			for (uint32_t corner = 0; corner < 8; corner++)
+			{
+				glm::vec3 point((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y,
+					(corner & 4) ? boundsMax.z : boundsMin.z);
+				glm::vec3 transformed = glm::vec3(transform * glm::vec4(point, 1.0f));
+				primitive.BoundsMin = glm::min(primitive.BoundsMin, transformed);
+				primitive.BoundsMax = glm::max(primitive.BoundsMax, transformed);
+			}
+
+			m_Primitives.push_back(primitive);
+		}
+	}
+
+	const JsonValue& children = nodeValue["children"];
+	for (size_t i = 0; i < children.Size(); i++)
+	{
+		LoadNode(children.At(i).GetUint(), transform, depth + 1);
+	}
+}
+
+GltfModel::BufferRange GltfModel::GetBufferView(uint32_t bufferView) const
+{
+	const JsonValue& view = m_Document["bufferViews"].At(bufferView);
+	uint32_t buffer = view["buffer"].GetUint(UINT32_MAX);
+	if (buffer >= m_Buffers.size())
+	{
+		throw std::runtime_error("Invalid glTF buffer view!");
+	}
+
+	size_t offset = static_cast<size_t>(view["byteOffset"].GetNumber());
+	size_t length = static_cast<size_t>(view["byteLength"].GetNumber());
+	if (offset > m_Buffers[buffer].Size || length > m_Buffers[buffer].Size - offset)
+	{
+		throw std::runtime_error("glTF buffer view out of its buffer!");
+	}
+
+	return { m_Buffers[buffer].Data + offset, length };
+}
+
+GltfAccessor GltfModel::GetAccessor(uint32_t accessor) const
+{
+	const JsonValue& accessorValue = m_Document["accessors"].At(accessor);
+	if (accessorValue.IsNull())
+	{
+		throw std::runtime_error("Invalid glTF accessor index!");
+	}
+	if (accessorValue.Has("sparse"))
+	{
+		throw std::runtime_error("Sparse glTF accessors are not supported!");
+	}
+
+	GltfAccessor result;
+	result.Count = accessorValue["count"].GetUint();
+	result.ComponentType = accessorValue["componentType"].GetUint();
+	result.ComponentCount = GetComponentCount(accessorValue["type"].GetString());
+	result.Normalized = accessorValue["normalized"].GetBool();
+
+	uint32_t elementSize = GetComponentSize(result.ComponentType) * result.ComponentCount;
+	result.Stride = elementSize;
+	if (!accessorValue.Has("bufferView"))
+	{
+		return result;
+	}
+
+	uint32_t bufferView = accessorValue["bufferView"].GetUint();
+	BufferRange view = GetBufferView(bufferView);
+	uint32_t byteStride = m_Document["bufferViews"].At(bufferView)["byteStride"].GetUint();
+	if (byteStride != 0)
+	{
+		result.Stride = byteStride;
+	}
+
+	// Every element must be inside the view
+	size_t offset = static_cast<size_t>(accessorValue["byteOffset"].GetNumber());
+	if (result.Count > 0 && (offset > view.Size ||
+		static_cast<size_t>(result.Count - 1) * result.Stride + elementSize > view.Size - offset))
+	{
+		throw std::runtime_error("glTF accessor out of its buffer view!");
+	}
+
+	result.Data = view.Data + offset;
+	return result;
+}
+
+GltfAccessor GltfModel::GetAttribute(const GltfPrimitive& primitive, const char* name) const
+{
+	const JsonValue& attribute = m_Document["meshes"].At(primitive.Mesh)["primitives"].At(primitive.Primitive)["attributes"][name];
+	return attribute.IsNull() ? GltfAccessor() : GetAccessor(attribute.GetUint());
+}
+
+int32_t GltfModel::GetMaterialImage(int32_t material) const
+{
+	if (material < 0)
+	{
+		return -1;
+	}
+
+	const JsonValue& textureInfo = m_Document["materials"].At(material)["pbrMetallicRoughness"]["baseColorTexture"];
+	if (textureInfo.IsNull())
+	{
+		return -1;
+	}
+
+	const JsonValue& texture = m_Document["textures"].At(textureInfo["index"].GetUint());
+	uint32_t image = texture["source"].GetUint(UINT32_MAX);
+	return image < m_Images.size() ? static_cast<int32_t>(image) : -1;
+}
+
+void GltfModel::WriteVertices(const GltfPrimitive& primitive, Vertex* vertices) const
+{
+	TRACE_FUNCTION();
+
+	GltfAccessor positions = GetAttribute(primitive, "POSITION");
+	GltfAccessor colors = GetAttribute(primitive, "COLOR_0");
+	GltfAccessor textureCoords = GetAttribute(primitive, "TEXCOORD_0");
+	GltfAccessor normals = GetAttribute(primitive, "NORMAL");
+	bool identity = primitive.Transform == glm::mat4(1.0f);
+
+	// Interleaved exactly like Vertex (same view, stride and offsets): one copy of the whole block
+	if (identity && positions.Data && positions.Stride == sizeof(Vertex) && positions.ComponentType == COMPONENT_FLOAT
+		&& colors.Data == positions.Data + offsetof(Vertex, Color) && colors.ComponentType == COMPONENT_FLOAT && colors.ComponentCount == 3
+		&& textureCoords.Data == positions.Data + offsetof(Vertex, TextureCoords) && textureCoords.ComponentType == COMPONENT_FLOAT
+		&& normals.Data == positions.Data + offsetof(Vertex, Normal) && normals.ComponentType == COMPONENT_FLOAT
+		&& colors.Stride == sizeof(Vertex) && textureCoords.Stride == sizeof(Vertex) && normals.Stride == sizeof(Vertex))
+	{
+		memcpy(vertices, positions.Data, sizeof(Vertex) * primitive.VertexCount);
+		return;
+	}
+
+	// Otherwise every vertex is gathered from the streams and written whole, in order (staging memory is usually
+	// write-combined, partial or scattered writes would be slow)
+	glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(primitive.Transform)));
+	for (uint32_t i = 0; i < primitive.VertexCount; i++)
+	{
+		Vertex vertex;
+		ReadElement(positions, i, &vertex.Position.x, 3);
+
+		// White without vertex colors (alpha is dropped)
+		if (colors.Data)
+		{
+			ReadElement(colors, i, &vertex.Color.x, 3);
+		}
+		else
+		{
+			vertex.Color = glm::vec3(1.0f);
+		}
+
+		ReadElement(textureCoords, i, &vertex.TextureCoords.x, 2);
+
+		// Zero = unlit, ambient only
+		ReadElement(normals, i, &vertex.Normal.x, 3);
+
+		if (!identity)
+		{
+			vertex.Position = glm::vec3(primitive.Transform * glm::vec4(vertex.Position, 1.0f));
+			if (normals.Data)
+			{
+				vertex.Normal = glm::normalize(normalTransform * vertex.Normal);
+			}
+		}
+
+		vertices[i] = vertex;
+	}
+}
+
+void GltfModel::WriteIndices(const GltfPrimitive& primitive, uint32_t* indices) const
+{
+	TRACE_FUNCTION();
+
+	const JsonValue& indicesValue = m_Document["meshes"].At(primitive.Mesh)["primitives"].At(primitive.Primitive)["indices"];
+	if (indicesValue.IsNull())
+	{
+		// Not indexed: every three vertices are a triangle
+		for (uint32_t i = 0; i < primitive.IndexCount; i += 3)
+		{
+			indices[i] = i;
+			indices[i + 1] = primitive.FlipWinding ? i + 2 : i + 1;
+			indices[i + 2] = primitive.FlipWinding ? i + 1 : i + 2;
+		}
+		return;
+	}
+
+	// 32 bit and tightly packed: already the GPU layout (every index was checked against the vertex count on load)
+	GltfAccessor accessor = GetAccessor(indicesValue.GetUint());
+	if (!primitive.FlipWinding && accessor.Data && accessor.ComponentType == COMPONENT_UNSIGNED_INT && accessor.Stride == sizeof(uint32_t))
+	{
+		memcpy(indices, accessor.Data, sizeof(uint32_t) * primitive.IndexCount);
+		return;
+	}
+
+	if (accessor.Data == nullptr)
+	{
+		memset(indices, 0, sizeof(uint32_t) * primitive.IndexCount);
+		return;
+	}
+
+	for (uint32_t i = 0; i < primitive.IndexCount; i += 3)
+	{
+		indices[i] = ReadIndex(accessor, i);
+		indices[i + 1] = ReadIndex(accessor, primitive.FlipWinding ? i + 2 : i + 1);
+		indices[i + 2] = ReadIndex(accessor, primitive.FlipWinding ? i + 1 : i + 2);
+	}
+}
+
+void GltfModel::WritePositions(const GltfPrimitive& primitive, glm::vec3* positions) const
+{
+	GltfAccessor accessor = GetAttribute(primitive, "POSITION");
+	bool identity = primitive.Transform == glm::mat4(1.0f);
+	if (identity && IsTightFloat(accessor, 3))
+	{
+		memcpy(positions, accessor.Data, sizeof(glm::vec3) * primitive.VertexCount);
+		return;
+	}
+
+	for (uint32_t i = 0; i < primitive.VertexCount; i++)
+	{
+		glm::vec3 position;
+		ReadElement(accessor, i, &position.x, 3);
+		positions[i] = identity ? position : glm::vec3(primitive.Transform * glm::vec4(position, 1.0f));
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "Json.h"
+#include "MappedFile.h"
+#include "Utils.h"
+
+// Triangle list of a glTF mesh as placed by one node (node transforms are baked into the vertices, like the Assimp path)
+struct GltfPrimitive
+{
+	uint32_t Mesh;
+	uint32_t Primitive;
+	glm::mat4 Transform;
+	bool FlipWinding;			// mirroring transform, triangles are written in reverse order
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	int32_t Material;			// -1 = none
+	glm::vec3 BoundsMin;		// model space
+	glm::vec3 BoundsMax;
+};
+
+// Image of a material: a file next to the model, or encoded bytes inside a buffer (decoded straight from the mapping)
+struct GltfImage
+{
+	std::string Path;
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+};
+
+// Typed view of an accessor's elements inside a buffer
+struct GltfAccessor
+{
+	const uint8_t* Data = nullptr;		// nullptr = no buffer view, every element is zero
+	uint32_t Count = 0;
+	uint32_t ComponentType = 0;
+	uint32_t ComponentCount = 0;
+	uint32_t Stride = 0;
+	bool Normalized = false;
+};
+
+// glTF 2.0 model (.glb, or .gltf with external or data URI buffers). Files are memory mapped and the accessors are
+// read in place: the Write functions gather straight from the mapping into the caller's (staging) memory, accessors
+// already in the GPU layout are copied with a single memcpy. Nothing is kept but the parsed JSON and the mappings.
+class GltfModel
+{
+public:
+	GltfModel() = default;
+
+	// Default scene only, triangle primitives (skins and morph targets are ignored). Throws on invalid files
+	void Load(const std::string& filepath);
+	static bool IsGltfFile(const std::string& filepath);
+
+	const std::vector<GltfPrimitive>& GetPrimitives() const { return m_Primitives; }
+	const std::vector<GltfImage>& GetImages() const { return m_Images; }
+	// Base color image of a material (-1 = none)
+	int32_t GetMaterialImage(int32_t material) const;
+
+	void WriteVertices(const GltfPrimitive& primitive, Vertex* vertices) const;
+	void WriteIndices(const GltfPrimitive& primitive, uint32_t* indices) const;
+	void WritePositions(const GltfPrimitive& primitive, glm::vec3* positions) const;
+
+private:
+	struct BufferRange
+	{
+		const uint8_t* Data;
+		size_t Size;
+	};
+
+	void LoadBuffers(const std::string& directory, BufferRange binaryChunk);
+	void LoadImages(const std::string& directory);
+	void LoadNode(uint32_t node, const glm::mat4& parentTransform, uint32_t depth);
+
+	GltfAccessor GetAccessor(uint32_t accessor) const;
+	GltfAccessor GetAttribute(const GltfPrimitive& primitive, const char* name) const;
+	BufferRange GetBufferView(uint32_t bufferView) const;
+
+private:
+	JsonValue m_Document;
+	MappedFile m_File;
+	std::vector<std::unique_ptr<MappedFile>> m_BufferFiles;		// external buffers
+	std::vector<std::vector<uint8_t>> m_DecodedData;			// base64 data URIs (the only copies)
+	std::vector<BufferRange> m_Buffers;
+
+	std::vector<GltfPrimitive> m_Primitives;
+	std::vector<GltfImage> m_Images;
+};
@@ -0,0 +1,267 @@
+#include "GpuProfiler.h"
+
+#include <stdexcept>
+
+#include "Utils.h"
+
+// Statistics read back per frame, in the order Vulkan writes them (ascending bit order)
+static const VkQueryPipelineStatisticFlags s_PipelineStatistics =
+	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+static const uint32_t s_PipelineStatisticCount = 4;
+
+void GpuProfiler::Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, bool pipelineStatistics)
+{
+	m_Device = device;
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyList.data());
+
+	// Without valid timestamp bits the profiler records nothing (and dynamic resolution stays at its maximum)
+	uint32_t timestampValidBits = queueFamilyList[queueFamily].timestampValidBits;
+	m_TimestampsSupported = timestampValidBits > 0 && deviceProperties.limits.timestampPeriod > 0.0f;
+	m_TimestampPeriod = deviceProperties.limits.timestampPeriod;
+	m_TimestampMask = timestampValidBits >= 64 ? ~0ull : ((1ull << timestampValidBits) - 1);
+	m_StatisticsSupported = pipelineStatistics;
+
+	m_Frames.resize(framesInFlight);
+	if (!m_TimestampsSupported)
+	{
+		return;
+	}
+
+	VkQueryPoolCreateInfo timestampPoolCreateInfo = {};
+	timestampPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	timestampPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	timestampPoolCreateInfo.queryCount = 2 + GPU_PROFILER_MAX_SCOPES * 2;
+
+	VkQueryPoolCreateInfo statisticsPoolCreateInfo = {};
+	statisticsPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	statisticsPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	statisticsPoolCreateInfo.queryCount = 1;
+	statisticsPoolCreateInfo.pipelineStatistics = s_PipelineStatistics;
+
+	for (FrameQueries& frame : m_Frames)
+	{
+		if (vkCreateQueryPool(m_Device, &timestampPoolCreateInfo, nullptr, &frame.TimestampPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create timestamp query pool!");
+		}
+
+		if (m_StatisticsSupported &&
+			vkCreateQueryPool(m_Device, &statisticsPoolCreateInfo, nullptr, &frame.StatisticsPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline statistics query pool!");
+		}
+
+		frame.ScopeNames.reserve(GPU_PROFILER_MAX_SCOPES);
+	}
+
+	// Upload timing: the one-off command buffer helpers write into this pool while it is set
+	VkQueryPoolCreateInfo uploadPoolCreateInfo = timestampPoolCreateInfo;
+	uploadPoolCreateInfo.queryCount = 2;
+	if (vkCreateQueryPool(m_Device, &uploadPoolCreateInfo, nullptr, &m_UploadPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upload timestamp query pool!");
+	}
+}
+
+void GpuProfiler::Destroy()
+{
+	UploadTimer& uploadTimer = GetUploadTimer();
+	uploadTimer.QueryPool = VK_NULL_HANDLE;
+
+	for (FrameQueries& frame : m_Frames)
+	{
+		if (frame.TimestampPool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(m_Device, frame.TimestampPool, nullptr);
+		if (frame.StatisticsPool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(m_Device, frame.StatisticsPool, nullptr);
+	}
+	m_Frames.clear();
+
+	if (m_UploadPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(m_Device, m_UploadPool, nullptr);
+		m_UploadPool = VK_NULL_HANDLE;
+	}
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	m_Recording = nullptr;
+	if (!m_TimestampsSupported)
+	{
+		return;
+	}
+
+	FrameQueries& frame = m_Frames[frameIndex];
+	frame.ScopeNames.clear();
+	frame.FrameNumber = m_FrameCounter++;
+	frame.Written = false;
+	m_Recording = &frame;
+
+	// Pools are reset in the command buffer, so nothing has to wait on the CPU
+	vkCmdResetQueryPool(commandBuffer, frame.TimestampPool, 0, 2 + GPU_PROFILER_MAX_SCOPES * 2);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.TimestampPool, 0);
+
+	if (frame.StatisticsPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, frame.StatisticsPool, 0, 1);
+		vkCmdBeginQuery(commandBuffer, frame.StatisticsPool, 0, 0);
+		frame.StatisticsActive = true;
+	}
+}
+
+void GpuProfiler::EndFrame(VkCommandBuffer commandBuffer)
+{
+	if (m_Recording == nullptr)
+	{
+		return;
+	}
+
+	EndPipelineStatistics(commandBuffer);
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Recording->TimestampPool, 1);
+	m_Recording->Written = true;
+	m_Recording = nullptr;
+}
+
+void GpuProfiler::EndPipelineStatistics(VkCommandBuffer commandBuffer)
+{
+	if (m_Recording == nullptr || !m_Recording->StatisticsActive)
+	{
+		return;
+	}
+
+	vkCmdEndQuery(commandBuffer, m_Recording->StatisticsPool, 0);
+	m_Recording->StatisticsActive = false;
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (m_Recording == nullptr || m_Recording->ScopeNames.size() >= GPU_PROFILER_MAX_SCOPES)
+	{
+		return UINT32_MAX;
+	}
+
+	uint32_t scope = static_cast<uint32_t>(m_Recording->ScopeNames.size());
+	m_Recording->ScopeNames.push_back(name);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_Recording->TimestampPool, 2 + scope * 2);
+	return scope;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+	if (m_Recording == nullptr || scope >= m_Recording->ScopeNames.size())
+	{
+		return;
+	}
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Recording->TimestampPool, 2 + scope * 2 + 1);
+}
+
+bool GpuProfiler::ReadResults(uint32_t frameIndex)
+{
+	if (!m_TimestampsSupported)
+	{
+		return false;
+	}
+
+	FrameQueries& frame = m_Frames[frameIndex];
+	if (!frame.Written)
+	{
+		return false;
+	}
+
+	// No WAIT flag: VK_NOT_READY means the frame is still running, keep the previous results
+	uint32_t queryCount = 2 + static_cast<uint32_t>(frame.ScopeNames.size()) * 2;
+	uint64_t timestamps[2 + GPU_PROFILER_MAX_SCOPES * 2] = {};
+	VkResult result = vkGetQueryPoolResults(m_Device, frame.TimestampPool, 0, queryCount, sizeof(timestamps), timestamps,
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	m_LastStats.Valid = true;
+	m_LastStats.FrameNumber = frame.FrameNumber;
+	m_LastStats.FrameMs = TicksToMs(timestamps[0], timestamps[1]);
+	m_LastStats.BusyMs = 0.0;
+	m_LastStats.Scopes.resize(frame.ScopeNames.size());
+	for (size_t i = 0; i < frame.ScopeNames.size(); i++)
+	{
+		m_LastStats.Scopes[i].Name = frame.ScopeNames[i];
+		m_LastStats.Scopes[i].Milliseconds = TicksToMs(timestamps[2 + i * 2], timestamps[2 + i * 2 + 1]);
+		m_LastStats.BusyMs += m_LastStats.Scopes[i].Milliseconds;
+	}
+
+	m_LastStats.HasPipelineStatistics = false;
+	if (frame.StatisticsPool != VK_NULL_HANDLE)
+	{
+		uint64_t statistics[s_PipelineStatisticCount] = {};
+		result = vkGetQueryPoolResults(m_Device, frame.StatisticsPool, 0, 1, sizeof(statistics), statistics,
+			sizeof(statistics), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS)
+		{
+			m_LastStats.HasPipelineStatistics = true;
+			m_LastStats.VertexInvocations = statistics[0];
+			m_LastStats.ClippingInvocations = statistics[1];
+			m_LastStats.ClippingPrimitives = statistics[2];
+			m_LastStats.FragmentInvocations = statistics[3];
+		}
+	}
+
+	frame.Written = false;
+	return true;
+}
+
+void GpuProfiler::BeginUploadBatch(const std::string& name)
+{
+	if (m_UploadPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	UploadTimer& uploadTimer = GetUploadTimer();
+	if (m_UploadStack.empty())
+	{
+		uploadTimer.QueryPool = m_UploadPool;
+		uploadTimer.TimestampPeriod = m_TimestampPeriod;
+		uploadTimer.TimestampMask = m_TimestampMask;
+	}
+
+	m_UploadStack.push_back({ name, uploadTimer.TotalMs, uploadTimer.Submits });
+}
+
+void GpuProfiler::EndUploadBatch()
+{
+	if (m_UploadStack.empty())
+	{
+		return;
+	}
+
+	UploadTimer& uploadTimer = GetUploadTimer();
+	const UploadBatch& batch = m_UploadStack.back();
+	m_UploadTimes.push_back({ batch.Name, uploadTimer.TotalMs - batch.StartMs, uploadTimer.Submits - batch.StartSubmits });
+	m_UploadStack.pop_back();
+
+	// Outside of batches the helpers run without timestamps
+	if (m_UploadStack.empty())
+	{
+		uploadTimer.QueryPool = VK_NULL_HANDLE;
+	}
+}
+
+double GpuProfiler::TicksToMs(uint64_t begin, uint64_t end) const
+{
+	uint64_t ticks = (end - begin) & m_TimestampMask;
+	return static_cast<double>(ticks) * m_TimestampPeriod / 1000000.0;
+}
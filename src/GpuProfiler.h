@@ -0,0 +1,109 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Timestamp scopes recorded per frame (each uses 2 queries)
+const int GPU_PROFILER_MAX_SCOPES = 16;
+
+struct GpuScopeTime
+{
+	const char* Name;			// string literal passed to BeginScope
+	double Milliseconds;
+};
+
+// GPU results of one frame, read back once its timeline value is reached (FramesInFlight frames late)
+struct GpuFrameStats
+{
+	bool Valid = false;
+	uint64_t FrameNumber = 0;		// BeginFrame call the results belong to
+	double FrameMs = 0.0;
+	double BusyMs = 0.0;			// sum of the scopes (with async compute FrameMs also spans the next frame's geometry)
+	std::vector<GpuScopeTime> Scopes;
+
+	// Pipeline statistics of the whole frame (only if the device supports them)
+	bool HasPipelineStatistics = false;
+	uint64_t VertexInvocations = 0;
+	uint64_t ClippingInvocations = 0;
+	uint64_t ClippingPrimitives = 0;
+	uint64_t FragmentInvocations = 0;
+};
+
+// GPU time of one upload batch (one-off command buffers submitted between BeginUploadBatch and EndUploadBatch)
+struct GpuUploadTime
+{
+	std::string Name;
+	double Milliseconds;
+	uint32_t Submits;
+};
+
+// Timestamp and pipeline statistics queries, one set of query pools per frame in flight.
+// Results are fetched without waiting: a frame is only read back once the GPU has finished it.
+class GpuProfiler
+{
+public:
+	GpuProfiler() = default;
+
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, bool pipelineStatistics);
+	void Destroy();
+
+	bool IsSupported() const { return m_TimestampsSupported; }
+	double GetTimestampPeriod() const { return m_TimestampPeriod; }
+
+	// Recording (frameIndex = frame in flight the command buffer belongs to)
+	void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+	void EndFrame(VkCommandBuffer commandBuffer);
+	// A query cannot span command buffers: ends the statistics before the frame moves to another one (EndFrame does otherwise)
+	void EndPipelineStatistics(VkCommandBuffer commandBuffer);
+	uint32_t BeginScope(VkCommandBuffer commandBuffer, const char* name);
+	void EndScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+	// Fetch the results of a frame in flight (call once the frame's timeline value is reached), false if nothing new
+	bool ReadResults(uint32_t frameIndex);
+	const GpuFrameStats& GetLastFrameStats() const { return m_LastStats; }
+
+	// Upload batches (nestable), timed inside the one-off command buffers of Utils.h
+	void BeginUploadBatch(const std::string& name);
+	void EndUploadBatch();
+	const std::vector<GpuUploadTime>& GetUploadTimes() const { return m_UploadTimes; }
+
+private:
+	struct FrameQueries
+	{
+		VkQueryPool TimestampPool = VK_NULL_HANDLE;		// 0/1 = frame, then 2 per scope
+		VkQueryPool StatisticsPool = VK_NULL_HANDLE;
+		std::vector<const char*> ScopeNames;
+		uint64_t FrameNumber = 0;
+		bool Written = false;
+		bool StatisticsActive = false;
+	};
+
+	struct UploadBatch
+	{
+		std::string Name;
+		double StartMs;
+		uint32_t StartSubmits;
+	};
+
+	double TicksToMs(uint64_t begin, uint64_t end) const;
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	bool m_TimestampsSupported = false;
+	bool m_StatisticsSupported = false;
+	double m_TimestampPeriod = 1.0;			// nanoseconds per tick
+	uint64_t m_TimestampMask = ~0ull;		// valid bits of the queue family
+
+	std::vector<FrameQueries> m_Frames;
+	FrameQueries* m_Recording = nullptr;
+	uint64_t m_FrameCounter = 0;
+	GpuFrameStats m_LastStats;
+
+	VkQueryPool m_UploadPool = VK_NULL_HANDLE;
+	std::vector<UploadBatch> m_UploadStack;
+	std::vector<GpuUploadTime> m_UploadTimes;
+};
@@ -0,0 +1,263 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <string>
+
+#include "Trace.h"
+
+namespace
+{
+	// Queue of the calling thread, UINT32_MAX outside the pool
+	thread_local uint32_t s_WorkerIndex = UINT32_MAX;
+}
+
+void JobSystem::Init(uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		// hardware_concurrency may return 0 when unknown
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	m_Stop = false;
+	m_Queues.clear();
+	for (uint32_t i = 0; i < workerCount + 1; i++)
+	{
+		m_Queues.emplace_back(new WorkerQueue());
+	}
+
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		m_Workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+void JobSystem::Shutdown()
+{
+	if (m_Workers.empty())
+	{
+		return;
+	}
+
+	// Drain first. Running jobs may still queue more work, so wait until nothing is queued or running
+	while (m_UnfinishedJobs.load() > 0)
+	{
+		Job job;
+		if (TryPop(job))
+		{
+			Execute(job);
+			m_UnfinishedJobs.fetch_sub(1);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Stop = true;
+	}
+	m_SleepCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+	m_Workers.clear();
+	m_Queues.clear();
+}
+
+void JobSystem::Run(std::function<void()> function, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter != nullptr)
+	{
+		counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (dependency != nullptr)
+	{
+		// Checked under the lock: the last job of the dependency drains the list under the same lock
+		std::lock_guard<std::mutex> lock(dependency->m_ContinuationMutex);
+		if (!dependency->IsDone())
+		{
+			dependency->m_Continuations.push_back({ std::move(function), counter });
+			return;
+		}
+	}
+
+	Push({ std::move(function), counter });
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& function,
+	JobCounter* counter, JobCounter* dependency)
+{
+	batchSize = std::max(batchSize, 1u);
+	for (uint32_t begin = 0; begin < count; begin += batchSize)
+	{
+		uint32_t end = std::min(begin + batchSize, count);
+		Run([function, begin, end]() { function(begin, end); }, counter, dependency);
+	}
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	TRACE_ZONE("JobSystem::Wait");
+
+	while (!counter.IsDone())
+	{
+		Job job;
+		if (TryPop(job))
+		{
+			Execute(job);
+			m_UnfinishedJobs.fetch_sub(1);
+		}
+		else
+		{
+			// Remaining jobs are running on other threads (or wait on a dependency): sleep until the counter is done
+			// or there is queued work to help with again
+			std::unique_lock<std::mutex> lock(m_SleepMutex);
+			m_SleepCondition.wait(lock, [this, &counter]() { return counter.IsDone() || m_QueuedJobs.load() > 0; });
+		}
+	}
+
+	// The last job may still hold the counter's lock
+	std::lock_guard<std::mutex> lock(counter.m_ContinuationMutex);
+}
+
+void JobSystem::Push(Job job)
+{
+	// Without workers (not initialized) the job runs right away
+	if (m_Queues.empty())
+	{
+		Execute(job);
+		return;
+	}
+
+	uint32_t queueIndex = s_WorkerIndex < m_Workers.size() ? s_WorkerIndex : static_cast<uint32_t>(m_Workers.size());
+	WorkerQueue& queue = *m_Queues[queueIndex];
+	m_UnfinishedJobs.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		queue.Jobs.push_back(std::move(job));
+	}
+	m_QueuedJobs.fetch_add(1);
+
+	// Taking the lock orders the push before a worker's sleep check, so the wakeup can't be missed
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+	}
+	m_SleepCondition.notify_one();
+}
+
+bool JobSystem::TryPop(Job& job)
+{
+	if (m_QueuedJobs.load() == 0)
+	{
+		return false;
+	}
+
+	uint32_t queueCount = static_cast<uint32_t>(m_Queues.size());
+	uint32_t ownIndex = s_WorkerIndex < m_Workers.size() ? s_WorkerIndex : queueCount - 1;
+
+	// Own queue first, newest job
+	{
+		WorkerQueue& queue = *m_Queues[ownIndex];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (!queue.Jobs.empty())
+		{
+			job = std::move(queue.Jobs.back());
+			queue.Jobs.pop_back();
+			m_QueuedJobs.fetch_sub(1);
+			return true;
+		}
+	}
+
+	// Then steal the oldest job of the next non empty queue
+	for (uint32_t offset = 1; offset < queueCount; offset++)
+	{
+		WorkerQueue& queue = *m_Queues[(ownIndex + offset) % queueCount];
+		std::unique_lock<std::mutex> lock(queue.Mutex, std::try_to_lock);
+		if (lock.owns_lock() && !queue.Jobs.empty())
+		{
+			job = std::move(queue.Jobs.front());
+			queue.Jobs.pop_front();
+			m_QueuedJobs.fetch_sub(1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(Job& job)
+{
+	job.Function();
+
+	JobCounter* counter = job.Counter;
+	if (counter == nullptr)
+	{
+		return;
+	}
+
+	// The counter only reaches zero under its lock, Wait takes the same lock before the counter may go away
+	std::vector<JobCounter::Continuation> continuations;
+	uint32_t pending = counter->m_Pending.load(std::memory_order_relaxed);
+	while (true)
+	{
+		if (pending > 1)
+		{
+			if (counter->m_Pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+			{
+				return;
+			}
+			continue;
+		}
+
+		// Last job of the counter: take the jobs that depended on it
+		std::lock_guard<std::mutex> lock(counter->m_ContinuationMutex);
+		if (counter->m_Pending.compare_exchange_strong(pending, 0, std::memory_order_acq_rel))
+		{
+			continuations.swap(counter->m_Continuations);
+			break;
+		}
+	}
+
+	for (JobCounter::Continuation& continuation : continuations)
+	{
+		Push({ std::move(continuation.Function), continuation.Counter });
+	}
+
+	// Wake the threads sleeping in Wait (the counter isn't touched anymore, it may be gone once they return)
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+	}
+	m_SleepCondition.notify_all();
+}
+
+void JobSystem::WorkerLoop(uint32_t workerIndex)
+{
+	s_WorkerIndex = workerIndex;
+
+	std::string threadName = "Job Worker " + std::to_string(workerIndex);
+	TRACE_THREAD_NAME(threadName.c_str());
+
+	while (true)
+	{
+		Job job;
+		if (TryPop(job))
+		{
+			Execute(job);
+			m_UnfinishedJobs.fetch_sub(1);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_SleepMutex);
+		m_SleepCondition.wait(lock, [this]() { return m_Stop || m_QueuedJobs.load() > 0; });
+		if (m_Stop)
+		{
+			return;
+		}
+	}
+}
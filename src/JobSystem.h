@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class JobSystem;
+
+// Number of unfinished jobs of a group. Jobs can be made to start only once a counter reaches zero
+// (dependencies), and JobSystem::Wait runs other jobs on the calling thread until it does.
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	struct Continuation
+	{
+		std::function<void()> Function;
+		JobCounter* Counter;
+	};
+
+	std::atomic<uint32_t> m_Pending{ 0 };
+
+	// Jobs waiting for this counter to reach zero
+	std::mutex m_ContinuationMutex;
+	std::vector<Continuation> m_Continuations;
+};
+
+// Fixed pool of worker threads with one deque each. Owners push and pop at the back (LIFO, cache warm),
+// idle workers steal from the front of the other deques (FIFO, oldest and usually largest work first).
+// The thread calling Wait helps with the work, so the pool has one thread less than the core count.
+class JobSystem
+{
+public:
+	JobSystem() = default;
+	~JobSystem() { Shutdown(); }
+
+	// 0 workers = hardware threads - 1 (at least 1)
+	void Init(uint32_t workerCount = 0);
+	// Waits for the queued and running jobs (and the jobs they queue), then joins the workers
+	void Shutdown();
+
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+	// Queue a job. counter (optional) is incremented now and decremented when the job has run,
+	// dependency (optional) delays the job until that counter reaches zero.
+	void Run(std::function<void()> function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+	// Split [0, count) into batches of batchSize and run function(begin, end) for each as a job
+	void ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& function,
+		JobCounter* counter, JobCounter* dependency = nullptr);
+
+	// Run jobs on the calling thread until the counter reaches zero (sleeps while there is nothing to help with)
+	void Wait(JobCounter& counter);
+
+private:
+	struct Job
+	{
+		std::function<void()> Function;
+		JobCounter* Counter;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex Mutex;
+		std::deque<Job> Jobs;
+	};
+
+	void Push(Job job);
+	bool TryPop(Job& job);
+	void Execute(Job& job);
+	void WorkerLoop(uint32_t workerIndex);
+
+private:
+	// Index m_Workers.size() is the queue of every thread outside the pool (main thread)
+	std::vector<std::unique_ptr<WorkerQueue>> m_Queues;
+	std::vector<std::thread> m_Workers;
+
+	// Sleeping workers are woken on every push, threads sleeping in Wait also when a counter reaches zero
+	std::mutex m_SleepMutex;
+	std::condition_variable m_SleepCondition;
+	std::atomic<uint32_t> m_QueuedJobs{ 0 };
+	// Queued or running. A job queues its follow-up work before it finishes, so this only reaches zero once all work is done
+	std::atomic<uint32_t> m_UnfinishedJobs{ 0 };
+	bool m_Stop = false;
+};
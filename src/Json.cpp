@@ -0,0 +1,331 @@
+#include "Json.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+
+static const JsonValue s_NullValue;
+
+// Recursive descent over the text, values are built in place
+class JsonParser
+{
+public:
+	JsonParser(const char* text, size_t length)
+		: m_Text(text), m_End(text + length), m_Current(text)
+	{
+	}
+
+	JsonValue ParseDocument()
+	{
+		JsonValue value;
+		ParseValue(value, 0);
+		SkipWhitespace();
+		if (m_Current != m_End)
+		{
+			Fail("trailing characters");
+		}
+		return value;
+	}
+
+private:
+	static const uint32_t MAX_DEPTH = 256;
+
+	void Fail(const char* reason) const
+	{
+		throw std::runtime_error(std::string("Failed to parse JSON (") + reason + ") at offset " + std::to_string(m_Current - m_Text) + "!");
+	}
+
+	void SkipWhitespace()
+	{
+		while (m_Current < m_End && (*m_Current == ' ' || *m_Current == '\t' || *m_Current == '\n' || *m_Current == '\r'))
+		{
+			m_Current++;
+		}
+	}
+
+	void Expect(char character)
+	{
+		SkipWhitespace();
+		if (m_Current >= m_End || *m_Current != character)
+		{
+			Fail("unexpected character");
+		}
+		m_Current++;
+	}
+
+	bool Consume(const char* literal)
+	{
+		size_t length = strlen(literal);
+		if (static_cast<size_t>(m_End - m_Current) >= length && memcmp(m_Current, literal, length) == 0)
+		{
+			m_Current += length;
+			return true;
+		}
+		return false;
+	}
+
+	void ParseValue(JsonValue& value, uint32_t depth)
+	{
+		if (depth > MAX_DEPTH)
+		{
+			Fail("nested too deep");
+		}
+
+		SkipWhitespace();
+		if (m_Current >= m_End)
+		{
+			Fail("unexpected end");
+		}
+
+		switch (*m_Current)
+		{
+		case '{':
+			ParseObject(value, depth);
+			break;
+		case '[':
+			ParseArray(value, depth);
+			break;
+		case '"':
+			value.m_Type = JsonValue::Type::String;
+			ParseString(value.m_String);
+			break;
+		case 't':
+		case 'f':
+			value.m_Type = JsonValue::Type::Bool;
+			value.m_Bool = *m_Current == 't';
+			if (!Consume(value.m_Bool ? "true" : "false"))
+			{
+				Fail("invalid literal");
+			}
+			break;
+		case 'n':
+			if (!Consume("null"))
+			{
+				Fail("invalid literal");
+			}
+			break;
+		default:
+			ParseNumber(value);
+			break;
+		}
+	}
+
+	void ParseObject(JsonValue& value, uint32_t depth)
+	{
+		value.m_Type = JsonValue::Type::Object;
+		m_Current++;
+		SkipWhitespace();
+		if (m_Current < m_End && *m_Current == '}')
+		{
+			m_Current++;
+			return;
+		}
+
+		while (true)
+		{
+			SkipWhitespace();
+			if (m_Current >= m_End || *m_Current != '"')
+			{
+				Fail("expected a member name");
+			}
+			value.m_Keys.emplace_back();
+			ParseString(value.m_Keys.back());
+			Expect(':');
+
+			value.m_Elements.emplace_back();
+			ParseValue(value.m_Elements.back(), depth + 1);
+
+			SkipWhitespace();
+			if (m_Current < m_End && *m_Current == ',')
+			{
+				m_Current++;
+				continue;
+			}
+			Expect('}');
+			return;
+		}
+	}
+
+	void ParseArray(JsonValue& value, uint32_t depth)
+	{
+		value.m_Type = JsonValue::Type::Array;
+		m_Current++;
+		SkipWhitespace();
+		if (m_Current < m_End && *m_Current == ']')
+		{
+			m_Current++;
+			return;
+		}
+
+		while (true)
+		{
+			value.m_Elements.emplace_back();
+			ParseValue(value.m_Elements.back(), depth + 1);
+
+			SkipWhitespace();
+			if (m_Current < m_End && *m_Current == ',')
+			{
+				m_Current++;
+				continue;
+			}
+			Expect(']');
+			return;
+		}
+	}
+
+	void ParseString(std::string& string)
+	{
+		m_Current++;
+		while (m_Current < m_End && *m_Current != '"')
+		{
+			char character = *m_Current++;
+			if (character != '\\')
+			{
+				string.push_back(character);
+				continue;
+			}
+
+			if (m_Current >= m_End)
+			{
+				break;
+			}
+			char escape = *m_Current++;
+			switch (escape)
+			{
+			case 'b': string.push_back('\b'); break;
+			case 'f': string.push_back('\f'); break;
+			case 'n': string.push_back('\n'); break;
+			case 'r': string.push_back('\r'); break;
+			case 't': string.push_back('\t'); break;
+			case 'u':
+				AppendCodePoint(string, ParseHex4());
+				break;
+			default:
+				string.push_back(escape);
+				break;
+			}
+		}
+
+		if (m_Current >= m_End)
+		{
+			Fail("unterminated string");
+		}
+		m_Current++;
+	}
+
+	uint32_t ParseHex4()
+	{
+		if (m_End - m_Current < 4)
+		{
+			Fail("invalid escape");
+		}
+
+		uint32_t codePoint = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			char digit = *m_Current++;
+			codePoint <<= 4;
+			if (digit >= '0' && digit <= '9') codePoint |= digit - '0';
+			else if (digit >= 'a' && digit <= 'f') codePoint |= digit - 'a' + 10;
+			else if (digit >= 'A' && digit <= 'F') codePoint |= digit - 'A' + 10;
+			else Fail("invalid escape");
+		}
+		return codePoint;
+	}
+
+	// UTF-8 (surrogate pairs are joined)
+	void AppendCodePoint(std::string& string, uint32_t codePoint)
+	{
+		if (codePoint >= 0xD800 && codePoint <= 0xDBFF && Consume("\\u"))
+		{
+			uint32_t low = ParseHex4();
+			codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+		}
+
+		if (codePoint < 0x80)
+		{
+			string.push_back(static_cast<char>(codePoint));
+		}
+		else if (codePoint < 0x800)
+		{
+			string.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+			string.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+		}
+		else if (codePoint < 0x10000)
+		{
+			string.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+			string.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+			string.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+		}
+		else
+		{
+			string.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+			string.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+			string.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+			string.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+		}
+	}
+
+	void ParseNumber(JsonValue& value)
+	{
+		// strtod needs a terminated string, numbers are short
+		const char* start = m_Current;
+		while (m_Current < m_End && (strchr("+-0123456789.eE", *m_Current) != nullptr))
+		{
+			m_Current++;
+		}
+		if (m_Current == start || m_Current - start > 63)
+		{
+			Fail("invalid number");
+		}
+
+		char buffer[64];
+		memcpy(buffer, start, m_Current - start);
+		buffer[m_Current - start] = '\0';
+
+		char* end;
+		value.m_Type = JsonValue::Type::Number;
+		value.m_Number = strtod(buffer, &end);
+		if (*end != '\0')
+		{
+			Fail("invalid number");
+		}
+	}
+
+private:
+	const char* m_Text;
+	const char* m_End;
+	const char* m_Current;
+};
+
+JsonValue JsonValue::Parse(const char* text, size_t length)
+{
+	JsonParser parser(text, length);
+	return parser.ParseDocument();
+}
+
+const JsonValue& JsonValue::At(size_t index) const
+{
+	if (m_Type != Type::Array || index >= m_Elements.size())
+	{
+		return s_NullValue;
+	}
+	return m_Elements[index];
+}
+
+const JsonValue& JsonValue::operator[](const char* key) const
+{
+	for (size_t i = 0; i < m_Keys.size(); i++)
+	{
+		if (m_Keys[i] == key)
+		{
+			return m_Elements[i];
+		}
+	}
+	return s_NullValue;
+}
+
+bool JsonValue::Has(const char* key) const
+{
+	return !(*this)[key].IsNull();
+}
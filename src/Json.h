@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Parsed JSON document (enough for glTF). Objects keep their member order, numbers are doubles. Lookups of missing
+// members or elements return a null value, so optional properties read as their fallback.
+class JsonValue
+{
+public:
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	JsonValue() = default;
+
+	// Throws on malformed text
+	static JsonValue Parse(const char* text, size_t length);
+
+	Type GetType() const { return m_Type; }
+	bool IsNull() const { return m_Type == Type::Null; }
+
+	bool GetBool(bool fallback = false) const { return m_Type == Type::Bool ? m_Bool : fallback; }
+	double GetNumber(double fallback = 0.0) const { return m_Type == Type::Number ? m_Number : fallback; }
+	uint32_t GetUint(uint32_t fallback = 0) const { return m_Type == Type::Number ? static_cast<uint32_t>(m_Number) : fallback; }
+	const std::string& GetString() const { return m_String; }
+
+	// Elements of an array or members of an object
+	size_t Size() const { return m_Elements.size(); }
+	const JsonValue& At(size_t index) const;
+	const JsonValue& operator[](const char* key) const;
+	bool Has(const char* key) const;
+
+private:
+	friend class JsonParser;
+
+	Type m_Type = Type::Null;
+	bool m_Bool = false;
+	double m_Number = 0.0;
+	std::string m_String;
+	std::vector<JsonValue> m_Elements;
+	std::vector<std::string> m_Keys;		// object member names, parallel to m_Elements
+};
@@ -0,0 +1,105 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filepath)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_File = file;
+	m_Mapping = mapping;
+	m_Data = static_cast<const uint8_t*>(view);
+	m_Size = static_cast<size_t>(size.QuadPart);
+#else
+	int file = open(filepath.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// The mapping keeps the file referenced, the descriptor isn't needed anymore
+	void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	m_Data = static_cast<const uint8_t*>(view);
+	m_Size = static_cast<size_t>(status.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_Data);
+	CloseHandle(m_Mapping);
+	CloseHandle(m_File);
+	m_Mapping = nullptr;
+	m_File = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+
+	m_Data = nullptr;
+	m_Size = 0;
+}
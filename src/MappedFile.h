@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Whole file mapped read-only into memory (pages are read on first touch, nothing is copied). Unmapped by Close or
+// the destructor, pointers into the data are valid until then
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// false when the file can't be opened or is empty
+	bool Open(const std::string& filepath);
+	void Close();
+
+	const uint8_t* GetData() const { return m_Data; }
+	size_t GetSize() const { return m_Size; }
+
+private:
+	const uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+
+#ifdef _WIN32
+	void* m_File = nullptr;			// HANDLE
+	void* m_Mapping = nullptr;		// HANDLE
+#endif
+};
@@ -2,18 +2,82 @@
 
 
 Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-	VkCommandPool transferCmdPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int textureID)
+	VkCommandPool transferCmdPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int textureID,
+	std::vector<SkinVertex>* skinVertices)
 {
 	m_IndexCount = indices->size();
 	m_VertexCount = vertices->size();
 	m_PhysicalDevice = newPhysicalDevice;
 	m_Device = newDevice;
-	CreateVertexBuffer(transferQueue, transferCmdPool, vertices);
-	CreateIndexBuffer(transferQueue, transferCmdPool, indices);
+	if (skinVertices)
+	{
+		CreateSkinBuffer(transferQueue, transferCmdPool, skinVertices);
+	}
+	CreateVertexBuffer(transferQueue, transferCmdPool, m_VertexCount,
+		[vertices](Vertex* data) { memcpy(data, vertices->data(), sizeof(Vertex) * vertices->size()); });
+	CreateIndexBuffer(transferQueue, transferCmdPool, m_IndexCount,
+		[indices](uint32_t* data) { memcpy(data, indices->data(), sizeof(uint32_t) * indices->size()); });
 
 	m_UBOModel.Model = glm::mat4(1.0f);
 	m_TextureID = textureID;
 
+	if (!vertices->empty())
+	{
+		m_BoundsMin = m_BoundsMax = (*vertices)[0].Position;
+		for (const Vertex& vertex : *vertices)
+		{
+			m_BoundsMin = glm::min(m_BoundsMin, vertex.Position);
+			m_BoundsMax = glm::max(m_BoundsMax, vertex.Position);
+		}
+	}
+
+	// Skinned meshes move away from their bind pose, they are never occluders
+	if (!skinVertices && indices->size() / 3 <= SOFTWARE_OCCLUDER_MAX_MESH_TRIANGLES)
+	{
+		m_OccluderPositions.reserve(vertices->size());
+		for (const Vertex& vertex : *vertices)
+		{
+			m_OccluderPositions.push_back(vertex.Position);
+		}
+		m_OccluderIndices = *indices;
+	}
+
+}
+
+Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
+	VkCommandPool transferCmdPool, const MeshSource& source, int textureID)
+{
+	m_IndexCount = source.IndexCount;
+	m_VertexCount = source.VertexCount;
+	m_PhysicalDevice = newPhysicalDevice;
+	m_Device = newDevice;
+	m_BoundsMin = source.BoundsMin;
+	m_BoundsMax = source.BoundsMax;
+
+	// The occluder copy takes the indices first, the staging buffer gets a copy of it (one read of the source)
+	bool occluder = source.WritePositions && m_IndexCount / 3 <= SOFTWARE_OCCLUDER_MAX_MESH_TRIANGLES;
+	if (occluder)
+	{
+		m_OccluderPositions.resize(m_VertexCount);
+		source.WritePositions(m_OccluderPositions.data());
+		m_OccluderIndices.resize(m_IndexCount);
+		source.WriteIndices(m_OccluderIndices.data());
+	}
+
+	CreateVertexBuffer(transferQueue, transferCmdPool, m_VertexCount, source.WriteVertices);
+	if (occluder)
+	{
+		const std::vector<uint32_t>& occluderIndices = m_OccluderIndices;
+		CreateIndexBuffer(transferQueue, transferCmdPool, m_IndexCount,
+			[&occluderIndices](uint32_t* data) { memcpy(data, occluderIndices.data(), sizeof(uint32_t) * occluderIndices.size()); });
+	}
+	else
+	{
+		CreateIndexBuffer(transferQueue, transferCmdPool, m_IndexCount, source.WriteIndices);
+	}
+
+	m_UBOModel.Model = glm::mat4(1.0f);
+	m_TextureID = textureID;
 }
 
 
@@ -22,12 +86,12 @@ Mesh::~Mesh()
 	//DestroyBuffers();
 }
 
-int Mesh::GetVertexCount()
+int Mesh::GetVertexCount() const
 {
 	return static_cast<int>(m_VertexCount);
 }
 
-VkBuffer Mesh::GetVertexBuffer()
+VkBuffer Mesh::GetVertexBuffer() const
 {
 	return m_VertexBuffer;
 }
@@ -38,13 +102,18 @@ void Mesh::DestroyBuffers()
 	vkFreeMemory(m_Device, m_VertexBufferMemory, nullptr);
 	vkDestroyBuffer(m_Device, m_IndexBuffer, nullptr);
 	vkFreeMemory(m_Device, m_IndexBufferMemory, nullptr);
+	if (m_SkinBuffer)
+	{
+		vkDestroyBuffer(m_Device, m_SkinBuffer, nullptr);
+		vkFreeMemory(m_Device, m_SkinBufferMemory, nullptr);
+	}
 }
 
 void Mesh::CreateVertexBuffer(VkQueue transferQueue,
-	VkCommandPool transferCmdPool, std::vector<Vertex>* vertices)
+	VkCommandPool transferCmdPool, size_t vertexCount, const std::function<void(Vertex*)>& writeVertices)
 {
 	// Get size of buffer
-	VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
+	VkDeviceSize bufferSize = sizeof(Vertex) * vertexCount;
 
 	// temporary buffer to stage vertex data before transferring to GPU
 	VkBuffer stagingBuffer;
@@ -59,13 +128,15 @@ void Mesh::CreateVertexBuffer(VkQueue transferQueue,
 	// Map memory to vertex buffer
 	void* data;			// 1. create pointer to a point in normal memory
 	vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);	// 2. "Map the vertex buffer memory to that point
-	memcpy(data, vertices->data(), (size_t)bufferSize); // 3. Copy memory from vertices vector to the point
+	writeVertices(static_cast<Vertex*>(data));	// 3. Write the vertices to the point
 	vkUnmapMemory(m_Device, stagingBufferMemory);		// 4. Unmap the vertex buffer memory
 
 	// Create buffer with TRANSFER_DST_BIT to mark recipient of transfer data (also VERTEX_BUFFER)
 	// Buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the gpu and only accessible by it and not CPU (host)
+	// (skinned meshes: also the STORAGE_BUFFER read by the skinning compute shader)
+	VkBufferUsageFlags skinUsage = IsSkinned() ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0;
 	CreateBuffer(m_PhysicalDevice, m_Device, bufferSize, 
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | skinUsage,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_VertexBuffer, &m_VertexBufferMemory);
 
 	// copy stagin buffer to vertex buffer
@@ -87,10 +158,11 @@ void Mesh::CreateVertexBuffer(VkQueue transferQueue,
 	//vkUnmapMemory(m_Device, m_VertexBufferMemory);		// 4. Unmap the vertex buffer memory
 }
 
-void Mesh::CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCmdPool, std::vector<uint32_t>* indices)
+void Mesh::CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCmdPool, size_t indexCount,
+	const std::function<void(uint32_t*)>& writeIndices)
 {
 	// Get the buffer size
-	VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
+	VkDeviceSize bufferSize = sizeof(uint32_t) * indexCount;
 
 	//temporary buffer data
 	VkBuffer stagingBuffer;
@@ -105,7 +177,7 @@ void Mesh::CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCmdPoo
 	// Map memory to index buffer
 	void* data;			// 1. create pointer to a point in normal memory
 	vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);	// 2. "Map the vertex buffer memory to that point
-	memcpy(data, indices->data(), (size_t)bufferSize); // 3. Copy memory from vertices vector to the point
+	writeIndices(static_cast<uint32_t*>(data));	// 3. Write the indices to the point
 	vkUnmapMemory(m_Device, stagingBufferMemory);		// 4. Unmap the vertex buffer memory
 	
 	// Buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the gpu and only accessible by it and not CPU (host)
@@ -122,3 +194,30 @@ void Mesh::CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCmdPoo
 	vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
 }
 
+
+void Mesh::CreateSkinBuffer(VkQueue transferQueue, VkCommandPool transferCmdPool, std::vector<SkinVertex>* skinVertices)
+{
+	VkDeviceSize bufferSize = sizeof(SkinVertex) * skinVertices->size();
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+
+	CreateBuffer(m_PhysicalDevice, m_Device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);
+	memcpy(data, skinVertices->data(), (size_t)bufferSize);
+	vkUnmapMemory(m_Device, stagingBufferMemory);
+
+	// Only read by the skinning compute shader
+	CreateBuffer(m_PhysicalDevice, m_Device, bufferSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_SkinBuffer, &m_SkinBufferMemory);
+
+	CopyBuffer(m_Device, transferQueue, transferCmdPool, stagingBuffer, m_SkinBuffer, bufferSize);
+
+	vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
+	vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
+}
@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 
 #include <vector>
+#include <functional>
 
 #include "Utils.h"
 
@@ -12,6 +13,18 @@ struct UniformBufferObjectModel
 	glm::mat4 Model;
 };
 
+// Mesh part written straight into the staging buffers by its loader (no intermediate vertex and index lists).
+// The bounds are known up front, WritePositions (optional) fills the software occlusion copy
+struct MeshSource
+{
+	uint32_t VertexCount = 0;
+	uint32_t IndexCount = 0;
+	glm::vec3 BoundsMin = glm::vec3(0.0f);
+	glm::vec3 BoundsMax = glm::vec3(0.0f);
+	std::function<void(Vertex*)> WriteVertices;
+	std::function<void(uint32_t*)> WriteIndices;
+	std::function<void(glm::vec3*)> WritePositions;
+};
 
 class Mesh
 {
@@ -19,29 +32,48 @@ public:
 	Mesh() = default;
 	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
 		VkCommandPool transferCmdPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices,
-		int textureID);
+		int textureID, std::vector<SkinVertex>* skinVertices = nullptr);
+	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
+		VkCommandPool transferCmdPool, const MeshSource& source, int textureID);
 
 	~Mesh();
 
-	int GetVertexCount();
-	int GetIndexCount() { return static_cast<int>(m_IndexCount); }
+	int GetVertexCount() const;
+	int GetIndexCount() const { return static_cast<int>(m_IndexCount); }
 
-	VkBuffer GetVertexBuffer();
-	VkBuffer GetIndexBuffer() { return m_IndexBuffer; }
+	VkBuffer GetVertexBuffer() const;
+	VkBuffer GetIndexBuffer() const { return m_IndexBuffer; }
 
 	void SetModel(glm::mat4& model) { m_UBOModel.Model = model; };
 	UniformBufferObjectModel GetUniformBufferModel() { return m_UBOModel; }
-	int GetTextureID() { return m_TextureID; };
+	int GetTextureID() const { return m_TextureID; };
+
+	// Model space bounding box of the vertices (occlusion culling)
+	const glm::vec3& GetBoundsMin() const { return m_BoundsMin; }
+	const glm::vec3& GetBoundsMax() const { return m_BoundsMax; }
+
+	// CPU copy of the triangles for software occlusion (only meshes up to SOFTWARE_OCCLUDER_MAX_MESH_TRIANGLES)
+	bool CanOcclude() const { return !m_OccluderIndices.empty(); }
+	const std::vector<glm::vec3>& GetOccluderPositions() const { return m_OccluderPositions; }
+	const std::vector<uint32_t>& GetOccluderIndices() const { return m_OccluderIndices; }
+
+	// Skinned meshes keep the bind pose in the vertex buffer (read by skinning.comp) and their joints and weights in a
+	// separate storage buffer, the skinned vertices are written to per-frame buffers owned by the renderer
+	bool IsSkinned() const { return m_SkinBuffer != nullptr; }
+	VkBuffer GetSkinBuffer() const { return m_SkinBuffer; }
 
 	void DestroyBuffers();
 
 
 private:
 	void CreateVertexBuffer(VkQueue transferQueue,
-		VkCommandPool transferCmdPool, std::vector<Vertex>* vertices);
+		VkCommandPool transferCmdPool, size_t vertexCount, const std::function<void(Vertex*)>& writeVertices);
 
 	void CreateIndexBuffer(VkQueue transferQueue,
-		VkCommandPool transferCmdPool, std::vector<uint32_t>* indices);
+		VkCommandPool transferCmdPool, size_t indexCount, const std::function<void(uint32_t*)>& writeIndices);
+
+	void CreateSkinBuffer(VkQueue transferQueue,
+		VkCommandPool transferCmdPool, std::vector<SkinVertex>* skinVertices);
 
 private:
 
@@ -49,6 +81,12 @@ private:
 
 	int m_TextureID;
 
+	glm::vec3 m_BoundsMin = glm::vec3(0.0f);
+	glm::vec3 m_BoundsMax = glm::vec3(0.0f);
+
+	std::vector<glm::vec3> m_OccluderPositions;
+	std::vector<uint32_t> m_OccluderIndices;
+
 	size_t m_VertexCount;
 	VkBuffer m_VertexBuffer = nullptr;
 	VkDeviceMemory m_VertexBufferMemory;
@@ -57,6 +95,9 @@ private:
 	VkBuffer m_IndexBuffer;
 	VkDeviceMemory m_IndexBufferMemory;
 
+	VkBuffer m_SkinBuffer = nullptr;
+	VkDeviceMemory m_SkinBufferMemory;
+
 	VkPhysicalDevice m_PhysicalDevice;
 	VkDevice m_Device;
 
@@ -1,5 +1,8 @@
 #include "MeshModel.h"
 
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Trace.h"
 
 MeshModel::MeshModel(std::vector<Mesh>& meshList)
 	: m_MeshList(meshList)
@@ -23,6 +26,35 @@ void MeshModel::SetModel(glm::mat4& newModel)
 	m_Model = newModel;
 }
 
+void MeshModel::SetSkeleton(const Skeleton& skeleton, const std::vector<AnimationClip>& clips)
+{
+	m_Skeleton = skeleton;
+	m_Clips = clips;
+	m_AnimationState = AnimationState();
+	UpdateSkinMatrices();
+}
+
+void MeshModel::UpdateSkinMatrices()
+{
+	// Bind pose without clips
+	if (m_Clips.empty())
+	{
+		AnimationClip bindPose;
+		SampleAnimation(m_Skeleton, bindPose, 0.0f, m_Pose);
+	}
+	else
+	{
+		SampleAnimation(m_Skeleton, m_Clips[m_AnimationState.Clip % m_Clips.size()], m_AnimationState.Time, m_Pose);
+		if (m_AnimationState.BlendClip < m_Clips.size() && m_AnimationState.BlendWeight > 0.0f)
+		{
+			SampleAnimation(m_Skeleton, m_Clips[m_AnimationState.BlendClip], m_AnimationState.BlendTime, m_BlendPose);
+			BlendAnimationPoses(m_Pose, m_BlendPose, m_AnimationState.BlendWeight, m_Pose);
+		}
+	}
+
+	ComputeSkinMatrices(m_Skeleton, m_Pose, m_WorldTransforms, m_SkinMatrices);
+}
+
 void MeshModel::DestroyMeshModel()
 {
 	for (auto& mesh : m_MeshList)
@@ -33,6 +65,8 @@ void MeshModel::DestroyMeshModel()
 
 std::vector<std::string> MeshModel::LoadMaterials(const aiScene* scene)
 {
+	TRACE_FUNCTION();
+
 	// Create 1:1 sized list of textures
 	std::vector<std::string> textureList(scene->mNumMaterials);
 	
@@ -63,16 +97,22 @@ std::vector<std::string> MeshModel::LoadMaterials(const aiScene* scene)
 	return textureList;
 }
 
-std::vector<Mesh> MeshModel::LoadNode(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, std::vector<int>& materialToTexture)
+std::vector<Mesh> MeshModel::LoadNode(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, std::vector<int>& materialToTexture,
+	Skeleton* skeleton, const glm::mat4& parentTransform)
 {
+	TRACE_FUNCTION();
+
 	std::vector<Mesh> meshList;
 
+	// Transform of this node relative to the model (Assimp matrices are row major)
+	glm::mat4 nodeTransform = parentTransform * glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+
 	// Go through each mesh at this node and create it, then add it out meshList
 	for (size_t i = 0; i < node->mNumMeshes; i++)
 	{
 		// Load mesh and push back to mesh list
 		auto mesh = LoadMesh(newPhysicaldDevice, newDevice, transferQueue,
-			transferCommandPool, scene->mMeshes[node->mMeshes[i]], scene, materialToTexture);
+			transferCommandPool, scene->mMeshes[node->mMeshes[i]], scene, materialToTexture, skeleton, nodeTransform);
 		meshList.push_back(mesh);
 	}
 
@@ -80,15 +120,23 @@ std::vector<Mesh> MeshModel::LoadNode(VkPhysicalDevice newPhysicaldDevice, VkDev
 	for (size_t i = 0; i < node->mNumChildren; i++)
 	{
 		std::vector<Mesh> newList = LoadNode(newPhysicaldDevice, newDevice, transferQueue,
-			transferCommandPool, node->mChildren[i], scene, materialToTexture);
+			transferCommandPool, node->mChildren[i], scene, materialToTexture, skeleton, nodeTransform);
 		meshList.insert(meshList.end(), newList.begin(), newList.end());
 	}
 
 	return meshList;
 }
 
-Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, std::vector<int>& materialToTexture)
+Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, std::vector<int>& materialToTexture,
+	Skeleton* skeleton, const glm::mat4& nodeTransform)
 {
+	TRACE_FUNCTION();
+
+	// Bones are relative to the mesh, not to its node
+	bool skinned = skeleton && mesh->HasBones();
+	glm::mat4 transform = skinned ? glm::mat4(1.0f) : nodeTransform;
+	glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
 
@@ -99,7 +147,7 @@ Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice
 	for (size_t i = 0; i < mesh->mNumVertices; i++)
 	{
 		// Set position
-		vertices[i].Position = { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
+		vertices[i].Position = glm::vec3(transform * glm::vec4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f));
 
 		// Set tex coord (if they exist)
 		if (mesh->mTextureCoords[0])
@@ -114,10 +162,14 @@ Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice
 		// Set color
 		vertices[i].Color = { 1.0f, 1.0f, 1.0f };
 
-
+		// Set normal (zero = unlit, ambient only)
 		if(mesh->HasNormals())
 		{
-			
+			vertices[i].Normal = glm::normalize(normalTransform * glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z));
+		}
+		else
+		{
+			vertices[i].Normal = { 0.0f, 0.0f, 0.0f };
 		}
 	}
 
@@ -133,9 +185,52 @@ Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice
 		}
 	}
 
+	// Joints and weights: the MAX_BONE_INFLUENCES largest weights of every vertex, normalized
+	std::vector<SkinVertex> skinVertices;
+	if (skinned)
+	{
+		skinVertices.resize(mesh->mNumVertices, { glm::uvec4(0), glm::vec4(0.0f) });
+		for (uint32_t b = 0; b < mesh->mNumBones; b++)
+		{
+			const aiBone* bone = mesh->mBones[b];
+			uint32_t boneIndex = skeleton->AddBone(bone->mName.C_Str(), glm::transpose(glm::make_mat4(&bone->mOffsetMatrix.a1)));
+			for (uint32_t w = 0; w < bone->mNumWeights; w++)
+			{
+				SkinVertex& skinVertex = skinVertices[bone->mWeights[w].mVertexId];
+				float weight = bone->mWeights[w].mWeight;
+
+				// Replace the smallest influence when the vertex is full
+				uint32_t smallest = 0;
+				for (uint32_t k = 1; k < MAX_BONE_INFLUENCES; k++)
+				{
+					if (skinVertex.Weights[k] < skinVertex.Weights[smallest])
+					{
+						smallest = k;
+					}
+				}
+				if (weight > skinVertex.Weights[smallest])
+				{
+					skinVertex.Joints[smallest] = boneIndex;
+					skinVertex.Weights[smallest] = weight;
+				}
+			}
+		}
+
+		// Vertices without weights stay at their bind position (zero weights, see skinning.comp)
+		for (SkinVertex& skinVertex : skinVertices)
+		{
+			float weightSum = skinVertex.Weights.x + skinVertex.Weights.y + skinVertex.Weights.z + skinVertex.Weights.w;
+			if (weightSum > 0.0f)
+			{
+				skinVertex.Weights /= weightSum;
+			}
+		}
+	}
+
 	// Create mesh and return it
 	Mesh newMesh = Mesh(newPhysicaldDevice, newDevice, transferQueue,
-		transferCommandPool, &vertices, &indices, materialToTexture[mesh->mMaterialIndex]);
+		transferCommandPool, &vertices, &indices, materialToTexture[mesh->mMaterialIndex],
+		skinned ? &skinVertices : nullptr);
 
 	return newMesh;
 }
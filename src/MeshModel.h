@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "Mesh.h"
+#include "Animation.h"
 
 class MeshModel
 {
@@ -20,18 +21,53 @@ public:
 	glm::mat4 GetModel() { return m_Model; }
 	void SetModel(glm::mat4& newModel);
 
+	// Scene graph node placing the model (the model matrix is the node's world transform)
+	uint32_t GetSceneNode() const { return m_SceneNode; }
+	void SetSceneNode(uint32_t sceneNode) { m_SceneNode = sceneNode; }
+
+	// Always rasterized by software occlusion (mesh parts with a CPU copy), others only when large on screen
+	bool IsOccluder() const { return m_Occluder; }
+	void SetOccluder(bool occluder) { m_Occluder = occluder; }
+
+	// Skeleton and clips of a skinned model (mesh parts with bones are skinned on the GPU every frame)
+	bool IsSkinned() const { return !m_Skeleton.BoneJoints.empty(); }
+	void SetSkeleton(const Skeleton& skeleton, const std::vector<AnimationClip>& clips);
+	const Skeleton& GetSkeleton() const { return m_Skeleton; }
+	size_t GetAnimationCount() const { return m_Clips.size(); }
+	const AnimationState& GetAnimationState() const { return m_AnimationState; }
+	void SetAnimationState(const AnimationState& animationState) { m_AnimationState = animationState; }
+
+	// Samples (and blends) the clips of the animation state into the skin matrices, one per bone
+	void UpdateSkinMatrices();
+	const std::vector<glm::mat4>& GetSkinMatrices() const { return m_SkinMatrices; }
+
 	void DestroyMeshModel();
 
 	static std::vector<std::string> LoadMaterials(const aiScene* scene);
+	// Node transforms of the file are baked into the vertices (the parts of a model share its model matrix).
+	// With a skeleton, meshes with bones get their joints and weights and stay in mesh space (the skin matrices place them)
 	static std::vector<Mesh> LoadNode(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue,
-		VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, std::vector<int>& materialToTexture);
+		VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, std::vector<int>& materialToTexture,
+		Skeleton* skeleton = nullptr, const glm::mat4& parentTransform = glm::mat4(1.0f));
 	static Mesh LoadMesh(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue,
-		VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, std::vector<int>& materialToTexture);
+		VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, std::vector<int>& materialToTexture,
+		Skeleton* skeleton = nullptr, const glm::mat4& nodeTransform = glm::mat4(1.0f));
 
 	~MeshModel();
 
 private:
 	std::vector<Mesh> m_MeshList;
 	glm::mat4 m_Model;
+	bool m_Occluder = false;
+	uint32_t m_SceneNode = UINT32_MAX;
+
+	Skeleton m_Skeleton;
+	std::vector<AnimationClip> m_Clips;
+	AnimationState m_AnimationState;
+	// Scratch of UpdateSkinMatrices, kept to avoid allocations every frame
+	AnimationPose m_Pose;
+	AnimationPose m_BlendPose;
+	std::vector<glm::mat4> m_WorldTransforms;
+	std::vector<glm::mat4> m_SkinMatrices;
 };
 
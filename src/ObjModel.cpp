@@ -0,0 +1,638 @@
+#include "ObjModel.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+#include <map>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+
+#include "MappedFile.h"
+#include "JobSystem.h"
+#include "Trace.h"
+
+// Relative (negative) indices are resolved against the chunk's own element count while parsing and stored as
+// local - OBJ_RELATIVE_BIAS (always negative), the merge adds the chunk's first global index. Absolute indices stay
+// 1-based (positive), 0 = missing
+static const int32_t OBJ_RELATIVE_BIAS = 1 << 30;
+
+// Face corner as written in the file (see OBJ_RELATIVE_BIAS), 0-based global indices after the merge (-1 = missing)
+struct ObjCorner
+{
+	int32_t Position;
+	int32_t TextureCoord;
+	int32_t Normal;
+};
+
+// o, g or usemtl line: the faces from FirstCorner on start a new group and/or use another material
+struct ObjStateChange
+{
+	uint32_t FirstCorner;
+	bool NewGroup;
+	bool SetsMaterial;
+	std::string Material;
+};
+
+// Everything parsed from one chunk of lines
+struct ObjChunk
+{
+	const char* Begin;
+	const char* End;
+
+	std::vector<glm::vec3> Positions;
+	std::vector<glm::vec2> TextureCoords;
+	std::vector<glm::vec3> Normals;
+	std::vector<ObjCorner> Corners;				// 3 per triangle
+	std::vector<ObjStateChange> StateChanges;
+	std::vector<std::string> MaterialLibraries;
+	std::string Error;							// set instead of throwing (jobs must not throw)
+};
+
+// Corners of a mesh in one chunk
+struct ObjCornerRange
+{
+	uint32_t Chunk;
+	uint32_t Begin;
+	uint32_t End;
+};
+
+struct ObjMeshCorners
+{
+	std::vector<ObjCornerRange> Ranges;
+	uint32_t CornerCount = 0;
+};
+
+static bool IsSpace(char character)
+{
+	return character == ' ' || character == '\t' || character == '\r';
+}
+
+static const char* SkipSpaces(const char* current, const char* end)
+{
+	while (current < end && IsSpace(*current))
+	{
+		current++;
+	}
+	return current;
+}
+
+static bool IsDigit(char character)
+{
+	return character >= '0' && character <= '9';
+}
+
+// Decimal float without locale or strtod overhead: up to 19 significant digits into an integer, then one scale by
+// a power of ten (exact for the common exponents). Returns the end of the number, current when there is none
+static const char* ParseFloat(const char* current, const char* end, float& value)
+{
+	static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	const char* start = current;
+	bool negative = false;
+	if (current < end && (*current == '-' || *current == '+'))
+	{
+		negative = *current == '-';
+		current++;
+	}
+
+	uint64_t mantissa = 0;
+	int digitCount = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+	while (current < end && IsDigit(*current))
+	{
+		if (digitCount < 19)
+		{
+			mantissa = mantissa * 10 + (*current - '0');
+			digitCount += mantissa != 0;
+		}
+		else
+		{
+			exponent++;
+		}
+		anyDigits = true;
+		current++;
+	}
+
+	if (current < end && *current == '.')
+	{
+		current++;
+		while (current < end && IsDigit(*current))
+		{
+			if (digitCount < 19)
+			{
+				mantissa = mantissa * 10 + (*current - '0');
+				digitCount += mantissa != 0;
+				exponent--;
+			}
+			anyDigits = true;
+			current++;
+		}
+	}
+
+	if (!anyDigits)
+	{
+		return start;
+	}
+
+	if (current < end && (*current == 'e' || *current == 'E'))
+	{
+		const char* exponentStart = current++;
+		bool negativeExponent = false;
+		if (current < end && (*current == '-' || *current == '+'))
+		{
+			negativeExponent = *current == '-';
+			current++;
+		}
+
+		if (current < end && IsDigit(*current))
+		{
+			int fileExponent = 0;
+			while (current < end && IsDigit(*current))
+			{
+				fileExponent = std::min(fileExponent * 10 + (*current - '0'), 10000);
+				current++;
+			}
+			exponent += negativeExponent ? -fileExponent : fileExponent;
+		}
+		else
+		{
+			current = exponentStart;
+		}
+	}
+
+	double result = static_cast<double>(mantissa);
+	if (exponent < 0 && exponent >= -22)
+	{
+		result /= powersOf10[-exponent];
+	}
+	else if (exponent > 0 && exponent <= 22)
+	{
+		result *= powersOf10[exponent];
+	}
+	else if (exponent != 0)
+	{
+		result *= std::pow(10.0, exponent);
+	}
+
+	value = static_cast<float>(negative ? -result : result);
+	return current;
+}
+
+// Up to count floats of a v, vt or vn line (missing ones stay zero, extra ones like vertex colors are ignored)
+static void ParseFloats(const char* current, const char* end, float* values, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		current = SkipSpaces(current, end);
+		values[i] = 0.0f;
+		current = ParseFloat(current, end, values[i]);
+	}
+}
+
+// One index of a face corner (see OBJ_RELATIVE_BIAS). Returns the end of the number, nullptr when invalid
+static const char* ParseIndex(const char* current, const char* end, uint32_t elementCount, int32_t& index)
+{
+	bool negative = current < end && *current == '-';
+	if (negative)
+	{
+		current++;
+	}
+	if (current >= end || !IsDigit(*current))
+	{
+		return nullptr;
+	}
+
+	int64_t value = 0;
+	while (current < end && IsDigit(*current))
+	{
+		value = std::min<int64_t>(value * 10 + (*current - '0'), OBJ_RELATIVE_BIAS);
+		current++;
+	}
+
+	if (value == 0 || value >= OBJ_RELATIVE_BIAS)
+	{
+		return nullptr;
+	}
+	index = negative ? static_cast<int32_t>(elementCount - value - OBJ_RELATIVE_BIAS) : static_cast<int32_t>(value);
+	return current;
+}
+
+// Rest of a line without the surrounding spaces (names and paths may contain spaces)
+static std::string ParseName(const char* current, const char* end)
+{
+	current = SkipSpaces(current, end);
+	while (end > current && IsSpace(end[-1]))
+	{
+		end--;
+	}
+	return std::string(current, end);
+}
+
+static bool StartsWithKeyword(const char* current, const char* end, const char* keyword)
+{
+	size_t length = strlen(keyword);
+	return static_cast<size_t>(end - current) > length && memcmp(current, keyword, length) == 0 && IsSpace(current[length]);
+}
+
+static void ParseChunk(ObjChunk& chunk)
+{
+	// Corners of the current face (polygons are fanned into triangles)
+	std::vector<ObjCorner> faceCorners;
+
+	const char* current = chunk.Begin;
+	while (current < chunk.End)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(current, '\n', chunk.End - current));
+		lineEnd = lineEnd ? lineEnd : chunk.End;
+		current = SkipSpaces(current, lineEnd);
+
+		if (lineEnd - current >= 2)
+		{
+			if (current[0] == 'v' && IsSpace(current[1]))
+			{
+				glm::vec3 position;
+				ParseFloats(current + 2, lineEnd, &position.x, 3);
+				chunk.Positions.push_back(position);
+			}
+			else if (current[0] == 'v' && current[1] == 't' && lineEnd - current > 2 && IsSpace(current[2]))
+			{
+				glm::vec2 textureCoord;
+				ParseFloats(current + 3, lineEnd, &textureCoord.x, 2);
+				chunk.TextureCoords.push_back(textureCoord);
+			}
+			else if (current[0] == 'v' && current[1] == 'n' && lineEnd - current > 2 && IsSpace(current[2]))
+			{
+				glm::vec3 normal;
+				ParseFloats(current + 3, lineEnd, &normal.x, 3);
+				chunk.Normals.push_back(normal);
+			}
+			else if (current[0] == 'f' && IsSpace(current[1]))
+			{
+				faceCorners.clear();
+				const char* corner = SkipSpaces(current + 2, lineEnd);
+				while (corner < lineEnd)
+				{
+					// v, v/vt, v//vn or v/vt/vn
+					ObjCorner faceCorner = { 0, 0, 0 };
+					corner = ParseIndex(corner, lineEnd, static_cast<uint32_t>(chunk.Positions.size()), faceCorner.Position);
+					if (corner && corner < lineEnd && *corner == '/')
+					{
+						corner++;
+						if (corner < lineEnd && *corner != '/')
+						{
+							corner = ParseIndex(corner, lineEnd, static_cast<uint32_t>(chunk.TextureCoords.size()), faceCorner.TextureCoord);
+						}
+						if (corner && corner < lineEnd && *corner == '/')
+						{
+							corner = ParseIndex(corner + 1, lineEnd, static_cast<uint32_t>(chunk.Normals.size()), faceCorner.Normal);
+						}
+					}
+					if (corner == nullptr || (corner < lineEnd && !IsSpace(*corner)))
+					{
+						chunk.Error = "Invalid OBJ face: " + std::string(current, lineEnd);
+						return;
+					}
+
+					faceCorners.push_back(faceCorner);
+					corner = SkipSpaces(corner, lineEnd);
+				}
+
+				for (size_t i = 2; i < faceCorners.size(); i++)
+				{
+					chunk.Corners.push_back(faceCorners[0]);
+					chunk.Corners.push_back(faceCorners[i - 1]);
+					chunk.Corners.push_back(faceCorners[i]);
+				}
+			}
+			else if ((current[0] == 'o' || current[0] == 'g') && IsSpace(current[1]))
+			{
+				chunk.StateChanges.push_back({ static_cast<uint32_t>(chunk.Corners.size()), true, false, std::string() });
+			}
+			else if (StartsWithKeyword(current, lineEnd, "usemtl"))
+			{
+				chunk.StateChanges.push_back({ static_cast<uint32_t>(chunk.Corners.size()), false, true, ParseName(current + 6, lineEnd) });
+			}
+			else if (StartsWithKeyword(current, lineEnd, "mtllib"))
+			{
+				chunk.MaterialLibraries.push_back(ParseName(current + 6, lineEnd));
+			}
+		}
+
+		current = lineEnd + 1;
+	}
+}
+
+// Global 0-based index of a parsed one (-1 = missing), false when out of range
+static bool ResolveIndex(int32_t& index, uint32_t chunkFirst, uint32_t totalCount)
+{
+	int64_t resolved = -1;
+	if (index > 0)
+	{
+		resolved = index - 1;
+	}
+	else if (index < 0)
+	{
+		resolved = static_cast<int64_t>(chunkFirst) + index + OBJ_RELATIVE_BIAS;
+	}
+
+	if (resolved >= static_cast<int64_t>(totalCount) || (index != 0 && resolved < 0))
+	{
+		return false;
+	}
+	index = static_cast<int32_t>(resolved);
+	return true;
+}
+
+static uint32_t HashCorner(const ObjCorner& corner)
+{
+	uint32_t hash = static_cast<uint32_t>(corner.Position) * 73856093u;
+	hash ^= static_cast<uint32_t>(corner.TextureCoord) * 19349663u;
+	hash ^= static_cast<uint32_t>(corner.Normal) * 83492791u;
+	return hash ^ (hash >> 15);
+}
+
+bool ObjModel::IsObjFile(const std::string& filepath)
+{
+	size_t dot = filepath.rfind('.');
+	if (dot == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string extension = filepath.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+	return extension == "obj";
+}
+
+void ObjModel::Load(const std::string& filepath, JobSystem& jobSystem)
+{
+	TRACE_FUNCTION();
+
+	MappedFile file;
+	if (!file.Open(filepath))
+	{
+		throw std::runtime_error("Failed to open OBJ file: " + filepath);
+	}
+
+	std::string directory;
+	size_t lastSlash = filepath.find_last_of("/\\");
+	if (lastSlash != std::string::npos)
+	{
+		directory = filepath.substr(0, lastSlash + 1);
+	}
+
+	// Chunks of whole lines
+	const char* text = reinterpret_cast<const char*>(file.GetData());
+	const char* textEnd = text + file.GetSize();
+	std::vector<ObjChunk> chunks;
+	const char* chunkBegin = text;
+	while (chunkBegin < textEnd)
+	{
+		const char* chunkEnd = textEnd;
+		if (static_cast<size_t>(textEnd - chunkBegin) > OBJ_PARSE_CHUNK_SIZE)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(chunkBegin + OBJ_PARSE_CHUNK_SIZE, '\n', textEnd - chunkBegin - OBJ_PARSE_CHUNK_SIZE));
+			chunkEnd = lineEnd ? lineEnd + 1 : textEnd;
+		}
+
+		chunks.emplace_back();
+		chunks.back().Begin = chunkBegin;
+		chunks.back().End = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	JobCounter parseCounter;
+	jobSystem.ParallelFor(static_cast<uint32_t>(chunks.size()), 1, [&chunks](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			ParseChunk(chunks[i]);
+		}
+	}, &parseCounter);
+	jobSystem.Wait(parseCounter);
+
+	// First global index of every chunk's elements
+	std::vector<uint32_t> firstPositions(chunks.size()), firstTextureCoords(chunks.size()), firstNormals(chunks.size());
+	uint32_t positionCount = 0, textureCoordCount = 0, normalCount = 0;
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		if (!chunks[i].Error.empty())
+		{
+			throw std::runtime_error(chunks[i].Error + " (" + filepath + ")");
+		}
+
+		firstPositions[i] = positionCount;
+		firstTextureCoords[i] = textureCoordCount;
+		firstNormals[i] = normalCount;
+		positionCount += static_cast<uint32_t>(chunks[i].Positions.size());
+		textureCoordCount += static_cast<uint32_t>(chunks[i].TextureCoords.size());
+		normalCount += static_cast<uint32_t>(chunks[i].Normals.size());
+	}
+
+	// Gather the elements and resolve the corner indices, per chunk
+	std::vector<glm::vec3> positions(positionCount);
+	std::vector<glm::vec2> textureCoords(textureCoordCount);
+	std::vector<glm::vec3> normals(normalCount);
+	JobCounter resolveCounter;
+	jobSystem.ParallelFor(static_cast<uint32_t>(chunks.size()), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			ObjChunk& chunk = chunks[i];
+			std::copy(chunk.Positions.begin(), chunk.Positions.end(), positions.begin() + firstPositions[i]);
+			std::copy(chunk.TextureCoords.begin(), chunk.TextureCoords.end(), textureCoords.begin() + firstTextureCoords[i]);
+			std::copy(chunk.Normals.begin(), chunk.Normals.end(), normals.begin() + firstNormals[i]);
+
+			for (ObjCorner& corner : chunk.Corners)
+			{
+				if (!ResolveIndex(corner.Position, firstPositions[i], positionCount) || corner.Position < 0 ||
+					!ResolveIndex(corner.TextureCoord, firstTextureCoords[i], textureCoordCount) ||
+					!ResolveIndex(corner.Normal, firstNormals[i], normalCount))
+				{
+					chunk.Error = "OBJ face index out of range";
+					break;
+				}
+			}
+		}
+	}, &resolveCounter);
+	jobSystem.Wait(resolveCounter);
+
+	for (ObjChunk& chunk : chunks)
+	{
+		if (!chunk.Error.empty())
+		{
+			throw std::runtime_error(chunk.Error + " (" + filepath + ")");
+		}
+		for (const std::string& library : chunk.MaterialLibraries)
+		{
+			LoadMaterialLibrary(directory + library);
+		}
+	}
+
+	// Faces of the same group and material form one mesh (in order of first use, like Assimp)
+	std::map<std::pair<uint32_t, int32_t>, uint32_t> meshLookup;
+	std::vector<ObjMeshCorners> meshCorners;
+	uint32_t group = 0;
+	int32_t material = -1;
+	auto addRange = [&](uint32_t chunk, uint32_t begin, uint32_t end)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+
+		auto inserted = meshLookup.insert({ { group, material }, static_cast<uint32_t>(meshCorners.size()) });
+		if (inserted.second)
+		{
+			meshCorners.emplace_back();
+			m_Meshes.emplace_back();
+			m_Meshes.back().Material = material;
+		}
+
+		ObjMeshCorners& corners = meshCorners[inserted.first->second];
+		corners.Ranges.push_back({ chunk, begin, end });
+		corners.CornerCount += end - begin;
+	};
+
+	for (uint32_t c = 0; c < chunks.size(); c++)
+	{
+		uint32_t begin = 0;
+		for (const ObjStateChange& stateChange : chunks[c].StateChanges)
+		{
+			addRange(c, begin, stateChange.FirstCorner);
+			begin = stateChange.FirstCorner;
+
+			group += stateChange.NewGroup;
+			if (stateChange.SetsMaterial)
+			{
+				auto name = std::find(m_MaterialNames.begin(), m_MaterialNames.end(), stateChange.Material);
+				material = name != m_MaterialNames.end() ? static_cast<int32_t>(name - m_MaterialNames.begin()) : -1;
+			}
+		}
+		addRange(c, begin, static_cast<uint32_t>(chunks[c].Corners.size()));
+	}
+
+	// Assemble the meshes, joining identical corners (open addressing table of vertex indices)
+	JobCounter meshCounter;
+	jobSystem.ParallelFor(static_cast<uint32_t>(m_Meshes.size()), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t m = begin; m < end; m++)
+		{
+			ObjMesh& mesh = m_Meshes[m];
+			const ObjMeshCorners& corners = meshCorners[m];
+
+			uint32_t tableSize = 16;
+			while (tableSize < corners.CornerCount * 2)
+			{
+				tableSize *= 2;
+			}
+			std::vector<uint32_t> table(tableSize, UINT32_MAX);
+			std::vector<ObjCorner> vertexCorners;
+			vertexCorners.reserve(corners.CornerCount);
+			mesh.Vertices.reserve(corners.CornerCount);
+			mesh.Indices.reserve(corners.CornerCount);
+
+			bool hasNormals = false;
+			for (const ObjCornerRange& range : corners.Ranges)
+			{
+				const std::vector<ObjCorner>& chunkCorners = chunks[range.Chunk].Corners;
+				for (uint32_t i = range.Begin; i < range.End; i++)
+				{
+					const ObjCorner& corner = chunkCorners[i];
+					uint32_t slot = HashCorner(corner) & (tableSize - 1);
+					while (table[slot] != UINT32_MAX)
+					{
+						const ObjCorner& existing = vertexCorners[table[slot]];
+						if (existing.Position == corner.Position && existing.TextureCoord == corner.TextureCoord && existing.Normal == corner.Normal)
+						{
+							break;
+						}
+						slot = (slot + 1) & (tableSize - 1);
+					}
+
+					if (table[slot] == UINT32_MAX)
+					{
+						table[slot] = static_cast<uint32_t>(mesh.Vertices.size());
+						vertexCorners.push_back(corner);
+
+						// Flipped texture coordinates (aiProcess_FlipUVs), zero normal = unlit until generated
+						Vertex vertex;
+						vertex.Position = positions[corner.Position];
+						vertex.Color = glm::vec3(1.0f);
+						vertex.TextureCoords = corner.TextureCoord >= 0
+							? glm::vec2(textureCoords[corner.TextureCoord].x, 1.0f - textureCoords[corner.TextureCoord].y) : glm::vec2(0.0f);
+						vertex.Normal = glm::vec3(0.0f);
+						if (corner.Normal >= 0 && glm::dot(normals[corner.Normal], normals[corner.Normal]) > 0.0f)
+						{
+							vertex.Normal = glm::normalize(normals[corner.Normal]);
+						}
+						hasNormals = hasNormals || corner.Normal >= 0;
+						mesh.Vertices.push_back(vertex);
+					}
+					mesh.Indices.push_back(table[slot]);
+				}
+			}
+
+			// Smooth normals for meshes without any (aiProcess_GenSmoothNormals): area weighted face normals summed
+			// per position, so vertices only split by their texture coordinates stay smooth
+			if (!hasNormals)
+			{
+				std::unordered_map<int32_t, glm::vec3> positionNormals;
+				for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+				{
+					const glm::vec3& p0 = mesh.Vertices[mesh.Indices[i]].Position;
+					glm::vec3 faceNormal = glm::cross(mesh.Vertices[mesh.Indices[i + 1]].Position - p0, mesh.Vertices[mesh.Indices[i + 2]].Position - p0);
+					for (size_t k = 0; k < 3; k++)
+					{
+						positionNormals[vertexCorners[mesh.Indices[i + k]].Position] += faceNormal;
+					}
+				}
+
+				for (size_t v = 0; v < mesh.Vertices.size(); v++)
+				{
+					glm::vec3 normal = positionNormals[vertexCorners[v].Position];
+					mesh.Vertices[v].Normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+				}
+			}
+
+			mesh.Vertices.shrink_to_fit();
+		}
+	}, &meshCounter);
+	jobSystem.Wait(meshCounter);
+}
+
+void ObjModel::LoadMaterialLibrary(const std::string& filepath)
+{
+	MappedFile file;
+	if (!file.Open(filepath))
+	{
+		return;
+	}
+
+	const char* current = reinterpret_cast<const char*>(file.GetData());
+	const char* end = current + file.GetSize();
+	while (current < end)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(current, '\n', end - current));
+		lineEnd = lineEnd ? lineEnd : end;
+		current = SkipSpaces(current, lineEnd);
+
+		if (StartsWithKeyword(current, lineEnd, "newmtl"))
+		{
+			m_MaterialNames.push_back(ParseName(current + 6, lineEnd));
+			m_MaterialTextures.emplace_back();
+		}
+		else if (StartsWithKeyword(current, lineEnd, "map_Kd") && !m_MaterialTextures.empty())
+		{
+			// Options ("-bm 0.5", "-s 1 1 1", ...) come before the file name, which is the last token
+			std::string texture = ParseName(current + 6, lineEnd);
+			size_t lastSpace = texture.find_last_of(" \t");
+			m_MaterialTextures.back() = lastSpace != std::string::npos && texture[0] == '-' ? texture.substr(lastSpace + 1) : texture;
+		}
+
+		current = lineEnd + 1;
+	}
+}
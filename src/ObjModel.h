@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "Utils.h"
+
+class JobSystem;
+
+// Faces of one object or group of an OBJ file with one material, triangulated, identical vertices joined
+struct ObjMesh
+{
+	std::vector<Vertex> Vertices;
+	std::vector<uint32_t> Indices;
+	int32_t Material = -1;		// -1 = none
+};
+
+// Wavefront OBJ model with its MTL materials. The file is memory mapped and split into chunks of whole lines that
+// are parsed in parallel, the meshes are then assembled in parallel (vertices joined through a hash table on their
+// position, texture coordinate and normal indices). Same result as the Assimp import with the renderer's flags:
+// polygons fanned into triangles, flipped texture coordinates, smooth normals generated for meshes without any.
+class ObjModel
+{
+public:
+	ObjModel() = default;
+
+	// Throws on invalid files (missing material libraries are skipped, like Assimp does)
+	void Load(const std::string& filepath, JobSystem& jobSystem);
+	static bool IsObjFile(const std::string& filepath);
+
+	std::vector<ObjMesh>& GetMeshes() { return m_Meshes; }
+	// Diffuse texture (map_Kd) of every material, empty = none
+	const std::vector<std::string>& GetMaterialTextures() const { return m_MaterialTextures; }
+
+private:
+	void LoadMaterialLibrary(const std::string& filepath);
+
+private:
+	std::vector<ObjMesh> m_Meshes;
+	std::vector<std::string> m_MaterialNames;
+	std::vector<std::string> m_MaterialTextures;
+};
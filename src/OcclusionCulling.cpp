@@ -0,0 +1,127 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+
+#include "Trace.h"
+#include "Utils.h"
+
+void OcclusionCulling::UpdatePyramid(const float* tiles, uint32_t renderWidth, uint32_t renderHeight, const glm::mat4& viewProjection,
+	uint64_t frame)
+{
+	TRACE_FUNCTION();
+
+	uint32_t width = (renderWidth + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+	uint32_t height = (renderHeight + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+
+	m_ViewProjection = viewProjection;
+	m_TileScale = glm::vec2(static_cast<float>(renderWidth), static_cast<float>(renderHeight)) / static_cast<float>(HIZ_TILE_SIZE);
+	m_Stats.PyramidFrame = frame;
+
+	// Keeps the level allocations from one frame to the next
+	uint32_t levelCount = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size = (size + 1) / 2)
+	{
+		levelCount++;
+	}
+	m_Levels.resize(levelCount);
+
+	m_Levels[0].Width = width;
+	m_Levels[0].Height = height;
+	m_Levels[0].Depth.assign(tiles, tiles + width * height);
+
+	// Odd sides: the last texel of a level also covers the last texel of the level below
+	for (uint32_t l = 1; l < levelCount; l++)
+	{
+		const Level& source = m_Levels[l - 1];
+		Level& level = m_Levels[l];
+		level.Width = (source.Width + 1) / 2;
+		level.Height = (source.Height + 1) / 2;
+		level.Depth.resize(level.Width * level.Height);
+
+		for (uint32_t y = 0; y < level.Height; y++)
+		{
+			uint32_t y0 = y * 2;
+			uint32_t y1 = std::min(y0 + 1, source.Height - 1);
+			for (uint32_t x = 0; x < level.Width; x++)
+			{
+				uint32_t x0 = x * 2;
+				uint32_t x1 = std::min(x0 + 1, source.Width - 1);
+				level.Depth[y * level.Width + x] = std::max(
+					std::max(source.Depth[y0 * source.Width + x0], source.Depth[y0 * source.Width + x1]),
+					std::max(source.Depth[y1 * source.Width + x0], source.Depth[y1 * source.Width + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCulling::IsOccluded(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	if (m_Levels.empty())
+	{
+		return false;
+	}
+	m_Stats.Tested++;
+
+	// Screen rectangle and nearest depth of the box in the pyramid's frame
+	glm::mat4 modelViewProjection = m_ViewProjection * model;
+	glm::vec2 ndcMin(1.0f);
+	glm::vec2 ndcMax(-1.0f);
+	float nearestDepth = 1.0f;
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = modelViewProjection * glm::vec4(position, 1.0f);
+
+		// Crosses the near plane: the camera is (nearly) inside the box
+		if (clip.w <= 1e-4f)
+		{
+			return false;
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		ndcMin = glm::min(ndcMin, glm::vec2(ndc));
+		ndcMax = glm::max(ndcMax, glm::vec2(ndc));
+		nearestDepth = std::min(nearestDepth, ndc.z);
+	}
+
+	// Partly outside the old view: nothing is known about what hides it there
+	if (ndcMin.x < -1.0f || ndcMin.y < -1.0f || ndcMax.x > 1.0f || ndcMax.y > 1.0f)
+	{
+		return false;
+	}
+
+	// Tiles covered on the finest level (ndc -1..1 spans the render extent, y down like the depth buffer)
+	const Level& finest = m_Levels[0];
+	uint32_t x0 = std::min(static_cast<uint32_t>((ndcMin.x * 0.5f + 0.5f) * m_TileScale.x), finest.Width - 1);
+	uint32_t x1 = std::min(static_cast<uint32_t>((ndcMax.x * 0.5f + 0.5f) * m_TileScale.x), finest.Width - 1);
+	uint32_t y0 = std::min(static_cast<uint32_t>((ndcMin.y * 0.5f + 0.5f) * m_TileScale.y), finest.Height - 1);
+	uint32_t y1 = std::min(static_cast<uint32_t>((ndcMax.y * 0.5f + 0.5f) * m_TileScale.y), finest.Height - 1);
+
+	// Coarsest level where the rectangle still covers at most 2x2 texels
+	uint32_t l = 0;
+	while (l + 1 < m_Levels.size() && ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1))
+	{
+		l++;
+	}
+
+	const Level& level = m_Levels[l];
+	float farthestOccluder = 0.0f;
+	for (uint32_t y = y0 >> l; y <= (y1 >> l); y++)
+	{
+		for (uint32_t x = x0 >> l; x <= (x1 >> l); x++)
+		{
+			farthestOccluder = std::max(farthestOccluder, level.Depth[y * level.Width + x]);
+		}
+	}
+
+	bool occluded = nearestDepth > farthestOccluder;
+	m_Stats.Occluded += occluded ? 1 : 0;
+	return occluded;
+}
+
+void OcclusionCulling::ResetStats()
+{
+	m_Stats.Tested = 0;
+	m_Stats.Occluded = 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+struct OcclusionStats
+{
+	uint32_t Tested = 0;
+	uint32_t Occluded = 0;
+	uint64_t PyramidFrame = 0;		// frame the depth pyramid was built from (0 = none yet)
+};
+
+// Hierarchical-Z occlusion culling on the CPU. The GPU reduces the depth buffer of every frame to the max depth of
+// HIZ_TILE_SIZE tiles, which is read back once the frame is done and turned into a max depth pyramid here.
+// Bounds are reprojected into the frame the pyramid comes from (its view-projection), so a moving camera or object
+// is tested against where the occluders really were.
+class OcclusionCulling
+{
+public:
+	OcclusionCulling() = default;
+
+	// tiles = max depths of the HIZ_TILE_SIZE tiles of a renderWidth x renderHeight depth buffer (row major),
+	// viewProjection = the one the frame was rendered with
+	void UpdatePyramid(const float* tiles, uint32_t renderWidth, uint32_t renderHeight, const glm::mat4& viewProjection, uint64_t frame);
+	bool HasPyramid() const { return !m_Levels.empty(); }
+
+	// True if the model space box is hidden behind what the pyramid's frame had drawn
+	bool IsOccluded(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	void ResetStats();
+	const OcclusionStats& GetStats() const { return m_Stats; }
+
+private:
+	struct Level
+	{
+		uint32_t Width;
+		uint32_t Height;
+		std::vector<float> Depth;
+	};
+
+	std::vector<Level> m_Levels;			// 0 = tiles, each next level halves both sides (max of 2x2), last is 1x1
+	glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+	glm::vec2 m_TileScale = glm::vec2(0.0f);	// tiles across the render extent (the last tile of a row/column is partial)
+	OcclusionStats m_Stats;
+};
@@ -0,0 +1,557 @@
+#include "PipelineManager.h"
+
+#include <stdexcept>
+#include <iostream>
+#include <cstring>
+#include <limits>
+#include <array>
+
+#include "Utils.h"
+#include "Trace.h"
+
+// FNV-1a, good enough to bucket pipeline descriptions (collisions are resolved with operator==)
+static const uint64_t s_HashOffset = 14695981039346656037ull;
+static const uint64_t s_HashPrime = 1099511628211ull;
+
+static void HashBytes(uint64_t& hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= s_HashPrime;
+	}
+}
+
+template<typename T>
+static void HashValue(uint64_t& hash, const T& value)
+{
+	HashBytes(hash, &value, sizeof(T));
+}
+
+SpecializationConstant SpecializationConstant::Int(uint32_t constantID, int32_t value)
+{
+	SpecializationConstant constant;
+	constant.ConstantID = constantID;
+	memcpy(&constant.Value, &value, sizeof(uint32_t));
+	return constant;
+}
+
+SpecializationConstant SpecializationConstant::Float(uint32_t constantID, float value)
+{
+	SpecializationConstant constant;
+	constant.ConstantID = constantID;
+	memcpy(&constant.Value, &value, sizeof(uint32_t));
+	return constant;
+}
+
+uint64_t PipelineDesc::Hash() const
+{
+	uint64_t hash = s_HashOffset;
+
+	HashBytes(hash, VertexShader.data(), VertexShader.size());
+	HashValue(hash, '\0');
+	HashBytes(hash, FragmentShader.data(), FragmentShader.size());
+	HashValue(hash, '\0');
+	HashBytes(hash, ComputeShader.data(), ComputeShader.size());
+	HashValue(hash, '\0');
+
+	for (const SpecializationConstant& constant : SpecializationConstants)
+	{
+		HashValue(hash, constant.ConstantID);
+		HashValue(hash, constant.Value);
+	}
+
+	HashValue(hash, VertexStride);
+	for (const VkVertexInputAttributeDescription& attribute : VertexAttributes)
+	{
+		HashValue(hash, attribute.location);
+		HashValue(hash, attribute.format);
+		HashValue(hash, attribute.offset);
+	}
+
+	HashValue(hash, Topology);
+	HashValue(hash, PolygonMode);
+	HashValue(hash, CullMode);
+	HashValue(hash, FrontFace);
+
+	HashValue(hash, DepthTest);
+	HashValue(hash, DepthWrite);
+	HashValue(hash, DepthCompareOp);
+
+	HashValue(hash, ColorAttachmentCount);
+	HashValue(hash, BlendEnable);
+	HashValue(hash, SrcColorBlendFactor);
+	HashValue(hash, DstColorBlendFactor);
+	HashValue(hash, ColorBlendOp);
+	HashValue(hash, SrcAlphaBlendFactor);
+	HashValue(hash, DstAlphaBlendFactor);
+	HashValue(hash, AlphaBlendOp);
+
+	HashValue(hash, Layout);
+	HashValue(hash, RenderPass);
+	HashValue(hash, Subpass);
+
+	return hash;
+}
+
+bool PipelineDesc::operator==(const PipelineDesc& other) const
+{
+	if (!IsCompatible(other) || SpecializationConstants.size() != other.SpecializationConstants.size())
+		return false;
+
+	for (size_t i = 0; i < SpecializationConstants.size(); i++)
+	{
+		if (SpecializationConstants[i].ConstantID != other.SpecializationConstants[i].ConstantID
+			|| SpecializationConstants[i].Value != other.SpecializationConstants[i].Value)
+			return false;
+	}
+
+	return VertexShader == other.VertexShader && FragmentShader == other.FragmentShader && ComputeShader == other.ComputeShader
+		&& Topology == other.Topology && PolygonMode == other.PolygonMode
+		&& CullMode == other.CullMode && FrontFace == other.FrontFace
+		&& DepthTest == other.DepthTest && DepthWrite == other.DepthWrite && DepthCompareOp == other.DepthCompareOp
+		&& ColorAttachmentCount == other.ColorAttachmentCount && BlendEnable == other.BlendEnable
+		&& SrcColorBlendFactor == other.SrcColorBlendFactor && DstColorBlendFactor == other.DstColorBlendFactor
+		&& ColorBlendOp == other.ColorBlendOp
+		&& SrcAlphaBlendFactor == other.SrcAlphaBlendFactor && DstAlphaBlendFactor == other.DstAlphaBlendFactor
+		&& AlphaBlendOp == other.AlphaBlendOp;
+}
+
+bool PipelineDesc::IsCompatible(const PipelineDesc& other) const
+{
+	if (ComputeShader.empty() != other.ComputeShader.empty())
+		return false;
+
+	if (Layout != other.Layout || RenderPass != other.RenderPass || Subpass != other.Subpass
+		|| ColorAttachmentCount != other.ColorAttachmentCount || VertexStride != other.VertexStride || VertexAttributes.size() != other.VertexAttributes.size())
+		return false;
+
+	for (size_t i = 0; i < VertexAttributes.size(); i++)
+	{
+		if (VertexAttributes[i].location != other.VertexAttributes[i].location
+			|| VertexAttributes[i].format != other.VertexAttributes[i].format
+			|| VertexAttributes[i].offset != other.VertexAttributes[i].offset)
+			return false;
+	}
+
+	return true;
+}
+
+uint32_t PipelineDesc::Distance(const PipelineDesc& other) const
+{
+	uint32_t distance = 0;
+
+	// A different shader changes far more than a state or constant does
+	distance += (VertexShader != other.VertexShader) ? 8 : 0;
+	distance += (FragmentShader != other.FragmentShader) ? 8 : 0;
+	distance += (ComputeShader != other.ComputeShader) ? 8 : 0;
+
+	// Constants missing on either side count as different
+	for (const SpecializationConstant& constant : SpecializationConstants)
+	{
+		bool matched = false;
+		for (const SpecializationConstant& otherConstant : other.SpecializationConstants)
+		{
+			if (otherConstant.ConstantID == constant.ConstantID)
+			{
+				matched = otherConstant.Value == constant.Value;
+				break;
+			}
+		}
+		distance += matched ? 0 : 1;
+	}
+	if (other.SpecializationConstants.size() > SpecializationConstants.size())
+	{
+		distance += static_cast<uint32_t>(other.SpecializationConstants.size() - SpecializationConstants.size());
+	}
+
+	distance += (Topology != other.Topology) + (PolygonMode != other.PolygonMode)
+		+ (CullMode != other.CullMode) + (FrontFace != other.FrontFace);
+	distance += (DepthTest != other.DepthTest) + (DepthWrite != other.DepthWrite) + (DepthCompareOp != other.DepthCompareOp);
+	distance += (BlendEnable != other.BlendEnable) + (SrcColorBlendFactor != other.SrcColorBlendFactor)
+		+ (DstColorBlendFactor != other.DstColorBlendFactor) + (ColorBlendOp != other.ColorBlendOp);
+
+	return distance;
+}
+
+void PipelineManager::Init(VkDevice device, VkPipelineCache pipelineCache, JobSystem& jobSystem)
+{
+	m_Device = device;
+	m_PipelineCache = pipelineCache;
+	m_JobSystem = &jobSystem;
+	m_Stopping = false;
+}
+
+void PipelineManager::Destroy()
+{
+	// Pipelines still queued are dropped, compiles already running are waited for
+	m_Stopping = true;
+	for (std::unique_ptr<PipelineEntry>& entry : m_Entries)
+	{
+		if (m_JobSystem != nullptr)
+		{
+			m_JobSystem->Wait(entry->CompileCounter);
+		}
+	}
+
+	for (std::unique_ptr<PipelineEntry>& entry : m_Entries)
+	{
+		if (entry->Pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(m_Device, entry->Pipeline, nullptr);
+		}
+	}
+	m_Entries.clear();
+	m_HashToID.clear();
+
+	for (auto& shaderModule : m_ShaderModules)
+	{
+		vkDestroyShaderModule(m_Device, shaderModule.second, nullptr);
+	}
+	m_ShaderModules.clear();
+}
+
+uint32_t PipelineManager::Create(const PipelineDesc& desc)
+{
+	bool added = false;
+	uint32_t pipelineID = FindOrAdd(desc, &added);
+
+	PipelineEntry* entry;
+	{
+		std::lock_guard<std::mutex> lock(m_EntriesMutex);
+		entry = m_Entries[pipelineID].get();
+	}
+
+	if (added)
+	{
+		Compile(*entry);
+	}
+	else
+	{
+		// Already queued as a job: wait for it instead of compiling twice (runs it here if no worker took it yet)
+		m_JobSystem->Wait(entry->CompileCounter);
+
+		// Another thread added it and is compiling it (or has not queued the job yet)
+		std::unique_lock<std::mutex> lock(m_StateMutex);
+		m_StateCondition.wait(lock, [entry]() { return entry->State.load() != PipelineState::Pending; });
+	}
+
+	if (entry->State.load() != PipelineState::Ready)
+	{
+		throw std::runtime_error("Failed to create a graphics pipeline!");
+	}
+
+	return pipelineID;
+}
+
+uint32_t PipelineManager::Request(const PipelineDesc& desc)
+{
+	bool added = false;
+	uint32_t pipelineID = FindOrAdd(desc, &added);
+
+	if (added)
+	{
+		PipelineEntry* entry;
+		{
+			std::lock_guard<std::mutex> lock(m_EntriesMutex);
+			entry = m_Entries[pipelineID].get();
+		}
+
+		m_PendingCount++;
+		m_JobSystem->Run([this, entry]()
+		{
+			if (m_Stopping.load())
+				SetState(*entry, PipelineState::Failed);
+			else
+				Compile(*entry);
+			m_PendingCount--;
+		}, &entry->CompileCounter);
+	}
+
+	return pipelineID;
+}
+
+VkPipeline PipelineManager::Get(uint32_t pipelineID)
+{
+	std::lock_guard<std::mutex> lock(m_EntriesMutex);
+
+	const PipelineEntry& requested = *m_Entries[pipelineID];
+	if (requested.State.load() == PipelineState::Ready)
+	{
+		return requested.Pipeline;
+	}
+
+	// Not compiled yet: fall back to the closest ready permutation that can be bound in its place
+	VkPipeline nearest = VK_NULL_HANDLE;
+	uint32_t nearestDistance = std::numeric_limits<uint32_t>::max();
+	for (const std::unique_ptr<PipelineEntry>& entry : m_Entries)
+	{
+		if (entry->State.load() != PipelineState::Ready || !requested.Desc.IsCompatible(entry->Desc))
+			continue;
+
+		uint32_t distance = requested.Desc.Distance(entry->Desc);
+		if (distance < nearestDistance)
+		{
+			nearest = entry->Pipeline;
+			nearestDistance = distance;
+		}
+	}
+
+	return nearest;
+}
+
+bool PipelineManager::IsReady(uint32_t pipelineID)
+{
+	std::lock_guard<std::mutex> lock(m_EntriesMutex);
+	return m_Entries[pipelineID]->State.load() == PipelineState::Ready;
+}
+
+uint32_t PipelineManager::FindOrAdd(const PipelineDesc& desc, bool* added)
+{
+	uint64_t hash = desc.Hash();
+
+	std::lock_guard<std::mutex> lock(m_EntriesMutex);
+
+	// Identical description already known: share it
+	auto range = m_HashToID.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (m_Entries[it->second]->Desc == desc)
+		{
+			*added = false;
+			return it->second;
+		}
+	}
+
+	std::unique_ptr<PipelineEntry> entry(new PipelineEntry());
+	entry->Desc = desc;
+	entry->Hash = hash;
+
+	uint32_t pipelineID = static_cast<uint32_t>(m_Entries.size());
+	m_Entries.push_back(std::move(entry));
+	m_HashToID.emplace(hash, pipelineID);
+
+	*added = true;
+	return pipelineID;
+}
+
+void PipelineManager::Compile(PipelineEntry& entry)
+{
+	TRACE_FUNCTION();
+
+	const PipelineDesc& desc = entry.Desc;
+
+	try
+	{
+		// -- Specialization constants (same map for both stages, ids missing in a stage are ignored)
+		std::vector<VkSpecializationMapEntry> mapEntries(desc.SpecializationConstants.size());
+		std::vector<uint32_t> constantData(desc.SpecializationConstants.size());
+		for (size_t i = 0; i < desc.SpecializationConstants.size(); i++)
+		{
+			mapEntries[i].constantID = desc.SpecializationConstants[i].ConstantID;
+			mapEntries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+			mapEntries[i].size = sizeof(uint32_t);
+			constantData[i] = desc.SpecializationConstants[i].Value;
+		}
+
+		VkSpecializationInfo specializationInfo = {};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+		specializationInfo.pMapEntries = mapEntries.data();
+		specializationInfo.dataSize = constantData.size() * sizeof(uint32_t);
+		specializationInfo.pData = constantData.data();
+
+		// -- Compute pipeline (single stage, no fixed function state)
+		if (!desc.ComputeShader.empty())
+		{
+			VkComputePipelineCreateInfo computeCreateInfo = {};
+			computeCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			computeCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			computeCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			computeCreateInfo.stage.module = GetShaderModule(desc.ComputeShader);
+			computeCreateInfo.stage.pName = "main";
+			computeCreateInfo.stage.pSpecializationInfo = mapEntries.empty() ? nullptr : &specializationInfo;
+			computeCreateInfo.layout = desc.Layout;
+			computeCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+			computeCreateInfo.basePipelineIndex = -1;
+
+			VkResult result = vkCreateComputePipelines(m_Device, m_PipelineCache, 1, &computeCreateInfo, nullptr, &entry.Pipeline);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create a compute pipeline!");
+			}
+
+			SetState(entry, PipelineState::Ready);
+			return;
+		}
+
+		// -- Shader stages
+		VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = GetShaderModule(desc.VertexShader);
+		shaderStages[0].pName = "main";
+		shaderStages[0].pSpecializationInfo = mapEntries.empty() ? nullptr : &specializationInfo;
+
+		shaderStages[1] = shaderStages[0];
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = GetShaderModule(desc.FragmentShader);
+
+		// -- Vertex Input
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = desc.VertexStride;
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions = desc.VertexAttributes;
+		for (VkVertexInputAttributeDescription& attribute : attributeDescriptions)
+		{
+			attribute.binding = 0;
+		}
+
+		VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
+		vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputCreateInfo.vertexBindingDescriptionCount = desc.VertexStride > 0 ? 1 : 0;
+		vertexInputCreateInfo.pVertexBindingDescriptions = desc.VertexStride > 0 ? &bindingDescription : nullptr;
+		vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+		// -- Input Assembly
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
+		inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssemblyCreateInfo.topology = desc.Topology;
+		inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+		// -- Viewport & Scissor (dynamic, the render resolution changes at runtime)
+		VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
+		viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportStateCreateInfo.viewportCount = 1;
+		viewportStateCreateInfo.pViewports = nullptr;
+		viewportStateCreateInfo.scissorCount = 1;
+		viewportStateCreateInfo.pScissors = nullptr;
+
+		std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
+		dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
+		// -- Rasterizer
+		VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
+		rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizerCreateInfo.depthClampEnable = VK_FALSE;
+		rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+		rasterizerCreateInfo.polygonMode = desc.PolygonMode;
+		rasterizerCreateInfo.lineWidth = 1.0f;
+		rasterizerCreateInfo.cullMode = desc.CullMode;
+		rasterizerCreateInfo.frontFace = desc.FrontFace;
+		rasterizerCreateInfo.depthBiasEnable = VK_FALSE;
+
+		// -- Multisampling
+		VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
+		multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;
+		multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		// -- Blending
+		VkPipelineColorBlendAttachmentState colorState = {};
+		colorState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+									| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		colorState.blendEnable = desc.BlendEnable ? VK_TRUE : VK_FALSE;
+		colorState.srcColorBlendFactor = desc.SrcColorBlendFactor;
+		colorState.dstColorBlendFactor = desc.DstColorBlendFactor;
+		colorState.colorBlendOp = desc.ColorBlendOp;
+		colorState.srcAlphaBlendFactor = desc.SrcAlphaBlendFactor;
+		colorState.dstAlphaBlendFactor = desc.DstAlphaBlendFactor;
+		colorState.alphaBlendOp = desc.AlphaBlendOp;
+		std::vector<VkPipelineColorBlendAttachmentState> colorStates(desc.ColorAttachmentCount, colorState);
+
+		VkPipelineColorBlendStateCreateInfo colorBlendingCreateInfo = {};
+		colorBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlendingCreateInfo.logicOpEnable = VK_FALSE;
+		colorBlendingCreateInfo.logicOp = VK_LOGIC_OP_COPY;
+		colorBlendingCreateInfo.attachmentCount = static_cast<uint32_t>(colorStates.size());
+		colorBlendingCreateInfo.pAttachments = colorStates.data();
+
+		// -- Depth Stencil Testing
+		VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
+		depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencilCreateInfo.depthTestEnable = desc.DepthTest ? VK_TRUE : VK_FALSE;
+		depthStencilCreateInfo.depthWriteEnable = desc.DepthWrite ? VK_TRUE : VK_FALSE;
+		depthStencilCreateInfo.depthCompareOp = desc.DepthCompareOp;
+		depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+		depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+
+		// -- Graphics pipeline creation
+		VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineCreateInfo.stageCount = 2;
+		pipelineCreateInfo.pStages = shaderStages;
+		pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+		pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+		pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+		pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+		pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+		pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
+		pipelineCreateInfo.pColorBlendState = &colorBlendingCreateInfo;
+		pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+		pipelineCreateInfo.layout = desc.Layout;
+		pipelineCreateInfo.renderPass = desc.RenderPass;
+		pipelineCreateInfo.subpass = desc.Subpass;
+		pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineCreateInfo.basePipelineIndex = -1;
+
+		// The pipeline cache is internally synchronized, so workers can share it
+		VkResult result = vkCreateGraphicsPipelines(m_Device, m_PipelineCache, 1, &pipelineCreateInfo, nullptr, &entry.Pipeline);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a graphics pipeline!");
+		}
+
+		SetState(entry, PipelineState::Ready);
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cout << "ERROR: " << e.what() << " (" << (desc.ComputeShader.empty() ? desc.VertexShader + ", " + desc.FragmentShader : desc.ComputeShader) << ")" << std::endl;
+		SetState(entry, PipelineState::Failed);
+	}
+}
+
+void PipelineManager::SetState(PipelineEntry& entry, PipelineState state)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_StateMutex);
+		entry.State.store(state);
+	}
+	m_StateCondition.notify_all();
+}
+
+VkShaderModule PipelineManager::GetShaderModule(const std::string& filepath)
+{
+	std::lock_guard<std::mutex> lock(m_ShaderMutex);
+
+	// Modules are shared by every permutation of the same shader
+	auto it = m_ShaderModules.find(filepath);
+	if (it != m_ShaderModules.end())
+	{
+		return it->second;
+	}
+
+	std::vector<char> code = readSPVFile(filepath);
+
+	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = code.size();
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	VkResult result = vkCreateShaderModule(m_Device, &shaderModuleCreateInfo, nullptr, &shaderModule);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a shader module!");
+	}
+
+	m_ShaderModules[filepath] = shaderModule;
+	return shaderModule;
+}
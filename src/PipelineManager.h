@@ -0,0 +1,139 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include "JobSystem.h"
+
+// 32-bit specialization constant value (int, uint, float bits or bool) for a given constant_id
+struct SpecializationConstant
+{
+	uint32_t ConstantID;
+	uint32_t Value;
+
+	static SpecializationConstant Int(uint32_t constantID, int32_t value);
+	static SpecializationConstant Float(uint32_t constantID, float value);
+};
+
+// Everything that makes a pipeline permutation unique
+struct PipelineDesc
+{
+	// Shaders (SPIR-V paths) and their specialization constants (applied to every stage)
+	std::string VertexShader;
+	std::string FragmentShader;
+	std::string ComputeShader;			// set = compute pipeline (only the layout and constants are used)
+	std::vector<SpecializationConstant> SpecializationConstants;
+
+	// Vertex layout (stride 0 = no vertex input)
+	uint32_t VertexStride = 0;
+	std::vector<VkVertexInputAttributeDescription> VertexAttributes;
+
+	// Raster state
+	VkPrimitiveTopology Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPolygonMode PolygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags CullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace FrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	// Depth state
+	bool DepthTest = true;
+	bool DepthWrite = true;
+	VkCompareOp DepthCompareOp = VK_COMPARE_OP_LESS;
+
+	// Blend state (same for every color attachment of the subpass)
+	uint32_t ColorAttachmentCount = 1;
+	bool BlendEnable = false;
+	VkBlendFactor SrcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	VkBlendFactor DstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	VkBlendOp ColorBlendOp = VK_BLEND_OP_ADD;
+	VkBlendFactor SrcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	VkBlendFactor DstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	VkBlendOp AlphaBlendOp = VK_BLEND_OP_ADD;
+
+	// Where the pipeline is used (no render pass for compute pipelines)
+	VkPipelineLayout Layout = VK_NULL_HANDLE;
+	VkRenderPass RenderPass = VK_NULL_HANDLE;
+	uint32_t Subpass = 0;				// viewport and scissor are dynamic state (set when recording)
+
+	uint64_t Hash() const;
+	bool operator==(const PipelineDesc& other) const;
+
+	// Can a pipeline of `other` be bound in place of this one (same layout, pass and vertex input)
+	bool IsCompatible(const PipelineDesc& other) const;
+	// Number of differing shaders, constants and states (used to pick the nearest ready variant)
+	uint32_t Distance(const PipelineDesc& other) const;
+};
+
+// Owns every pipeline permutation. Identical descriptions are deduplicated, missing permutations
+// are compiled as jobs, and Get returns the nearest ready variant until a compile finishes.
+class PipelineManager
+{
+public:
+	PipelineManager() = default;
+	~PipelineManager() = default;
+
+	void Init(VkDevice device, VkPipelineCache pipelineCache, JobSystem& jobSystem);
+	void Destroy();
+
+	// Compile on the calling thread (startup pipelines, always ready once this returns)
+	uint32_t Create(const PipelineDesc& desc);
+	// Queue for background compilation, returns immediately
+	uint32_t Request(const PipelineDesc& desc);
+
+	// Requested pipeline if ready, otherwise the nearest compatible ready variant (VK_NULL_HANDLE if none)
+	VkPipeline Get(uint32_t pipelineID);
+	bool IsReady(uint32_t pipelineID);
+
+	uint32_t GetPendingCount() const { return m_PendingCount.load(); }
+
+private:
+	enum class PipelineState
+	{
+		Pending,
+		Ready,
+		Failed
+	};
+
+	struct PipelineEntry
+	{
+		PipelineDesc Desc;
+		uint64_t Hash;
+		VkPipeline Pipeline = VK_NULL_HANDLE;
+		std::atomic<PipelineState> State{ PipelineState::Pending };
+		JobCounter CompileCounter;		// background compile job of this entry
+	};
+
+	uint32_t FindOrAdd(const PipelineDesc& desc, bool* added);
+	void Compile(PipelineEntry& entry);
+	void SetState(PipelineEntry& entry, PipelineState state);
+	VkShaderModule GetShaderModule(const std::string& filepath);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	VkPipelineCache m_PipelineCache = VK_NULL_HANDLE;
+
+	// Entries never move (unique_ptr), so workers can compile while new ones are added
+	std::mutex m_EntriesMutex;
+	std::vector<std::unique_ptr<PipelineEntry>> m_Entries;
+	std::unordered_multimap<uint64_t, uint32_t> m_HashToID;
+
+	std::mutex m_ShaderMutex;
+	std::unordered_map<std::string, VkShaderModule> m_ShaderModules;
+
+	// Background compilation
+	JobSystem* m_JobSystem = nullptr;
+	std::atomic<uint32_t> m_PendingCount{ 0 };
+	std::atomic<bool> m_Stopping{ false };
+
+	// Signaled whenever an entry leaves the Pending state
+	std::mutex m_StateMutex;
+	std::condition_variable m_StateCondition;
+};
@@ -0,0 +1,1279 @@
+#include "RenderGraph.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include "Utils.h"
+
+uint32_t RenderGraph::CreateImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	Image image;
+	image.Name = name;
+	image.Desc = desc;
+	m_Images.push_back(image);
+
+	return static_cast<uint32_t>(m_Images.size() - 1);
+}
+
+uint32_t RenderGraph::ImportImage(const std::string& name, const RenderGraphImageDesc& desc, const std::vector<VkImage>& images,
+	const std::vector<VkImageView>& imageViews, VkImageLayout finalLayout)
+{
+	if (images.size() != imageViews.size())
+	{
+		throw std::runtime_error("Failed to import render graph image " + name + ": one view per image needed!");
+	}
+
+	Image image;
+	image.Name = name;
+	image.Desc = desc;
+	image.Imported = true;
+	image.FinalLayout = finalLayout;
+	image.Images = images;
+	image.ImageViews = imageViews;
+	m_Images.push_back(image);
+
+	return static_cast<uint32_t>(m_Images.size() - 1);
+}
+
+uint32_t RenderGraph::AddPass(const std::string& name, RenderGraphQueue queue, RenderGraphRecordFunc record)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Queue = queue;
+	pass.Record = std::move(record);
+	m_Passes.push_back(pass);
+
+	return static_cast<uint32_t>(m_Passes.size() - 1);
+}
+
+void RenderGraph::Read(uint32_t pass, uint32_t image, RenderGraphAccess access)
+{
+	if (IsWrite(access))
+	{
+		throw std::runtime_error("Failed to add a read to pass " + m_Passes[pass].Name + ": write access!");
+	}
+
+	ImageUse use;
+	use.Image = image;
+	use.Access = access;
+	AddUse(pass, use);
+}
+
+void RenderGraph::Write(uint32_t pass, uint32_t image, RenderGraphAccess access)
+{
+	if (!IsWrite(access))
+	{
+		throw std::runtime_error("Failed to add a write to pass " + m_Passes[pass].Name + ": read access!");
+	}
+
+	ImageUse use;
+	use.Image = image;
+	use.Access = access;
+	AddUse(pass, use);
+}
+
+void RenderGraph::Write(uint32_t pass, uint32_t image, RenderGraphAccess access, const VkClearValue& clearValue)
+{
+	if (!IsWrite(access) || !IsAttachment(access))
+	{
+		throw std::runtime_error("Failed to add a cleared write to pass " + m_Passes[pass].Name + ": not an attachment write!");
+	}
+
+	ImageUse use;
+	use.Image = image;
+	use.Access = access;
+	use.Clear = true;
+	use.ClearValue = clearValue;
+	AddUse(pass, use);
+}
+
+void RenderGraph::AddUse(uint32_t pass, const ImageUse& use)
+{
+	// One use per image and pass, a pass can't be in two layouts at once
+	for (const ImageUse& other : m_Passes[pass].Uses)
+	{
+		if (other.Image == use.Image)
+		{
+			throw std::runtime_error("Failed to add " + m_Images[use.Image].Name + " to pass " + m_Passes[pass].Name + ": already used!");
+		}
+	}
+
+	m_Passes[pass].Uses.push_back(use);
+}
+
+void RenderGraph::Compile(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t instanceCount, bool asyncCompute,
+	uint32_t graphicsFamily, uint32_t computeFamily)
+{
+	m_Device = device;
+	m_InstanceCount = instanceCount;
+
+	// Every imported image is indexed the same way (e.g. by swapchain image)
+	m_ImportCount = 0;
+	for (const Image& image : m_Images)
+	{
+		if (!image.Imported)
+		{
+			continue;
+		}
+
+		if (m_ImportCount != 0 && image.Images.size() != m_ImportCount)
+		{
+			throw std::runtime_error("Failed to compile render graph: imported images differ in count!");
+		}
+		m_ImportCount = static_cast<uint32_t>(image.Images.size());
+	}
+	m_ImportCount = std::max(m_ImportCount, 1u);
+
+	CullPasses();
+	BuildBatches(asyncCompute);
+	MergeRenderPasses();
+	CreateImages(physicalDevice, graphicsFamily, computeFamily);
+	BuildBarriers();
+	CreateRenderPasses();
+
+	m_Compiled = true;
+}
+
+void RenderGraph::Destroy()
+{
+	if (!m_Compiled)
+	{
+		return;
+	}
+
+	for (RenderPassGroup& group : m_RenderPasses)
+	{
+		for (VkFramebuffer framebuffer : group.Framebuffers)
+		{
+			vkDestroyFramebuffer(m_Device, framebuffer, nullptr);
+		}
+		vkDestroyRenderPass(m_Device, group.RenderPass, nullptr);
+	}
+
+	// Imported images belong to their owner
+	for (Image& image : m_Images)
+	{
+		if (image.Imported)
+		{
+			continue;
+		}
+
+		for (size_t i = 0; i < image.Images.size(); i++)
+		{
+			vkDestroyImageView(m_Device, image.ImageViews[i], nullptr);
+			vkDestroyImage(m_Device, image.Images[i], nullptr);
+		}
+	}
+
+	for (MemorySlot& slot : m_MemorySlots)
+	{
+		for (VkDeviceMemory memory : slot.Memory)
+		{
+			vkFreeMemory(m_Device, memory, nullptr);
+		}
+	}
+
+	m_Passes.clear();
+	m_Images.clear();
+	m_MemorySlots.clear();
+	m_RenderPasses.clear();
+	m_Batches.clear();
+	m_MemorySize = 0;
+	m_UnaliasedMemorySize = 0;
+	m_LazyMemorySize = 0;
+	m_Compiled = false;
+}
+
+VkRenderPass RenderGraph::GetRenderPass(uint32_t pass) const
+{
+	uint32_t renderPass = m_Passes[pass].RenderPass;
+	return renderPass == UINT32_MAX ? VK_NULL_HANDLE : m_RenderPasses[renderPass].RenderPass;
+}
+
+VkImageLayout RenderGraph::GetLayout(uint32_t image, RenderGraphAccess access) const
+{
+	return GetAccessLayout(access, IsDepthFormat(m_Images[image].Desc.Format));
+}
+
+void RenderGraph::SetRenderArea(uint32_t pass, VkExtent2D extent)
+{
+	m_Passes[pass].RenderArea = extent;
+}
+
+void RenderGraph::RecordBatch(VkCommandBuffer commandBuffer, uint32_t batch, uint32_t instance, uint32_t importIndex)
+{
+	const Batch& currentBatch = m_Batches[batch];
+
+	for (const Step& step : currentBatch.Steps)
+	{
+		const Pass& pass = m_Passes[step.Pass];
+		RecordBarriers(commandBuffer, step.Barriers, instance, importIndex);
+
+		if (pass.RenderPass == UINT32_MAX)
+		{
+			pass.Record(commandBuffer, instance);
+			continue;
+		}
+
+		const RenderPassGroup& group = m_RenderPasses[pass.RenderPass];
+		if (pass.Subpass == 0)
+		{
+			// The render area of the first pass applies to every subpass
+			VkRenderPassBeginInfo renderPassBeginInfo = {};
+			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassBeginInfo.renderPass = group.RenderPass;
+			renderPassBeginInfo.framebuffer = group.Framebuffers[group.HasImported ? instance * m_ImportCount + importIndex : instance];
+			renderPassBeginInfo.renderArea.offset = { 0, 0 };
+			renderPassBeginInfo.renderArea.extent.width = std::min(pass.RenderArea.width, group.Extent.width);
+			renderPassBeginInfo.renderArea.extent.height = std::min(pass.RenderArea.height, group.Extent.height);
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(group.ClearValues.size());
+			renderPassBeginInfo.pClearValues = group.ClearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		}
+		else
+		{
+			vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		pass.Record(commandBuffer, instance);
+
+		if (pass.Subpass == group.Passes.size() - 1)
+		{
+			vkCmdEndRenderPass(commandBuffer);
+		}
+	}
+
+	RecordBarriers(commandBuffer, currentBatch.EndBarriers, instance, importIndex);
+}
+
+RenderGraph::AccessInfo RenderGraph::GetAccessInfo(const Pass& pass, const ImageUse& use) const
+{
+	// Shader accesses happen in the stage of the pass type (a compute pass stays a dispatch on the graphics queue)
+	VkPipelineStageFlags shaderStage = pass.Queue == RenderGraphQueue::Compute ?
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+	AccessInfo info = {};
+	info.Layout = GetAccessLayout(use.Access, IsDepthFormat(m_Images[use.Image].Desc.Format));
+	info.Write = IsWrite(use.Access);
+
+	switch (use.Access)
+	{
+	case RenderGraphAccess::ColorAttachment:
+		info.Stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		info.Access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		break;
+	case RenderGraphAccess::DepthAttachment:
+		info.Stage = depthStages;
+		info.Access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		break;
+	case RenderGraphAccess::StorageImage:
+		info.Stage = shaderStage;
+		info.Access = VK_ACCESS_SHADER_WRITE_BIT;
+		break;
+	case RenderGraphAccess::DepthRead:
+		info.Stage = depthStages;
+		info.Access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		break;
+	case RenderGraphAccess::InputAttachment:
+		info.Stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		info.Access = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		break;
+	case RenderGraphAccess::Sampled:
+		info.Stage = shaderStage;
+		info.Access = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	}
+
+	return info;
+}
+
+VkImageLayout RenderGraph::GetAccessLayout(RenderGraphAccess access, bool depthFormat)
+{
+	switch (access)
+	{
+	case RenderGraphAccess::ColorAttachment:	return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	case RenderGraphAccess::DepthAttachment:	return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	case RenderGraphAccess::StorageImage:		return VK_IMAGE_LAYOUT_GENERAL;
+	case RenderGraphAccess::DepthRead:			return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	case RenderGraphAccess::InputAttachment:
+	case RenderGraphAccess::Sampled:
+		return depthFormat ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	return VK_IMAGE_LAYOUT_GENERAL;
+}
+
+bool RenderGraph::IsWrite(RenderGraphAccess access)
+{
+	return access == RenderGraphAccess::ColorAttachment || access == RenderGraphAccess::DepthAttachment ||
+		access == RenderGraphAccess::StorageImage;
+}
+
+bool RenderGraph::IsAttachment(RenderGraphAccess access)
+{
+	return access == RenderGraphAccess::ColorAttachment || access == RenderGraphAccess::DepthAttachment ||
+		access == RenderGraphAccess::DepthRead || access == RenderGraphAccess::InputAttachment;
+}
+
+bool RenderGraph::IsDepthFormat(VkFormat format)
+{
+	return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+		format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+VkImageAspectFlags RenderGraph::GetBarrierAspect(VkFormat format)
+{
+	// Layout transitions of combined depth/stencil formats cover both aspects
+	if (format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT)
+	{
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+
+	return IsDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walk back from the outputs (imported images): a pass stays if a later pass (or an output) needs one of its writes
+	std::vector<bool> needed(m_Images.size(), false);
+	for (size_t i = 0; i < m_Images.size(); i++)
+	{
+		needed[i] = m_Images[i].Imported;
+	}
+
+	for (size_t p = m_Passes.size(); p-- > 0;)
+	{
+		Pass& pass = m_Passes[p];
+
+		bool contributes = false;
+		for (const ImageUse& use : pass.Uses)
+		{
+			contributes = contributes || (IsWrite(use.Access) && needed[use.Image]);
+		}
+
+		pass.Culled = !contributes;
+		if (pass.Culled)
+		{
+			continue;
+		}
+
+		// Its reads are needed, and so are the attachments it loads instead of clearing
+		for (const ImageUse& use : pass.Uses)
+		{
+			if (!IsWrite(use.Access) || (IsAttachment(use.Access) && !use.Clear))
+			{
+				needed[use.Image] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::BuildBatches(bool asyncCompute)
+{
+	// Without async compute everything goes to the graphics queue, in one batch
+	m_Batches.clear();
+	for (Pass& pass : m_Passes)
+	{
+		if (pass.Culled)
+		{
+			continue;
+		}
+
+		RenderGraphQueue queue = asyncCompute ? pass.Queue : RenderGraphQueue::Graphics;
+		if (m_Batches.empty() || m_Batches.back().Queue != queue)
+		{
+			Batch batch;
+			batch.Queue = queue;
+			m_Batches.push_back(batch);
+		}
+
+		pass.Batch = static_cast<uint32_t>(m_Batches.size() - 1);
+	}
+}
+
+void RenderGraph::MergeRenderPasses()
+{
+	m_RenderPasses.clear();
+	uint32_t currentGroup = UINT32_MAX;		// render pass the previous pass ended up in
+
+	for (uint32_t p = 0; p < m_Passes.size(); p++)
+	{
+		Pass& pass = m_Passes[p];
+		if (pass.Culled)
+		{
+			continue;
+		}
+
+		// Compute passes end the current render pass
+		if (pass.Queue == RenderGraphQueue::Compute)
+		{
+			for (const ImageUse& use : pass.Uses)
+			{
+				if (IsAttachment(use.Access))
+				{
+					throw std::runtime_error("Failed to compile render graph: compute pass " + pass.Name + " uses an attachment!");
+				}
+			}
+
+			currentGroup = UINT32_MAX;
+			continue;
+		}
+
+		// Every attachment of a render pass has the same size
+		VkExtent2D extent = { 0, 0 };
+		for (const ImageUse& use : pass.Uses)
+		{
+			if (!IsAttachment(use.Access))
+			{
+				continue;
+			}
+
+			const VkExtent2D& imageExtent = m_Images[use.Image].Desc.Extent;
+			if (extent.width == 0)
+			{
+				extent = imageExtent;
+			}
+			else if (extent.width != imageExtent.width || extent.height != imageExtent.height)
+			{
+				throw std::runtime_error("Failed to compile render graph: attachments of pass " + pass.Name + " differ in size!");
+			}
+		}
+
+		if (extent.width == 0)
+		{
+			throw std::runtime_error("Failed to compile render graph: graphics pass " + pass.Name + " has no attachment!");
+		}
+
+		// Merge into the previous render pass when the pass only reads the images written there as input attachments
+		// (the data stays on chip on tile-based GPUs) and nothing has to leave the render pass in between
+		bool merge = currentGroup != UINT32_MAX;
+		if (merge)
+		{
+			const RenderPassGroup& group = m_RenderPasses[currentGroup];
+			merge = m_Passes[group.Passes.back()].Batch == pass.Batch &&
+				group.Extent.width == extent.width && group.Extent.height == extent.height;
+
+			for (uint32_t groupPass : group.Passes)
+			{
+				for (const ImageUse& groupUse : m_Passes[groupPass].Uses)
+				{
+					for (const ImageUse& use : pass.Uses)
+					{
+						// An image can't be both an attachment and a shader resource of the same render pass
+						if (use.Image == groupUse.Image && IsAttachment(use.Access) != IsAttachment(groupUse.Access))
+						{
+							merge = false;
+						}
+					}
+				}
+			}
+		}
+
+		if (!merge)
+		{
+			RenderPassGroup group;
+			group.Extent = extent;
+			m_RenderPasses.push_back(group);
+			currentGroup = static_cast<uint32_t>(m_RenderPasses.size() - 1);
+		}
+
+		RenderPassGroup& group = m_RenderPasses[currentGroup];
+
+		// Input attachments read what an earlier subpass of the same render pass wrote
+		for (const ImageUse& use : pass.Uses)
+		{
+			if (use.Access != RenderGraphAccess::InputAttachment)
+			{
+				continue;
+			}
+
+			if (std::find(group.Attachments.begin(), group.Attachments.end(), use.Image) == group.Attachments.end())
+			{
+				throw std::runtime_error("Failed to compile render graph: input attachment " + m_Images[use.Image].Name + " of pass " +
+					pass.Name + " is not written in the same render pass!");
+			}
+		}
+
+		pass.RenderPass = currentGroup;
+		pass.Subpass = static_cast<uint32_t>(group.Passes.size());
+		if (pass.RenderArea.width == 0)
+		{
+			pass.RenderArea = extent;
+		}
+		group.Passes.push_back(p);
+
+		for (const ImageUse& use : pass.Uses)
+		{
+			if (IsAttachment(use.Access) &&
+				std::find(group.Attachments.begin(), group.Attachments.end(), use.Image) == group.Attachments.end())
+			{
+				group.Attachments.push_back(use.Image);
+				group.ClearValues.push_back(use.ClearValue);
+			}
+		}
+	}
+}
+
+void RenderGraph::CreateImages(VkPhysicalDevice physicalDevice, uint32_t graphicsFamily, uint32_t computeFamily)
+{
+	// Lifetimes, usage and queues from the passes left after culling. An image only used as an attachment of one
+	// render pass is never loaded or stored (load/store ops follow the uses), it can live in tile memory only
+	std::vector<uint32_t> renderPasses(m_Images.size(), UINT32_MAX);
+	for (Image& image : m_Images)
+	{
+		image.Transient = !image.Imported;
+	}
+
+	for (uint32_t p = 0; p < m_Passes.size(); p++)
+	{
+		const Pass& pass = m_Passes[p];
+		if (pass.Culled)
+		{
+			continue;
+		}
+
+		for (const ImageUse& use : pass.Uses)
+		{
+			Image& image = m_Images[use.Image];
+			image.FirstPass = std::min(image.FirstPass, p);
+			image.LastPass = std::max(image.LastPass, p);
+
+			bool otherRenderPass = renderPasses[use.Image] != UINT32_MAX && renderPasses[use.Image] != pass.RenderPass;
+			if (!IsAttachment(use.Access) || pass.RenderPass == UINT32_MAX || otherRenderPass)
+			{
+				image.Transient = false;
+			}
+			renderPasses[use.Image] = pass.RenderPass;
+
+			if (m_Batches[pass.Batch].Queue == RenderGraphQueue::Compute)
+			{
+				image.UsedOnCompute = true;
+			}
+			else
+			{
+				image.UsedOnGraphics = true;
+			}
+
+			switch (use.Access)
+			{
+			case RenderGraphAccess::ColorAttachment:	image.Usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+			case RenderGraphAccess::DepthAttachment:
+			case RenderGraphAccess::DepthRead:			image.Usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+			case RenderGraphAccess::StorageImage:		image.Usage |= VK_IMAGE_USAGE_STORAGE_BIT; break;
+			case RenderGraphAccess::InputAttachment:	image.Usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT; break;
+			case RenderGraphAccess::Sampled:			image.Usage |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+			}
+		}
+	}
+
+	// Device local memory types (aliased images must agree on one of them), lazily allocated ones for transient images
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	uint32_t deviceLocalTypes = 0;
+	uint32_t lazyTypes = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+		if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		{
+			deviceLocalTypes |= 1u << i;
+		}
+		if ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+		{
+			lazyTypes |= 1u << i;
+		}
+	}
+
+	// Graph images in order of first use, each placed in the first memory slot whose last image is done by then.
+	// Batches execute in order (chained by semaphores), so pass order is execution order across queues too
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < m_Images.size(); i++)
+	{
+		const Image& image = m_Images[i];
+		if (image.Imported)
+		{
+			// Imported images stay exclusive to the graphics queue
+			if (image.UsedOnCompute && graphicsFamily != computeFamily)
+			{
+				throw std::runtime_error("Failed to compile render graph: imported image " + image.Name + " used on the compute queue!");
+			}
+			continue;
+		}
+
+		if (image.FirstPass != UINT32_MAX)
+		{
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return m_Images[a].FirstPass < m_Images[b].FirstPass; });
+
+	for (uint32_t imageIndex : order)
+	{
+		Image& image = m_Images[imageIndex];
+
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.extent.width = image.Desc.Extent.width;
+		imageCreateInfo.extent.height = image.Desc.Extent.height;
+		imageCreateInfo.extent.depth = 1;
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.format = image.Desc.Format;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.usage = image.Usage | (image.Transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		// Images used on both queues are shared, no ownership transfers needed
+		uint32_t sharedFamilies[2] = { graphicsFamily, computeFamily };
+		if (image.UsedOnGraphics && image.UsedOnCompute && graphicsFamily != computeFamily)
+		{
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			imageCreateInfo.queueFamilyIndexCount = 2;
+			imageCreateInfo.pQueueFamilyIndices = sharedFamilies;
+		}
+
+		image.Images.resize(m_InstanceCount);
+		image.ImageViews.resize(m_InstanceCount);
+		for (uint32_t instance = 0; instance < m_InstanceCount; instance++)
+		{
+			if (vkCreateImage(m_Device, &imageCreateInfo, nullptr, &image.Images[instance]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph image " + image.Name + "!");
+			}
+		}
+
+		// Every instance has the same requirements
+		VkMemoryRequirements memoryRequirements;
+		vkGetImageMemoryRequirements(m_Device, image.Images[0], &memoryRequirements);
+		m_UnaliasedMemorySize += memoryRequirements.size * m_InstanceCount;
+
+		// Desktop GPUs have no lazily allocated memory, transient images are regular (aliased) images there
+		bool lazy = image.Transient && (memoryRequirements.memoryTypeBits & lazyTypes) != 0;
+		uint32_t memoryTypeBits = memoryRequirements.memoryTypeBits & (lazy ? lazyTypes : deviceLocalTypes);
+		for (uint32_t s = 0; s < m_MemorySlots.size(); s++)
+		{
+			const MemorySlot& slot = m_MemorySlots[s];
+			if (slot.LastPass < image.FirstPass && slot.Lazy == lazy && (slot.MemoryTypeBits & memoryTypeBits) != 0)
+			{
+				image.MemorySlot = s;
+				break;
+			}
+		}
+
+		if (image.MemorySlot == UINT32_MAX)
+		{
+			m_MemorySlots.push_back(MemorySlot());
+			image.MemorySlot = static_cast<uint32_t>(m_MemorySlots.size() - 1);
+			m_MemorySlots.back().Lazy = lazy;
+		}
+
+		MemorySlot& slot = m_MemorySlots[image.MemorySlot];
+		slot.Size = std::max(slot.Size, memoryRequirements.size);
+		slot.Alignment = std::max(slot.Alignment, memoryRequirements.alignment);
+		slot.MemoryTypeBits &= memoryTypeBits;
+		slot.LastPass = image.LastPass;
+		image.PreviousAlias = slot.LastImage;
+		slot.LastImage = imageIndex;
+	}
+
+	// One allocation per slot and instance, sized for its largest image
+	for (MemorySlot& slot : m_MemorySlots)
+	{
+		VkMemoryAllocateInfo memoryAllocateInfo = {};
+		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocateInfo.allocationSize = slot.Size;
+		memoryAllocateInfo.memoryTypeIndex = FindMemoryTypeIndex(physicalDevice, slot.MemoryTypeBits,
+			slot.Lazy ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		slot.Memory.resize(m_InstanceCount);
+		for (uint32_t instance = 0; instance < m_InstanceCount; instance++)
+		{
+			if (vkAllocateMemory(m_Device, &memoryAllocateInfo, nullptr, &slot.Memory[instance]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate render graph memory!");
+			}
+		}
+
+		m_MemorySize += slot.Size * m_InstanceCount;
+		m_LazyMemorySize += slot.Lazy ? slot.Size * m_InstanceCount : 0;
+	}
+
+	for (uint32_t imageIndex : order)
+	{
+		Image& image = m_Images[imageIndex];
+		const MemorySlot& slot = m_MemorySlots[image.MemorySlot];
+
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = image.Desc.Format;
+		viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewCreateInfo.subresourceRange.aspectMask = IsDepthFormat(image.Desc.Format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		viewCreateInfo.subresourceRange.baseMipLevel = 0;
+		viewCreateInfo.subresourceRange.levelCount = 1;
+		viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+		viewCreateInfo.subresourceRange.layerCount = 1;
+
+		for (uint32_t instance = 0; instance < m_InstanceCount; instance++)
+		{
+			vkBindImageMemory(m_Device, image.Images[instance], slot.Memory[instance], 0);
+
+			viewCreateInfo.image = image.Images[instance];
+			if (vkCreateImageView(m_Device, &viewCreateInfo, nullptr, &image.ImageViews[instance]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph image view " + image.Name + "!");
+			}
+		}
+	}
+}
+
+void RenderGraph::BuildBarriers()
+{
+	// Simulate one frame: every image starts undefined (nothing is kept between frames)
+	std::vector<ImageState> states(m_Images.size());
+
+	for (uint32_t p = 0; p < m_Passes.size(); p++)
+	{
+		const Pass& pass = m_Passes[p];
+		if (pass.Culled)
+		{
+			continue;
+		}
+
+		Batch& batch = m_Batches[pass.Batch];
+		Step step;
+		step.Pass = p;
+
+		// The first use of an aliased image waits for the last use of the image before it in the same memory
+		for (const ImageUse& use : pass.Uses)
+		{
+			const Image& image = m_Images[use.Image];
+			if (image.FirstPass == p && image.PreviousAlias != UINT32_MAX && states[image.PreviousAlias].Batch == pass.Batch)
+			{
+				const ImageState& previous = states[image.PreviousAlias];
+				ImageState& state = states[use.Image];
+				state.Batch = pass.Batch;
+				state.WriteStage = previous.WriteStage | previous.ReadStages;
+				state.WriteAccess = previous.WriteAccess;
+			}
+		}
+
+		if (pass.RenderPass == UINT32_MAX)
+		{
+			for (const ImageUse& use : pass.Uses)
+			{
+				ImageState& state = states[use.Image];
+				Barrier barrier;
+				if (MakeBarrier(use.Image, state, GetAccessInfo(pass, use), pass.Batch, !state.Written, &barrier))
+				{
+					step.Barriers.push_back(barrier);
+				}
+			}
+		}
+		else if (pass.Subpass == 0)
+		{
+			// Whole render pass at once: barriers bring every image to its layout in the first subpass using it, the
+			// render pass does the transitions between subpasses
+			RenderPassGroup& group = m_RenderPasses[pass.RenderPass];
+			group.LoadOps.assign(group.Attachments.size(), VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+			group.StoreOps.assign(group.Attachments.size(), VK_ATTACHMENT_STORE_OP_DONT_CARE);
+
+			std::vector<uint32_t> groupImages;
+			for (uint32_t groupPass : group.Passes)
+			{
+				for (const ImageUse& use : m_Passes[groupPass].Uses)
+				{
+					if (std::find(groupImages.begin(), groupImages.end(), use.Image) == groupImages.end())
+					{
+						groupImages.push_back(use.Image);
+					}
+				}
+			}
+
+			for (uint32_t imageIndex : groupImages)
+			{
+				AccessInfo first = {};
+				AccessInfo combined = {};
+				AccessInfo last = {};
+				VkPipelineStageFlags writeStages = 0;
+				VkAccessFlags writeAccess = 0;
+				VkPipelineStageFlags readStages = 0;
+				const ImageUse* firstUse = nullptr;
+
+				for (uint32_t groupPass : group.Passes)
+				{
+					for (const ImageUse& use : m_Passes[groupPass].Uses)
+					{
+						if (use.Image != imageIndex)
+						{
+							continue;
+						}
+
+						AccessInfo info = GetAccessInfo(m_Passes[groupPass], use);
+						if (firstUse == nullptr)
+						{
+							firstUse = &use;
+							first = info;
+						}
+						last = info;
+
+						combined.Stage |= info.Stage;
+						combined.Access |= info.Access;
+						combined.Write = combined.Write || info.Write;
+						if (info.Write)
+						{
+							writeStages |= info.Stage;
+							writeAccess |= info.Access;
+						}
+						else
+						{
+							readStages |= info.Stage;
+						}
+					}
+				}
+
+				ImageState& state = states[imageIndex];
+				auto attachment = std::find(group.Attachments.begin(), group.Attachments.end(), imageIndex);
+				bool discard = !state.Written || firstUse->Clear;
+
+				if (attachment != group.Attachments.end())
+				{
+					size_t a = attachment - group.Attachments.begin();
+					group.LoadOps[a] = firstUse->Clear ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+						(state.Written ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+
+					// Stored only if something after the render pass needs it
+					const ImageUse* nextUse = nullptr;
+					bool usedLater = GetNextUse(imageIndex, group.Passes.back(), &nextUse) != UINT32_MAX;
+					group.StoreOps[a] = usedLater || m_Images[imageIndex].Imported ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				}
+
+				combined.Layout = first.Layout;
+				Barrier barrier;
+				if (MakeBarrier(imageIndex, state, combined, pass.Batch, discard, &barrier))
+				{
+					step.Barriers.push_back(barrier);
+				}
+
+				// State after the render pass (left in the layout of its last subpass)
+				state.Layout = last.Layout;
+				if (writeStages != 0)
+				{
+					state.WriteStage = writeStages;
+					state.WriteAccess = writeAccess;
+					state.VisibleStages = 0;
+					state.ReadStages = readStages;
+					state.Written = true;
+				}
+				else
+				{
+					state.ReadStages |= readStages;
+				}
+			}
+		}
+
+		batch.Steps.push_back(step);
+
+		// End of a batch: images used later on another batch change layout here (the semaphore between the batches
+		// makes the writes available), outputs go to their final layout
+		uint32_t nextPass = p + 1;
+		while (nextPass < m_Passes.size() && m_Passes[nextPass].Culled)
+		{
+			nextPass++;
+		}
+		if (nextPass < m_Passes.size() && m_Passes[nextPass].Batch == pass.Batch)
+		{
+			continue;
+		}
+
+		for (uint32_t i = 0; i < m_Images.size(); i++)
+		{
+			ImageState& state = states[i];
+			if (state.Batch != pass.Batch)
+			{
+				continue;
+			}
+
+			Barrier barrier;
+			barrier.Image = i;
+			barrier.OldLayout = state.Layout;
+			barrier.SrcStage = state.WriteStage | state.ReadStages;
+			barrier.SrcAccess = state.WriteAccess;
+
+			const ImageUse* nextUse = nullptr;
+			uint32_t next = GetNextUse(i, p, &nextUse);
+			if (next == UINT32_MAX)
+			{
+				if (!m_Images[i].Imported)
+				{
+					continue;
+				}
+
+				// Copied out on the same queue (headless) or handed to the presentation engine
+				barrier.NewLayout = m_Images[i].FinalLayout;
+				bool transfer = barrier.NewLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				barrier.DstStage = transfer ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+				barrier.DstAccess = transfer ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+			}
+			else
+			{
+				barrier.NewLayout = GetAccessInfo(m_Passes[next], *nextUse).Layout;
+				barrier.DstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+				barrier.DstAccess = 0;
+			}
+
+			if (barrier.NewLayout != barrier.OldLayout)
+			{
+				batch.EndBarriers.push_back(barrier);
+			}
+			state.Layout = barrier.NewLayout;
+		}
+	}
+}
+
+bool RenderGraph::MakeBarrier(uint32_t image, ImageState& state, const AccessInfo& info, uint32_t batch, bool discard, Barrier* barrier) const
+{
+	// Accesses of another batch are ordered by the semaphores between the batches, only the layout can still differ
+	if (state.Batch != batch)
+	{
+		state.WriteStage = 0;
+		state.WriteAccess = 0;
+		state.VisibleStages = 0;
+		state.ReadStages = 0;
+	}
+	state.Batch = batch;
+
+	bool layoutChange = state.Layout != info.Layout;
+	bool hazard = info.Write ? (state.WriteStage | state.ReadStages) != 0 :
+		(state.WriteStage != 0 && (info.Stage & ~state.VisibleStages) != 0);
+
+	if (!layoutChange && !hazard)
+	{
+		state.ReadStages |= info.Write ? 0 : info.Stage;
+		if (info.Write)
+		{
+			state.WriteStage = info.Stage;
+			state.WriteAccess = info.Access;
+			state.VisibleStages = 0;
+			state.Written = true;
+		}
+		return false;
+	}
+
+	barrier->Image = image;
+	barrier->OldLayout = layoutChange && discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.Layout;
+	barrier->NewLayout = info.Layout;
+	barrier->SrcStage = state.WriteStage | state.ReadStages;
+	barrier->SrcAccess = state.WriteAccess;
+	barrier->DstStage = info.Stage;
+	barrier->DstAccess = info.Access;
+
+	// Nothing to wait for in this batch: wait in the stage of the access (chains with a semaphore wait on that stage)
+	if (barrier->SrcStage == 0)
+	{
+		barrier->SrcStage = info.Stage;
+	}
+
+	state.Layout = info.Layout;
+	if (info.Write)
+	{
+		state.WriteStage = info.Stage;
+		state.WriteAccess = info.Access;
+		state.VisibleStages = 0;
+		state.ReadStages = 0;
+		state.Written = true;
+	}
+	else if (layoutChange)
+	{
+		// The transition acts like a write finished before the reading stage
+		state.WriteStage = info.Stage;
+		state.WriteAccess = 0;
+		state.VisibleStages = info.Stage;
+		state.ReadStages = info.Stage;
+	}
+	else
+	{
+		state.VisibleStages |= info.Stage;
+		state.ReadStages |= info.Stage;
+	}
+
+	return true;
+}
+
+void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers, uint32_t instance, uint32_t importIndex) const
+{
+	if (barriers.empty())
+	{
+		return;
+	}
+
+	std::vector<VkImageMemoryBarrier> imageBarriers(barriers.size());
+	VkPipelineStageFlags srcStage = 0;
+	VkPipelineStageFlags dstStage = 0;
+
+	for (size_t i = 0; i < barriers.size(); i++)
+	{
+		const Barrier& barrier = barriers[i];
+		const Image& image = m_Images[barrier.Image];
+
+		VkImageMemoryBarrier& imageBarrier = imageBarriers[i];
+		imageBarrier = {};
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.srcAccessMask = barrier.SrcAccess;
+		imageBarrier.dstAccessMask = barrier.DstAccess;
+		imageBarrier.oldLayout = barrier.OldLayout;
+		imageBarrier.newLayout = barrier.NewLayout;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = image.Images[image.Imported ? importIndex : instance];
+		imageBarrier.subresourceRange = { GetBarrierAspect(image.Desc.Format), 0, 1, 0, 1 };
+
+		srcStage |= barrier.SrcStage;
+		dstStage |= barrier.DstStage;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr,
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+uint32_t RenderGraph::GetNextUse(uint32_t image, uint32_t afterPass, const ImageUse** use) const
+{
+	for (uint32_t p = afterPass + 1; p < m_Passes.size(); p++)
+	{
+		if (m_Passes[p].Culled)
+		{
+			continue;
+		}
+
+		for (const ImageUse& passUse : m_Passes[p].Uses)
+		{
+			if (passUse.Image == image)
+			{
+				*use = &passUse;
+				return p;
+			}
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+void RenderGraph::CreateRenderPasses()
+{
+	for (RenderPassGroup& group : m_RenderPasses)
+	{
+		uint32_t subpassCount = static_cast<uint32_t>(group.Passes.size());
+		uint32_t attachmentCount = static_cast<uint32_t>(group.Attachments.size());
+
+		// Layout of every attachment in every subpass (UNDEFINED = not used there)
+		std::vector<std::vector<VkImageLayout>> layouts(subpassCount, std::vector<VkImageLayout>(attachmentCount, VK_IMAGE_LAYOUT_UNDEFINED));
+		std::vector<std::vector<AccessInfo>> accesses(subpassCount, std::vector<AccessInfo>(attachmentCount, AccessInfo()));
+
+		std::vector<std::vector<VkAttachmentReference>> colorReferences(subpassCount);
+		std::vector<std::vector<VkAttachmentReference>> inputReferences(subpassCount);
+		std::vector<VkAttachmentReference> depthReferences(subpassCount);
+		std::vector<std::vector<uint32_t>> preserveAttachments(subpassCount);
+		std::vector<VkSubpassDescription> subpasses(subpassCount);
+
+		for (uint32_t s = 0; s < subpassCount; s++)
+		{
+			const Pass& pass = m_Passes[group.Passes[s]];
+			VkSubpassDescription& subpass = subpasses[s];
+			subpass = {};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+			bool hasDepth = false;
+			for (const ImageUse& use : pass.Uses)
+			{
+				if (!IsAttachment(use.Access))
+				{
+					continue;
+				}
+
+				uint32_t a = static_cast<uint32_t>(std::find(group.Attachments.begin(), group.Attachments.end(), use.Image) - group.Attachments.begin());
+				AccessInfo info = GetAccessInfo(pass, use);
+				layouts[s][a] = info.Layout;
+				accesses[s][a] = info;
+
+				VkAttachmentReference reference = {};
+				reference.attachment = a;
+				reference.layout = info.Layout;
+
+				switch (use.Access)
+				{
+				case RenderGraphAccess::ColorAttachment:
+					colorReferences[s].push_back(reference);
+					break;
+				case RenderGraphAccess::DepthAttachment:
+				case RenderGraphAccess::DepthRead:
+					if (hasDepth)
+					{
+						throw std::runtime_error("Failed to compile render graph: pass " + pass.Name + " has two depth attachments!");
+					}
+					depthReferences[s] = reference;
+					hasDepth = true;
+					break;
+				default:
+					inputReferences[s].push_back(reference);
+					break;
+				}
+			}
+
+			subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences[s].size());
+			subpass.pColorAttachments = colorReferences[s].data();
+			subpass.inputAttachmentCount = static_cast<uint32_t>(inputReferences[s].size());
+			subpass.pInputAttachments = inputReferences[s].data();
+			subpass.pDepthStencilAttachment = hasDepth ? &depthReferences[s] : nullptr;
+		}
+
+		// Attachments skipped by a subpass between two that use them have to be preserved
+		for (uint32_t s = 0; s < subpassCount; s++)
+		{
+			for (uint32_t a = 0; a < attachmentCount; a++)
+			{
+				if (layouts[s][a] != VK_IMAGE_LAYOUT_UNDEFINED)
+				{
+					continue;
+				}
+
+				bool usedBefore = false;
+				bool usedAfter = false;
+				for (uint32_t other = 0; other < subpassCount; other++)
+				{
+					usedBefore = usedBefore || (other < s && layouts[other][a] != VK_IMAGE_LAYOUT_UNDEFINED);
+					usedAfter = usedAfter || (other > s && layouts[other][a] != VK_IMAGE_LAYOUT_UNDEFINED);
+				}
+
+				if (usedBefore && usedAfter)
+				{
+					preserveAttachments[s].push_back(a);
+				}
+			}
+
+			subpasses[s].preserveAttachmentCount = static_cast<uint32_t>(preserveAttachments[s].size());
+			subpasses[s].pPreserveAttachments = preserveAttachments[s].data();
+		}
+
+		// Initial layout = first subpass layout (set by the barriers before the render pass), final = last subpass layout
+		std::vector<VkAttachmentDescription> attachments(attachmentCount);
+		for (uint32_t a = 0; a < attachmentCount; a++)
+		{
+			VkImageLayout firstLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout lastLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			for (uint32_t s = 0; s < subpassCount; s++)
+			{
+				if (layouts[s][a] != VK_IMAGE_LAYOUT_UNDEFINED)
+				{
+					firstLayout = firstLayout == VK_IMAGE_LAYOUT_UNDEFINED ? layouts[s][a] : firstLayout;
+					lastLayout = layouts[s][a];
+				}
+			}
+
+			VkAttachmentDescription& attachment = attachments[a];
+			attachment = {};
+			attachment.format = m_Images[group.Attachments[a]].Desc.Format;
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp = group.LoadOps[a];
+			attachment.storeOp = group.StoreOps[a];
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = firstLayout;
+			attachment.finalLayout = lastLayout;
+		}
+
+		// One dependency per pair of subpasses sharing an attachment that one of them writes (or changes the layout of)
+		std::vector<VkSubpassDependency> dependencies;
+		for (uint32_t dst = 1; dst < subpassCount; dst++)
+		{
+			for (uint32_t src = 0; src < dst; src++)
+			{
+				VkSubpassDependency dependency = {};
+				dependency.srcSubpass = src;
+				dependency.dstSubpass = dst;
+				dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;		// pixel local, the data can stay in tile memory
+
+				for (uint32_t a = 0; a < attachmentCount; a++)
+				{
+					if (layouts[src][a] == VK_IMAGE_LAYOUT_UNDEFINED || layouts[dst][a] == VK_IMAGE_LAYOUT_UNDEFINED)
+					{
+						continue;
+					}
+
+					const AccessInfo& srcAccess = accesses[src][a];
+					const AccessInfo& dstAccess = accesses[dst][a];
+					if (!srcAccess.Write && !dstAccess.Write && layouts[src][a] == layouts[dst][a])
+					{
+						continue;
+					}
+
+					dependency.srcStageMask |= srcAccess.Stage;
+					dependency.srcAccessMask |= srcAccess.Write ? srcAccess.Access : 0;
+					dependency.dstStageMask |= dstAccess.Stage;
+					dependency.dstAccessMask |= dstAccess.Access;
+				}
+
+				if (dependency.srcStageMask != 0)
+				{
+					dependencies.push_back(dependency);
+				}
+			}
+		}
+
+		VkRenderPassCreateInfo renderPassCreateInfo = {};
+		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassCreateInfo.attachmentCount = attachmentCount;
+		renderPassCreateInfo.pAttachments = attachments.data();
+		renderPassCreateInfo.subpassCount = subpassCount;
+		renderPassCreateInfo.pSubpasses = subpasses.data();
+		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCreateInfo.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(m_Device, &renderPassCreateInfo, nullptr, &group.RenderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph render pass for " + m_Passes[group.Passes[0]].Name + "!");
+		}
+
+		// One framebuffer per instance, times the import count if an imported image is attached
+		for (uint32_t imageIndex : group.Attachments)
+		{
+			group.HasImported = group.HasImported || m_Images[imageIndex].Imported;
+		}
+
+		uint32_t importCount = group.HasImported ? m_ImportCount : 1;
+		group.Framebuffers.resize(m_InstanceCount * importCount);
+		for (uint32_t f = 0; f < group.Framebuffers.size(); f++)
+		{
+			uint32_t instance = f / importCount;
+			uint32_t importIndex = f % importCount;
+
+			std::vector<VkImageView> imageViews(attachmentCount);
+			for (uint32_t a = 0; a < attachmentCount; a++)
+			{
+				const Image& image = m_Images[group.Attachments[a]];
+				imageViews[a] = image.ImageViews[image.Imported ? importIndex : instance];
+			}
+
+			VkFramebufferCreateInfo framebufferCreateInfo = {};
+			framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferCreateInfo.renderPass = group.RenderPass;
+			framebufferCreateInfo.attachmentCount = attachmentCount;
+			framebufferCreateInfo.pAttachments = imageViews.data();
+			framebufferCreateInfo.width = group.Extent.width;
+			framebufferCreateInfo.height = group.Extent.height;
+			framebufferCreateInfo.layers = 1;
+
+			if (vkCreateFramebuffer(m_Device, &framebufferCreateInfo, nullptr, &group.Framebuffers[f]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph framebuffer!");
+			}
+		}
+	}
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+// Queue a pass is written for (without async compute every pass runs on the graphics queue)
+enum class RenderGraphQueue
+{
+	Graphics,
+	Compute
+};
+
+// How a pass uses an image, decides the image layout, pipeline stages and accesses
+enum class RenderGraphAccess
+{
+	// Writes
+	ColorAttachment,
+	DepthAttachment,		// depth test and write
+	StorageImage,			// imageStore from a shader
+
+	// Reads
+	DepthRead,				// depth test only (read only depth attachment)
+	InputAttachment,		// subpassLoad, the writer has to end up in the same render pass (merged subpass)
+	Sampled					// texture read from a fragment or compute shader
+};
+
+struct RenderGraphImageDesc
+{
+	VkFormat Format = VK_FORMAT_UNDEFINED;
+	VkExtent2D Extent = { 0, 0 };
+};
+
+// Records the commands of a pass (instance = which copy of the graph images the frame renders to)
+using RenderGraphRecordFunc = std::function<void(VkCommandBuffer commandBuffer, uint32_t instance)>;
+
+// Frame described as passes declaring the images they read and write, in execution order.
+// Compile culls the passes nothing depends on, merges consecutive graphics passes into the subpasses of one
+// render pass, derives every layout transition and barrier, and aliases the memory of images whose lifetimes
+// don't overlap. Passes are grouped into batches (runs on one queue), the caller submits them in order and
+// chains them with semaphores.
+class RenderGraph
+{
+public:
+	RenderGraph() = default;
+
+	// -- Setup (before Compile)
+	uint32_t CreateImage(const std::string& name, const RenderGraphImageDesc& desc);
+	// Images owned elsewhere (e.g. swapchain images, picked per frame by importIndex). They are the graph outputs:
+	// passes writing them are never culled and they are left in finalLayout after their last use
+	uint32_t ImportImage(const std::string& name, const RenderGraphImageDesc& desc, const std::vector<VkImage>& images,
+		const std::vector<VkImageView>& imageViews, VkImageLayout finalLayout);
+
+	uint32_t AddPass(const std::string& name, RenderGraphQueue queue, RenderGraphRecordFunc record);
+	void Read(uint32_t pass, uint32_t image, RenderGraphAccess access);
+	void Write(uint32_t pass, uint32_t image, RenderGraphAccess access);
+	// Attachment write cleared on load
+	void Write(uint32_t pass, uint32_t image, RenderGraphAccess access, const VkClearValue& clearValue);
+
+	// instanceCount = copies of every graph image (frames that can overlap on the GPU must use different instances).
+	// Images only used as attachments of one render pass are transient (lazily allocated memory where available)
+	void Compile(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t instanceCount, bool asyncCompute,
+		uint32_t graphicsFamily, uint32_t computeFamily);
+	void Destroy();
+
+	// -- After Compile
+	bool IsCulled(uint32_t pass) const { return m_Passes[pass].Culled; }
+	VkRenderPass GetRenderPass(uint32_t pass) const;
+	uint32_t GetSubpass(uint32_t pass) const { return m_Passes[pass].Subpass; }
+	// index = instance for graph images, import index for imported ones
+	VkImage GetImage(uint32_t image, uint32_t index) const { return m_Images[image].Images[index]; }
+	VkImageView GetImageView(uint32_t image, uint32_t index) const { return m_Images[image].ImageViews[index]; }
+	bool IsTransient(uint32_t image) const { return m_Images[image].Transient; }
+	// Layout an image is in while a pass accesses it that way (for descriptor writes)
+	VkImageLayout GetLayout(uint32_t image, RenderGraphAccess access) const;
+
+	// Area of a graphics pass' render pass (default: the whole attachments), can change every frame
+	void SetRenderArea(uint32_t pass, VkExtent2D extent);
+
+	// Batches: runs of passes on one queue, each recorded into its own command buffer
+	uint32_t GetBatchCount() const { return static_cast<uint32_t>(m_Batches.size()); }
+	RenderGraphQueue GetBatchQueue(uint32_t batch) const { return m_Batches[batch].Queue; }
+	void RecordBatch(VkCommandBuffer commandBuffer, uint32_t batch, uint32_t instance, uint32_t importIndex);
+
+	// Device memory of the graph images (all instances), and what it would take without aliasing.
+	// Lazily allocated memory is counted too, though tilers only back it if an attachment ever leaves tile memory
+	VkDeviceSize GetMemorySize() const { return m_MemorySize; }
+	VkDeviceSize GetUnaliasedMemorySize() const { return m_UnaliasedMemorySize; }
+	VkDeviceSize GetLazyMemorySize() const { return m_LazyMemorySize; }
+
+private:
+	struct ImageUse
+	{
+		uint32_t Image;
+		RenderGraphAccess Access;
+		bool Clear = false;
+		VkClearValue ClearValue = {};
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		RenderGraphQueue Queue;
+		RenderGraphRecordFunc Record;
+		std::vector<ImageUse> Uses;
+
+		bool Culled = false;
+		uint32_t Batch = 0;
+		uint32_t RenderPass = UINT32_MAX;		// index into m_RenderPasses (UINT32_MAX = no render pass)
+		uint32_t Subpass = 0;
+		VkExtent2D RenderArea = { 0, 0 };
+	};
+
+	struct Image
+	{
+		std::string Name;
+		RenderGraphImageDesc Desc;
+		bool Imported = false;
+		VkImageLayout FinalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		// Derived from the uses of the passes left after culling
+		VkImageUsageFlags Usage = 0;
+		bool UsedOnGraphics = false;
+		bool UsedOnCompute = false;
+		uint32_t FirstPass = UINT32_MAX;
+		uint32_t LastPass = 0;
+		uint32_t MemorySlot = UINT32_MAX;
+		uint32_t PreviousAlias = UINT32_MAX;	// image using the memory slot before this one
+		bool Transient = false;					// never leaves its render pass (no load, no store)
+
+		std::vector<VkImage> Images;			// one per instance (per import index if imported)
+		std::vector<VkImageView> ImageViews;
+	};
+
+	// Memory shared by images whose lifetimes don't overlap (one allocation per instance)
+	struct MemorySlot
+	{
+		VkDeviceSize Size = 0;
+		VkDeviceSize Alignment = 1;
+		uint32_t MemoryTypeBits = ~0u;
+		uint32_t LastPass = 0;					// last pass using the slot's current image
+		uint32_t LastImage = UINT32_MAX;
+		bool Lazy = false;						// lazily allocated, transient images only
+		std::vector<VkDeviceMemory> Memory;
+	};
+
+	struct Barrier
+	{
+		uint32_t Image;
+		VkImageLayout OldLayout;
+		VkImageLayout NewLayout;
+		VkPipelineStageFlags SrcStage;
+		VkAccessFlags SrcAccess;
+		VkPipelineStageFlags DstStage;
+		VkAccessFlags DstAccess;
+	};
+
+	// Consecutive graphics passes sharing one VkRenderPass (one subpass each)
+	struct RenderPassGroup
+	{
+		std::vector<uint32_t> Passes;
+		std::vector<uint32_t> Attachments;			// graph images, in attachment order
+		std::vector<VkClearValue> ClearValues;		// one per attachment
+		std::vector<VkAttachmentLoadOp> LoadOps;
+		std::vector<VkAttachmentStoreOp> StoreOps;
+		VkExtent2D Extent = { 0, 0 };
+		VkRenderPass RenderPass = VK_NULL_HANDLE;
+		bool HasImported = false;					// an imported attachment: one framebuffer per instance and import index
+		std::vector<VkFramebuffer> Framebuffers;
+	};
+
+	// Barriers recorded before a pass (before the render pass for the first subpass of a group)
+	struct Step
+	{
+		uint32_t Pass;
+		std::vector<Barrier> Barriers;
+	};
+
+	struct Batch
+	{
+		RenderGraphQueue Queue;
+		std::vector<Step> Steps;
+		std::vector<Barrier> EndBarriers;		// layout changes for the next batch and the final layout of outputs
+	};
+
+	// Sync state of an image while the frame is simulated by Compile
+	struct ImageState
+	{
+		VkImageLayout Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags WriteStage = 0;		// last write (or layout transition)
+		VkAccessFlags WriteAccess = 0;
+		VkPipelineStageFlags VisibleStages = 0;		// stages that already waited for the last write
+		VkPipelineStageFlags ReadStages = 0;		// reads since the last write
+		uint32_t Batch = UINT32_MAX;				// batch of the last access
+		bool Written = false;
+	};
+
+	struct AccessInfo
+	{
+		VkImageLayout Layout;
+		VkPipelineStageFlags Stage;
+		VkAccessFlags Access;
+		bool Write;
+	};
+
+	AccessInfo GetAccessInfo(const Pass& pass, const ImageUse& use) const;
+	static VkImageLayout GetAccessLayout(RenderGraphAccess access, bool depthFormat);
+	static bool IsWrite(RenderGraphAccess access);
+	static bool IsAttachment(RenderGraphAccess access);
+	static bool IsDepthFormat(VkFormat format);
+	static VkImageAspectFlags GetBarrierAspect(VkFormat format);
+
+	void AddUse(uint32_t pass, const ImageUse& use);
+	void CullPasses();
+	void BuildBatches(bool asyncCompute);
+	void MergeRenderPasses();
+	void CreateImages(VkPhysicalDevice physicalDevice, uint32_t graphicsFamily, uint32_t computeFamily);
+	void BuildBarriers();
+	void CreateRenderPasses();
+
+	// Barrier bringing `state` to a new access (false if none is needed)
+	bool MakeBarrier(uint32_t image, ImageState& state, const AccessInfo& info, uint32_t batch, bool discard, Barrier* barrier) const;
+	void RecordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers, uint32_t instance, uint32_t importIndex) const;
+	uint32_t GetNextUse(uint32_t image, uint32_t afterPass, const ImageUse** use) const;
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	uint32_t m_InstanceCount = 0;
+	uint32_t m_ImportCount = 1;				// images per imported image
+	bool m_Compiled = false;
+
+	std::vector<Pass> m_Passes;
+	std::vector<Image> m_Images;
+	std::vector<MemorySlot> m_MemorySlots;
+	std::vector<RenderPassGroup> m_RenderPasses;
+	std::vector<Batch> m_Batches;
+
+	VkDeviceSize m_MemorySize = 0;
+	VkDeviceSize m_UnaliasedMemorySize = 0;
+	VkDeviceSize m_LazyMemorySize = 0;
+};
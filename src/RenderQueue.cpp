@@ -0,0 +1,194 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+static const int s_SortKeyPipelineBits = 4;
+static const int s_SortKeyDepthBits = 20;
+static const int s_SortKeyDescriptorSetBits = 10;
+static const int s_SortKeyTextureBits = 14;
+static const int s_SortKeyGeometryBits = 16;
+
+uint64_t RenderQueue::MakeSortKey(uint32_t pipelineID, uint32_t descriptorSetID, uint32_t textureID,
+	uint32_t geometryID, float normalizedDepth)
+{
+	// Quantize depth in [0, 1] (front to back)
+	normalizedDepth = std::min(std::max(normalizedDepth, 0.0f), 1.0f);
+	uint64_t depth = static_cast<uint64_t>(normalizedDepth * static_cast<float>((1u << s_SortKeyDepthBits) - 1));
+
+	// Depth goes above the model and part fields, they are unique and would always decide the order otherwise
+	// (parts of a model share its depth and descriptor set, so they still stay next to each other)
+	uint64_t key = 0;
+	key |= static_cast<uint64_t>(pipelineID & ((1u << s_SortKeyPipelineBits) - 1));
+	key = (key << s_SortKeyDepthBits) | depth;
+	key = (key << s_SortKeyDescriptorSetBits) | (descriptorSetID & ((1u << s_SortKeyDescriptorSetBits) - 1));
+	key = (key << s_SortKeyTextureBits) | (textureID & ((1u << s_SortKeyTextureBits) - 1));
+	key = (key << s_SortKeyGeometryBits) | (geometryID & ((1u << s_SortKeyGeometryBits) - 1));
+
+	return key;
+}
+
+void RenderQueue::Clear()
+{
+	m_Packets.clear();
+}
+
+void RenderQueue::Sort()
+{
+	const size_t count = m_Packets.size();
+	if (count < 2)
+		return;
+
+	m_SortEntries.resize(count);
+	m_SortScratch.resize(count);
+
+	// Build all 8 byte histograms in a single pass over the keys
+	uint32_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = m_Packets[i].SortKey;
+		m_SortEntries[i] = { key, static_cast<uint32_t>(i) };
+
+		for (int pass = 0; pass < 8; pass++)
+		{
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+		}
+	}
+
+	SortEntry* src = m_SortEntries.data();
+	SortEntry* dst = m_SortScratch.data();
+
+	for (int pass = 0; pass < 8; pass++)
+	{
+		uint32_t* histogram = histograms[pass];
+		const int shift = pass * 8;
+
+		// Every key shares this byte (e.g. single pipeline), so the pass would not change the order
+		if (histogram[(src[0].Key >> shift) & 0xFF] == count)
+			continue;
+
+		// Exclusive prefix sum gives the first output slot of each bucket
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			uint32_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		// Stable scatter into the destination buffer
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[histogram[(src[i].Key >> shift) & 0xFF]++] = src[i];
+		}
+
+		std::swap(src, dst);
+	}
+
+	// Gather packets in sorted order
+	m_SortedPackets.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		m_SortedPackets[i] = m_Packets[src[i].Index];
+	}
+	m_Packets.swap(m_SortedPackets);
+}
+
+void RenderQueue::Record(VkCommandBuffer commandBuffer, const RenderQueueBindings& bindings, RenderQueueStats& stats) const
+{
+	// Currently bound state (nothing is bound at the start of the subpass)
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	uint32_t boundDynamicOffset = 0;
+	bool frameSetBound = false;
+	bool textureSetBound = false;
+	bool materialPushed = false;
+	uint32_t pushedTextureID = 0;
+	VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+
+	for (const DrawPacket& packet : m_Packets)
+	{
+		// Pipeline
+		VkPipeline pipeline = bindings.Pipelines[packet.PipelineID];
+		if (pipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+			stats.PipelineBinds++;
+		}
+		else
+		{
+			stats.PipelineBindsAvoided++;
+		}
+
+		// Set 0 (view-projection + model dynamic offset): only rebind when the dynamic offset changes
+		if (!frameSetBound || packet.DynamicOffset != boundDynamicOffset)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bindings.PipelineLayout,
+				0, 1, &bindings.FrameDescriptorSet, 1, &packet.DynamicOffset);
+			frameSetBound = true;
+			boundDynamicOffset = packet.DynamicOffset;
+			stats.DescriptorSetBinds++;
+		}
+		else
+		{
+			stats.DescriptorSetBindsAvoided++;
+		}
+
+		// Set 1 (texture table): holds every texture, so it is bound once for the whole queue
+		// layouts are compatible, so rebinding set 0 does not disturb it
+		if (!textureSetBound)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bindings.PipelineLayout,
+				1, 1, &bindings.TextureDescriptorSet, 0, nullptr);
+			textureSetBound = true;
+			stats.DescriptorSetBinds++;
+		}
+		else
+		{
+			stats.DescriptorSetBindsAvoided++;
+		}
+
+		// Material: select the texture in the table
+		if (!materialPushed || packet.TextureID != pushedTextureID)
+		{
+			PushMaterial pushMaterial = { packet.TextureID };
+			vkCmdPushConstants(commandBuffer, bindings.PipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT,
+				0, sizeof(PushMaterial), &pushMaterial);
+			materialPushed = true;
+			pushedTextureID = packet.TextureID;
+			stats.PushConstantUpdates++;
+		}
+		else
+		{
+			stats.PushConstantUpdatesAvoided++;
+		}
+
+		// Geometry
+		if (packet.VertexBuffer != boundVertexBuffer)
+		{
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &packet.VertexBuffer, offsets);
+			boundVertexBuffer = packet.VertexBuffer;
+			stats.VertexBufferBinds++;
+		}
+		else
+		{
+			stats.VertexBufferBindsAvoided++;
+		}
+
+		if (packet.IndexBuffer != boundIndexBuffer)
+		{
+			vkCmdBindIndexBuffer(commandBuffer, packet.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			boundIndexBuffer = packet.IndexBuffer;
+			stats.IndexBufferBinds++;
+		}
+		else
+		{
+			stats.IndexBufferBindsAvoided++;
+		}
+
+		vkCmdDrawIndexed(commandBuffer, packet.IndexCount, 1, 0, 0, 0);
+		stats.DrawCalls++;
+		stats.Triangles += packet.IndexCount / 3;
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstdint>
+
+// Compact description of a single indexed draw, sorted by SortKey before recording
+struct DrawPacket
+{
+	uint64_t SortKey;			// see RenderQueue::MakeSortKey for the bit layout
+	VkBuffer VertexBuffer;
+	VkBuffer IndexBuffer;
+	uint32_t IndexCount;
+	uint32_t PipelineID;		// index into RenderQueueBindings::Pipelines
+	uint32_t DynamicOffset;		// offset into the model dynamic uniform buffer (set 0)
+	uint32_t TextureID;			// slot in the bindless texture table (set 1), pushed as PushMaterial
+};
+
+// Fragment push constant selecting the material texture in the texture table
+struct PushMaterial
+{
+	uint32_t TextureIndex;
+};
+
+// State needed by the recorder to turn packets into commands
+struct RenderQueueBindings
+{
+	VkPipelineLayout PipelineLayout;
+	const VkPipeline* Pipelines;					// indexed by DrawPacket::PipelineID
+	VkDescriptorSet FrameDescriptorSet;				// set 0: view-projection + dynamic model buffer
+	VkDescriptorSet TextureDescriptorSet;			// set 1: bindless texture table, bound once
+};
+
+// Per-frame counts of state changes that were issued versus skipped as redundant
+struct RenderQueueStats
+{
+	uint32_t DrawCalls = 0;
+	uint64_t Triangles = 0;
+
+	uint32_t PipelineBinds = 0;
+	uint32_t PipelineBindsAvoided = 0;
+	uint32_t DescriptorSetBinds = 0;
+	uint32_t DescriptorSetBindsAvoided = 0;
+	uint32_t VertexBufferBinds = 0;
+	uint32_t VertexBufferBindsAvoided = 0;
+	uint32_t IndexBufferBinds = 0;
+	uint32_t IndexBufferBindsAvoided = 0;
+	uint32_t PushConstantUpdates = 0;
+	uint32_t PushConstantUpdatesAvoided = 0;
+
+	uint32_t BindsIssued() const
+	{
+		return PipelineBinds + DescriptorSetBinds + VertexBufferBinds + IndexBufferBinds + PushConstantUpdates;
+	}
+
+	uint32_t BindsAvoided() const
+	{
+		return PipelineBindsAvoided + DescriptorSetBindsAvoided + VertexBufferBindsAvoided + IndexBufferBindsAvoided +
+			PushConstantUpdatesAvoided;
+	}
+};
+
+class RenderQueue
+{
+public:
+	RenderQueue() = default;
+
+	// Sort key layout (most significant first):
+	// [63..60] pipeline | [59..40] depth | [39..30] descriptor set | [29..16] texture | [15..0] geometry
+	static uint64_t MakeSortKey(uint32_t pipelineID, uint32_t descriptorSetID, uint32_t textureID,
+		uint32_t geometryID, float normalizedDepth);
+
+	void Clear();
+	void Submit(const DrawPacket& packet) { m_Packets.push_back(packet); }
+
+	// LSD radix sort of the packets by SortKey
+	void Sort();
+
+	// Record every packet into the command buffer, skipping binds of state that is already bound
+	void Record(VkCommandBuffer commandBuffer, const RenderQueueBindings& bindings, RenderQueueStats& stats) const;
+
+	size_t GetPacketCount() const { return m_Packets.size(); }
+	const std::vector<DrawPacket>& GetPackets() const { return m_Packets; }
+
+private:
+	struct SortEntry
+	{
+		uint64_t Key;
+		uint32_t Index;
+	};
+
+	std::vector<DrawPacket> m_Packets;
+	std::vector<DrawPacket> m_SortedPackets;
+
+	// Ping-pong buffers for the radix passes (kept between frames to avoid reallocations)
+	std::vector<SortEntry> m_SortEntries;
+	std::vector<SortEntry> m_SortScratch;
+};
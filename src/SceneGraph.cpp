@@ -0,0 +1,181 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Trace.h"
+
+const uint32_t SceneGraph::InvalidNode;
+
+uint32_t SceneGraph::CreateNode(uint32_t parent, const glm::mat4& localTransform)
+{
+	if (parent != InvalidNode && parent >= GetNodeCount())
+	{
+		throw std::runtime_error("Invalid scene node parent!");
+	}
+
+	// Appended for now, moved to its breadth-first place by the next Update
+	uint32_t node = GetNodeCount();
+	uint32_t slot = static_cast<uint32_t>(m_Nodes.size());
+	m_Parents.push_back(parent);
+	m_Slots.push_back(slot);
+
+	m_Nodes.push_back(node);
+	m_ParentSlots.push_back(parent == InvalidNode ? InvalidNode : m_Slots[parent]);
+	m_FirstChildSlots.push_back(0);
+	m_ChildCounts.push_back(0);
+	m_LocalTransforms.push_back(localTransform);
+	m_WorldTransforms.push_back(localTransform);
+	m_Dirty.push_back(0);
+
+	MarkDirty(slot);
+	m_OrderChanged = true;
+	return node;
+}
+
+void SceneGraph::SetParent(uint32_t node, uint32_t parent)
+{
+	for (uint32_t ancestor = parent; ancestor != InvalidNode; ancestor = m_Parents[ancestor])
+	{
+		if (ancestor == node)
+		{
+			throw std::runtime_error("Scene node can't be parented to its own subtree!");
+		}
+	}
+
+	m_Parents[node] = parent;
+	MarkDirty(m_Slots[node]);
+	m_OrderChanged = true;
+}
+
+void SceneGraph::SetLocalTransform(uint32_t node, const glm::mat4& localTransform)
+{
+	uint32_t slot = m_Slots[node];
+	m_LocalTransforms[slot] = localTransform;
+	MarkDirty(slot);
+}
+
+void SceneGraph::Update()
+{
+	TRACE_FUNCTION();
+
+	m_UpdatedNodes.clear();
+	if (m_OrderChanged)
+	{
+		SortBreadthFirst();
+	}
+
+	// Parents come first, so a flagged node's parent is final when it is reached; it flags its children in turn
+	uint32_t slotCount = static_cast<uint32_t>(m_Nodes.size());
+	for (uint32_t slot = m_FirstDirtySlot; slot < slotCount; slot++)
+	{
+		if (!m_Dirty[slot])
+		{
+			continue;
+		}
+		m_Dirty[slot] = 0;
+
+		uint32_t parentSlot = m_ParentSlots[slot];
+		m_WorldTransforms[slot] = parentSlot == InvalidNode ? m_LocalTransforms[slot] :
+			m_WorldTransforms[parentSlot] * m_LocalTransforms[slot];
+
+		std::fill(m_Dirty.begin() + m_FirstChildSlots[slot], m_Dirty.begin() + m_FirstChildSlots[slot] + m_ChildCounts[slot], 1);
+		m_UpdatedNodes.push_back(m_Nodes[slot]);
+	}
+
+	m_FirstDirtySlot = UINT32_MAX;
+}
+
+void SceneGraph::MarkDirty(uint32_t slot)
+{
+	m_Dirty[slot] = 1;
+	m_FirstDirtySlot = std::min(m_FirstDirtySlot, slot);
+}
+
+void SceneGraph::SortBreadthFirst()
+{
+	TRACE_FUNCTION();
+
+	uint32_t nodeCount = GetNodeCount();
+
+	// Children of every node, in node ID order (counting sort on the parent)
+	std::vector<uint32_t> childOffsets(nodeCount + 1, 0);
+	for (uint32_t node = 0; node < nodeCount; node++)
+	{
+		if (m_Parents[node] != InvalidNode)
+		{
+			childOffsets[m_Parents[node] + 1]++;
+		}
+	}
+	for (uint32_t node = 0; node < nodeCount; node++)
+	{
+		childOffsets[node + 1] += childOffsets[node];
+	}
+
+	std::vector<uint32_t> children(nodeCount);
+	std::vector<uint32_t> childFill(childOffsets.begin(), childOffsets.end() - 1);
+	for (uint32_t node = 0; node < nodeCount; node++)
+	{
+		if (m_Parents[node] != InvalidNode)
+		{
+			children[childFill[m_Parents[node]]++] = node;
+		}
+	}
+
+	// Roots, then level by level (the order list is its own queue)
+	std::vector<uint32_t> order;
+	order.reserve(nodeCount);
+	for (uint32_t node = 0; node < nodeCount; node++)
+	{
+		if (m_Parents[node] == InvalidNode)
+		{
+			order.push_back(node);
+		}
+	}
+
+	std::vector<uint32_t> firstChildSlots(nodeCount);
+	std::vector<uint32_t> childCounts(nodeCount);
+	for (uint32_t slot = 0; slot < order.size(); slot++)
+	{
+		uint32_t node = order[slot];
+		firstChildSlots[slot] = static_cast<uint32_t>(order.size());
+		childCounts[slot] = childOffsets[node + 1] - childOffsets[node];
+		order.insert(order.end(), children.begin() + childOffsets[node], children.begin() + childOffsets[node + 1]);
+	}
+
+	// Move every node's data to its new slot
+	std::vector<uint32_t> slots(nodeCount);
+	std::vector<glm::mat4> localTransforms(nodeCount);
+	std::vector<glm::mat4> worldTransforms(nodeCount);
+	std::vector<uint8_t> dirty(nodeCount);
+	for (uint32_t slot = 0; slot < nodeCount; slot++)
+	{
+		uint32_t oldSlot = m_Slots[order[slot]];
+		slots[order[slot]] = slot;
+		localTransforms[slot] = m_LocalTransforms[oldSlot];
+		worldTransforms[slot] = m_WorldTransforms[oldSlot];
+		dirty[slot] = m_Dirty[oldSlot];
+	}
+
+	std::vector<uint32_t> parentSlots(nodeCount);
+	m_FirstDirtySlot = UINT32_MAX;
+	for (uint32_t slot = 0; slot < nodeCount; slot++)
+	{
+		uint32_t parent = m_Parents[order[slot]];
+		parentSlots[slot] = parent == InvalidNode ? InvalidNode : slots[parent];
+		if (dirty[slot] && m_FirstDirtySlot == UINT32_MAX)
+		{
+			m_FirstDirtySlot = slot;
+		}
+	}
+
+	m_Nodes.swap(order);
+	m_Slots.swap(slots);
+	m_ParentSlots.swap(parentSlots);
+	m_FirstChildSlots.swap(firstChildSlots);
+	m_ChildCounts.swap(childCounts);
+	m_LocalTransforms.swap(localTransforms);
+	m_WorldTransforms.swap(worldTransforms);
+	m_Dirty.swap(dirty);
+	m_OrderChanged = false;
+}
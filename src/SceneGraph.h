@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// Transform hierarchy: every node has a local transform (relative to its parent) and a world transform.
+// Nodes are stored breadth-first in contiguous arrays, so parents come before their children and the children of a
+// node are next to each other. Changing a local transform only flags the node, Update then recomputes the flagged
+// nodes and their subtrees in one pass from the first flagged node; untouched subtrees are never visited.
+// Node IDs stay valid when the hierarchy changes (the arrays are reordered on the next Update).
+class SceneGraph
+{
+public:
+	static const uint32_t InvalidNode = UINT32_MAX;
+
+	SceneGraph() = default;
+
+	uint32_t CreateNode(uint32_t parent = InvalidNode, const glm::mat4& localTransform = glm::mat4(1.0f));
+	// InvalidNode = make it a root
+	void SetParent(uint32_t node, uint32_t parent);
+	uint32_t GetParent(uint32_t node) const { return m_Parents[node]; }
+
+	void SetLocalTransform(uint32_t node, const glm::mat4& localTransform);
+	const glm::mat4& GetLocalTransform(uint32_t node) const { return m_LocalTransforms[m_Slots[node]]; }
+	// As of the last Update
+	const glm::mat4& GetWorldTransform(uint32_t node) const { return m_WorldTransforms[m_Slots[node]]; }
+
+	// Recompute the world transforms of changed nodes and everything below them
+	void Update();
+	// Nodes whose world transform was recomputed by the last Update
+	const std::vector<uint32_t>& GetUpdatedNodes() const { return m_UpdatedNodes; }
+
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_Parents.size()); }
+
+private:
+	void MarkDirty(uint32_t slot);
+	void SortBreadthFirst();
+
+private:
+	// By node ID
+	std::vector<uint32_t> m_Parents;
+	std::vector<uint32_t> m_Slots;				// position in the breadth-first arrays
+
+	// Breadth-first order (by slot)
+	std::vector<uint32_t> m_Nodes;				// node ID of a slot
+	std::vector<uint32_t> m_ParentSlots;
+	std::vector<uint32_t> m_FirstChildSlots;	// children are contiguous: [first, first + count)
+	std::vector<uint32_t> m_ChildCounts;
+	std::vector<glm::mat4> m_LocalTransforms;
+	std::vector<glm::mat4> m_WorldTransforms;
+	std::vector<uint8_t> m_Dirty;
+
+	uint32_t m_FirstDirtySlot = UINT32_MAX;
+	bool m_OrderChanged = false;				// nodes were added or reparented since the last sort
+	std::vector<uint32_t> m_UpdatedNodes;
+};
@@ -0,0 +1,67 @@
+// Clustered point lighting, shared by the forward (shader.frag) and deferred (lighting.frag) paths.
+// Lights are binned on the CPU every frame, layouts match ClusteredLighting.h
+
+struct PointLight {
+	vec4 positionRadius;		// view space position, radius
+	vec4 colorIntensity;
+};
+
+struct ClusterRange {
+	uint offset;
+	uint count;
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer LightBuffer {
+	uvec4 gridSize;				// clusters in x, y, z, visible light count
+	vec4 sliceParams;			// depth slice = log(view depth) * x + y, z/w = 1 / render extent
+	PointLight lights[];
+} lightBuffer;
+
+layout(std430, set = 0, binding = 3) readonly buffer ClusterBuffer {
+	ClusterRange clusters[];
+} clusterBuffer;
+
+layout(std430, set = 0, binding = 4) readonly buffer LightIndexBuffer {
+	uint lightIndices[];
+} lightIndexBuffer;
+
+const float AMBIENT = 0.2;
+
+uint clusterIndex(vec2 fragCoord, vec3 viewPos)
+{
+	uvec3 grid = lightBuffer.gridSize.xyz;
+	uvec2 tile = uvec2(fragCoord * lightBuffer.sliceParams.zw * vec2(grid.xy));
+	tile = min(tile, grid.xy - 1);
+	float slice = log(max(-viewPos.z, 1e-4)) * lightBuffer.sliceParams.x + lightBuffer.sliceParams.y;
+	uint z = uint(clamp(slice, 0.0, float(grid.z - 1)));
+	return (z * grid.y + tile.y) * grid.x + tile.x;
+}
+
+// Light reaching a view space point (ambient included), n = normalized view space normal
+vec3 clusteredLighting(vec2 fragCoord, vec3 viewPos, vec3 n)
+{
+	vec3 lighting = vec3(AMBIENT);
+
+	ClusterRange cluster = clusterBuffer.clusters[clusterIndex(fragCoord, viewPos)];
+	for (uint i = 0; i < cluster.count; i++)
+	{
+		PointLight light = lightBuffer.lights[lightIndexBuffer.lightIndices[cluster.offset + i]];
+		vec3 toLight = light.positionRadius.xyz - viewPos;
+		float distanceSq = dot(toLight, toLight);
+		float radius = light.positionRadius.w;
+		if (distanceSq >= radius * radius)
+		{
+			continue;
+		}
+
+		// Inverse square falloff, windowed to reach zero at the radius
+		float ratio = distanceSq / (radius * radius);
+		float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+		float attenuation = window * window / (distanceSq + 1.0);
+		float lambert = max(dot(n, toLight * inversesqrt(max(distanceSq, 1e-8))), 0.0);
+
+		lighting += light.colorIntensity.rgb * light.colorIntensity.w * attenuation * lambert;
+	}
+
+	return lighting;
+}
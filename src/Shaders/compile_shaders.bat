@@ -1,5 +1,11 @@
 C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -V shader.vert
 C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -V shader.frag
-C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o second_vert.spv -V second.vert
-C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o second_frag.spv -V second.frag
+C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o composite_comp.spv -V composite.comp
+C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o hiz_comp.spv -V hiz.comp
+C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o upscale_vert.spv -V upscale.vert
+C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o upscale_frag.spv -V upscale.frag
+C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o gbuffer_frag.spv -V gbuffer.frag
+C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o lighting_vert.spv -V lighting.vert
+C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o lighting_frag.spv -V lighting.frag
+C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o skinning_comp.spv -V skinning.comp
 pause
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Deferred geometry pass: fills the G-buffer, lighting happens once per pixel in lighting.frag
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outNormal;	// view space normal * 0.5 + 0.5, a = lit (0 = no normal, ambient only)
+
+layout(location = 0) in vec3 o_color;
+layout(location = 1) in vec2 fragTex;
+layout(location = 2) in vec3 viewPos;
+layout(location = 3) in vec3 viewNormal;
+
+// Different descriptor set: bindless texture table (every loaded texture)
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// Material: index of the texture in the table (same for the whole draw)
+layout(push_constant) uniform PushMaterial {
+	uint textureIndex;
+} pushMaterial;
+
+void main()
+{
+	outAlbedo = texture(textures[pushMaterial.textureIndex], fragTex);
+
+	if (dot(viewNormal, viewNormal) < 1e-8)
+	{
+		outNormal = vec4(0.5, 0.5, 0.5, 0.0);
+	}
+	else
+	{
+		outNormal = vec4(normalize(viewNormal) * 0.5 + 0.5, 1.0);
+	}
+}
@@ -0,0 +1,41 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Deferred lighting subpass: reads the G-buffer of this pixel from tile memory, lights it once
+layout(location = 0) out vec4 outColor;
+
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput inputAlbedo;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput inputNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput inputDepth;
+
+#include "clustered_lighting.glsl"
+
+// View space position reconstruction from the depth buffer
+layout(push_constant) uniform PushLighting {
+	mat4 inverseProjection;
+} pushLighting;
+
+void main()
+{
+	// Nothing drawn here, leave the clear color
+	float depth = subpassLoad(inputDepth).r;
+	if (depth >= 1.0)
+	{
+		discard;
+	}
+
+	vec4 albedo = subpassLoad(inputAlbedo);
+	vec4 packedNormal = subpassLoad(inputNormal);
+	if (packedNormal.a < 0.5)
+	{
+		outColor = vec4(albedo.rgb * AMBIENT, albedo.a);
+		return;
+	}
+
+	vec2 ndc = gl_FragCoord.xy * lightBuffer.sliceParams.zw * 2.0 - 1.0;
+	vec4 viewPos = pushLighting.inverseProjection * vec4(ndc, depth, 1.0);
+	viewPos /= viewPos.w;
+
+	vec3 n = normalize(packedNormal.xyz * 2.0 - 1.0);
+	outColor = vec4(albedo.rgb * clusteredLighting(gl_FragCoord.xy, viewPos.xyz, n), albedo.a);
+}
@@ -10,4 +10,4 @@ vec2 positions[3] = vec2[] (
 void main()
 {
 	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-}
\ No newline at end of file
+}
@@ -1,14 +1,34 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 0) out vec4 outColor; // output color
 
 layout(location = 0) in vec3 o_color;
 layout(location = 1) in vec2 fragTex;
+layout(location = 2) in vec3 viewPos;
+layout(location = 3) in vec3 viewNormal;
 
-// Different descriptor set 
-layout(set = 1, binding = 0) uniform sampler2D textureSampler;
+#include "clustered_lighting.glsl"
+
+// Different descriptor set: bindless texture table (every loaded texture)
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// Material: index of the texture in the table (same for the whole draw)
+layout(push_constant) uniform PushMaterial {
+	uint textureIndex;
+} pushMaterial;
 
 void main()
 {
-	outColor = texture(textureSampler,fragTex);
-}
\ No newline at end of file
+	vec4 albedo = texture(textures[pushMaterial.textureIndex], fragTex);
+
+	// Meshes without normals are only lit by the ambient term
+	if (dot(viewNormal, viewNormal) < 1e-8)
+	{
+		outColor = vec4(albedo.rgb * AMBIENT, albedo.a);
+		return;
+	}
+
+	outColor = vec4(albedo.rgb * clusteredLighting(gl_FragCoord.xy, viewPos, normalize(viewNormal)), albedo.a);
+}
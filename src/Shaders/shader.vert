@@ -3,6 +3,7 @@
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
 layout(location = 2) in vec2 texCoords;
+layout(location = 3) in vec3 normal;
 
 layout(set = 0, binding = 0) uniform uboViewProjection {
 	mat4 projection;
@@ -20,10 +21,16 @@ layout(push_constant) uniform PushModel {
 
 layout(location = 0) out vec3 out_color;
 layout(location = 1) out vec2 fragTex;
+layout(location = 2) out vec3 viewPos;		// view space, for the cluster lookup and lighting
+layout(location = 3) out vec3 viewNormal;
 
 void main()
 {
-	gl_Position = viewProjectionMtx.projection * viewProjectionMtx.view * modelMtx.model *vec4(position, 1.0);
+	mat4 modelView = viewProjectionMtx.view * modelMtx.model;
+	vec4 viewPosition = modelView * vec4(position, 1.0);
+	gl_Position = viewProjectionMtx.projection * viewPosition;
+	viewPos = viewPosition.xyz;
+	viewNormal = mat3(modelView) * normal;		// no non-uniform scale in the scene
 	out_color = color;
 	fragTex = texCoords;
 }
\ No newline at end of file
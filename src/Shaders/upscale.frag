@@ -0,0 +1,60 @@
+#version 450
+
+layout(location = 0) in vec2 screenUV;
+
+layout(location = 0) out vec4 outColor; // output color
+
+// Scene rendered at the dynamic resolution (only the top left part of the texture is valid)
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+
+layout(push_constant) uniform PushUpscale {
+	vec2 uvScale;		// rendered size / texture size
+	vec2 textureSize;	// texture size in pixels
+} pushUpscale;
+
+// Catmull-Rom bicubic filter using 9 bilinear taps (sharper than bilinear when upscaling)
+vec4 SampleCatmullRom(vec2 uv)
+{
+	vec2 texelSize = 1.0 / pushUpscale.textureSize;
+	vec2 samplePos = uv * pushUpscale.textureSize;
+	vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+
+	// Weights of the 4 texels on each axis
+	vec2 f = samplePos - texPos1;
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+	// The middle two texels are fetched with one bilinear tap
+	vec2 w12 = w1 + w2;
+	vec2 offset12 = w2 / w12;
+
+	// Keep every tap inside the rendered region, outside of it the texture holds stale data
+	vec2 minUV = 0.5 * texelSize;
+	vec2 maxUV = pushUpscale.uvScale - 0.5 * texelSize;
+	vec2 uv0 = clamp((texPos1 - 1.0) * texelSize, minUV, maxUV);
+	vec2 uv3 = clamp((texPos1 + 2.0) * texelSize, minUV, maxUV);
+	vec2 uv12 = clamp((texPos1 + offset12) * texelSize, minUV, maxUV);
+
+	vec4 result = vec4(0.0);
+	result += texture(sceneColor, vec2(uv0.x, uv0.y)) * w0.x * w0.y;
+	result += texture(sceneColor, vec2(uv12.x, uv0.y)) * w12.x * w0.y;
+	result += texture(sceneColor, vec2(uv3.x, uv0.y)) * w3.x * w0.y;
+
+	result += texture(sceneColor, vec2(uv0.x, uv12.y)) * w0.x * w12.y;
+	result += texture(sceneColor, vec2(uv12.x, uv12.y)) * w12.x * w12.y;
+	result += texture(sceneColor, vec2(uv3.x, uv12.y)) * w3.x * w12.y;
+
+	result += texture(sceneColor, vec2(uv0.x, uv3.y)) * w0.x * w3.y;
+	result += texture(sceneColor, vec2(uv12.x, uv3.y)) * w12.x * w3.y;
+	result += texture(sceneColor, vec2(uv3.x, uv3.y)) * w3.x * w3.y;
+
+	// Negative lobes can ring below zero on hard edges
+	return max(result, vec4(0.0));
+}
+
+void main()
+{
+	outColor = SampleCatmullRom(screenUV * pushUpscale.uvScale);
+}
\ No newline at end of file
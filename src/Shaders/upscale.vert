@@ -0,0 +1,16 @@
+#version 450
+
+// array for triangle that fills screen
+vec2 positions[3] = vec2[] (
+	vec2(3.0, -1.0),
+	vec2(-1.0, -1.0),
+	vec2(-1.0, 3.0)
+);
+
+layout(location = 0) out vec2 screenUV;	// [0, 1] over the whole swapchain image
+
+void main()
+{
+	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+	screenUV = positions[gl_VertexIndex] * 0.5 + 0.5;
+}
\ No newline at end of file
@@ -0,0 +1,373 @@
+#include "SoftwareOcclusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SOFTWARE_OCCLUSION_AVX2 1
+#elif defined(__AVX2__)
+#define SOFTWARE_OCCLUSION_AVX2 1
+#endif
+
+#ifdef SOFTWARE_OCCLUSION_AVX2
+#include <immintrin.h>
+#endif
+
+#include "JobSystem.h"
+#include "Trace.h"
+#include "Utils.h"
+
+// Rows of the depth buffer rasterized by one job
+static const uint32_t BAND_ROWS = 16;
+// Vertices closer to the eye than this (clip w) are not projected, their triangles are skipped
+static const float MIN_CLIP_W = 1e-4f;
+
+SoftwareOcclusion::SoftwareOcclusion()
+	: m_Depth(SOFTWARE_OCCLUSION_WIDTH * SOFTWARE_OCCLUSION_HEIGHT, 1.0f)
+{
+	m_UseAvx2 = IsAvx2Supported();
+}
+
+void SoftwareOcclusion::Render(JobSystem& jobSystem, const std::vector<SoftwareOccluder>& occluders, const glm::mat4& viewProjection)
+{
+	TRACE_FUNCTION();
+
+	m_ViewProjection = viewProjection;
+	m_Stats = SoftwareOcclusionStats();
+	m_Stats.Occluders = static_cast<uint32_t>(occluders.size());
+	m_Stats.Avx2 = m_UseAvx2;
+	std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+
+	std::vector<uint32_t> firstTriangles(occluders.size());
+	uint32_t triangleCount = 0;
+	for (size_t i = 0; i < occluders.size(); i++)
+	{
+		firstTriangles[i] = triangleCount;
+		triangleCount += static_cast<uint32_t>(occluders[i].Indices->size() / 3);
+	}
+	m_Triangles.resize(triangleCount);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// 1. Triangle setup, one job per occluder (each writes its own range of the triangle list)
+	JobCounter setupCounter;
+	jobSystem.ParallelFor(static_cast<uint32_t>(occluders.size()), 1, [this, &occluders, &firstTriangles](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			SetupTriangles(occluders[i], firstTriangles[i]);
+		}
+	}, &setupCounter);
+
+	// 2. Row bands once every triangle is set up (bands never share a row, no locking)
+	JobCounter rasterCounter;
+	uint32_t bandCount = (SOFTWARE_OCCLUSION_HEIGHT + BAND_ROWS - 1) / BAND_ROWS;
+	jobSystem.ParallelFor(bandCount, 1, [this](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t band = begin; band < end; band++)
+		{
+			uint32_t minY = band * BAND_ROWS;
+			uint32_t maxY = std::min(minY + BAND_ROWS, SOFTWARE_OCCLUSION_HEIGHT) - 1;
+			if (m_UseAvx2)
+			{
+				RasterizeBandAvx2(minY, maxY);
+			}
+			else
+			{
+				RasterizeBand(minY, maxY);
+			}
+		}
+	}, &rasterCounter, &setupCounter);
+	jobSystem.Wait(rasterCounter);
+
+	for (const Triangle& triangle : m_Triangles)
+	{
+		m_Stats.Triangles += triangle.MinY <= triangle.MaxY ? 1 : 0;
+	}
+}
+
+bool SoftwareOcclusion::IsOccluded(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	m_Stats.Tested++;
+	if (m_Stats.Triangles == 0)
+	{
+		return false;
+	}
+
+	// Screen rectangle and nearest depth of the box corners
+	glm::mat4 modelViewProjection = m_ViewProjection * model;
+	glm::vec2 screenMin(FLT_MAX);
+	glm::vec2 screenMax(-FLT_MAX);
+	float nearestDepth = FLT_MAX;
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = modelViewProjection * glm::vec4(position, 1.0f);
+		if (clip.w < MIN_CLIP_W)
+		{
+			// Reaches behind the eye, can't be behind anything
+			return false;
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 screen((ndc.x * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_HEIGHT);
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+		nearestDepth = std::min(nearestDepth, ndc.z);
+	}
+
+	// Every pixel the rectangle touches (off screen parts are left to the clipper)
+	int32_t minX = std::max(static_cast<int32_t>(std::floor(screenMin.x)), 0);
+	int32_t minY = std::max(static_cast<int32_t>(std::floor(screenMin.y)), 0);
+	int32_t maxX = std::min(static_cast<int32_t>(std::floor(screenMax.x)), static_cast<int32_t>(SOFTWARE_OCCLUSION_WIDTH) - 1);
+	int32_t maxY = std::min(static_cast<int32_t>(std::floor(screenMax.y)), static_cast<int32_t>(SOFTWARE_OCCLUSION_HEIGHT) - 1);
+	if (minX > maxX || minY > maxY)
+	{
+		return false;
+	}
+
+	for (int32_t y = minY; y <= maxY; y++)
+	{
+		const float* row = &m_Depth[y * SOFTWARE_OCCLUSION_WIDTH];
+		for (int32_t x = minX; x <= maxX; x++)
+		{
+			if (nearestDepth <= row[x])
+			{
+				return false;
+			}
+		}
+	}
+
+	m_Stats.Occluded++;
+	return true;
+}
+
+float SoftwareOcclusion::GetScreenArea(const glm::mat4& modelViewProjection, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	glm::vec2 ndcMin(FLT_MAX);
+	glm::vec2 ndcMax(-FLT_MAX);
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = modelViewProjection * glm::vec4(position, 1.0f);
+		if (clip.w < MIN_CLIP_W)
+		{
+			// Around the eye, covers the screen
+			return 1.0f;
+		}
+
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		ndcMin = glm::min(ndcMin, ndc);
+		ndcMax = glm::max(ndcMax, ndc);
+	}
+
+	ndcMin = glm::clamp(ndcMin, glm::vec2(-1.0f), glm::vec2(1.0f));
+	ndcMax = glm::clamp(ndcMax, glm::vec2(-1.0f), glm::vec2(1.0f));
+	return (ndcMax.x - ndcMin.x) * (ndcMax.y - ndcMin.y) * 0.25f;
+}
+
+void SoftwareOcclusion::SetupTriangles(const SoftwareOccluder& occluder, uint32_t firstTriangle)
+{
+	glm::mat4 modelViewProjection = m_ViewProjection * occluder.Model;
+	const std::vector<glm::vec3>& positions = *occluder.Positions;
+	const std::vector<uint32_t>& indices = *occluder.Indices;
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		Triangle& triangle = m_Triangles[firstTriangle + i / 3];
+		triangle.MinY = 1;
+		triangle.MaxY = 0;
+
+		// Screen position (pixels) and depth of the corners
+		glm::vec3 screen[3];
+		bool behindEye = false;
+		for (uint32_t v = 0; v < 3; v++)
+		{
+			glm::vec4 clip = modelViewProjection * glm::vec4(positions[indices[i + v]], 1.0f);
+			if (clip.w < MIN_CLIP_W)
+			{
+				behindEye = true;
+				break;
+			}
+
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			screen[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_HEIGHT, ndc.z);
+		}
+		if (behindEye)
+		{
+			continue;
+		}
+
+		// Pixels whose centers may be inside
+		float minX = std::min(std::min(screen[0].x, screen[1].x), screen[2].x);
+		float maxX = std::max(std::max(screen[0].x, screen[1].x), screen[2].x);
+		float minY = std::min(std::min(screen[0].y, screen[1].y), screen[2].y);
+		float maxY = std::max(std::max(screen[0].y, screen[1].y), screen[2].y);
+		triangle.MinX = std::max(static_cast<int32_t>(std::ceil(minX - 0.5f)), 0);
+		triangle.MaxX = std::min(static_cast<int32_t>(std::floor(maxX - 0.5f)), static_cast<int32_t>(SOFTWARE_OCCLUSION_WIDTH) - 1);
+		int32_t pixelMinY = std::max(static_cast<int32_t>(std::ceil(minY - 0.5f)), 0);
+		int32_t pixelMaxY = std::min(static_cast<int32_t>(std::floor(maxY - 0.5f)), static_cast<int32_t>(SOFTWARE_OCCLUSION_HEIGHT) - 1);
+		if (triangle.MinX > triangle.MaxX || pixelMinY > pixelMaxY)
+		{
+			continue;
+		}
+
+		// Edge e is opposite to corner e: zero on the edge, the triangle's area (x2) at the corner
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			const glm::vec3& a = screen[(e + 1) % 3];
+			const glm::vec3& b = screen[(e + 2) % 3];
+			triangle.EdgeA[e] = a.y - b.y;
+			triangle.EdgeB[e] = b.x - a.x;
+			triangle.EdgeC[e] = -(triangle.EdgeA[e] * a.x + triangle.EdgeB[e] * a.y);
+		}
+
+		// Both windings are drawn (occluders needn't be closed), flipped so the inside is positive
+		float area = triangle.EdgeA[0] * screen[0].x + triangle.EdgeB[0] * screen[0].y + triangle.EdgeC[0];
+		if (std::abs(area) < 1e-6f)
+		{
+			continue;
+		}
+		if (area < 0.0f)
+		{
+			for (uint32_t e = 0; e < 3; e++)
+			{
+				triangle.EdgeA[e] = -triangle.EdgeA[e];
+				triangle.EdgeB[e] = -triangle.EdgeB[e];
+				triangle.EdgeC[e] = -triangle.EdgeC[e];
+			}
+			area = -area;
+		}
+
+		// Depth as a plane over the screen: barycentric weights are edge / area
+		float inverseArea = 1.0f / area;
+		triangle.DepthA = (triangle.EdgeA[0] * screen[0].z + triangle.EdgeA[1] * screen[1].z + triangle.EdgeA[2] * screen[2].z) * inverseArea;
+		triangle.DepthB = (triangle.EdgeB[0] * screen[0].z + triangle.EdgeB[1] * screen[1].z + triangle.EdgeB[2] * screen[2].z) * inverseArea;
+		triangle.DepthC = (triangle.EdgeC[0] * screen[0].z + triangle.EdgeC[1] * screen[1].z + triangle.EdgeC[2] * screen[2].z) * inverseArea;
+
+		triangle.MinY = pixelMinY;
+		triangle.MaxY = pixelMaxY;
+	}
+}
+
+void SoftwareOcclusion::RasterizeBand(uint32_t minY, uint32_t maxY)
+{
+	for (const Triangle& triangle : m_Triangles)
+	{
+		int32_t startY = std::max(triangle.MinY, static_cast<int32_t>(minY));
+		int32_t endY = std::min(triangle.MaxY, static_cast<int32_t>(maxY));
+		for (int32_t y = startY; y <= endY; y++)
+		{
+			float* row = &m_Depth[y * SOFTWARE_OCCLUSION_WIDTH];
+			float pixelY = static_cast<float>(y) + 0.5f;
+			for (int32_t x = triangle.MinX; x <= triangle.MaxX; x++)
+			{
+				float pixelX = static_cast<float>(x) + 0.5f;
+				float edge0 = triangle.EdgeA[0] * pixelX + triangle.EdgeB[0] * pixelY + triangle.EdgeC[0];
+				float edge1 = triangle.EdgeA[1] * pixelX + triangle.EdgeB[1] * pixelY + triangle.EdgeC[1];
+				float edge2 = triangle.EdgeA[2] * pixelX + triangle.EdgeB[2] * pixelY + triangle.EdgeC[2];
+				if (edge0 >= 0.0f && edge1 >= 0.0f && edge2 >= 0.0f)
+				{
+					float depth = triangle.DepthA * pixelX + triangle.DepthB * pixelY + triangle.DepthC;
+					row[x] = std::min(row[x], depth);
+				}
+			}
+		}
+	}
+}
+
+#ifdef SOFTWARE_OCCLUSION_AVX2
+void SoftwareOcclusion::RasterizeBandAvx2(uint32_t minY, uint32_t maxY)
+{
+	// 8 pixels a step from a multiple of 8 (the buffer width is one, a step never leaves the row)
+	const __m256 pixelOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (const Triangle& triangle : m_Triangles)
+	{
+		int32_t startY = std::max(triangle.MinY, static_cast<int32_t>(minY));
+		int32_t endY = std::min(triangle.MaxY, static_cast<int32_t>(maxY));
+		if (startY > endY)
+		{
+			continue;
+		}
+
+		__m256 edgeA0 = _mm256_set1_ps(triangle.EdgeA[0]);
+		__m256 edgeA1 = _mm256_set1_ps(triangle.EdgeA[1]);
+		__m256 edgeA2 = _mm256_set1_ps(triangle.EdgeA[2]);
+		__m256 depthA = _mm256_set1_ps(triangle.DepthA);
+		int32_t startX = triangle.MinX & ~7;
+
+		for (int32_t y = startY; y <= endY; y++)
+		{
+			float* row = &m_Depth[y * SOFTWARE_OCCLUSION_WIDTH];
+			float pixelY = static_cast<float>(y) + 0.5f;
+			__m256 rowEdge0 = _mm256_set1_ps(triangle.EdgeB[0] * pixelY + triangle.EdgeC[0]);
+			__m256 rowEdge1 = _mm256_set1_ps(triangle.EdgeB[1] * pixelY + triangle.EdgeC[1]);
+			__m256 rowEdge2 = _mm256_set1_ps(triangle.EdgeB[2] * pixelY + triangle.EdgeC[2]);
+			__m256 rowDepth = _mm256_set1_ps(triangle.DepthB * pixelY + triangle.DepthC);
+
+			for (int32_t x = startX; x <= triangle.MaxX; x += 8)
+			{
+				__m256 pixelX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), pixelOffsets);
+				__m256 edge0 = _mm256_add_ps(_mm256_mul_ps(edgeA0, pixelX), rowEdge0);
+				__m256 edge1 = _mm256_add_ps(_mm256_mul_ps(edgeA1, pixelX), rowEdge1);
+				__m256 edge2 = _mm256_add_ps(_mm256_mul_ps(edgeA2, pixelX), rowEdge2);
+				__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(edge0, zero, _CMP_GE_OQ),
+					_mm256_cmp_ps(edge1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(edge2, zero, _CMP_GE_OQ));
+				if (_mm256_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				__m256 depth = _mm256_add_ps(_mm256_mul_ps(depthA, pixelX), rowDepth);
+				__m256 current = _mm256_loadu_ps(row + x);
+				__m256 closer = _mm256_and_ps(inside, _mm256_cmp_ps(depth, current, _CMP_LT_OQ));
+				_mm256_storeu_ps(row + x, _mm256_blendv_ps(current, depth, closer));
+			}
+		}
+	}
+}
+
+bool SoftwareOcclusion::IsAvx2Supported()
+{
+#if defined(_MSC_VER)
+	// AVX2 instructions and the OS saving the YMM registers
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+	if (!osSavesYmm)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	// Compiled for AVX2, the whole program already requires it
+	return true;
+#endif
+}
+#else
+void SoftwareOcclusion::RasterizeBandAvx2(uint32_t minY, uint32_t maxY)
+{
+	RasterizeBand(minY, maxY);
+}
+
+bool SoftwareOcclusion::IsAvx2Supported()
+{
+	return false;
+}
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+class JobSystem;
+
+// Mesh rasterized into the occlusion depth buffer (model space triangles)
+struct SoftwareOccluder
+{
+	const std::vector<glm::vec3>* Positions;
+	const std::vector<uint32_t>* Indices;
+	glm::mat4 Model;
+};
+
+struct SoftwareOcclusionStats
+{
+	uint32_t Occluders = 0;
+	uint32_t Triangles = 0;			// occluder triangles set up (culled ones excluded)
+	uint32_t Tested = 0;
+	uint32_t Occluded = 0;
+	bool Avx2 = false;				// rows rasterized 8 pixels at a time
+};
+
+// Occlusion culling without a GPU round trip: a few large occluders are rasterized on the CPU into a small depth buffer
+// (SOFTWARE_OCCLUSION_WIDTH x SOFTWARE_OCCLUSION_HEIGHT, nearest depth) with edge functions, then the bounding boxes of
+// the occludees are tested against it. The buffer is split into row bands rasterized as jobs; rows are evaluated
+// 8 pixels at a time with AVX2 when the CPU supports it. Pixels are covered by their center, so an occluder edge
+// can hide up to a pixel more than it really does.
+class SoftwareOcclusion
+{
+public:
+	SoftwareOcclusion();
+
+	// Clears the depth buffer and rasterizes the occluders seen through viewProjection
+	void Render(JobSystem& jobSystem, const std::vector<SoftwareOccluder>& occluders, const glm::mat4& viewProjection);
+
+	// True if the model space box is hidden behind the rasterized occluders
+	bool IsOccluded(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	// Fraction of the screen covered by the projected box (occluder selection)
+	static float GetScreenArea(const glm::mat4& modelViewProjection, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	const std::vector<float>& GetDepth() const { return m_Depth; }
+	const SoftwareOcclusionStats& GetStats() const { return m_Stats; }
+
+private:
+	// Screen space triangle: edge functions and depth plane as a * x + b * y + c, oriented so inside is >= 0
+	struct Triangle
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float DepthA, DepthB, DepthC;
+		int32_t MinX, MaxX;
+		int32_t MinY, MaxY;		// MinY > MaxY = culled
+	};
+
+	void SetupTriangles(const SoftwareOccluder& occluder, uint32_t firstTriangle);
+	void RasterizeBand(uint32_t minY, uint32_t maxY);
+	void RasterizeBandAvx2(uint32_t minY, uint32_t maxY);
+
+	static bool IsAvx2Supported();
+
+private:
+	bool m_UseAvx2 = false;
+	glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+	std::vector<float> m_Depth;					// row major, 1.0 = nothing drawn
+	std::vector<Triangle> m_Triangles;
+	SoftwareOcclusionStats m_Stats;
+};
@@ -0,0 +1,148 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	// Written only by its owning thread, the write index is published with release so a dump sees whole events
+	struct ThreadBuffer
+	{
+		uint32_t ThreadID;
+		std::string Name;
+		std::unique_ptr<TraceEvent[]> Events{ new TraceEvent[TRACE_EVENTS_PER_THREAD] };
+		std::atomic<uint64_t> WriteIndex{ 0 };
+	};
+
+	// Buffers live until the program exits, so threads may end before the trace is written
+	std::mutex s_BuffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> s_Buffers;
+
+	thread_local ThreadBuffer* s_ThreadBuffer = nullptr;
+
+	// Calibration point for the tick to nanosecond conversion (second point taken when writing the trace)
+	const std::chrono::steady_clock::time_point s_StartTime = std::chrono::steady_clock::now();
+	const uint64_t s_StartTicks = Trace::Ticks();
+
+	// Registration takes the lock once per thread, every later event is lock free
+	ThreadBuffer* GetThreadBuffer()
+	{
+		if (s_ThreadBuffer == nullptr)
+		{
+			std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+
+			std::lock_guard<std::mutex> lock(s_BuffersMutex);
+			buffer->ThreadID = static_cast<uint32_t>(s_Buffers.size());
+			buffer->Name = "Thread " + std::to_string(buffer->ThreadID);
+			s_ThreadBuffer = buffer.get();
+			s_Buffers.push_back(std::move(buffer));
+		}
+		return s_ThreadBuffer;
+	}
+
+	// Names are string literals or __FUNCTION__, only quotes and backslashes need escaping
+	void WriteJsonString(std::ofstream& file, const char* text)
+	{
+		file << '"';
+		for (const char* c = text; *c != '\0'; c++)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				file << '\\';
+			}
+			file << *c;
+		}
+		file << '"';
+	}
+
+	// Nanoseconds as microseconds with 3 decimals (no floating point rounding)
+	void WriteMicroseconds(std::ofstream& file, uint64_t nanoseconds)
+	{
+		file << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000 << std::setfill(' ');
+	}
+}
+
+namespace Trace
+{
+#ifndef TRACE_HAS_TSC
+	uint64_t Ticks()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+#endif
+
+	void Record(const char* name, uint64_t startTicks, uint64_t endTicks)
+	{
+		ThreadBuffer* buffer = GetThreadBuffer();
+		uint64_t index = buffer->WriteIndex.load(std::memory_order_relaxed);
+
+		TraceEvent& event = buffer->Events[index & (TRACE_EVENTS_PER_THREAD - 1)];
+		event.Name = name;
+		event.StartTicks = startTicks;
+		event.EndTicks = endTicks;
+
+		buffer->WriteIndex.store(index + 1, std::memory_order_release);
+	}
+
+	void SetThreadName(const char* name)
+	{
+		ThreadBuffer* buffer = GetThreadBuffer();
+
+		std::lock_guard<std::mutex> lock(s_BuffersMutex);
+		buffer->Name = name;
+	}
+
+	bool WriteChromeTrace(const std::string& filepath)
+	{
+		std::ofstream file(filepath, std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		// Ticks per nanosecond over the whole run (exactly 1 without a TSC)
+		uint64_t elapsedNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - s_StartTime).count());
+		uint64_t elapsedTicks = Trace::Ticks() - s_StartTicks;
+		double nsPerTick = elapsedTicks > 0 ? static_cast<double>(elapsedNs) / static_cast<double>(elapsedTicks) : 1.0;
+		auto toNs = [nsPerTick](uint64_t ticks) { return static_cast<uint64_t>(static_cast<double>(ticks) * nsPerTick); };
+
+		std::lock_guard<std::mutex> lock(s_BuffersMutex);
+
+		// Complete ("X") events, timestamps in microseconds
+		file << "{\n\"displayTimeUnit\": \"ns\",\n\"traceEvents\": [\n";
+		bool first = true;
+		for (const std::unique_ptr<ThreadBuffer>& buffer : s_Buffers)
+		{
+			file << (first ? "" : ",\n") << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << buffer->ThreadID
+				<< ", \"args\": { \"name\": ";
+			WriteJsonString(file, buffer->Name.c_str());
+			file << " } }";
+			first = false;
+
+			uint64_t end = buffer->WriteIndex.load(std::memory_order_acquire);
+			uint64_t begin = end > TRACE_EVENTS_PER_THREAD ? end - TRACE_EVENTS_PER_THREAD : 0;
+			for (uint64_t i = begin; i < end; i++)
+			{
+				const TraceEvent& event = buffer->Events[i & (TRACE_EVENTS_PER_THREAD - 1)];
+				file << ",\n{ \"name\": ";
+				WriteJsonString(file, event.Name);
+				file << ", \"ph\": \"X\", \"pid\": 0, \"tid\": " << buffer->ThreadID << ", \"ts\": ";
+				WriteMicroseconds(file, toNs(event.StartTicks - s_StartTicks));
+				file << ", \"dur\": ";
+				WriteMicroseconds(file, toNs(event.EndTicks - event.StartTicks));
+				file << " }";
+			}
+		}
+		file << "\n]\n}\n";
+
+		file.close();
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRACE_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_HAS_TSC 1
+#endif
+
+// CPU trace zones. Compiled in only with ENABLE_TRACING (Debug and Benchmark configurations),
+// otherwise every macro expands to nothing.
+//
+//	TRACE_ZONE("Name");			// scope of the current block, name must outlive the program (string literal)
+//	TRACE_FUNCTION();			// same, named after the enclosing function
+//	TRACE_THREAD_NAME("Name");	// label of the calling thread in the trace
+//
+// Every thread writes into its own fixed size ring buffer (oldest events are overwritten), no locks
+// on the hot path. Zones store raw CPU ticks (rdtsc, a few ns to read), converted to nanoseconds
+// when Trace::WriteChromeTrace dumps the buffers as Chrome trace / Perfetto JSON.
+
+// Events kept per thread (power of 2)
+const uint32_t TRACE_EVENTS_PER_THREAD = 1 << 16;
+
+struct TraceEvent
+{
+	const char* Name;
+	uint64_t StartTicks;
+	uint64_t EndTicks;
+};
+
+namespace Trace
+{
+	// Invariant TSC where available, steady clock nanoseconds otherwise
+#ifdef TRACE_HAS_TSC
+	inline uint64_t Ticks() { return __rdtsc(); }
+#else
+	uint64_t Ticks();
+#endif
+
+	void Record(const char* name, uint64_t startTicks, uint64_t endTicks);
+	void SetThreadName(const char* name);
+
+	// Best called while the other threads are idle (events written during the dump may be torn)
+	bool WriteChromeTrace(const std::string& filepath);
+
+	constexpr bool IsEnabled()
+	{
+#ifdef ENABLE_TRACING
+		return true;
+#else
+		return false;
+#endif
+	}
+}
+
+class TraceZone
+{
+public:
+	explicit TraceZone(const char* name) : m_Name(name), m_StartTicks(Trace::Ticks()) {}
+	~TraceZone() { Trace::Record(m_Name, m_StartTicks, Trace::Ticks()); }
+
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+	const char* m_Name;
+	uint64_t m_StartTicks;
+};
+
+#ifdef ENABLE_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_FUNCTION() TRACE_ZONE(__FUNCTION__)
+#define TRACE_THREAD_NAME(name) Trace::SetThreadName(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_FUNCTION() ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,177 @@
+#include "TransformStore.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TRANSFORM_STORE_SSE 1
+#endif
+
+#include "JobSystem.h"
+#include "Trace.h"
+
+// Blocks of 4 entries composed by one job
+static const uint32_t BLOCKS_PER_JOB = 1024;
+
+uint32_t TransformStore::Add()
+{
+	uint32_t id = m_Count++;
+	if (id % 4 == 0)
+	{
+		// New block of identity transforms
+		uint32_t paddedCount = id + 4;
+		m_TranslationX.resize(paddedCount, 0.0f);
+		m_TranslationY.resize(paddedCount, 0.0f);
+		m_TranslationZ.resize(paddedCount, 0.0f);
+		m_RotationX.resize(paddedCount, 0.0f);
+		m_RotationY.resize(paddedCount, 0.0f);
+		m_RotationZ.resize(paddedCount, 0.0f);
+		m_RotationW.resize(paddedCount, 1.0f);
+		m_ScaleX.resize(paddedCount, 1.0f);
+		m_ScaleY.resize(paddedCount, 1.0f);
+		m_ScaleZ.resize(paddedCount, 1.0f);
+		m_Matrices.resize(paddedCount, glm::mat4(1.0f));
+		m_Dirty.resize(paddedCount, 0);
+	}
+
+	return id;
+}
+
+void TransformStore::Set(const uint32_t* ids, const ModelTransform* transforms, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t id = ids[i];
+		const ModelTransform& transform = transforms[i];
+		m_TranslationX[id] = transform.Translation.x;
+		m_TranslationY[id] = transform.Translation.y;
+		m_TranslationZ[id] = transform.Translation.z;
+		m_RotationX[id] = transform.Rotation.x;
+		m_RotationY[id] = transform.Rotation.y;
+		m_RotationZ[id] = transform.Rotation.z;
+		m_RotationW[id] = transform.Rotation.w;
+		m_ScaleX[id] = transform.Scale.x;
+		m_ScaleY[id] = transform.Scale.y;
+		m_ScaleZ[id] = transform.Scale.z;
+		m_Dirty[id] = 1;
+	}
+}
+
+ModelTransform TransformStore::Get(uint32_t id) const
+{
+	ModelTransform transform;
+	transform.Translation = glm::vec3(m_TranslationX[id], m_TranslationY[id], m_TranslationZ[id]);
+	transform.Rotation = glm::quat(m_RotationW[id], m_RotationX[id], m_RotationY[id], m_RotationZ[id]);
+	transform.Scale = glm::vec3(m_ScaleX[id], m_ScaleY[id], m_ScaleZ[id]);
+	return transform;
+}
+
+void TransformStore::Compose(JobSystem& jobSystem)
+{
+	TRACE_FUNCTION();
+
+	uint32_t blockCount = (m_Count + 3) / 4;
+	if (blockCount <= BLOCKS_PER_JOB)
+	{
+		ComposeBlocks(0, blockCount);
+	}
+	else
+	{
+		JobCounter counter;
+		jobSystem.ParallelFor(blockCount, BLOCKS_PER_JOB, [this](uint32_t begin, uint32_t end) { ComposeBlocks(begin, end); }, &counter);
+		jobSystem.Wait(counter);
+	}
+
+	m_Composed.clear();
+	for (uint32_t id = 0; id < m_Count; id++)
+	{
+		if (m_Dirty[id])
+		{
+			m_Dirty[id] = 0;
+			m_Composed.push_back(id);
+		}
+	}
+}
+
+void TransformStore::ComposeBlocks(uint32_t firstBlock, uint32_t endBlock)
+{
+	for (uint32_t block = firstBlock; block < endBlock; block++)
+	{
+		uint32_t first = block * 4;
+		uint32_t dirty;
+		memcpy(&dirty, &m_Dirty[first], sizeof(dirty));
+		if (dirty == 0)
+		{
+			continue;
+		}
+
+#ifdef TRANSFORM_STORE_SSE
+		// Every register holds one matrix element of the 4 entries, transposed into columns at the end
+		__m128 x = _mm_loadu_ps(&m_RotationX[first]);
+		__m128 y = _mm_loadu_ps(&m_RotationY[first]);
+		__m128 z = _mm_loadu_ps(&m_RotationZ[first]);
+		__m128 w = _mm_loadu_ps(&m_RotationW[first]);
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 two = _mm_set1_ps(2.0f);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		__m128 scaleX = _mm_loadu_ps(&m_ScaleX[first]);
+		__m128 scaleY = _mm_loadu_ps(&m_ScaleY[first]);
+		__m128 scaleZ = _mm_loadu_ps(&m_ScaleZ[first]);
+
+		__m128 c0r0 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX);
+		__m128 c0r1 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX);
+		__m128 c0r2 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX);
+		__m128 c0r3 = _mm_setzero_ps();
+
+		__m128 c1r0 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY);
+		__m128 c1r1 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY);
+		__m128 c1r2 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY);
+		__m128 c1r3 = _mm_setzero_ps();
+
+		__m128 c2r0 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ);
+		__m128 c2r1 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ);
+		__m128 c2r2 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ);
+		__m128 c2r3 = _mm_setzero_ps();
+
+		__m128 c3r0 = _mm_loadu_ps(&m_TranslationX[first]);
+		__m128 c3r1 = _mm_loadu_ps(&m_TranslationY[first]);
+		__m128 c3r2 = _mm_loadu_ps(&m_TranslationZ[first]);
+		__m128 c3r3 = one;
+
+		_MM_TRANSPOSE4_PS(c0r0, c0r1, c0r2, c0r3);
+		_MM_TRANSPOSE4_PS(c1r0, c1r1, c1r2, c1r3);
+		_MM_TRANSPOSE4_PS(c2r0, c2r1, c2r2, c2r3);
+		_MM_TRANSPOSE4_PS(c3r0, c3r1, c3r2, c3r3);
+
+		// After the transposes register n of a column holds that column of entry n
+		__m128 columns[4][4] = {
+			{ c0r0, c1r0, c2r0, c3r0 },
+			{ c0r1, c1r1, c2r1, c3r1 },
+			{ c0r2, c1r2, c2r2, c3r2 },
+			{ c0r3, c1r3, c2r3, c3r3 } };
+		for (uint32_t entry = 0; entry < 4; entry++)
+		{
+			float* matrix = &m_Matrices[first + entry][0][0];
+			for (uint32_t column = 0; column < 4; column++)
+			{
+				_mm_storeu_ps(matrix + column * 4, columns[entry][column]);
+			}
+		}
+#else
+		for (uint32_t id = first; id < first + 4; id++)
+		{
+			glm::quat rotation(m_RotationW[id], m_RotationX[id], m_RotationY[id], m_RotationZ[id]);
+			glm::mat4 matrix = glm::mat4_cast(rotation);
+			matrix[0] *= m_ScaleX[id];
+			matrix[1] *= m_ScaleY[id];
+			matrix[2] *= m_ScaleZ[id];
+			matrix[3] = glm::vec4(m_TranslationX[id], m_TranslationY[id], m_TranslationZ[id], 1.0f);
+			m_Matrices[id] = matrix;
+		}
+#endif
+	}
+}
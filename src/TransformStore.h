@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+#include <cstdint>
+
+class JobSystem;
+
+// Translation, rotation and scale, composed as T * R * S
+struct ModelTransform
+{
+	glm::vec3 Translation = glm::vec3(0.0f);
+	glm::quat Rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 Scale = glm::vec3(1.0f);
+};
+
+// Transforms as structure of arrays (one float array per component), so Compose builds the matrices of 4 entries at
+// a time with SSE. Set only flags entries, Compose turns the flagged ones into matrices (blocks of 4 entries split
+// over jobs) and lists them for the caller.
+class TransformStore
+{
+public:
+	TransformStore() = default;
+
+	// New entries hold the identity and are not composed until they are Set
+	uint32_t Add();
+	uint32_t GetCount() const { return m_Count; }
+
+	void Set(const uint32_t* ids, const ModelTransform* transforms, uint32_t count);
+	ModelTransform Get(uint32_t id) const;
+
+	void Compose(JobSystem& jobSystem);
+	// Entries composed by the last Compose
+	const std::vector<uint32_t>& GetComposed() const { return m_Composed; }
+	const glm::mat4& GetMatrix(uint32_t id) const { return m_Matrices[id]; }
+
+private:
+	void ComposeBlocks(uint32_t firstBlock, uint32_t endBlock);
+
+private:
+	uint32_t m_Count = 0;
+
+	// Padded to a multiple of 4 with identity transforms
+	std::vector<float> m_TranslationX, m_TranslationY, m_TranslationZ;
+	std::vector<float> m_RotationX, m_RotationY, m_RotationZ, m_RotationW;
+	std::vector<float> m_ScaleX, m_ScaleY, m_ScaleZ;
+	std::vector<glm::mat4> m_Matrices;
+	std::vector<uint8_t> m_Dirty;
+
+	std::vector<uint32_t> m_Composed;
+};
@@ -7,8 +7,36 @@
 
 #include <glm/glm.hpp>
 
-const int MAX_FRAME_DRAWS = 2;
+// Default number of frames the CPU may record ahead of the GPU (RendererSettings::FramesInFlight)
+const int DEFAULT_FRAMES_IN_FLIGHT = 2;
 const int MAX_OBJECTS = 20;
+// Size of the bindless texture table (clamped to the device limit at startup)
+const int MAX_TEXTURES = 1024;
+// Workgroup size of the composite compute shader (local_size_x/y of composite.comp)
+const uint32_t COMPOSITE_GROUP_SIZE = 8;
+// Clustered lighting: froxel grid (screen tiles x depth slices) and buffer capacities per frame
+const uint32_t CLUSTER_GRID_X = 16;
+const uint32_t CLUSTER_GRID_Y = 9;
+const uint32_t CLUSTER_GRID_Z = 24;
+const uint32_t MAX_LIGHTS = 4096;
+const uint32_t MAX_CLUSTER_LIGHT_INDICES = 256 * 1024;
+// Occlusion culling: pixels per side of a texel of the depth pyramid's finest level (local_size of hiz.comp is 8x8)
+const uint32_t HIZ_TILE_SIZE = 16;
+// Software occlusion: depth buffer size (width a multiple of 8 for the AVX2 rows), meshes small enough to keep a CPU
+// copy for rasterizing, occluder triangles rasterized per frame and the screen fraction that makes a mesh an occluder
+const uint32_t SOFTWARE_OCCLUSION_WIDTH = 320;
+const uint32_t SOFTWARE_OCCLUSION_HEIGHT = 192;
+const uint32_t SOFTWARE_OCCLUDER_MAX_MESH_TRIANGLES = 16 * 1024;
+const uint32_t SOFTWARE_OCCLUDER_TRIANGLE_BUDGET = 64 * 1024;
+const float SOFTWARE_OCCLUDER_MIN_SCREEN_AREA = 0.05f;
+// Skinning: joints per vertex, skin matrices of all skinned models per frame, skinned mesh parts and the
+// workgroup size of skinning.comp (local_size_x)
+const uint32_t MAX_BONE_INFLUENCES = 4;
+const uint32_t MAX_SKIN_JOINTS = 4096;
+const uint32_t MAX_SKINNED_MESHES = 64;
+const uint32_t SKINNING_GROUP_SIZE = 64;
+// OBJ import: bytes of the file parsed per job (split at line ends)
+const size_t OBJ_PARSE_CHUNK_SIZE = 1024 * 1024;
 
 static const std::vector<const char*> s_DeviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
@@ -20,14 +48,23 @@ struct Vertex
 	glm::vec3 Position;
 	glm::vec3 Color;
 	glm::vec2 TextureCoords; // (u,v)
+	glm::vec3 Normal;
 
 };
 
+// Joints and weights of a skinned vertex (std430, matches skinning.comp)
+struct SkinVertex
+{
+	glm::uvec4 Joints;
+	glm::vec4 Weights;
+};
+
 // Indices (locations) of queue families (if they exist at all)
 struct QueueFamilyIndices
 {
 	int GraphicsFamily = -1; // location of graphics queue family
 	int PresentationFamily = -1; // location of presentation queue family
+	int ComputeFamily = -1; // async compute queue family (the graphics family when there is no separate one)
 
 	bool IsValid()
 	{
@@ -48,6 +85,74 @@ struct SwapChainImage
 	VkImageView ImageView;
 };
 
+// Everything a single frame in flight records and writes into, independent of the swapchain image it renders to
+struct FrameContext
+{
+	VkCommandPool CommandPool;
+	VkCommandBuffer CommandBuffer;
+
+	// Async compute only: composite on the compute queue, then upscale and present back on the graphics queue
+	VkCommandPool ComputeCommandPool = VK_NULL_HANDLE;
+	VkCommandBuffer ComputeCommandBuffer = VK_NULL_HANDLE;
+	VkCommandBuffer PresentCommandBuffer = VK_NULL_HANDLE;		// allocated from CommandPool
+
+	// Uniform data (view-projection and dynamic model buffer) and the set 0 descriptor pointing at it
+	VkBuffer UniformBuffer;
+	VkDeviceMemory UniformBufferMemory;
+	VkBuffer UniformDynamicBuffer;
+	VkDeviceMemory UniformDynamicBufferMemory;
+	// Clustered lighting: header + visible lights, cluster ranges and the light index list (storage buffers)
+	VkBuffer LightBuffer;
+	VkDeviceMemory LightBufferMemory;
+	VkBuffer ClusterBuffer;
+	VkDeviceMemory ClusterBufferMemory;
+	VkBuffer LightIndexBuffer;
+	VkDeviceMemory LightIndexBufferMemory;
+	VkDescriptorSet DescriptorSet;
+
+	// Max depth of HIZ_TILE_SIZE tiles of the frame's depth buffer, read back for occlusion culling of later frames
+	VkBuffer HiZBuffer;
+	VkDeviceMemory HiZBufferMemory;
+	VkExtent2D HiZExtent = { 0, 0 };		// render extent the tiles cover (0 = none written), changes with the dynamic resolution
+	glm::mat4 HiZViewProjection = glm::mat4(1.0f);
+
+	// Skin matrices of every skinned model (storage buffer read by the skinning dispatches)
+	VkBuffer JointBuffer;
+	VkDeviceMemory JointBufferMemory;
+
+	// Synchronization (binary semaphores only order the swapchain acquire and present)
+	VkSemaphore ImageAvailable;
+	VkSemaphore RenderFinished;
+	VkSemaphore GeometryFinished = VK_NULL_HANDLE;	// async compute only, the composite waits on it
+	uint64_t TimelineValue = 0;		// last frame recorded with this context, its resources are free once the graphics timeline reaches it
+};
+
+// Push constants of the composite (compute) and upscale passes
+struct PushComposite
+{
+	uint32_t RenderWidth;
+	uint32_t RenderHeight;
+};
+
+struct PushUpscale
+{
+	glm::vec2 UvScale;			// rendered size / scene texture size
+	glm::vec2 TextureSize;		// scene texture size in pixels
+};
+
+// Deferred lighting subpass: view space position from the depth buffer
+struct PushLighting
+{
+	glm::mat4 InverseProjection;
+};
+
+// Skinning dispatch of one mesh part: its vertices and where its model's skin matrices start in the joint buffer
+struct PushSkinning
+{
+	uint32_t VertexCount;
+	uint32_t JointOffset;
+};
+
 
 static std::vector<char> readSPVFile(const std::string& filename)
 {
@@ -132,6 +237,23 @@ static void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDev
 	vkBindBufferMemory(device, *buffer, *bufferMemory, 0);
 }
 
+// GPU time of the one-off command buffers below, measured while the GPU profiler has set a query pool (2 timestamps)
+struct UploadTimer
+{
+	VkQueryPool QueryPool = VK_NULL_HANDLE;
+	double TimestampPeriod = 1.0;		// nanoseconds per tick
+	uint64_t TimestampMask = ~0ull;
+	double TotalMs = 0.0;
+	uint32_t Submits = 0;
+};
+
+// Shared by every translation unit (the helpers below are static)
+inline UploadTimer& GetUploadTimer()
+{
+	static UploadTimer timer;
+	return timer;
+}
+
 static VkCommandBuffer BeginCommandBuffer(VkDevice device, VkCommandPool commandPool)
 {
 	// Command buffer to hold transfer commands
@@ -156,11 +278,24 @@ static VkCommandBuffer BeginCommandBuffer(VkDevice device, VkCommandPool command
 	// Begin recording transfer commands
 	vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo);
 
+	UploadTimer& uploadTimer = GetUploadTimer();
+	if (uploadTimer.QueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, uploadTimer.QueryPool, 0, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, uploadTimer.QueryPool, 0);
+	}
+
 	return commandBuffer;
 }
 
 static void FinishAndSubmitCommandBuffer(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer)
 {
+	UploadTimer& uploadTimer = GetUploadTimer();
+	if (uploadTimer.QueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, uploadTimer.QueryPool, 1);
+	}
+
 	// End command
 	vkEndCommandBuffer(commandBuffer);
 
@@ -175,6 +310,19 @@ static void FinishAndSubmitCommandBuffer(VkDevice device, VkCommandPool commandP
 	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
 	vkQueueWaitIdle(queue);
 
+	// Queue is idle, the timestamps are available
+	if (uploadTimer.QueryPool != VK_NULL_HANDLE)
+	{
+		uint64_t timestamps[2] = {};
+		if (vkGetQueryPoolResults(device, uploadTimer.QueryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			uint64_t ticks = (timestamps[1] - timestamps[0]) & uploadTimer.TimestampMask;
+			uploadTimer.TotalMs += static_cast<double>(ticks) * uploadTimer.TimestampPeriod / 1000000.0;
+			uploadTimer.Submits++;
+		}
+	}
+
 	// Free temporary command buffer back to pool
 	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 
@@ -1,28 +1,53 @@
 #include "VulkanRenderer.h"
 
 #include <cstring>
+#include <cstdio>
+#include <cfloat>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
 
 static const std::vector<const char*> s_ValidationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
 
-int VulkanRenderer::Init(GLFWwindow* window)
+// Pipeline cache blob, kept next to the executable's working directory between runs
+static const std::string s_PipelineCacheFile = "pipeline_cache.bin";
+
+int VulkanRenderer::Init(GLFWwindow* window, const RendererSettings& settings)
 {
 	m_Window = window;
+	m_Settings = settings;
+	m_Settings.FramesInFlight = std::max(m_Settings.FramesInFlight, 1u);
+	m_Settings.HeadlessImageCount = std::max(m_Settings.HeadlessImageCount, 1u);
 
 	try
 	{
+		m_JobSystem.Init();
+
 		CreateInstance();
-		CreateSurface();
+		if (!m_Settings.Headless)
+		{
+			CreateSurface();
+		}
 		GetPhysicalDevice();
 		CreateLogicalDevice();		
-		CreateSwapChain();
-		CreateRenderPass();
+		CreatePipelineCache();
+		if (m_Settings.Headless)
+		{
+			CreateOffscreenImages();
+		}
+		else
+		{
+			CreateSwapChain();
+		}
+		BuildRenderGraph();
 		CreateDescriptorSetLayout();
 		CreateGraphicsPipeline();
-		CreateDepthBufferImage();
-		CreateColorBufferImage();
-		CreateFramebuffers();
 		CreateCommandPool();
 		CreateCommandBuffers();
 		CreateTextureSampler();
@@ -30,14 +55,26 @@ int VulkanRenderer::Init(GLFWwindow* window)
 		CreateUniformBuffers();
 		CreateDescriptorPool();
 		CreateDescriptorSets();
-		CreateInputDescriptorSets();
+		CreateCompositeDescriptorSets();
+		CreateUpscaleDescriptorSets();
+		CreateGBufferDescriptorSets();
 		CreateSynchronization();
 
+		// Frame timestamps drive the dynamic resolution, without them the scene stays at full resolution
+		QueueFamilyIndices indices = GetQueueFamilies(m_MainDevice.PhysicalDevice);
+		m_GpuProfiler.Init(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, indices.GraphicsFamily,
+			m_Settings.FramesInFlight, m_PipelineStatisticsSupported);
+
+		// Start at full resolution, the scale follows the GPU frame time from the first measured frame on
+		float maxScale = m_Settings.DynamicResolution ? m_Settings.MaxRenderScale : 1.0f;
+		float minScale = m_Settings.DynamicResolution ? m_Settings.MinRenderScale : maxScale;
+		m_DynamicResolution.Init(m_Settings.GpuFrameBudgetMs, minScale, maxScale);
+
 		 //int firstTexture = CreateTexture("src/Textures/bird_painting.jpg");
 
 		// Set mvp
 		m_Camera.Projection = glm::perspective(glm::radians(45.0f),
-			(float)m_SwapchainExtent.width / (float)m_SwapchainExtent.height, 0.1f, 100.0f);
+			(float)m_SwapchainExtent.width / (float)m_SwapchainExtent.height, m_CameraNearPlane, m_CameraFarPlane);
 		m_Camera.View = glm::lookAt(glm::vec3(1.0f, 1.0f, 10.0f), glm::vec3(0.0f, 1.0f, -1.0f),
 			glm::vec3(0.0f, 1.0f, 0.0f));
 
@@ -47,17 +84,17 @@ int VulkanRenderer::Init(GLFWwindow* window)
 		// Create mesh object
 		// vertex data
 		std::vector<Vertex> meshVertices2 = {
-			{{-0.1, -0.1, 0.0}, {0.0, 1.0, 0.0}, {1.0f, 1.0f}},
-			{{0.1, -0.1, 0.0},  {0.0, 1.0, 0.0}, {1.0f, 0.0f} },
-			{{0.1, 0.1, 0.0}, {0.0, 1.0, .5},    {0.0f, 0.0f}},
-			{{-0.1, 0.1, 0.0}, {0.0, 1.0, 0.35}, {0.0f, 1.0f}}
+			{{-0.1, -0.1, 0.0}, {0.0, 1.0, 0.0}, {1.0f, 1.0f}, {0.0f, 0.0f, 0.0f}},
+			{{0.1, -0.1, 0.0},  {0.0, 1.0, 0.0}, {1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}},
+			{{0.1, 0.1, 0.0}, {0.0, 1.0, .5},    {0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}},
+			{{-0.1, 0.1, 0.0}, {0.0, 1.0, 0.35}, {0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}}
 		};
 
 		std::vector<Vertex> meshVertices = {
-			{{-0.2, -0.2, 1.0}, {1.0, 0.0, 0.0}, {1.0f, 1.0f}},
-			{{0.2, -0.2, 1.0},  {1.0, 0.0, 0.0}, {1.0f, 0.0f}},
-			{{0.2, 0.2, 1.0}, {1.0, 0.0, 1.0}, {0.0f, 0.0f}},
-			{{-0.2, 0.2, 1.0}, {0.5, 0.5, 0.35}, {0.0f, 1.0f}}
+			{{-0.2, -0.2, 1.0}, {1.0, 0.0, 0.0}, {1.0f, 1.0f}, {0.0f, 0.0f, 0.0f}},
+			{{0.2, -0.2, 1.0},  {1.0, 0.0, 0.0}, {1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}},
+			{{0.2, 0.2, 1.0}, {1.0, 0.0, 1.0}, {0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}},
+			{{-0.2, 0.2, 1.0}, {0.5, 0.5, 0.35}, {0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}}
 		};
 
 		/*std::vector<Vertex> meshVertices2 = {
@@ -80,10 +117,22 @@ int VulkanRenderer::Init(GLFWwindow* window)
 			CreateTexture("src/Textures/bird_painting.jpg")));*/
 
 		
-		CreateMeshModel("src/Models/Sora/Sora.obj");
-		// CreateMeshModel("C:/Users/engen/Pictures/desert_model/untitled.obj");
-		CreateMeshModel("src/Models/Cactuar/cactuar.obj");
-		CreateMeshModel("src/Models/Sora/Sora.obj");
+		// Model files are parsed in parallel, their buffers and textures are then created in order on this thread
+		std::vector<ModelImport> modelImports(m_Settings.Models.size());
+		JobCounter importCounter;
+		m_JobSystem.ParallelFor(static_cast<uint32_t>(modelImports.size()), 1, [this, &modelImports](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				modelImports[i] = ImportModel(m_Settings.Models[i], m_JobSystem);
+			}
+		}, &importCounter);
+		m_JobSystem.Wait(importCounter);
+
+		for (size_t i = 0; i < modelImports.size(); i++)
+		{
+			CreateMeshModel(m_Settings.Models[i], modelImports[i]);
+		}
 		
 	}
 	catch (const std::runtime_error& e)
@@ -97,75 +146,362 @@ int VulkanRenderer::Init(GLFWwindow* window)
 
 void VulkanRenderer::UpdateModel(uint32_t meshObjectIndex, glm::mat4& newModel)
 {
-	m_ModelList[meshObjectIndex].SetModel(newModel);
+	m_SceneGraph.SetLocalTransform(m_ModelList[meshObjectIndex].GetSceneNode(), newModel);
+}
+
+void VulkanRenderer::UpdateModels(const uint32_t* meshObjectIndices, const ModelTransform* transforms, uint32_t count)
+{
+	m_ModelTransforms.Set(meshObjectIndices, transforms, count);
+}
+
+void VulkanRenderer::SetOccluder(uint32_t meshObjectIndex, bool occluder)
+{
+	m_ModelList[meshObjectIndex].SetOccluder(occluder);
+}
+
+void VulkanRenderer::SetAnimation(uint32_t meshObjectIndex, const AnimationState& animationState)
+{
+	m_ModelList[meshObjectIndex].SetAnimationState(animationState);
+}
+
+uint32_t VulkanRenderer::AddLight(const PointLight& light)
+{
+	if (m_Lights.size() >= MAX_LIGHTS)
+	{
+		throw std::runtime_error("Too many lights!");
+	}
+
+	m_Lights.push_back(light);
+	return static_cast<uint32_t>(m_Lights.size() - 1);
+}
+
+void VulkanRenderer::UpdateLight(uint32_t lightIndex, const PointLight& light)
+{
+	m_Lights[lightIndex] = light;
 }
 
 void VulkanRenderer::Draw()
 {
-	// 1. Get next available image to draw to and set something to signal when we're finished
-	// with the image (a semaphore)
-	
-	// Wait for given fence to signal (open) from last draw before continuing
-	vkWaitForFences(m_MainDevice.LogicalDevice, 1, &m_DrawFences[m_CurrentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-	// Manually reset (close) fences
-	vkResetFences(m_MainDevice.LogicalDevice, 1, &m_DrawFences[m_CurrentFrame]);
+	TRACE_FUNCTION();
+
+	FrameContext& frame = m_Frames[m_CurrentFrame];
+	auto prepareStart = std::chrono::high_resolution_clock::now();
+	double cpuFrameMs = m_HasDrawn ? std::chrono::duration<double, std::milli>(prepareStart - m_LastDrawStart).count() : 0.0;
+	m_LastDrawStart = prepareStart;
+	m_HasDrawn = true;
+
+	// CPU work that touches no frame resource first (draw list, model transforms), it overlaps the frames in flight
+	PrepareFrame();
+
+	// A single frame in flight: the deferred present of the last frame completes this frame context, submit it first
+	if (m_PendingPresent.Valid && m_PendingPresent.FrameIndex == m_CurrentFrame)
+	{
+		SubmitPendingPresent();
+	}
+
+	// 1. Wait until the GPU is done with the last frame recorded with this context (command buffers, uniform buffers)
+	auto waitStart = std::chrono::high_resolution_clock::now();
+	{
+		TRACE_ZONE("WaitFrameTimeline");
+		WaitForGraphicsTimeline(frame.TimelineValue);
+	}
+
+	auto frameWaitEnd = std::chrono::high_resolution_clock::now();
+
+	// Frames complete in order, so everything deferred up to that frame can go
+	FlushDeferredDestroys(false);
+
+	// Last GPU time of this frame context picks the scene resolution of the frame recorded below
+	ReadGpuFrameTime();
+	auto acquireStart = std::chrono::high_resolution_clock::now();
 
-	// -- Get next image
+	// -- Get next image (signals a semaphore once it can be rendered to)
 	uint32_t imageIndex;
-	vkAcquireNextImageKHR(m_MainDevice.LogicalDevice, m_Swapchain, std::numeric_limits<uint64_t>::max(), m_SemaphoresImageAvailable[m_CurrentFrame],
-		VK_NULL_HANDLE, &imageIndex);
+	if (m_Settings.Headless)
+	{
+		// Offscreen images are simply cycled, nothing to acquire
+		imageIndex = m_NextOffscreenImage;
+		m_NextOffscreenImage = (m_NextOffscreenImage + 1) % static_cast<uint32_t>(m_SwapChainImages.size());
+	}
+	else
+	{
+		TRACE_ZONE("AcquireNextImage");
+		vkAcquireNextImageKHR(m_MainDevice.LogicalDevice, m_Swapchain, std::numeric_limits<uint64_t>::max(), frame.ImageAvailable,
+			VK_NULL_HANDLE, &imageIndex);
+	}
+
+	auto recordStart = std::chrono::high_resolution_clock::now();
 
-	// rec
-	RecordCommands(imageIndex);
+	m_FrameNumber++;
+	frame.TimelineValue = m_FrameNumber;
+
+	// rec (whole pools are reset, the frame's command buffers are re-recorded every frame)
+	vkResetCommandPool(m_MainDevice.LogicalDevice, frame.CommandPool, 0);
+	if (m_AsyncCompute)
+	{
+		vkResetCommandPool(m_MainDevice.LogicalDevice, frame.ComputeCommandPool, 0);
+	}
+	RecordCommands(frame, imageIndex);
 
-	UpdateUniformBuffers(imageIndex);
+	UpdateUniformBuffers(frame);
+	auto submitStart = std::chrono::high_resolution_clock::now();
 
 	// 2. Submit command buffer to queue for execution, make sure it watis for the image to be 
 	// signalled as available before drawing and signals when it has finished rendering
-	// -- Submit command buffer to render
-	// Queue submission info
+	if (m_AsyncCompute)
+	{
+		// Geometry, then the composite on the compute queue once the geometry is done
+		VkSubmitInfo geometrySubmitInfo = {};
+		geometrySubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		geometrySubmitInfo.commandBufferCount = 1;
+		geometrySubmitInfo.pCommandBuffers = &frame.CommandBuffer;
+		geometrySubmitInfo.signalSemaphoreCount = 1;
+		geometrySubmitInfo.pSignalSemaphores = &frame.GeometryFinished;
+
+		VkTimelineSemaphoreSubmitInfo computeTimelineInfo = {};
+		computeTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		computeTimelineInfo.signalSemaphoreValueCount = 1;
+		computeTimelineInfo.pSignalSemaphoreValues = &m_FrameNumber;
+
+		VkPipelineStageFlags computeWaitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		VkSubmitInfo computeSubmitInfo = {};
+		computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		computeSubmitInfo.pNext = &computeTimelineInfo;
+		computeSubmitInfo.waitSemaphoreCount = 1;
+		computeSubmitInfo.pWaitSemaphores = &frame.GeometryFinished;
+		computeSubmitInfo.pWaitDstStageMask = &computeWaitStage;
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &frame.ComputeCommandBuffer;
+		computeSubmitInfo.signalSemaphoreCount = 1;
+		computeSubmitInfo.pSignalSemaphores = &m_ComputeTimeline;
+
+		VkResult result;
+		{
+			TRACE_ZONE("QueueSubmit");
+			result = vkQueueSubmit(m_GraphicsQueue, 1, &geometrySubmitInfo, VK_NULL_HANDLE);
+			if (result == VK_SUCCESS)
+			{
+				result = vkQueueSubmit(m_ComputeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE);
+			}
+		}
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to command buffer to queue!");
+		}
+
+		// The last frame's upscale waits on its composite: queued behind this frame's geometry it no longer stalls the
+		// graphics queue, the composite runs next to the geometry instead (the frame is presented one Draw later)
+		SubmitPendingPresent();
+
+		m_PendingPresent.Valid = true;
+		m_PendingPresent.FrameIndex = m_CurrentFrame;
+		m_PendingPresent.ImageIndex = imageIndex;
+		m_PendingPresent.FrameNumber = m_FrameNumber;
+	}
+	else
+	{
+		// -- Submit command buffer to render
+		// Headless frames have no acquire to wait on and no present to signal, only the timeline (binary values are ignored)
+		std::array<VkSemaphore, 2> signalSemaphores = { m_GraphicsTimeline, frame.RenderFinished };
+		std::array<uint64_t, 2> signalValues = { m_FrameNumber, 0 };
+		uint32_t semaphoreCount = m_Settings.Headless ? 0 : 1;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1 + semaphoreCount;
+		timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+		// Queue submission info
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = semaphoreCount;				// number of semaphores to wait on
+		submitInfo.pWaitSemaphores = &frame.ImageAvailable;
+		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		submitInfo.pWaitDstStageMask = waitStages;  // Stages to check semaphores at
+		submitInfo.commandBufferCount = 1;			// number of command buffer to submit
+		submitInfo.pCommandBuffers = &frame.CommandBuffer;
+		submitInfo.signalSemaphoreCount = 1 + semaphoreCount;		// number of semaphores to signal
+		submitInfo.pSignalSemaphores = signalSemaphores.data();		// Semaphores to signal when command buffer finishes
+
+		// Submit command buffer to queue
+		VkResult result;
+		{
+			TRACE_ZONE("QueueSubmit");
+			result = vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		}
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to command buffer to queue!");
+		}
+
+		// 3. Present image to screen when it has signalled finished rendering
+		Present(frame, imageIndex);
+	}
+
+	auto submitEnd = std::chrono::high_resolution_clock::now();
+	m_FrameTimings.PrepareMs = std::chrono::duration<double, std::milli>(waitStart - prepareStart).count();
+	m_FrameTimings.WaitMs = std::chrono::duration<double, std::milli>(recordStart - waitStart).count();
+	m_FrameTimings.FrameWaitMs = std::chrono::duration<double, std::milli>(frameWaitEnd - waitStart).count();
+	m_FrameTimings.AcquireWaitMs = std::chrono::duration<double, std::milli>(recordStart - acquireStart).count();
+	m_FrameTimings.RecordMs = std::chrono::duration<double, std::milli>(submitStart - recordStart).count();
+	m_FrameTimings.SubmitMs = std::chrono::duration<double, std::milli>(submitEnd - submitStart).count();
+
+	FrameSample sample;
+	sample[FrameMetric::CpuFrameMs] = cpuFrameMs;
+	sample[FrameMetric::FrameWaitMs] = m_FrameTimings.FrameWaitMs;
+	sample[FrameMetric::AcquireWaitMs] = m_FrameTimings.AcquireWaitMs;
+	sample[FrameMetric::GpuFrameMs] = m_GpuProfiler.GetLastFrameStats().FrameMs;
+	sample[FrameMetric::DrawCalls] = m_RenderStats.DrawCalls;
+	sample[FrameMetric::OccludedDraws] = m_OcclusionCulling.GetStats().Occluded + m_SoftwareOcclusion.GetStats().Occluded;
+	sample[FrameMetric::Binds] = m_RenderStats.BindsIssued();
+	sample[FrameMetric::Triangles] = static_cast<double>(m_RenderStats.Triangles);
+	sample[FrameMetric::BytesUploaded] = static_cast<double>(m_FrameBytesUploaded);
+	m_FrameStats.Push(sample);
+
+	// Next frame context
+	m_CurrentFrame = (m_CurrentFrame + 1) % m_Settings.FramesInFlight;
+}
+
+void VulkanRenderer::SubmitPendingPresent(bool present)
+{
+	if (!m_PendingPresent.Valid)
+	{
+		return;
+	}
+	m_PendingPresent.Valid = false;
+
+	FrameContext& frame = m_Frames[m_PendingPresent.FrameIndex];
+
+	// Wait for the frame's composite (timeline) and, with a window, for its swapchain image (binary, value ignored)
+	std::array<VkSemaphore, 2> waitSemaphores = { m_ComputeTimeline, frame.ImageAvailable };
+	std::array<uint64_t, 2> waitValues = { m_PendingPresent.FrameNumber, 0 };
+	std::array<VkPipelineStageFlags, 2> waitStages = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	uint32_t waitCount = m_Settings.Headless ? 1 : 2;
+
+	// Last submit of the frame: completes it on the graphics timeline and, with a window, signals the present
+	std::array<VkSemaphore, 2> signalSemaphores = { m_GraphicsTimeline, frame.RenderFinished };
+	std::array<uint64_t, 2> signalValues = { m_PendingPresent.FrameNumber, 0 };
+	uint32_t signalCount = m_Settings.Headless || !present ? 1 : 2;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = waitCount;
+	timelineInfo.pWaitSemaphoreValues = waitValues.data();
+	timelineInfo.signalSemaphoreValueCount = signalCount;
+	timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;				// number of semaphores to wait on
-	submitInfo.pWaitSemaphores = &m_SemaphoresImageAvailable[m_CurrentFrame];
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.pWaitDstStageMask = waitStages;  // Stages to check semaphores at
-	submitInfo.commandBufferCount = 1;			// number of command buffer to submit
-	submitInfo.pCommandBuffers = &m_CommandBuffers[imageIndex];
-	submitInfo.signalSemaphoreCount = 1;		// number of semaphores to signal
-	submitInfo.pSignalSemaphores = &m_SemaphoresRenderFinished[m_CurrentFrame];		// Semaphores to signal when command buffer finishes
-
-	// Submit command buffer to queue
-	VkResult result = vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, m_DrawFences[m_CurrentFrame]);
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = waitCount;
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frame.PresentCommandBuffer;
+	submitInfo.signalSemaphoreCount = signalCount;
+	submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+	VkResult result;
+	{
+		TRACE_ZONE("QueueSubmit");
+		result = vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to command buffer to queue!");
+		throw std::runtime_error("Failed to submit present command buffer to queue!");
+	}
+
+	if (present)
+	{
+		Present(frame, m_PendingPresent.ImageIndex);
+	}
+	else
+	{
+		m_LastImageIndex = m_PendingPresent.ImageIndex;
+	}
+}
+
+void VulkanRenderer::Present(FrameContext& frame, uint32_t imageIndex)
+{
+	m_LastImageIndex = imageIndex;
+
+	// Nothing to present headless
+	if (m_Settings.Headless)
+	{
+		return;
 	}
 
-	// 3. Present image to screen when it has signalled finished rendering
+	TRACE_ZONE("QueuePresent");
+
 	// Present rendered image to screen
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &m_SemaphoresRenderFinished[m_CurrentFrame];		// semaphores to wait on
+	presentInfo.pWaitSemaphores = &frame.RenderFinished;		// semaphores to wait on
 	presentInfo.swapchainCount = 1;
 	presentInfo.pSwapchains = &m_Swapchain;		// Swapchain to present images to
 	presentInfo.pImageIndices = &imageIndex;	// index of images in swapchain to present
 
-	result = vkQueuePresentKHR(m_PresentationQueue, &presentInfo);
+	VkResult result = vkQueuePresentKHR(m_PresentationQueue, &presentInfo);
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to present rendererd image to screen!");
 	}
+}
+
+void VulkanRenderer::WaitForGraphicsTimeline(uint64_t value)
+{
+	// Frame number 0 was never submitted, nothing to wait for
+	uint64_t completedValue = 0;
+	vkGetSemaphoreCounterValue(m_MainDevice.LogicalDevice, m_GraphicsTimeline, &completedValue);
+	if (completedValue >= value)
+	{
+		return;
+	}
+
+	VkSemaphoreWaitInfo waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_GraphicsTimeline;
+	waitInfo.pValues = &value;
+
+	if (vkWaitSemaphores(m_MainDevice.LogicalDevice, &waitInfo, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to wait for the graphics timeline!");
+	}
+}
+
+void VulkanRenderer::DeferDestroy(std::function<void()> destroy)
+{
+	// The last frame recorded may still use it (with async compute even before its last submit)
+	m_DeferredDestroys.emplace_back(m_FrameNumber, std::move(destroy));
+}
+
+void VulkanRenderer::FlushDeferredDestroys(bool all)
+{
+	uint64_t completedValue = 0;
+	if (!all)
+	{
+		vkGetSemaphoreCounterValue(m_MainDevice.LogicalDevice, m_GraphicsTimeline, &completedValue);
+	}
 
-	// only for max_frame_draw = 2
-	m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAME_DRAWS;
+	// Queued in frame order
+	while (!m_DeferredDestroys.empty() && (all || m_DeferredDestroys.front().first <= completedValue))
+	{
+		m_DeferredDestroys.front().second();
+		m_DeferredDestroys.pop_front();
+	}
 }
 
 void VulkanRenderer::CleanUp()
 {
+	// The last frame may still wait for its final submit. It isn't presented: the window may be gone already
+	SubmitPendingPresent(false);
+
 	// Wait until no action being run on device before destroying
 	vkDeviceWaitIdle(m_MainDevice.LogicalDevice);
+	FlushDeferredDestroys(true);
 
 	// Clean all the meshes buffer
 	for (size_t i = 0; i < m_ModelList.size(); i++)
@@ -173,13 +509,34 @@ void VulkanRenderer::CleanUp()
 		m_ModelList[i].DestroyMeshModel();
 	}
 
-	vkDestroyDescriptorPool(m_MainDevice.LogicalDevice, m_InputDescriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(m_MainDevice.LogicalDevice, m_InputDescriptorSetLayout, nullptr);
+	for (SkinnedMesh& skinnedMesh : m_SkinnedMeshes)
+	{
+		for (size_t i = 0; i < skinnedMesh.OutputBuffers.size(); i++)
+		{
+			vkDestroyBuffer(m_MainDevice.LogicalDevice, skinnedMesh.OutputBuffers[i], nullptr);
+			vkFreeMemory(m_MainDevice.LogicalDevice, skinnedMesh.OutputBufferMemory[i], nullptr);
+		}
+	}
+	m_SkinnedMeshes.clear();
+
+	vkDestroyDescriptorPool(m_MainDevice.LogicalDevice, m_SkinningDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(m_MainDevice.LogicalDevice, m_SkinningDescriptorSetLayout, nullptr);
+
+	vkDestroyDescriptorPool(m_MainDevice.LogicalDevice, m_CompositeDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(m_MainDevice.LogicalDevice, m_CompositeDescriptorSetLayout, nullptr);
+
+	vkDestroyDescriptorPool(m_MainDevice.LogicalDevice, m_UpscaleDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(m_MainDevice.LogicalDevice, m_UpscaleDescriptorSetLayout, nullptr);
+
+	vkDestroyDescriptorPool(m_MainDevice.LogicalDevice, m_GBufferDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(m_MainDevice.LogicalDevice, m_GBufferDescriptorSetLayout, nullptr);
 
 	vkDestroyDescriptorPool(m_MainDevice.LogicalDevice, m_SamplerDescriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(m_MainDevice.LogicalDevice, m_SamplerDescriptorSetLayout, nullptr);
 
 	vkDestroySampler(m_MainDevice.LogicalDevice, m_TextureSampler, nullptr);
+	vkDestroySampler(m_MainDevice.LogicalDevice, m_UpscaleSampler, nullptr);
+	vkDestroySampler(m_MainDevice.LogicalDevice, m_CompositeSampler, nullptr);
 
 	// Free texture memory
 	for (size_t i = 0; i < m_TextureImages.size(); i++)
@@ -189,21 +546,8 @@ void VulkanRenderer::CleanUp()
 		vkFreeMemory(m_MainDevice.LogicalDevice, m_TextureImageMemory[i], nullptr);
 	}
 
-	// Clean depth buffer image
-	for (size_t i = 0; i < m_DepthBufferImage.size(); i++)
-	{
-		vkDestroyImageView(m_MainDevice.LogicalDevice, m_DepthBufferImageView[i], nullptr);
-		vkDestroyImage(m_MainDevice.LogicalDevice, m_DepthBufferImage[i], nullptr);
-		vkFreeMemory(m_MainDevice.LogicalDevice, m_DepthBufferImageMemory[i], nullptr);
-	}
-
-	// Clean image buffer 
-	for (size_t i = 0; i < m_ColorBufferImage.size(); i++)
-	{
-		vkDestroyImageView(m_MainDevice.LogicalDevice, m_ColorBufferImageView[i], nullptr);
-		vkDestroyImage(m_MainDevice.LogicalDevice, m_ColorBufferImage[i], nullptr);
-		vkFreeMemory(m_MainDevice.LogicalDevice, m_ColorBufferImageMemory[i], nullptr);
-	}
+	// Render graph images, render passes and framebuffers
+	m_RenderGraph.Destroy();
 
 	// Free object memories (dynamic buffer)
 	_aligned_free(m_ModelTransferSpace);
@@ -213,44 +557,74 @@ void VulkanRenderer::CleanUp()
 	vkDestroyDescriptorPool(m_MainDevice.LogicalDevice, m_DescriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(m_MainDevice.LogicalDevice, m_DescriptorSetLayout, nullptr);
 
-	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+	// Frame contexts
+	for (FrameContext& frame : m_Frames)
 	{
-		vkDestroyBuffer(m_MainDevice.LogicalDevice, m_UniformBuffers[i], nullptr);
-		vkFreeMemory(m_MainDevice.LogicalDevice, m_UniformBufferMemory[i], nullptr);
+		vkDestroyBuffer(m_MainDevice.LogicalDevice, frame.UniformBuffer, nullptr);
+		vkFreeMemory(m_MainDevice.LogicalDevice, frame.UniformBufferMemory, nullptr);
 
-		vkDestroyBuffer(m_MainDevice.LogicalDevice, m_UniformDynamicBuffers[i], nullptr);
-		vkFreeMemory(m_MainDevice.LogicalDevice, m_UniformDynamicBufferMemory[i], nullptr);
-	}
+		vkDestroyBuffer(m_MainDevice.LogicalDevice, frame.UniformDynamicBuffer, nullptr);
+		vkFreeMemory(m_MainDevice.LogicalDevice, frame.UniformDynamicBufferMemory, nullptr);
 
+		vkDestroyBuffer(m_MainDevice.LogicalDevice, frame.LightBuffer, nullptr);
+		vkFreeMemory(m_MainDevice.LogicalDevice, frame.LightBufferMemory, nullptr);
+		vkDestroyBuffer(m_MainDevice.LogicalDevice, frame.ClusterBuffer, nullptr);
+		vkFreeMemory(m_MainDevice.LogicalDevice, frame.ClusterBufferMemory, nullptr);
+		vkDestroyBuffer(m_MainDevice.LogicalDevice, frame.LightIndexBuffer, nullptr);
+		vkFreeMemory(m_MainDevice.LogicalDevice, frame.LightIndexBufferMemory, nullptr);
 
-	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
-	{
-		vkDestroySemaphore(m_MainDevice.LogicalDevice, m_SemaphoresImageAvailable[i], nullptr);
-		vkDestroySemaphore(m_MainDevice.LogicalDevice, m_SemaphoresRenderFinished[i], nullptr);
-		vkDestroyFence(m_MainDevice.LogicalDevice, m_DrawFences[i], nullptr);
-	}
+		vkDestroyBuffer(m_MainDevice.LogicalDevice, frame.HiZBuffer, nullptr);
+		vkFreeMemory(m_MainDevice.LogicalDevice, frame.HiZBufferMemory, nullptr);
 
-	vkDestroyCommandPool(m_MainDevice.LogicalDevice, m_GraphicsCommandPool, nullptr);
+		vkDestroyBuffer(m_MainDevice.LogicalDevice, frame.JointBuffer, nullptr);
+		vkFreeMemory(m_MainDevice.LogicalDevice, frame.JointBufferMemory, nullptr);
 
-	for (size_t i = 0; i < m_SwapChainFramebuffers.size(); i++)
-	{
-		vkDestroyFramebuffer(m_MainDevice.LogicalDevice, m_SwapChainFramebuffers[i], nullptr);
+		vkDestroySemaphore(m_MainDevice.LogicalDevice, frame.ImageAvailable, nullptr);
+		vkDestroySemaphore(m_MainDevice.LogicalDevice, frame.RenderFinished, nullptr);
+		vkDestroySemaphore(m_MainDevice.LogicalDevice, frame.GeometryFinished, nullptr);
+
+		vkDestroyCommandPool(m_MainDevice.LogicalDevice, frame.CommandPool, nullptr);
+		vkDestroyCommandPool(m_MainDevice.LogicalDevice, frame.ComputeCommandPool, nullptr);
 	}
+	m_Frames.clear();
 
-	// Destroy pipelines
-	vkDestroyPipeline(m_MainDevice.LogicalDevice, m_SecondPipeline, nullptr);
-	vkDestroyPipelineLayout(m_MainDevice.LogicalDevice, m_SecondPipelineLayout, nullptr);
+	vkDestroySemaphore(m_MainDevice.LogicalDevice, m_GraphicsTimeline, nullptr);
+	vkDestroySemaphore(m_MainDevice.LogicalDevice, m_ComputeTimeline, nullptr);
 
-	vkDestroyPipeline(m_MainDevice.LogicalDevice, m_GraphicsPipeline, nullptr);
+	vkDestroyCommandPool(m_MainDevice.LogicalDevice, m_GraphicsCommandPool, nullptr);
+
+	// Destroy pipelines (waits for background compiles, so the cache below has them too)
+	m_GpuProfiler.Destroy();
+	m_PipelineManager.Destroy();
+	m_JobSystem.Shutdown();
+	vkDestroyPipelineLayout(m_MainDevice.LogicalDevice, m_UpscalePipelineLayout, nullptr);
+	vkDestroyPipelineLayout(m_MainDevice.LogicalDevice, m_LightingPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(m_MainDevice.LogicalDevice, m_CompositePipelineLayout, nullptr);
+	vkDestroyPipelineLayout(m_MainDevice.LogicalDevice, m_SkinningPipelineLayout, nullptr);
 	vkDestroyPipelineLayout(m_MainDevice.LogicalDevice, m_PipelineLayout, nullptr);
 
-	vkDestroyRenderPass(m_MainDevice.LogicalDevice, m_RenderPass, nullptr);
+	// Write the cache back so the next launch skips the pipeline compiles
+	SavePipelineCache();
+	vkDestroyPipelineCache(m_MainDevice.LogicalDevice, m_PipelineCache, nullptr);
+
 	for (auto image : m_SwapChainImages)
 	{
 		vkDestroyImageView(m_MainDevice.LogicalDevice, image.ImageView, nullptr);
 	}
-	vkDestroySwapchainKHR(m_MainDevice.LogicalDevice, m_Swapchain, nullptr);
-	vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+
+	if (m_Settings.Headless)
+	{
+		for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+		{
+			vkDestroyImage(m_MainDevice.LogicalDevice, m_SwapChainImages[i].Image, nullptr);
+			vkFreeMemory(m_MainDevice.LogicalDevice, m_OffscreenImageMemory[i], nullptr);
+		}
+	}
+	else
+	{
+		vkDestroySwapchainKHR(m_MainDevice.LogicalDevice, m_Swapchain, nullptr);
+		vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+	}
 	vkDestroyDevice(m_MainDevice.LogicalDevice, nullptr);
 	vkDestroyInstance(m_Instance, nullptr);
 }
@@ -280,16 +654,19 @@ void VulkanRenderer::CreateInstance()
 	// Create a list to hold instance extensions
 	std::vector<const char*> instanceExtensions = std::vector<const char*>();
 
-	// Set up the extensions that Instance will use
-	uint32_t glfwExtensionCount = 0; // glfw may require multiple extensions
-	const char** glfwExtensions;	// Extensions passed as array of cstrings
+	// Set up the extensions that Instance will use (headless needs no window system extensions)
+	if (!m_Settings.Headless)
+	{
+		uint32_t glfwExtensionCount = 0; // glfw may require multiple extensions
+		const char** glfwExtensions;	// Extensions passed as array of cstrings
 
-	// get glfw extensions
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		// get glfw extensions
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	// Add glfw extensions to list of extensions
-	for (size_t i = 0; i < glfwExtensionCount; i++)
-		instanceExtensions.push_back(glfwExtensions[i]);
+		// Add glfw extensions to list of extensions
+		for (size_t i = 0; i < glfwExtensionCount; i++)
+			instanceExtensions.push_back(glfwExtensions[i]);
+	}
 
 	
 	if (!CheckInstanceExtensionSupport(&instanceExtensions))
@@ -335,7 +712,7 @@ void VulkanRenderer::CreateLogicalDevice()
 
 	// Vector for queue creation information and set for family indices
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> queueFamilyIndices = { indices.GraphicsFamily, indices.PresentationFamily };
+	std::set<int> queueFamilyIndices = { indices.GraphicsFamily, indices.PresentationFamily, indices.ComputeFamily };
 
 
 
@@ -357,13 +734,33 @@ void VulkanRenderer::CreateLogicalDevice()
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data(); // list of queue create infos. 
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(s_DeviceExtensions.size());		// number of enabled logical device extensions
-	deviceCreateInfo.ppEnabledExtensionNames = s_DeviceExtensions.data(); // list of enabled logical device extensions
+	std::vector<const char*> deviceExtensions = GetDeviceExtensions();
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());		// number of enabled logical device extensions
+	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data(); // list of enabled logical device extensions
 
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;		// Enable anisotropy
 
+	// Optional: per frame vertex/clipping/fragment counts for the GPU profiler
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(m_MainDevice.PhysicalDevice, &supportedFeatures);
+	m_PipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+	deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;  // physical device feature will use
+
+	// Descriptor indexing (core in Vulkan 1.2) for the bindless texture table
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.descriptorIndexing = VK_TRUE;
+	vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+	vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+	vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+
+	// Timeline semaphores (core in Vulkan 1.2) for the frame synchronization
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+
+	deviceCreateInfo.pNext = &vulkan12Features;
 	
 	if (enableValidationLayers)
 	{
@@ -384,6 +781,126 @@ void VulkanRenderer::CreateLogicalDevice()
 	// From given logical device, of given queue family, of given queue index, place reference in vkQueue
 	vkGetDeviceQueue(m_MainDevice.LogicalDevice, indices.GraphicsFamily, 0, &m_GraphicsQueue);
 	vkGetDeviceQueue(m_MainDevice.LogicalDevice, indices.PresentationFamily, 0, &m_PresentationQueue);
+	vkGetDeviceQueue(m_MainDevice.LogicalDevice, indices.ComputeFamily, 0, &m_ComputeQueue);
+
+	// Async compute needs a separate family (same family = same queue, nothing would overlap)
+	m_AsyncCompute = m_Settings.AsyncCompute && indices.ComputeFamily != indices.GraphicsFamily;
+
+	// Composite scope is only timed where the compute queue can write timestamps
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_MainDevice.PhysicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_MainDevice.PhysicalDevice, &queueFamilyCount, queueFamilyList.data());
+	m_ComputeTimestamps = queueFamilyList[indices.ComputeFamily].timestampValidBits > 0;
+}
+
+void VulkanRenderer::CreatePipelineCache()
+{
+	// Read the blob saved by the last run (missing file = cold start)
+	std::vector<char> cacheData;
+	std::ifstream file(s_PipelineCacheFile, std::ios::binary | std::ios::ate);
+	if (file.is_open())
+	{
+		cacheData.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(cacheData.data(), cacheData.size());
+		if (!file)
+		{
+			cacheData.clear();
+		}
+		file.close();
+	}
+
+	// Only hand the blob to the driver if it was written by this driver/device
+	if (!cacheData.empty() && !IsPipelineCacheCompatible(cacheData))
+	{
+		std::cout << "Pipeline cache '" << s_PipelineCacheFile << "' is stale or invalid, rebuilding it" << std::endl;
+		cacheData.clear();
+	}
+
+	VkPipelineCacheCreateInfo cacheCreateInfo = {};
+	cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheCreateInfo.initialDataSize = cacheData.size();
+	cacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+	VkResult result = vkCreatePipelineCache(m_MainDevice.LogicalDevice, &cacheCreateInfo, nullptr, &m_PipelineCache);
+	if (result != VK_SUCCESS && !cacheData.empty())
+	{
+		// Driver rejected the data anyway, start from an empty cache
+		cacheCreateInfo.initialDataSize = 0;
+		cacheCreateInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(m_MainDevice.LogicalDevice, &cacheCreateInfo, nullptr, &m_PipelineCache);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Cache!");
+	}
+}
+
+void VulkanRenderer::SavePipelineCache()
+{
+	size_t dataSize = 0;
+	VkResult result = vkGetPipelineCacheData(m_MainDevice.LogicalDevice, m_PipelineCache, &dataSize, nullptr);
+	if (result != VK_SUCCESS || dataSize == 0)
+	{
+		return;
+	}
+
+	std::vector<char> cacheData(dataSize);
+	result = vkGetPipelineCacheData(m_MainDevice.LogicalDevice, m_PipelineCache, &dataSize, cacheData.data());
+	if (result != VK_SUCCESS)
+	{
+		return;
+	}
+
+	// Write to a temporary file first and swap it in, so a crash never leaves a half written cache
+	std::string tempFile = s_PipelineCacheFile + ".tmp";
+	{
+		std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return;
+		}
+
+		file.write(cacheData.data(), dataSize);
+		file.close();
+		if (!file)
+		{
+			std::remove(tempFile.c_str());
+			return;
+		}
+	}
+
+#ifdef _WIN32
+	bool renamed = MoveFileExA(tempFile.c_str(), s_PipelineCacheFile.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool renamed = std::rename(tempFile.c_str(), s_PipelineCacheFile.c_str()) == 0;
+#endif
+	if (!renamed)
+	{
+		std::remove(tempFile.c_str());
+	}
+}
+
+bool VulkanRenderer::IsPipelineCacheCompatible(const std::vector<char>& cacheData)
+{
+	VkPipelineCacheHeaderVersionOne header;
+	if (cacheData.size() < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, cacheData.data(), sizeof(header));
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(m_MainDevice.PhysicalDevice, &deviceProperties);
+
+	// Header must match this driver build (UUID) and device exactly
+	return header.headerSize >= sizeof(header) && header.headerSize <= cacheData.size()
+		&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& header.vendorID == deviceProperties.vendorID
+		&& header.deviceID == deviceProperties.deviceID
+		&& memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
 }
 
 void VulkanRenderer::CreateSurface()
@@ -407,12 +924,13 @@ void VulkanRenderer::CreateSwapChain()
 	// 1. CHOOSE BEST SURFACE FORMAT
 	VkSurfaceFormatKHR surfaceFormat = ChooseBestSurfaceFormat(swapChainDetails.Formats);
 	// 2. CHOOSE BEST PRESENTATION MODE
-	VkPresentModeKHR presentMode = ChooseBestPresentationMode(swapChainDetails.PresentationMode);
+	VkPresentModeKHR presentMode = ChooseBestPresentationMode(swapChainDetails.PresentationMode, m_Settings.PresentMode);
 	// 3. CHOOSE SWAP CHAIN IMAGE RESOLUTION
 	VkExtent2D extent = ChooseSwapExtent(swapChainDetails.SurfaceCapabilities);
 
 	// How many image are in the swap chain? Get 1 more than minimum to allow triple buffering
-	uint32_t imageCount = swapChainDetails.SurfaceCapabilities.minImageCount + 1;
+	// (async compute: 1 more, the deferred present keeps an image acquired while the next frame acquires another)
+	uint32_t imageCount = swapChainDetails.SurfaceCapabilities.minImageCount + (m_AsyncCompute ? 2 : 1);
 
 	if (swapChainDetails.SurfaceCapabilities.maxImageCount > 0 && 
 		swapChainDetails.SurfaceCapabilities.maxImageCount < imageCount)
@@ -479,6 +997,12 @@ void VulkanRenderer::CreateSwapChain()
 	std::vector<VkImage> images(swapChainImageCount);
 	vkGetSwapchainImagesKHR(m_MainDevice.LogicalDevice, m_Swapchain, &swapChainImageCount, images.data());
 
+	// Acquiring more images than count - minImageCount at once may block forever: present right away instead
+	if (swapChainImageCount < swapChainDetails.SurfaceCapabilities.minImageCount + 2)
+	{
+		m_AsyncCompute = false;
+	}
+
 	for (VkImage image : images)
 	{
 		// Store image handle
@@ -491,210 +1015,298 @@ void VulkanRenderer::CreateSwapChain()
 	}
 }
 
-void VulkanRenderer::CreateRenderPass()
+void VulkanRenderer::CreateOffscreenImages()
 {
-	// Array of our subpasses
-	std::array<VkSubpassDescription, 2> subpassDescriptions = {};
+	// Stand-ins for the swapchain images: same role in the frame, but owned by us and copyable to the host
+	m_SwapchainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	m_SwapchainExtent = m_Settings.HeadlessExtent;
 
-	// ATTACHMENTS
-	// -----------------------------------------------------------------
-	// SUBPASS 1 ATTACHMENTS + REFERENCES (INPUT ATTACHMENTS)
-	// -----------------------------------------------------------------
-	// Color attachment (input)
-	VkAttachmentDescription colorAttachment = {};
-	colorAttachment.format = ChooseSupportedFormat(
-		{ VK_FORMAT_R8G8B8A8_UNORM },		// Formats
-		VK_IMAGE_TILING_OPTIMAL,			// tiling
-		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL // featureFlags
-	);
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	// depth attachment (input)
-	// Depth attachment of render pass
-	VkAttachmentDescription depthAttachment = {};
-	depthAttachment.format = ChooseSupportedFormat(
-		{ VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT },
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-	);
-	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-
-	// Corlor Attachment (input) Reference
-	VkAttachmentReference colorAttachmentReference = {};
-	colorAttachmentReference.attachment = 1;
-	colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	// Depth attachment (input) Reference
-	VkAttachmentReference depthAttachmentReference = {};
-	depthAttachmentReference.attachment = 2;
-	depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	// Set up subpass 1 (input)
-	subpassDescriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpassDescriptions[0].colorAttachmentCount = 1;
-	subpassDescriptions[0].pColorAttachments = &colorAttachmentReference;
-	subpassDescriptions[0].pDepthStencilAttachment = &depthAttachmentReference;
-
-
-	// -----------------------------------------------------------------
-	// SUBPASS 2 ATTACHMENTS + REFERENCES 
-	// -----------------------------------------------------------------
-	// Swapchain color attachment of render pass
-	VkAttachmentDescription swapchainColorAttachment = {};
-	swapchainColorAttachment.format = m_SwapchainImageFormat;
-	swapchainColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;	// number of samples to write for multisampling
-	swapchainColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; // Describes what do with attachment before rendering
-	swapchainColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;	// It describes what do with attachment after rendering
-	swapchainColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	swapchainColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-
-	// Framebuffer data will be store as image, but image can be given
-	// different data layout to give optimal use for certain operations
-	swapchainColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;		// image data layout before render pass starts
-	swapchainColorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;	// Image data layout after render pass (to change to)
-
-	// Attachment reference uses an attachment index that refers to index in the attachment list passed to renderPassCreateInfo
-	VkAttachmentReference swapchainColorAttachmentReference = {};
-	swapchainColorAttachmentReference.attachment = 0;
-	swapchainColorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	// reference to attachments that subpass will take input from
-	std::array<VkAttachmentReference, 2> inputReferences;
-	inputReferences[0].attachment = 1;
-	inputReferences[0].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	inputReferences[1].attachment = 2;
-	inputReferences[1].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-	// Set up subpass 2 
-	subpassDescriptions[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpassDescriptions[1].colorAttachmentCount = 1;
-	subpassDescriptions[1].pColorAttachments = &swapchainColorAttachmentReference;
-	subpassDescriptions[1].inputAttachmentCount = static_cast<uint32_t>(inputReferences.size());
-	subpassDescriptions[1].pInputAttachments = inputReferences.data();
-
-
-
-	// -----------------------------------------------------------------
-	//SUBPASSES DEPENDENCIES
-	// -----------------------------------------------------------------
-		
-	// Need to determine when layout transition occur using subpass dependencies
-	std::array<VkSubpassDependency, 3> subpassDependencies;
-	// Conversion from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-	// Transition must happen after...
-	subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL; // Subpass index (VK_SUBPASS_EXTERNAL = Special value meaning outside of render pass)
-	subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT; // Pipeline stage
-	subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT; // Stage access mask (memory access)
-	
-	// But must happen before
-	subpassDependencies[0].dstSubpass = 0;
-	subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	subpassDependencies[0].dependencyFlags = 0;
-
-	// Subpass 1 layout (color/depth) to subpass 2 layout (shader read)
-	subpassDependencies[1].srcSubpass = 0;
-	subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	//
-	subpassDependencies[1].dstSubpass = 1;
-	subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	subpassDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	subpassDependencies[1].dependencyFlags = 0;
-
-
-	// Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-	// Transition must happen after...
-	subpassDependencies[2].srcSubpass = 0; // Subpass index (VK_SUBPASS_EXTERNAL = Special value meaning outside of render pass)
-	subpassDependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // Pipeline stage
-	subpassDependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;; // Stage access mask (memory access)
-	// But must happen before
-	subpassDependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
-	subpassDependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpassDependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	subpassDependencies[2].dependencyFlags = 0;
-
-	std::array<VkAttachmentDescription, 3> renderPassAttachments = { swapchainColorAttachment,colorAttachment, depthAttachment };
-
-	// Create info for Render pass
-	VkRenderPassCreateInfo renderPassCreateInfo = {};
-	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(renderPassAttachments.size());
-	renderPassCreateInfo.pAttachments = renderPassAttachments.data();
-	renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
-	renderPassCreateInfo.pSubpasses = subpassDescriptions.data();
-	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-	renderPassCreateInfo.pDependencies = subpassDependencies.data();
-
-	VkResult result = vkCreateRenderPass(m_MainDevice.LogicalDevice, &renderPassCreateInfo, nullptr, &m_RenderPass);
-	if (result != VK_SUCCESS)
+	// The deferred present of async compute needs the next frame to render to another image
+	if (m_Settings.HeadlessImageCount < 2)
+	{
+		m_AsyncCompute = false;
+	}
+
+	m_OffscreenImageMemory.resize(m_Settings.HeadlessImageCount);
+	for (uint32_t i = 0; i < m_Settings.HeadlessImageCount; i++)
 	{
-		throw std::runtime_error("Failed to create Render Pass");
+		SwapChainImage offscreenImage = {};
+		offscreenImage.Image = CreateImage(m_SwapchainExtent.width, m_SwapchainExtent.height, m_SwapchainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_OffscreenImageMemory[i]);
+		offscreenImage.ImageView = CreateImageView(offscreenImage.Image, m_SwapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		m_SwapChainImages.push_back(offscreenImage);
 	}
 }
 
-void VulkanRenderer::CreateDescriptorSetLayout()
+bool VulkanRenderer::SaveLastFrame(const std::string& filepath)
 {
-	// UNIFORM VALUES DESCRIPTOR SET LAYOUT
-	// View-Projection binding info
-	VkDescriptorSetLayoutBinding vpLayoutBinding = {};
-	vpLayoutBinding.binding = 0; // binding point in shader
-	vpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // type of descriptor
-	vpLayoutBinding.descriptorCount = 1;		// number of descriptor for binding
-	vpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;		// Shader stage to bind to
-	vpLayoutBinding.pImmutableSamplers = nullptr;			// Fopr texture: can make sampler data unchangeable (imutable) by specifying in layout
+	if (!m_Settings.Headless)
+	{
+		return false;
+	}
 
-	// Model layout binding
-	VkDescriptorSetLayoutBinding modelLayoutBinding = {};
-	modelLayoutBinding.binding = 1;
-	modelLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-	modelLayoutBinding.descriptorCount = 1;
-	modelLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	modelLayoutBinding.pImmutableSamplers = nullptr;
+	// With async compute the last frame is only submitted by the next Draw
+	SubmitPendingPresent();
+	WaitForGraphicsTimeline(m_FrameNumber);
 
-	// List of descriptor set layout bindings
-	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { vpLayoutBinding , modelLayoutBinding };
+	// Copy the image (left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL by the upscale pass) into a host visible buffer
+	uint32_t width = m_SwapchainExtent.width;
+	uint32_t height = m_SwapchainExtent.height;
+	VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height * 4;
 
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	CreateBuffer(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
 
-	// Create descriptor set layout with given bindings
-	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
-	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());		// number of binding info	
-	layoutCreateInfo.pBindings = layoutBindings.data();		// array of binding infos
+	VkCommandBuffer commandBuffer = BeginCommandBuffer(m_MainDevice.LogicalDevice, m_GraphicsCommandPool);
 
+	VkBufferImageCopy imageRegion = {};
+	imageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageRegion.imageSubresource.layerCount = 1;
+	imageRegion.imageExtent = { width, height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, m_SwapChainImages[m_LastImageIndex].Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		stagingBuffer, 1, &imageRegion);
 
-	// Create descriptor set layour
-	VkResult result = vkCreateDescriptorSetLayout(m_MainDevice.LogicalDevice, &layoutCreateInfo, nullptr, &m_DescriptorSetLayout);
-	if (result != VK_SUCCESS)
+	FinishAndSubmitCommandBuffer(m_MainDevice.LogicalDevice, m_GraphicsCommandPool, m_GraphicsQueue, commandBuffer);
+
+	// Write RGB, dropping alpha
+	bool saved = false;
+	std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+	if (file.is_open())
 	{
-		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
-	}
+		void* data;
+		vkMapMemory(m_MainDevice.LogicalDevice, stagingBufferMemory, 0, imageSize, 0, &data);
+		const uint8_t* pixels = static_cast<const uint8_t*>(data);
+
+		file << "P6\n" << width << " " << height << "\n255\n";
+		std::vector<char> row(width * 3);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const uint8_t* pixel = pixels + (static_cast<size_t>(y) * width + x) * 4;
+				row[x * 3 + 0] = static_cast<char>(pixel[0]);
+				row[x * 3 + 1] = static_cast<char>(pixel[1]);
+				row[x * 3 + 2] = static_cast<char>(pixel[2]);
+			}
+			file.write(row.data(), row.size());
+		}
+
+		vkUnmapMemory(m_MainDevice.LogicalDevice, stagingBufferMemory);
+		saved = static_cast<bool>(file);
+	}
+
+	vkDestroyBuffer(m_MainDevice.LogicalDevice, stagingBuffer, nullptr);
+	vkFreeMemory(m_MainDevice.LogicalDevice, stagingBufferMemory, nullptr);
+	return saved;
+}
+
+void VulkanRenderer::BuildRenderGraph()
+{
+	// Graph images have one copy per frame in flight (the frame wait covers them, whatever swapchain image is acquired).
+	// Color and depth become transient, lazily allocated attachments as soon as nothing outside their render pass reads them
+	uint32_t instanceCount = m_Settings.FramesInFlight;
+
+	// IMAGES
+	// Scene pass color, read by the composite pass afterwards
+	RenderGraphImageDesc colorDesc = {};
+	colorDesc.Format = ChooseSupportedFormat(
+		{ VK_FORMAT_R8G8B8A8_UNORM },		// Formats
+		VK_IMAGE_TILING_OPTIMAL,			// tiling
+		VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT // featureFlags
+	);
+	colorDesc.Extent = m_SwapchainExtent;
+	m_ColorBufferImage = m_RenderGraph.CreateImage("Color", colorDesc);
+
+	// Depth buffer (visualized by the composite pass too)
+	RenderGraphImageDesc depthDesc = {};
+	depthDesc.Format = ChooseSupportedFormat(
+		{ VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT },
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+	);
+	depthDesc.Extent = m_SwapchainExtent;
+	m_DepthBufferImage = m_RenderGraph.CreateImage("Depth", depthDesc);
+
+	// Allocated at full resolution, the composite pass only writes the top left render extent of it.
+	// Written as a storage image (sRGB formats rarely support that), the upscale pass encodes to the swapchain format
+	RenderGraphImageDesc sceneColorDesc = {};
+	sceneColorDesc.Format = ChooseSupportedFormat(
+		{ VK_FORMAT_R8G8B8A8_UNORM },
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+	);
+	sceneColorDesc.Extent = m_SwapchainExtent;
+	m_SceneColorImage = m_RenderGraph.CreateImage("SceneColor", sceneColorDesc);
+
+	// Deferred G-buffer: albedo and view space normal (the normal's alpha tells lit from unlit pixels)
+	if (m_Settings.DeferredShading)
+	{
+		RenderGraphImageDesc albedoDesc = {};
+		albedoDesc.Format = ChooseSupportedFormat(
+			{ VK_FORMAT_R8G8B8A8_UNORM },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+		);
+		albedoDesc.Extent = m_SwapchainExtent;
+		m_AlbedoImage = m_RenderGraph.CreateImage("Albedo", albedoDesc);
+
+		RenderGraphImageDesc normalDesc = {};
+		normalDesc.Format = ChooseSupportedFormat(
+			{ VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_FORMAT_R8G8B8A8_UNORM },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+		);
+		normalDesc.Extent = m_SwapchainExtent;
+		m_NormalImage = m_RenderGraph.CreateImage("Normal", normalDesc);
+	}
+
+	// Swapchain images are the output. Headless images are never presented, they are left ready to be copied out (SaveLastFrame)
+	std::vector<VkImage> swapchainImages;
+	std::vector<VkImageView> swapchainImageViews;
+	for (const SwapChainImage& image : m_SwapChainImages)
+	{
+		swapchainImages.push_back(image.Image);
+		swapchainImageViews.push_back(image.ImageView);
+	}
+
+	RenderGraphImageDesc swapchainDesc = {};
+	swapchainDesc.Format = m_SwapchainImageFormat;
+	swapchainDesc.Extent = m_SwapchainExtent;
+	m_SwapchainGraphImage = m_RenderGraph.ImportImage("Swapchain", swapchainDesc, swapchainImages, swapchainImageViews,
+		m_Settings.Headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+	// PASSES (the graph derives the render passes, layouts and barriers from what they read and write)
+	m_GeometryPass = m_RenderGraph.AddPass("Geometry", RenderGraphQueue::Graphics,
+		[this](VkCommandBuffer commandBuffer, uint32_t) { RecordGeometry(commandBuffer); });
+
+	VkClearValue colorClear = {};
+	colorClear.color = { 0.20f, 0.10f, 0.40f, 1.0f };
+	VkClearValue depthClear = {};
+	depthClear.depthStencil.depth = 1.0f;
+	if (m_Settings.DeferredShading)
+	{
+		// G-buffer, then lighting as a second subpass (it only reads the G-buffer as input attachments, so the graph
+		// merges both into one render pass and never stores albedo and normal)
+		VkClearValue gBufferClear = {};
+		m_RenderGraph.Write(m_GeometryPass, m_AlbedoImage, RenderGraphAccess::ColorAttachment, gBufferClear);
+		m_RenderGraph.Write(m_GeometryPass, m_NormalImage, RenderGraphAccess::ColorAttachment, gBufferClear);
+		m_RenderGraph.Write(m_GeometryPass, m_DepthBufferImage, RenderGraphAccess::DepthAttachment, depthClear);
+
+		m_LightingPass = m_RenderGraph.AddPass("Lighting", RenderGraphQueue::Graphics,
+			[this](VkCommandBuffer commandBuffer, uint32_t instance) { RecordLighting(commandBuffer, instance); });
+		m_RenderGraph.Read(m_LightingPass, m_AlbedoImage, RenderGraphAccess::InputAttachment);
+		m_RenderGraph.Read(m_LightingPass, m_NormalImage, RenderGraphAccess::InputAttachment);
+		m_RenderGraph.Read(m_LightingPass, m_DepthBufferImage, RenderGraphAccess::InputAttachment);
+		m_RenderGraph.Write(m_LightingPass, m_ColorBufferImage, RenderGraphAccess::ColorAttachment, colorClear);
+	}
+	else
+	{
+		m_RenderGraph.Write(m_GeometryPass, m_ColorBufferImage, RenderGraphAccess::ColorAttachment, colorClear);
+		m_RenderGraph.Write(m_GeometryPass, m_DepthBufferImage, RenderGraphAccess::DepthAttachment, depthClear);
+	}
+
+	// Runs on the async compute queue when there is one. Not every compute family can write timestamps
+	m_CompositePass = m_RenderGraph.AddPass("Composite", RenderGraphQueue::Compute,
+		[this](VkCommandBuffer commandBuffer, uint32_t instance) { RecordComposite(commandBuffer, instance, !m_AsyncCompute || m_ComputeTimestamps); });
+	m_RenderGraph.Read(m_CompositePass, m_ColorBufferImage, RenderGraphAccess::Sampled);
+	m_RenderGraph.Read(m_CompositePass, m_DepthBufferImage, RenderGraphAccess::Sampled);
+	m_RenderGraph.Write(m_CompositePass, m_SceneColorImage, RenderGraphAccess::StorageImage);
+
+	// Every pixel is overwritten by the fullscreen triangle, no need to clear
+	m_UpscalePass = m_RenderGraph.AddPass("Upscale", RenderGraphQueue::Graphics,
+		[this](VkCommandBuffer commandBuffer, uint32_t instance) { RecordUpscale(commandBuffer, instance); });
+	m_RenderGraph.Read(m_UpscalePass, m_SceneColorImage, RenderGraphAccess::Sampled);
+	m_RenderGraph.Write(m_UpscalePass, m_SwapchainGraphImage, RenderGraphAccess::ColorAttachment);
+
+	QueueFamilyIndices indices = GetQueueFamilies(m_MainDevice.PhysicalDevice);
+	m_RenderGraph.Compile(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, instanceCount, m_AsyncCompute,
+		static_cast<uint32_t>(indices.GraphicsFamily), static_cast<uint32_t>(indices.ComputeFamily));
+
+	// Async compute submits geometry, composite and upscale separately (one command buffer each)
+	uint32_t expectedBatches = m_AsyncCompute ? 3 : 1;
+	if (m_RenderGraph.GetBatchCount() != expectedBatches)
+	{
+		throw std::runtime_error("Failed to build render graph: unexpected queue batches!");
+	}
+}
+
+void VulkanRenderer::CreateDescriptorSetLayout()
+{
+	// UNIFORM VALUES DESCRIPTOR SET LAYOUT
+	// View-Projection binding info
+	VkDescriptorSetLayoutBinding vpLayoutBinding = {};
+	vpLayoutBinding.binding = 0; // binding point in shader
+	vpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // type of descriptor
+	vpLayoutBinding.descriptorCount = 1;		// number of descriptor for binding
+	vpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;		// Shader stage to bind to
+	vpLayoutBinding.pImmutableSamplers = nullptr;			// Fopr texture: can make sampler data unchangeable (imutable) by specifying in layout
+
+	// Model layout binding
+	VkDescriptorSetLayoutBinding modelLayoutBinding = {};
+	modelLayoutBinding.binding = 1;
+	modelLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	modelLayoutBinding.descriptorCount = 1;
+	modelLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	modelLayoutBinding.pImmutableSamplers = nullptr;
+
+	// Clustered lighting bindings: lights, cluster ranges and light indices (read by the fragment shader)
+	VkDescriptorSetLayoutBinding lightLayoutBinding = {};
+	lightLayoutBinding.binding = 2;
+	lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	lightLayoutBinding.descriptorCount = 1;
+	lightLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	lightLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding clusterLayoutBinding = lightLayoutBinding;
+	clusterLayoutBinding.binding = 3;
+
+	VkDescriptorSetLayoutBinding lightIndexLayoutBinding = lightLayoutBinding;
+	lightIndexLayoutBinding.binding = 4;
+
+	// List of descriptor set layout bindings
+	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { vpLayoutBinding , modelLayoutBinding,
+		lightLayoutBinding, clusterLayoutBinding, lightIndexLayoutBinding };
+
+
+	// Create descriptor set layout with given bindings
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());		// number of binding info	
+	layoutCreateInfo.pBindings = layoutBindings.data();		// array of binding infos
+
+
+	// Create descriptor set layour
+	VkResult result = vkCreateDescriptorSetLayout(m_MainDevice.LogicalDevice, &layoutCreateInfo, nullptr, &m_DescriptorSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
 
 	// CREATE TEXTURE SAMPLER DESCRIPTOR SET LAYOUT
-	// Texture binding info
+	// Texture table binding info: one large array of textures, indexed in the shader (bindless)
 	VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
 	samplerLayoutBinding.binding = 0;
 	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.descriptorCount = 1;
+	samplerLayoutBinding.descriptorCount = m_MaxTextures;
 	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	samplerLayoutBinding.pImmutableSamplers = nullptr;
 
+	// Slots may stay empty (partially bound) and new textures can be written while the set is in use (update after bind)
+	VkDescriptorBindingFlags samplerBindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo samplerBindingFlagsCreateInfo = {};
+	samplerBindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	samplerBindingFlagsCreateInfo.bindingCount = 1;
+	samplerBindingFlagsCreateInfo.pBindingFlags = &samplerBindingFlags;
 
 	VkDescriptorSetLayoutCreateInfo textureLayoutCreateInfo = {};
 	textureLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	textureLayoutCreateInfo.pNext = &samplerBindingFlagsCreateInfo;
+	textureLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
 	textureLayoutCreateInfo.bindingCount = 1;
 	textureLayoutCreateInfo.pBindings = &samplerLayoutBinding;
 
@@ -706,193 +1318,132 @@ void VulkanRenderer::CreateDescriptorSetLayout()
 	}
 
 
-	// CREATE INPUT ATTACHMENT IMAGE DESCRIPTOR SET LAYOUT
+	// CREATE COMPOSITE DESCRIPTOR SET LAYOUT (compute: color and depth of the scene pass in, scene color out)
 	// Color input binding
 	VkDescriptorSetLayoutBinding colorInputLayoutBinding = {};
 	colorInputLayoutBinding.binding = 0;
-	colorInputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	colorInputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	colorInputLayoutBinding.descriptorCount = 1;
-	colorInputLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	colorInputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	// Color input binding
+	// Depth input binding
 	VkDescriptorSetLayoutBinding depthInputLayoutBinding = {};
 	depthInputLayoutBinding.binding = 1;
-	depthInputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	depthInputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	depthInputLayoutBinding.descriptorCount = 1;
-	depthInputLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	depthInputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// Scene color output binding
+	VkDescriptorSetLayoutBinding sceneColorOutputLayoutBinding = {};
+	sceneColorOutputLayoutBinding.binding = 2;
+	sceneColorOutputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	sceneColorOutputLayoutBinding.descriptorCount = 1;
+	sceneColorOutputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// Hi-Z tiles output binding (hiz.comp, same set as the composite)
+	VkDescriptorSetLayoutBinding hiZOutputLayoutBinding = {};
+	hiZOutputLayoutBinding.binding = 3;
+	hiZOutputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	hiZOutputLayoutBinding.descriptorCount = 1;
+	hiZOutputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	std::array<VkDescriptorSetLayoutBinding, 4> compositeBindings = { colorInputLayoutBinding, depthInputLayoutBinding,
+		sceneColorOutputLayoutBinding, hiZOutputLayoutBinding };
+
+	VkDescriptorSetLayoutCreateInfo compositeLayoutCreateInfo = {};
+	compositeLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	compositeLayoutCreateInfo.bindingCount = static_cast<uint32_t>(compositeBindings.size());
+	compositeLayoutCreateInfo.pBindings = compositeBindings.data();
 
-	// Arrays of input attachment bindings
-	std::array< VkDescriptorSetLayoutBinding, 2> inputBindings = { colorInputLayoutBinding , depthInputLayoutBinding };
+	// Create descriptor set layout
+	result = vkCreateDescriptorSetLayout(m_MainDevice.LogicalDevice, &compositeLayoutCreateInfo, nullptr, &m_CompositeDescriptorSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Composite Descriptor Set Layout!");
+	}
 
-	// Create descriptor set layout for input attachments
-	VkDescriptorSetLayoutCreateInfo inputLayoutCreateInfo = {};
-	inputLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	inputLayoutCreateInfo.bindingCount = static_cast<uint32_t>(inputBindings.size());
-	inputLayoutCreateInfo.pBindings = inputBindings.data();
+	// CREATE UPSCALE DESCRIPTOR SET LAYOUT (scene color, sampled with a filter)
+	VkDescriptorSetLayoutBinding sceneColorLayoutBinding = {};
+	sceneColorLayoutBinding.binding = 0;
+	sceneColorLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	sceneColorLayoutBinding.descriptorCount = 1;
+	sceneColorLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	sceneColorLayoutBinding.pImmutableSamplers = nullptr;
 
-	// Create descriptor set layout
-	result = vkCreateDescriptorSetLayout(m_MainDevice.LogicalDevice, &inputLayoutCreateInfo, nullptr, &m_InputDescriptorSetLayout);
+	VkDescriptorSetLayoutCreateInfo upscaleLayoutCreateInfo = {};
+	upscaleLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	upscaleLayoutCreateInfo.bindingCount = 1;
+	upscaleLayoutCreateInfo.pBindings = &sceneColorLayoutBinding;
+
+	result = vkCreateDescriptorSetLayout(m_MainDevice.LogicalDevice, &upscaleLayoutCreateInfo, nullptr, &m_UpscaleDescriptorSetLayout);
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to create a Input Descriptor Set Layout!");
+		throw std::runtime_error("Failed to create a Upscale Descriptor Set Layout!");
 	}
 
+	// CREATE G-BUFFER DESCRIPTOR SET LAYOUT (deferred lighting: albedo, normal and depth as input attachments)
+	if (m_Settings.DeferredShading)
+	{
+		std::array<VkDescriptorSetLayoutBinding, 3> gBufferBindings = {};
+		for (uint32_t i = 0; i < gBufferBindings.size(); i++)
+		{
+			gBufferBindings[i].binding = i;
+			gBufferBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			gBufferBindings[i].descriptorCount = 1;
+			gBufferBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo gBufferLayoutCreateInfo = {};
+		gBufferLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		gBufferLayoutCreateInfo.bindingCount = static_cast<uint32_t>(gBufferBindings.size());
+		gBufferLayoutCreateInfo.pBindings = gBufferBindings.data();
+
+		result = vkCreateDescriptorSetLayout(m_MainDevice.LogicalDevice, &gBufferLayoutCreateInfo, nullptr, &m_GBufferDescriptorSetLayout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a G-Buffer Descriptor Set Layout!");
+		}
+	}
+
+	// CREATE SKINNING DESCRIPTOR SET LAYOUT (bind pose vertices, joints and weights, skin matrices, skinned vertices)
+	std::array<VkDescriptorSetLayoutBinding, 4> skinningBindings = {};
+	for (uint32_t i = 0; i < skinningBindings.size(); i++)
+	{
+		skinningBindings[i].binding = i;
+		skinningBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		skinningBindings[i].descriptorCount = 1;
+		skinningBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo skinningLayoutCreateInfo = {};
+	skinningLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	skinningLayoutCreateInfo.bindingCount = static_cast<uint32_t>(skinningBindings.size());
+	skinningLayoutCreateInfo.pBindings = skinningBindings.data();
+
+	result = vkCreateDescriptorSetLayout(m_MainDevice.LogicalDevice, &skinningLayoutCreateInfo, nullptr, &m_SkinningDescriptorSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Skinning Descriptor Set Layout!");
+	}
 }
 
 void VulkanRenderer::CreateGraphicsPipeline()
 {
-	// Read in SPIR-V code 
-	auto vertexShaderCode = readSPVFile("src/Shaders/vert.spv");
-	auto fragmentShaderCode = readSPVFile("src/Shaders/frag.spv");
-
-	// Build Shader Module to link to graphics pipeline
-	VkShaderModule vertexShaderModule = CreateShaderModule(vertexShaderCode);
-	VkShaderModule fragmentShaderModule = CreateShaderModule(fragmentShaderCode);
-
-	// shader state creation information
-	// vertex stage create information
-	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
-	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertexShaderCreateInfo.module = vertexShaderModule;
-	vertexShaderCreateInfo.pName = "main";
-
-	// fragment stage create information
-	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
-	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragmentShaderCreateInfo.module = fragmentShaderModule;
-	fragmentShaderCreateInfo.pName = "main";
-
-	// put shader state creation info in to array
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo , fragmentShaderCreateInfo };
-
-	// How the data for a single vertex (including info such as position, color, texture coordinates, normals, etc) is as in whole
-	VkVertexInputBindingDescription bindingDescription = {};
-	bindingDescription.binding = 0;			// Can bind multiple streams of data, this defines which one
-	bindingDescription.stride = sizeof(Vertex);		// size of a single vertex object
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;	// How to move between data after each vertex
-																// VK_VERTEX_INPUT_RATE_INSTANCE: move to a vertex for next 
-
-	// How the data for an attribute is defined within a vertex
-	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions;
-
-	// Position attribute
-	attributeDescriptions[0].binding = 0;
-	attributeDescriptions[0].location = 0;			// location in shader wherre data will be read from
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;  // format the data will take (also it helps define size opf data)
-	attributeDescriptions[0].offset = offsetof(Vertex, Position); // where this attribute is defined in the data for a single vertex
-
-	// Color attribute 
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;			// location in shader wherre data will be read from
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;  // format the data will take (also it helps define size opf data)
-	attributeDescriptions[1].offset = offsetof(Vertex, Color); // where this attribute is defined in the data for a single vertex
-	
-	// Texture attribute
-	attributeDescriptions[2].binding = 0;
-	attributeDescriptions[2].location = 2;			// location in shader wherre data will be read from
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;  // format the data will take (also it helps define size opf data)
-	attributeDescriptions[2].offset = offsetof(Vertex, TextureCoords); // where this attribute is defined in the data for a single vertex
-
-	// Create PIPELINE
-	// -- Vertex Input
-	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
-	vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription; // list of binding description (data spacing, stride info)
-	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); // list of vertex attribite descriptions(data format and where to binding)
-
-
-	// -- Input Assembly
-	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
-	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;		// Allow overrinding of `strip` topology to start new primitives
-
-	// -- Viewport & Scissor
-	// Create a viewport info struct
-	VkViewport viewport = {};
-	viewport.x = 0.0f; viewport.y = 0.0f;  // start coordinates
-	viewport.width = (float)m_SwapchainExtent.width;  // viewport width and height
-	viewport.height = (float)m_SwapchainExtent.height;
-	viewport.minDepth = 0.0f; viewport.maxDepth = 1.0f;
-
-	// Create a scissor info struct
-	VkRect2D scissor = {};
-	scissor.offset = { 0,0 };		// offset to use region from
-	scissor.extent = m_SwapchainExtent; // extent to describe region to use, starting at offset
-
-	//
-	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportStateCreateInfo.viewportCount = 1;
-	viewportStateCreateInfo.pViewports = &viewport;
-	viewportStateCreateInfo.scissorCount = 1;
-	viewportStateCreateInfo.pScissors = &scissor;
-
-	// -- Dynamic States
-	// Dynamic states to enable
-	std::vector<VkDynamicState> dynamicStateEnables;
-	// dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT); // dynamic viewport: can resize in command buffer with vkCmdSetViewport(commandbuffer,0, 1, &viewport)
-	// dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR); // dynamic scissor: can resize in command buffer scissor vkCmdSetScissor(commandbuffer, 0, 1, &scissor)
-
-	// dynamic state create info
-	VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
-	dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
-	dynamicStateCreateInfo.pDynamicStates = dynamicStateEnables.data();
-
-	// -- Rasterizer
-	// Convert primitive into fragments
-	VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
-	rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizerCreateInfo.depthClampEnable = VK_FALSE;		// Change if fragments beyond near/far planes are clipped (default) or clamped to plane (To use we need to set device feature of GPU)
-	rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE; //Whether to discard data and skip rasterizer. Never creates framents, only suitable for pipeline without framebuffer output
-	rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL; // how to handle filling points between vertices
-	rasterizerCreateInfo.lineWidth = 1.0f;		// how thick line should be when drawn (for > 1.0f it is need to enable on gpu)
-	rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;	// which face of a triangle to cull
-	rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // winding to determine which side is front
-	rasterizerCreateInfo.depthBiasEnable = VK_FALSE;		// Whether to add depth bias to fragments (good for stopping `shadow acne` in shadow mapping)
-
-	// -- Multisampling
-	VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
-	multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;
-	multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;	// number of samples to use per fragment
-
-	// -- Blending
-
-	// Blending attachment state (how blending is handled)
-	VkPipelineColorBlendAttachmentState colorState = {};
-	colorState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
-								|VK_COLOR_COMPONENT_B_BIT  | VK_COLOR_COMPONENT_A_BIT;  // colors to apply blending to
-	colorState.blendEnable = VK_TRUE;	
-	// Blending uses equation: (srcColorBlendFactor * new color) colorBlendOp(dstColorBlendFactor * old color)
-	colorState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	colorState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	colorState.colorBlendOp = VK_BLEND_OP_ADD;
-	colorState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorState.alphaBlendOp = VK_BLEND_OP_ADD;
-
-	VkPipelineColorBlendStateCreateInfo colorBlendingCreateInfo = {};
-	colorBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlendingCreateInfo.logicOpEnable = VK_FALSE;
-	colorBlendingCreateInfo.logicOp = VK_LOGIC_OP_COPY;
-	colorBlendingCreateInfo.attachmentCount = 1;
-	colorBlendingCreateInfo.pAttachments = &colorState;
-
 	// -- Pipeline layout 
 	std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = { m_DescriptorSetLayout, m_SamplerDescriptorSetLayout };
+
+	// Material push constant (index into the texture table)
+	VkPushConstantRange materialPushConstantRange = {};
+	materialPushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	materialPushConstantRange.offset = 0;
+	materialPushConstantRange.size = sizeof(PushMaterial);
 	
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 	pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts.data();
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &materialPushConstantRange;
 
 	// Create pipeline layout
 	VkResult result = vkCreatePipelineLayout(m_MainDevice.LogicalDevice, &pipelineLayoutCreateInfo, nullptr, &m_PipelineLayout);
@@ -901,193 +1452,198 @@ void VulkanRenderer::CreateGraphicsPipeline()
 		throw std::runtime_error("Failed to create pipeline layout!");
 	}
 
-	// -- Depth Stencil Testing
-	// Depth stencil testing
-	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
-	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencilCreateInfo.depthTestEnable = VK_TRUE;		// Enable checking depth to determine fragment write
-	depthStencilCreateInfo.depthWriteEnable = VK_TRUE;	// Enable writing to depth buffer (to replace old values)
-	depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;	// Comparison operation that allows an overwrite (it is in front)
-	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;		// Depth bound test: does the depth value exist between bounds
-	depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
-
-
-	// -- Graphics pipeline creation
-	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineCreateInfo.stageCount = 2;			// number of shader stages
-	pipelineCreateInfo.pStages = shaderStages;
-	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;		// All the fixed function pipeline states
-	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
-	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
-	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
-	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
-	pipelineCreateInfo.pColorBlendState = &colorBlendingCreateInfo;
-	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
-	pipelineCreateInfo.layout = m_PipelineLayout;		// pipeline layout pipeline should iuse
-	pipelineCreateInfo.renderPass = m_RenderPass;		// Render pass description the pipeline is compatible with
-	pipelineCreateInfo.subpass = 0;						// subspass of render pass to use with pipeline
-
-
-	// Pipeline derivatives: can create multiple pipelines that derive from one another for optimization
-	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;	// Existing pipeline to derive from...
-	pipelineCreateInfo.basePipelineIndex = -1;		// or index of pipeline being created to derive from (in case creating multiple at once)
-
-	// Create graphics pipeline
-	result = vkCreateGraphicsPipelines(m_MainDevice.LogicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_GraphicsPipeline);
+	// Composite pipeline layout (scene pass images + render size of the split)
+	VkPushConstantRange compositePushConstantRange = {};
+	compositePushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	compositePushConstantRange.offset = 0;
+	compositePushConstantRange.size = sizeof(PushComposite);
+
+	VkPipelineLayoutCreateInfo compositePipelineLayoutCreateInfo = {};
+	compositePipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	compositePipelineLayoutCreateInfo.setLayoutCount = 1;
+	compositePipelineLayoutCreateInfo.pSetLayouts = &m_CompositeDescriptorSetLayout;
+	compositePipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	compositePipelineLayoutCreateInfo.pPushConstantRanges = &compositePushConstantRange;
 
+	result = vkCreatePipelineLayout(m_MainDevice.LogicalDevice, &compositePipelineLayoutCreateInfo, nullptr, &m_CompositePipelineLayout);
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to create a graphics pipeline!");
+		throw std::runtime_error("Failed to create composite pipeline layout!");
 	}
 
-	// Destroy shader modules
-	vkDestroyShaderModule(m_MainDevice.LogicalDevice, fragmentShaderModule, nullptr);
-	vkDestroyShaderModule(m_MainDevice.LogicalDevice, vertexShaderModule, nullptr);
+	// Upscale pipeline layout (scene color + its size)
+	VkPushConstantRange upscalePushConstantRange = {};
+	upscalePushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	upscalePushConstantRange.offset = 0;
+	upscalePushConstantRange.size = sizeof(PushUpscale);
 
+	VkPipelineLayoutCreateInfo upscalePipelineLayoutCreateInfo = {};
+	upscalePipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	upscalePipelineLayoutCreateInfo.setLayoutCount = 1;
+	upscalePipelineLayoutCreateInfo.pSetLayouts = &m_UpscaleDescriptorSetLayout;
+	upscalePipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	upscalePipelineLayoutCreateInfo.pPushConstantRanges = &upscalePushConstantRange;
 
-	// TO DO: CREATE A GENERAL FUNCTION TO CREATE PIPELINE
-	// ------------------------------------------------------------
-	// CREATE SECOND PASS PIPELINE
-	// Second pass shaders
-	auto secondVertexShaderCode = readSPVFile("src/Shaders/second_vert.spv");
-	auto secondFragmentShaderCode = readSPVFile("src/Shaders/second_frag.spv");
+	result = vkCreatePipelineLayout(m_MainDevice.LogicalDevice, &upscalePipelineLayoutCreateInfo, nullptr, &m_UpscalePipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upscale pipeline layout!");
+	}
 
-	// Build shaders
-	VkShaderModule secondVertexShaderModule = CreateShaderModule(secondVertexShaderCode);
-	VkShaderModule secondFragmentShaderModule = CreateShaderModule(secondFragmentShaderCode);
+	// Lighting pipeline layout (frame set for the lights, G-buffer inputs + inverse projection)
+	if (m_Settings.DeferredShading)
+	{
+		std::array<VkDescriptorSetLayout, 2> lightingSetLayouts = { m_DescriptorSetLayout, m_GBufferDescriptorSetLayout };
 
-	// Set new shaders
-	vertexShaderCreateInfo.module = secondVertexShaderModule;
-	fragmentShaderCreateInfo.module = secondFragmentShaderModule;
+		VkPushConstantRange lightingPushConstantRange = {};
+		lightingPushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		lightingPushConstantRange.offset = 0;
+		lightingPushConstantRange.size = sizeof(PushLighting);
 
-	VkPipelineShaderStageCreateInfo secondShaderStages[] = { vertexShaderCreateInfo , fragmentShaderCreateInfo };
+		VkPipelineLayoutCreateInfo lightingPipelineLayoutCreateInfo = {};
+		lightingPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		lightingPipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(lightingSetLayouts.size());
+		lightingPipelineLayoutCreateInfo.pSetLayouts = lightingSetLayouts.data();
+		lightingPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		lightingPipelineLayoutCreateInfo.pPushConstantRanges = &lightingPushConstantRange;
 
-	// No vertex data for second pass
-	vertexInputCreateInfo.vertexBindingDescriptionCount = 0;
-	vertexInputCreateInfo.pVertexBindingDescriptions = nullptr;
-	vertexInputCreateInfo.vertexAttributeDescriptionCount = 0;
-	vertexInputCreateInfo.pVertexAttributeDescriptions = nullptr;
+		result = vkCreatePipelineLayout(m_MainDevice.LogicalDevice, &lightingPipelineLayoutCreateInfo, nullptr, &m_LightingPipelineLayout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create lighting pipeline layout!");
+		}
+	}
 
-	// Disable depth buffer (Dont want to write to depth buffer)
-	depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
+	// Skinning pipeline layout (buffers of one skinned mesh + its vertex count and joint offset)
+	VkPushConstantRange skinningPushConstantRange = {};
+	skinningPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	skinningPushConstantRange.offset = 0;
+	skinningPushConstantRange.size = sizeof(PushSkinning);
 
-	// Create new pipeline layout
-	VkPipelineLayoutCreateInfo secondPipelineLayoutCreateInfo = {};
-	secondPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	secondPipelineLayoutCreateInfo.setLayoutCount = 1;
-	secondPipelineLayoutCreateInfo.pSetLayouts = &m_InputDescriptorSetLayout;
-	secondPipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	secondPipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+	VkPipelineLayoutCreateInfo skinningPipelineLayoutCreateInfo = {};
+	skinningPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	skinningPipelineLayoutCreateInfo.setLayoutCount = 1;
+	skinningPipelineLayoutCreateInfo.pSetLayouts = &m_SkinningDescriptorSetLayout;
+	skinningPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	skinningPipelineLayoutCreateInfo.pPushConstantRanges = &skinningPushConstantRange;
 
-	result = vkCreatePipelineLayout(m_MainDevice.LogicalDevice, &secondPipelineLayoutCreateInfo, nullptr, &m_SecondPipelineLayout);
+	result = vkCreatePipelineLayout(m_MainDevice.LogicalDevice, &skinningPipelineLayoutCreateInfo, nullptr, &m_SkinningPipelineLayout);
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to create second pipeline layout!");
+		throw std::runtime_error("Failed to create skinning pipeline layout!");
 	}
 
-	pipelineCreateInfo.pStages = secondShaderStages;	// update second shader stage list
-	pipelineCreateInfo.layout = m_SecondPipelineLayout;	// change pipeline for input attachment descriptor sets
-	pipelineCreateInfo.subpass = 1;	// use second subpass
+	// Pipelines are compiled by the pipeline manager, which shares permutations and the pipeline cache
+	m_PipelineManager.Init(m_MainDevice.LogicalDevice, m_PipelineCache, m_JobSystem);
+
+	// FIRST PASS PIPELINE
+	PipelineDesc pipelineDesc = {};
+	pipelineDesc.VertexShader = "src/Shaders/vert.spv";
+	pipelineDesc.FragmentShader = "src/Shaders/frag.spv";
 
-	// Create second pipeline
-	result = vkCreateGraphicsPipelines(m_MainDevice.LogicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_SecondPipeline);
-	if (result != VK_SUCCESS)
+	// How the data for a single vertex (position, color, texture coordinates) is laid out
+	pipelineDesc.VertexStride = sizeof(Vertex);
+	pipelineDesc.VertexAttributes = {
+		{ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, Position)) },		// location, binding, format, offset
+		{ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, Color)) },
+		{ 2, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, TextureCoords)) },
+		{ 3, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, Normal)) }
+	};
+
+	pipelineDesc.CullMode = VK_CULL_MODE_BACK_BIT;
+	pipelineDesc.FrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	// Depth test and write, alpha blending
+	pipelineDesc.DepthTest = true;
+	pipelineDesc.DepthWrite = true;
+	pipelineDesc.DepthCompareOp = VK_COMPARE_OP_LESS;
+	pipelineDesc.BlendEnable = true;
+
+	pipelineDesc.Layout = m_PipelineLayout;
+	pipelineDesc.RenderPass = m_RenderGraph.GetRenderPass(m_GeometryPass);
+	pipelineDesc.Subpass = m_RenderGraph.GetSubpass(m_GeometryPass);
+
+	// Deferred: fill the G-buffer instead (no blending, a G-buffer texel can't blend two surfaces)
+	if (m_Settings.DeferredShading)
 	{
-		throw std::runtime_error("Failed to create second graphiscs pipeline!");
+		pipelineDesc.FragmentShader = "src/Shaders/gbuffer_frag.spv";
+		pipelineDesc.ColorAttachmentCount = 2;
+		pipelineDesc.BlendEnable = false;
 	}
 
-	// Destroy second shader modules
-	vkDestroyShaderModule(m_MainDevice.LogicalDevice, secondFragmentShaderModule, nullptr);
-	vkDestroyShaderModule(m_MainDevice.LogicalDevice, secondVertexShaderModule, nullptr);
-}
+	// Startup pipelines are compiled right away so there is always a ready variant to fall back to
+	m_GraphicsPipelineID = m_PipelineManager.Create(pipelineDesc);
 
-void VulkanRenderer::CreateDepthBufferImage()
-{
-	// 1 depth buffer image to each swapchain
-	m_DepthBufferImage.resize(m_SwapChainImages.size());
-	m_DepthBufferImageMemory.resize(m_SwapChainImages.size());
-	m_DepthBufferImageView.resize(m_SwapChainImages.size());
+	// COMPOSITE PIPELINE (compute, runs on the async compute queue when there is one)
+	m_CompositePipelineDesc = {};
+	m_CompositePipelineDesc.ComputeShader = "src/Shaders/composite_comp.spv";
 
-	// Get supported format for depth buffer
-	m_DepthBufferFormat = ChooseSupportedFormat(
-		{VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT},
-		VK_IMAGE_TILING_OPTIMAL, 
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-	);
+	// Split screen in the middle, left shows color and right shows depth in [lowerBound, upperBound]
+	// (split is a share of the width, the render width itself changes with the dynamic resolution)
+	m_CompositePipelineDesc.SpecializationConstants = {
+		SpecializationConstant::Float(0, 0.5f),			// xSplit
+		SpecializationConstant::Float(1, 0.98f),		// lowerBound
+		SpecializationConstant::Float(2, 1.0f)			// upperBound
+	};
 
-	// Create buffer image amd image view
-	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
-	{
-		// Create depth buffer image
-		m_DepthBufferImage[i] = CreateImage(m_SwapchainExtent.width, m_SwapchainExtent.height, m_DepthBufferFormat, VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_DepthBufferImageMemory[i]);
+	m_CompositePipelineDesc.Layout = m_CompositePipelineLayout;
 
-		// Create depth buffer image view
-		m_DepthBufferImageView[i] = CreateImageView(m_DepthBufferImage[i], m_DepthBufferFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-	}
-	
-}
+	m_CompositePipelineID = m_PipelineManager.Create(m_CompositePipelineDesc);
 
-void VulkanRenderer::CreateColorBufferImage()
-{
-	// Resize supported format for color attachment
-	// Resize the color buffer image (1 buffer for each swapchain)
-	m_ColorBufferImage.resize(m_SwapChainImages.size());
-	m_ColorBufferImageMemory.resize(m_SwapChainImages.size());
-	m_ColorBufferImageView.resize(m_SwapChainImages.size());
+	// HI-Z PIPELINE (compute, recorded right after the composite, which already reads the depth)
+	PipelineDesc hiZDesc = {};
+	hiZDesc.ComputeShader = "src/Shaders/hiz_comp.spv";
+	hiZDesc.Layout = m_CompositePipelineLayout;
 
-	// Get supported format for color buffer
-	VkFormat colorBufferFormat = ChooseSupportedFormat(
-		{ VK_FORMAT_R8G8B8A8_UNORM},		// Formats
-		VK_IMAGE_TILING_OPTIMAL,			// tiling
-		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL // featureFlags
-	);
+	m_HiZPipelineID = m_PipelineManager.Create(hiZDesc);
+
+	// SKINNING PIPELINE (compute, recorded before the geometry on the graphics queue)
+	PipelineDesc skinningDesc = {};
+	skinningDesc.ComputeShader = "src/Shaders/skinning_comp.spv";
+	skinningDesc.Layout = m_SkinningPipelineLayout;
+
+	m_SkinningPipelineID = m_PipelineManager.Create(skinningDesc);
 
-	// Create buffer image amd image view
-	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+	// UPSCALE PIPELINE (fullscreen triangle, Catmull-Rom filter of the scene color)
+	PipelineDesc upscaleDesc = {};
+	upscaleDesc.VertexShader = "src/Shaders/upscale_vert.spv";
+	upscaleDesc.FragmentShader = "src/Shaders/upscale_frag.spv";
+	upscaleDesc.CullMode = VK_CULL_MODE_NONE;
+	upscaleDesc.DepthTest = false;
+	upscaleDesc.DepthWrite = false;
+	upscaleDesc.BlendEnable = false;
+	upscaleDesc.Layout = m_UpscalePipelineLayout;
+	upscaleDesc.RenderPass = m_RenderGraph.GetRenderPass(m_UpscalePass);
+	upscaleDesc.Subpass = m_RenderGraph.GetSubpass(m_UpscalePass);
+
+	m_UpscalePipelineID = m_PipelineManager.Create(upscaleDesc);
+
+	// LIGHTING PIPELINE (deferred, fullscreen triangle in the subpass after the G-buffer)
+	if (m_Settings.DeferredShading)
 	{
-		// Create depth buffer image
-		m_ColorBufferImage[i] = CreateImage(m_SwapchainExtent.width, m_SwapchainExtent.height, colorBufferFormat, VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_ColorBufferImageMemory[i]);
+		PipelineDesc lightingDesc = {};
+		lightingDesc.VertexShader = "src/Shaders/lighting_vert.spv";
+		lightingDesc.FragmentShader = "src/Shaders/lighting_frag.spv";
+		lightingDesc.CullMode = VK_CULL_MODE_NONE;
+		lightingDesc.DepthTest = false;
+		lightingDesc.DepthWrite = false;
+		lightingDesc.BlendEnable = false;
+		lightingDesc.Layout = m_LightingPipelineLayout;
+		lightingDesc.RenderPass = m_RenderGraph.GetRenderPass(m_LightingPass);
+		lightingDesc.Subpass = m_RenderGraph.GetSubpass(m_LightingPass);
 
-		// Create depth buffer image view
-		m_ColorBufferImageView[i] = CreateImageView(m_ColorBufferImage[i], colorBufferFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		m_LightingPipelineID = m_PipelineManager.Create(lightingDesc);
 	}
 }
 
-void VulkanRenderer::CreateFramebuffers()
+void VulkanRenderer::SetDepthVisualizationRange(float lowerBound, float upperBound)
 {
-	// Resize framebuffer count to equal the swapchain images count
-	m_SwapChainFramebuffers.resize(m_SwapChainImages.size());
+	// New permutation compiles in the background, the current one keeps being used until it is ready
+	PipelineDesc desc = m_CompositePipelineDesc;
+	desc.SpecializationConstants[1] = SpecializationConstant::Float(1, lowerBound);
+	desc.SpecializationConstants[2] = SpecializationConstant::Float(2, upperBound);
 
-	// Create a framebuffer for each swapchain image
-	for (size_t i = 0; i < m_SwapChainFramebuffers.size(); i++)
-	{
-		std::array<VkImageView, 3> attachments = {
-			m_SwapChainImages[i].ImageView,
-			m_ColorBufferImageView[i],
-			m_DepthBufferImageView[i]
-		};
-
-		VkFramebufferCreateInfo framebufferCreateInfo = {};
-		framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferCreateInfo.renderPass = m_RenderPass;			//Render pass layout that framebuffer will be used with
-		framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size()); 
-		framebufferCreateInfo.pAttachments = attachments.data();  // list of attachments (1:1 with render pass)
-		framebufferCreateInfo.width = m_SwapchainExtent.width;
-		framebufferCreateInfo.height = m_SwapchainExtent.height;
-		framebufferCreateInfo.layers = 1;
-
-		VkResult result = vkCreateFramebuffer(m_MainDevice.LogicalDevice, &framebufferCreateInfo, nullptr, &m_SwapChainFramebuffers[i]);
-		
-		if (result != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create a framebuffer!");
-		}
-	}
+	m_CompositePipelineID = m_PipelineManager.Request(desc);
 }
 
 void VulkanRenderer::CreateCommandPool()
@@ -1106,52 +1662,116 @@ void VulkanRenderer::CreateCommandPool()
 	{
 		throw std::runtime_error("Failed to create command pool!");
 	}
+
+	// One pool per frame in flight, reset as a whole once the graphics timeline has reached the frame
+	m_Frames.resize(m_Settings.FramesInFlight);
+
+	VkCommandPoolCreateInfo framePoolInfo = {};
+	framePoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	framePoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;		// buffers are short lived (re-recorded each frame)
+	framePoolInfo.queueFamilyIndex = queueFamilyIndices.GraphicsFamily;
+
+	// Async compute: the composite is recorded into a pool of the compute family
+	VkCommandPoolCreateInfo computePoolInfo = framePoolInfo;
+	computePoolInfo.queueFamilyIndex = queueFamilyIndices.ComputeFamily;
+
+	for (FrameContext& frame : m_Frames)
+	{
+		result = vkCreateCommandPool(m_MainDevice.LogicalDevice, &framePoolInfo, nullptr, &frame.CommandPool);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create frame command pool!");
+		}
+
+		if (m_AsyncCompute)
+		{
+			result = vkCreateCommandPool(m_MainDevice.LogicalDevice, &computePoolInfo, nullptr, &frame.ComputeCommandPool);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create frame compute command pool!");
+			}
+		}
+	}
 }
 
 void VulkanRenderer::CreateCommandBuffers()
 {
-	// Resize command buffer count to have one for each framebuffer
-	m_CommandBuffers.resize(m_SwapChainFramebuffers.size());
-
-	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	commandBufferAllocateInfo.commandPool = m_GraphicsCommandPool;
-	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // VK_COMMAND_BUFFER_LEVEL_PRIMARY : buffer you submit directly to queue. Cant be called by other buffer.
-																	   // VK_COMMAND_BUFFER_LEVEL_SECONDARY : buffer cant be called directly. Can be called from other buffers via vkCmdExecuteCommand when recording commands in primary buffer
-	commandBufferAllocateInfo.commandBufferCount = static_cast<uint32_t>(m_CommandBuffers.size());
+	// One command buffer for each frame in flight, allocated from the frame's own pool
+	for (FrameContext& frame : m_Frames)
+	{
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.commandPool = frame.CommandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // VK_COMMAND_BUFFER_LEVEL_PRIMARY : buffer you submit directly to queue. Cant be called by other buffer.
+																		   // VK_COMMAND_BUFFER_LEVEL_SECONDARY : buffer cant be called directly. Can be called from other buffers via vkCmdExecuteCommand when recording commands in primary buffer
+		commandBufferAllocateInfo.commandBufferCount = 1;
 	
-	// Allocate command buffer and place handles in array of buffers
-	VkResult result = vkAllocateCommandBuffers(m_MainDevice.LogicalDevice, &commandBufferAllocateInfo, m_CommandBuffers.data());
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate Command Buffers!");
+		VkResult result = vkAllocateCommandBuffers(m_MainDevice.LogicalDevice, &commandBufferAllocateInfo, &frame.CommandBuffer);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate Command Buffers!");
+		}
+
+		// Async compute: the frame is split into geometry (above), composite and upscale/present submits
+		if (m_AsyncCompute)
+		{
+			result = vkAllocateCommandBuffers(m_MainDevice.LogicalDevice, &commandBufferAllocateInfo, &frame.PresentCommandBuffer);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate Command Buffers!");
+			}
+
+			commandBufferAllocateInfo.commandPool = frame.ComputeCommandPool;
+			result = vkAllocateCommandBuffers(m_MainDevice.LogicalDevice, &commandBufferAllocateInfo, &frame.ComputeCommandBuffer);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate Command Buffers!");
+			}
+		}
 	}
 }
 
 void VulkanRenderer::CreateSynchronization()
 {
-	m_SemaphoresImageAvailable.resize(MAX_FRAME_DRAWS);
-	m_SemaphoresRenderFinished.resize(MAX_FRAME_DRAWS);
-	m_DrawFences.resize(MAX_FRAME_DRAWS);
-
 	// Semaphore creation information
 	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
 	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	// Fence creation info
-	VkFenceCreateInfo fenceCreateInfo = {};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	// Binary semaphores: swapchain acquire and present, geometry to composite (async compute)
+	for (FrameContext& frame : m_Frames)
 	{
-		if (vkCreateSemaphore(m_MainDevice.LogicalDevice, &semaphoreCreateInfo, nullptr, &m_SemaphoresImageAvailable[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(m_MainDevice.LogicalDevice, &semaphoreCreateInfo, nullptr, &m_SemaphoresRenderFinished[i]) != VK_SUCCESS || 
-			vkCreateFence(m_MainDevice.LogicalDevice, &fenceCreateInfo, nullptr, &m_DrawFences[i]) != VK_SUCCESS)
+		if (vkCreateSemaphore(m_MainDevice.LogicalDevice, &semaphoreCreateInfo, nullptr, &frame.ImageAvailable) != VK_SUCCESS ||
+			vkCreateSemaphore(m_MainDevice.LogicalDevice, &semaphoreCreateInfo, nullptr, &frame.RenderFinished) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create semaphores!");
+		}
+
+		if (m_AsyncCompute &&
+			vkCreateSemaphore(m_MainDevice.LogicalDevice, &semaphoreCreateInfo, nullptr, &frame.GeometryFinished) != VK_SUCCESS)
 		{
-			throw std::runtime_error("Failed to create semaphore and/or fence!");
+			throw std::runtime_error("Failed to create semaphores!");
 		}
 	}
+
+	// One timeline per queue, signalled with the frame number (the upscale waits on the compute one)
+	VkSemaphoreTypeCreateInfo timelineCreateInfo = {};
+	timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineCreateInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo timelineSemaphoreCreateInfo = semaphoreCreateInfo;
+	timelineSemaphoreCreateInfo.pNext = &timelineCreateInfo;
+
+	if (vkCreateSemaphore(m_MainDevice.LogicalDevice, &timelineSemaphoreCreateInfo, nullptr, &m_GraphicsTimeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timeline semaphores!");
+	}
+
+	if (m_AsyncCompute &&
+		vkCreateSemaphore(m_MainDevice.LogicalDevice, &timelineSemaphoreCreateInfo, nullptr, &m_ComputeTimeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timeline semaphores!");
+	}
 }
 
 void VulkanRenderer::CreateTextureSampler()
@@ -1179,6 +1799,32 @@ void VulkanRenderer::CreateTextureSampler()
 	{
 		throw std::runtime_error("Failed to create texture sampler!");
 	}
+
+	// Upscale sampler: bilinear taps of the Catmull-Rom filter, clamped so the edge of the render extent is not blended with black
+	VkSamplerCreateInfo upscaleSamplerCreateInfo = samplerCreateInfo;
+	upscaleSamplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	upscaleSamplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	upscaleSamplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	upscaleSamplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	upscaleSamplerCreateInfo.anisotropyEnable = VK_FALSE;
+	upscaleSamplerCreateInfo.maxAnisotropy = 1.0f;
+
+	result = vkCreateSampler(m_MainDevice.LogicalDevice, &upscaleSamplerCreateInfo, nullptr, &m_UpscaleSampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upscale sampler!");
+	}
+
+	// Composite sampler: only single texels are fetched, nearest keeps depth formats without linear filtering valid
+	VkSamplerCreateInfo compositeSamplerCreateInfo = upscaleSamplerCreateInfo;
+	compositeSamplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	compositeSamplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+
+	result = vkCreateSampler(m_MainDevice.LogicalDevice, &compositeSamplerCreateInfo, nullptr, &m_CompositeSampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create composite sampler!");
+	}
 }
 
 void VulkanRenderer::CreateUniformBuffers()
@@ -1189,23 +1835,50 @@ void VulkanRenderer::CreateUniformBuffers()
 	// Dynamic uniform buffer size (model buffer)
 	VkDeviceSize modelBufferSize = m_ModelUniformAlignment * MAX_OBJECTS;
 
-	// One uniform buffer for each image (and by extension, command buffer)
-	m_UniformBuffers.resize(m_SwapChainImages.size());
-	m_UniformBufferMemory.resize(m_SwapChainImages.size());
+	// Clustered lighting buffer sizes
+	VkDeviceSize lightBufferSize = sizeof(ClusterHeader) + sizeof(GpuPointLight) * MAX_LIGHTS;
+	VkDeviceSize clusterBufferSize = sizeof(ClusterRange) * CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+	VkDeviceSize lightIndexBufferSize = sizeof(uint32_t) * MAX_CLUSTER_LIGHT_INDICES;
+
+	// Hi-Z tiles of the full resolution (the render extent is at most that)
+	VkDeviceSize hiZBufferSize = sizeof(float) * ((m_SwapchainExtent.width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE) *
+		((m_SwapchainExtent.height + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE);
 
-	m_UniformDynamicBuffers.resize(m_SwapChainImages.size());
-	m_UniformDynamicBufferMemory.resize(m_SwapChainImages.size());
+	// Skin matrices of every skinned model
+	VkDeviceSize jointBufferSize = sizeof(glm::mat4) * MAX_SKIN_JOINTS;
 
-	// Create uniform buffers
-	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+	// One set of uniform buffers for each frame in flight (and by extension, command buffer)
+	for (FrameContext& frame : m_Frames)
 	{
 		CreateBuffer(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, bufferSize,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&m_UniformBuffers[i], &m_UniformBufferMemory[i]);
+			&frame.UniformBuffer, &frame.UniformBufferMemory);
 
 		CreateBuffer(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, modelBufferSize,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&m_UniformDynamicBuffers[i], &m_UniformDynamicBufferMemory[i]);
+			&frame.UniformDynamicBuffer, &frame.UniformDynamicBufferMemory);
+
+		// Clustered lighting, sized for the worst case (only the used part is written each frame)
+		CreateBuffer(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, lightBufferSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame.LightBuffer, &frame.LightBufferMemory);
+
+		CreateBuffer(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, clusterBufferSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame.ClusterBuffer, &frame.ClusterBufferMemory);
+
+		CreateBuffer(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, lightIndexBufferSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame.LightIndexBuffer, &frame.LightIndexBufferMemory);
+
+		// Depth tiles for occlusion culling, read on the host once the frame is done
+		CreateBuffer(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, hiZBufferSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame.HiZBuffer, &frame.HiZBufferMemory);
+
+		CreateBuffer(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, jointBufferSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame.JointBuffer, &frame.JointBufferMemory);
 	}
 }
 
@@ -1215,19 +1888,24 @@ void VulkanRenderer::CreateDescriptorPool()
 	// Type of descriptor
 	VkDescriptorPoolSize poolSize = {};
 	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize.descriptorCount = static_cast<uint32_t>(m_UniformBuffers.size());
+	poolSize.descriptorCount = static_cast<uint32_t>(m_Frames.size());
 
 	// Model pool size 
 	VkDescriptorPoolSize dynamicPoolSize = {};
-	dynamicPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	dynamicPoolSize.descriptorCount = static_cast<uint32_t>(m_UniformDynamicBuffers.size());
+	dynamicPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	dynamicPoolSize.descriptorCount = static_cast<uint32_t>(m_Frames.size());
+
+	// Clustered lighting buffers (3 per frame)
+	VkDescriptorPoolSize storagePoolSize = {};
+	storagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	storagePoolSize.descriptorCount = static_cast<uint32_t>(m_Frames.size() * 3);
 
 	// list of pool sizes
-	std::vector<VkDescriptorPoolSize> descriptorPoolSizeList = { poolSize, dynamicPoolSize };
+	std::vector<VkDescriptorPoolSize> descriptorPoolSizeList = { poolSize, dynamicPoolSize, storagePoolSize };
 
 	VkDescriptorPoolCreateInfo poolCreateInfo = {};
 	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolCreateInfo.maxSets = static_cast<uint32_t>(m_SwapChainImages.size());
+	poolCreateInfo.maxSets = static_cast<uint32_t>(m_Frames.size());		// one set 0 per frame in flight
 	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizeList.size());		// Amount of pool size
 	poolCreateInfo.pPoolSizes = descriptorPoolSizeList.data();
 
@@ -1241,11 +1919,12 @@ void VulkanRenderer::CreateDescriptorPool()
 	// CREATE SAMPLER DESCRIPTOR POOL
 	VkDescriptorPoolSize samplerPooSize = {};
 	samplerPooSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerPooSize.descriptorCount = MAX_OBJECTS; // Assuming 1 texture per object
+	samplerPooSize.descriptorCount = m_MaxTextures; // The whole texture table
 
 	VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
 	samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	samplerPoolCreateInfo.maxSets = MAX_OBJECTS;
+	samplerPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	samplerPoolCreateInfo.maxSets = 1;		// A single set holds every texture
 	samplerPoolCreateInfo.poolSizeCount = 1;
 	samplerPoolCreateInfo.pPoolSizes = &samplerPooSize;
 
@@ -1257,49 +1936,106 @@ void VulkanRenderer::CreateDescriptorPool()
 
 
 
-	// CREATE INPUT ATTACHMENT DESCRIPTOR POOL
-	// Color attachment pool size
-	VkDescriptorPoolSize colorInputPoolSize = {};
-	colorInputPoolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-	colorInputPoolSize.descriptorCount = static_cast<uint32_t>(m_ColorBufferImageView.size());
+	// CREATE COMPOSITE DESCRIPTOR POOL (one set per frame in flight, like the render graph images)
+	// Color and depth inputs
+	VkDescriptorPoolSize compositeInputPoolSize = {};
+	compositeInputPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	compositeInputPoolSize.descriptorCount = m_Settings.FramesInFlight * 2;
+
+	// Scene color output
+	VkDescriptorPoolSize compositeOutputPoolSize = {};
+	compositeOutputPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	compositeOutputPoolSize.descriptorCount = m_Settings.FramesInFlight;
+
+	// Hi-Z tiles output
+	VkDescriptorPoolSize compositeHiZPoolSize = {};
+	compositeHiZPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	compositeHiZPoolSize.descriptorCount = m_Settings.FramesInFlight;
+
+	std::array<VkDescriptorPoolSize, 3> compositePoolSizes = { compositeInputPoolSize , compositeOutputPoolSize, compositeHiZPoolSize };
+
+	VkDescriptorPoolCreateInfo compositePoolCreateInfo = {};
+	compositePoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	compositePoolCreateInfo.maxSets = m_Settings.FramesInFlight;
+	compositePoolCreateInfo.poolSizeCount = static_cast<uint32_t>(compositePoolSizes.size());
+	compositePoolCreateInfo.pPoolSizes = compositePoolSizes.data();
 
-	// Depth attachment pool size
-	VkDescriptorPoolSize depthInputPoolSize = {};
-	depthInputPoolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-	depthInputPoolSize.descriptorCount = static_cast<uint32_t>(m_ColorBufferImageView.size());
+	result = vkCreateDescriptorPool(m_MainDevice.LogicalDevice, &compositePoolCreateInfo, nullptr, &m_CompositeDescriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Composite Descriptor Pool!");
+	}
 
-	std::array<VkDescriptorPoolSize, 2> inputPoolSizes = { colorInputPoolSize , depthInputPoolSize };
+	// CREATE UPSCALE DESCRIPTOR POOL (scene color of each frame in flight)
+	VkDescriptorPoolSize upscalePoolSize = {};
+	upscalePoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	upscalePoolSize.descriptorCount = m_Settings.FramesInFlight;
 
-	// Create input attachment pool
-	VkDescriptorPoolCreateInfo inputPoolCreateInfo = {};
-	inputPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	inputPoolCreateInfo.maxSets = m_SwapChainImages.size();
-	inputPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(inputPoolSizes.size());
-	inputPoolCreateInfo.pPoolSizes = inputPoolSizes.data();
+	VkDescriptorPoolCreateInfo upscalePoolCreateInfo = {};
+	upscalePoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	upscalePoolCreateInfo.maxSets = m_Settings.FramesInFlight;
+	upscalePoolCreateInfo.poolSizeCount = 1;
+	upscalePoolCreateInfo.pPoolSizes = &upscalePoolSize;
 
-	result = vkCreateDescriptorPool(m_MainDevice.LogicalDevice, &inputPoolCreateInfo, nullptr, &m_InputDescriptorPool);
+	result = vkCreateDescriptorPool(m_MainDevice.LogicalDevice, &upscalePoolCreateInfo, nullptr, &m_UpscaleDescriptorPool);
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to create Input Descriptor Pool!");
+		throw std::runtime_error("Failed to create Upscale Descriptor Pool!");
+	}
+
+	// CREATE G-BUFFER DESCRIPTOR POOL (deferred: albedo, normal and depth of each frame in flight)
+	if (m_Settings.DeferredShading)
+	{
+		VkDescriptorPoolSize gBufferPoolSize = {};
+		gBufferPoolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		gBufferPoolSize.descriptorCount = m_Settings.FramesInFlight * 3;
+
+		VkDescriptorPoolCreateInfo gBufferPoolCreateInfo = {};
+		gBufferPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		gBufferPoolCreateInfo.maxSets = m_Settings.FramesInFlight;
+		gBufferPoolCreateInfo.poolSizeCount = 1;
+		gBufferPoolCreateInfo.pPoolSizes = &gBufferPoolSize;
+
+		result = vkCreateDescriptorPool(m_MainDevice.LogicalDevice, &gBufferPoolCreateInfo, nullptr, &m_GBufferDescriptorPool);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create G-Buffer Descriptor Pool!");
+		}
+	}
+
+	// CREATE SKINNING DESCRIPTOR POOL (4 buffers per skinned mesh and frame in flight, sets allocated as models load)
+	VkDescriptorPoolSize skinningPoolSize = {};
+	skinningPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	skinningPoolSize.descriptorCount = MAX_SKINNED_MESHES * m_Settings.FramesInFlight * 4;
+
+	VkDescriptorPoolCreateInfo skinningPoolCreateInfo = {};
+	skinningPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	skinningPoolCreateInfo.maxSets = MAX_SKINNED_MESHES * m_Settings.FramesInFlight;
+	skinningPoolCreateInfo.poolSizeCount = 1;
+	skinningPoolCreateInfo.pPoolSizes = &skinningPoolSize;
+
+	result = vkCreateDescriptorPool(m_MainDevice.LogicalDevice, &skinningPoolCreateInfo, nullptr, &m_SkinningDescriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Skinning Descriptor Pool!");
 	}
 }
 
 void VulkanRenderer::CreateDescriptorSets()
 {
-	// Resize descriptor sets, so we have one for each buffer
-	m_DescriptorSets.resize(m_SwapChainImages.size());
-
-	std::vector<VkDescriptorSetLayout> setLayouts(m_SwapChainImages.size(), m_DescriptorSetLayout);
+	// One descriptor set for each frame in flight
+	std::vector<VkDescriptorSetLayout> setLayouts(m_Frames.size(), m_DescriptorSetLayout);
+	std::vector<VkDescriptorSet> descriptorSets(m_Frames.size());
 
 	VkDescriptorSetAllocateInfo setAllocateInfo = {};
 	setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	setAllocateInfo.descriptorPool = m_DescriptorPool;					// Pool to allocate descriptor set from
-	setAllocateInfo.descriptorSetCount = static_cast<uint32_t>(m_SwapChainImages.size());	// number of set to allocate
+	setAllocateInfo.descriptorSetCount = static_cast<uint32_t>(m_Frames.size());	// number of set to allocate
 	setAllocateInfo.pSetLayouts = setLayouts.data();	// layout to use to allocate sets
 
 	// Allocate descriptor sets (multiple)
 	VkResult result = vkAllocateDescriptorSets(m_MainDevice.LogicalDevice,
-		&setAllocateInfo, m_DescriptorSets.data());
+		&setAllocateInfo, descriptorSets.data());
 
 	if (result != VK_SUCCESS)
 	{
@@ -1307,13 +2043,15 @@ void VulkanRenderer::CreateDescriptorSets()
 	}
 
 	// update all of descriptor set buffer bindings
-	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+	for (size_t i = 0; i < m_Frames.size(); i++)
 	{
+		FrameContext& frame = m_Frames[i];
+		frame.DescriptorSet = descriptorSets[i];
 
 		// UNIFORM BUFFER (VIEW-PROJECTION)
 		// buffer info and data offset info
 		VkDescriptorBufferInfo vpBufferInfo = {};
-		vpBufferInfo.buffer = m_UniformBuffers[i];	// buffer to get data from
+		vpBufferInfo.buffer = frame.UniformBuffer;	// buffer to get data from
 		vpBufferInfo.offset = 0;					// Position of start of data
 		vpBufferInfo.range = sizeof(Camera);		// Size of data
 
@@ -1321,7 +2059,7 @@ void VulkanRenderer::CreateDescriptorSets()
 		// Data about connection between binding and buffer
 		VkWriteDescriptorSet vpSetWrite = {};
 		vpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		vpSetWrite.dstSet = m_DescriptorSets[i];		// Descriptor set to update
+		vpSetWrite.dstSet = frame.DescriptorSet;		// Descriptor set to update
 		vpSetWrite.dstBinding = 0;						// binding to update (mathces with binding on layout/shader)
 		vpSetWrite.dstArrayElement = 0;			// index in array to update
 		vpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -1331,13 +2069,13 @@ void VulkanRenderer::CreateDescriptorSets()
 
 		// UNIFORM DYNAMIC (MODEL)
 		VkDescriptorBufferInfo modelBufferInfo = {};
-		modelBufferInfo.buffer = m_UniformDynamicBuffers[i];	// buffer to get data from
+		modelBufferInfo.buffer = frame.UniformDynamicBuffer;	// buffer to get data from
 		modelBufferInfo.offset = 0;					// Position of start of data
 		modelBufferInfo.range = m_ModelUniformAlignment;		// Size of data
 
 		VkWriteDescriptorSet modelSetWrite = {};
 		modelSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		modelSetWrite.dstSet = m_DescriptorSets[i];
+		modelSetWrite.dstSet = frame.DescriptorSet;
 		modelSetWrite.dstBinding = 1;
 		modelSetWrite.dstArrayElement = 0;
 		modelSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
@@ -1345,222 +2083,765 @@ void VulkanRenderer::CreateDescriptorSets()
 		modelSetWrite.pBufferInfo = &modelBufferInfo;
 
 
+		// STORAGE (CLUSTERED LIGHTING)
+		VkDescriptorBufferInfo lightBufferInfo = {};
+		lightBufferInfo.buffer = frame.LightBuffer;
+		lightBufferInfo.offset = 0;
+		lightBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo clusterBufferInfo = lightBufferInfo;
+		clusterBufferInfo.buffer = frame.ClusterBuffer;
+
+		VkDescriptorBufferInfo lightIndexBufferInfo = lightBufferInfo;
+		lightIndexBufferInfo.buffer = frame.LightIndexBuffer;
+
+		VkWriteDescriptorSet lightSetWrite = modelSetWrite;
+		lightSetWrite.dstBinding = 2;
+		lightSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		lightSetWrite.pBufferInfo = &lightBufferInfo;
+
+		VkWriteDescriptorSet clusterSetWrite = lightSetWrite;
+		clusterSetWrite.dstBinding = 3;
+		clusterSetWrite.pBufferInfo = &clusterBufferInfo;
+
+		VkWriteDescriptorSet lightIndexSetWrite = lightSetWrite;
+		lightIndexSetWrite.dstBinding = 4;
+		lightIndexSetWrite.pBufferInfo = &lightIndexBufferInfo;
+
 		// list of descriptor set writes
-		std::vector<VkWriteDescriptorSet> writeDescriptorSetLists = { vpSetWrite , modelSetWrite };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSetLists = { vpSetWrite , modelSetWrite,
+			lightSetWrite, clusterSetWrite, lightIndexSetWrite };
 
 		// Update the descriptor sets with new buffer/binding info
 		vkUpdateDescriptorSets(m_MainDevice.LogicalDevice, 
 			static_cast<uint32_t>(writeDescriptorSetLists.size()), writeDescriptorSetLists.data(), 0, nullptr);
 	}
+
+	// TEXTURE TABLE
+	// One set for every texture, slots are filled as textures are loaded (CreateTextureDescriptor)
+	VkDescriptorSetAllocateInfo textureSetAllocateInfo = {};
+	textureSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	textureSetAllocateInfo.descriptorPool = m_SamplerDescriptorPool;
+	textureSetAllocateInfo.descriptorSetCount = 1;
+	textureSetAllocateInfo.pSetLayouts = &m_SamplerDescriptorSetLayout;
+
+	result = vkAllocateDescriptorSets(m_MainDevice.LogicalDevice, &textureSetAllocateInfo, &m_TextureDescriptorSet);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate texture descriptor set!");
+	}
 }
 
-void VulkanRenderer::CreateInputDescriptorSets()
+void VulkanRenderer::CreateCompositeDescriptorSets()
 {
-	// Resize array to hold descriptor set for each swap chain image
-	m_InputDescriptorSets.resize(m_SwapChainImages.size());
+	// Resize array to hold descriptor set for each frame in flight
+	m_CompositeDescriptorSets.resize(m_Settings.FramesInFlight);
 
 	// Fill array of layout ready for set creation
-	std::vector<VkDescriptorSetLayout> setLayouts(m_SwapChainImages.size(), m_InputDescriptorSetLayout);
+	std::vector<VkDescriptorSetLayout> setLayouts(m_Settings.FramesInFlight, m_CompositeDescriptorSetLayout);
 
-	// input attachment descriptor set allocation info
+	// composite descriptor set allocation info
 	VkDescriptorSetAllocateInfo setAllocateInfo = {};
 	setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocateInfo.descriptorPool = m_InputDescriptorPool;
-	setAllocateInfo.descriptorSetCount = static_cast<uint32_t>(m_SwapChainImages.size());
+	setAllocateInfo.descriptorPool = m_CompositeDescriptorPool;
+	setAllocateInfo.descriptorSetCount = m_Settings.FramesInFlight;
 	setAllocateInfo.pSetLayouts = setLayouts.data();
 
 	// allocate descriptor sets
-	VkResult result = vkAllocateDescriptorSets(m_MainDevice.LogicalDevice, &setAllocateInfo, m_InputDescriptorSets.data());
+	VkResult result = vkAllocateDescriptorSets(m_MainDevice.LogicalDevice, &setAllocateInfo, m_CompositeDescriptorSets.data());
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to allocate input attachment descriptor sets!");
+		throw std::runtime_error("Failed to allocate composite descriptor sets!");
 	}
 
-	// Update each descriptor set with input attachment
-	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+	// Update each descriptor set with the render graph images of its frame
+	for (size_t i = 0; i < m_Settings.FramesInFlight; i++)
 	{
-		// color attachment descriptor
+		// color attachment descriptor (layouts are the ones the render graph puts the images in for the pass)
+		uint32_t instance = static_cast<uint32_t>(i);
 		VkDescriptorImageInfo colorAttachmentDescriptor = {};
-		colorAttachmentDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		colorAttachmentDescriptor.imageView = m_ColorBufferImageView[i];
-		colorAttachmentDescriptor.sampler = VK_NULL_HANDLE;
+		colorAttachmentDescriptor.imageLayout = m_RenderGraph.GetLayout(m_ColorBufferImage, RenderGraphAccess::Sampled);
+		colorAttachmentDescriptor.imageView = m_RenderGraph.GetImageView(m_ColorBufferImage, instance);
+		colorAttachmentDescriptor.sampler = m_CompositeSampler;
 
 		// Color attachment descriptor write
 		VkWriteDescriptorSet colorWrite = {};
 		colorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		colorWrite.dstSet = m_InputDescriptorSets[i];
+		colorWrite.dstSet = m_CompositeDescriptorSets[i];
 		colorWrite.dstBinding = 0;
 		colorWrite.dstArrayElement = 0;
-		colorWrite.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		colorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		colorWrite.descriptorCount = 1;
 		colorWrite.pImageInfo = &colorAttachmentDescriptor;
 
-		// depth attachment descriptor
-		VkDescriptorImageInfo depthAttachmentDescriptor = {};
-		depthAttachmentDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		depthAttachmentDescriptor.imageView = m_DepthBufferImageView[i];
-		depthAttachmentDescriptor.sampler = VK_NULL_HANDLE;
+		// depth attachment descriptor
+		VkDescriptorImageInfo depthAttachmentDescriptor = {};
+		depthAttachmentDescriptor.imageLayout = m_RenderGraph.GetLayout(m_DepthBufferImage, RenderGraphAccess::Sampled);
+		depthAttachmentDescriptor.imageView = m_RenderGraph.GetImageView(m_DepthBufferImage, instance);
+		depthAttachmentDescriptor.sampler = m_CompositeSampler;
+
+		// Depth attachment descriptor write
+		VkWriteDescriptorSet depthWrite = colorWrite;
+		depthWrite.dstBinding = 1;
+		depthWrite.pImageInfo = &depthAttachmentDescriptor;
+
+		// scene color descriptor (written here, sampled by the upscale pass)
+		VkDescriptorImageInfo sceneColorDescriptor = {};
+		sceneColorDescriptor.imageLayout = m_RenderGraph.GetLayout(m_SceneColorImage, RenderGraphAccess::StorageImage);
+		sceneColorDescriptor.imageView = m_RenderGraph.GetImageView(m_SceneColorImage, instance);
+		sceneColorDescriptor.sampler = VK_NULL_HANDLE;
+
+		VkWriteDescriptorSet sceneColorWrite = colorWrite;
+		sceneColorWrite.dstBinding = 2;
+		sceneColorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		sceneColorWrite.pImageInfo = &sceneColorDescriptor;
+
+		// List of composite descriptor set writes
+		// Hi-Z tiles of the frame
+		VkDescriptorBufferInfo hiZBufferInfo = {};
+		hiZBufferInfo.buffer = m_Frames[i].HiZBuffer;
+		hiZBufferInfo.offset = 0;
+		hiZBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet hiZWrite = colorWrite;
+		hiZWrite.dstBinding = 3;
+		hiZWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		hiZWrite.pImageInfo = nullptr;
+		hiZWrite.pBufferInfo = &hiZBufferInfo;
+
+		std::vector<VkWriteDescriptorSet> setWrites = { colorWrite , depthWrite, sceneColorWrite, hiZWrite };
+
+		// Update descriptor sets
+		vkUpdateDescriptorSets(m_MainDevice.LogicalDevice, static_cast<uint32_t>(setWrites.size()),
+			setWrites.data(), 0, nullptr);
+	}
+}
+
+void VulkanRenderer::CreateUpscaleDescriptorSets()
+{
+	m_UpscaleDescriptorSets.resize(m_Settings.FramesInFlight);
+	std::vector<VkDescriptorSetLayout> setLayouts(m_Settings.FramesInFlight, m_UpscaleDescriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo setAllocateInfo = {};
+	setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocateInfo.descriptorPool = m_UpscaleDescriptorPool;
+	setAllocateInfo.descriptorSetCount = m_Settings.FramesInFlight;
+	setAllocateInfo.pSetLayouts = setLayouts.data();
+
+	VkResult result = vkAllocateDescriptorSets(m_MainDevice.LogicalDevice, &setAllocateInfo, m_UpscaleDescriptorSets.data());
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate upscale descriptor sets!");
+	}
+
+	for (size_t i = 0; i < m_Settings.FramesInFlight; i++)
+	{
+		VkDescriptorImageInfo sceneColorInfo = {};
+		sceneColorInfo.imageLayout = m_RenderGraph.GetLayout(m_SceneColorImage, RenderGraphAccess::Sampled);
+		sceneColorInfo.imageView = m_RenderGraph.GetImageView(m_SceneColorImage, static_cast<uint32_t>(i));
+		sceneColorInfo.sampler = m_UpscaleSampler;
+
+		VkWriteDescriptorSet sceneColorWrite = {};
+		sceneColorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		sceneColorWrite.dstSet = m_UpscaleDescriptorSets[i];
+		sceneColorWrite.dstBinding = 0;
+		sceneColorWrite.dstArrayElement = 0;
+		sceneColorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		sceneColorWrite.descriptorCount = 1;
+		sceneColorWrite.pImageInfo = &sceneColorInfo;
+
+		vkUpdateDescriptorSets(m_MainDevice.LogicalDevice, 1, &sceneColorWrite, 0, nullptr);
+	}
+}
+
+void VulkanRenderer::CreateGBufferDescriptorSets()
+{
+	if (!m_Settings.DeferredShading)
+	{
+		return;
+	}
+
+	m_GBufferDescriptorSets.resize(m_Settings.FramesInFlight);
+	std::vector<VkDescriptorSetLayout> setLayouts(m_Settings.FramesInFlight, m_GBufferDescriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo setAllocateInfo = {};
+	setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocateInfo.descriptorPool = m_GBufferDescriptorPool;
+	setAllocateInfo.descriptorSetCount = m_Settings.FramesInFlight;
+	setAllocateInfo.pSetLayouts = setLayouts.data();
+
+	VkResult result = vkAllocateDescriptorSets(m_MainDevice.LogicalDevice, &setAllocateInfo, m_GBufferDescriptorSets.data());
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate G-buffer descriptor sets!");
+	}
+
+	// Same order as the input_attachment_index of lighting.frag
+	std::array<uint32_t, 3> gBufferImages = { m_AlbedoImage, m_NormalImage, m_DepthBufferImage };
+	for (size_t i = 0; i < m_Settings.FramesInFlight; i++)
+	{
+		std::array<VkDescriptorImageInfo, 3> imageInfos = {};
+		std::array<VkWriteDescriptorSet, 3> setWrites = {};
+		for (uint32_t b = 0; b < gBufferImages.size(); b++)
+		{
+			imageInfos[b].imageLayout = m_RenderGraph.GetLayout(gBufferImages[b], RenderGraphAccess::InputAttachment);
+			imageInfos[b].imageView = m_RenderGraph.GetImageView(gBufferImages[b], static_cast<uint32_t>(i));
+			imageInfos[b].sampler = VK_NULL_HANDLE;
+
+			setWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			setWrites[b].dstSet = m_GBufferDescriptorSets[i];
+			setWrites[b].dstBinding = b;
+			setWrites[b].dstArrayElement = 0;
+			setWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			setWrites[b].descriptorCount = 1;
+			setWrites[b].pImageInfo = &imageInfos[b];
+		}
+
+		vkUpdateDescriptorSets(m_MainDevice.LogicalDevice, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+	}
+}
+
+void VulkanRenderer::ReadGpuFrameTime()
+{
+	// The graphics timeline has reached this frame, so its queries are normally available (never waits if not).
+	// Pass times only: with async compute the frame's timestamps also span the next frame's geometry
+	if (m_GpuProfiler.ReadResults(m_CurrentFrame))
+	{
+		m_DynamicResolution.Update(static_cast<float>(m_GpuProfiler.GetLastFrameStats().BusyMs));
+	}
+}
+
+void VulkanRenderer::PrepareFrame()
+{
+	TRACE_FUNCTION();
+
+	// Nothing here touches a frame in flight resource, so it runs before waiting for the frame context
+
+	// Model matrices of the moved subtrees (transforms from UpdateModels first)
+	m_ModelTransforms.Compose(m_JobSystem);
+	for (uint32_t meshObjectIndex : m_ModelTransforms.GetComposed())
+	{
+		m_SceneGraph.SetLocalTransform(m_ModelList[meshObjectIndex].GetSceneNode(), m_ModelTransforms.GetMatrix(meshObjectIndex));
+	}
+	m_SceneGraph.Update();
+	for (MeshModel& meshModel : m_ModelList)
+	{
+		glm::mat4 model = m_SceneGraph.GetWorldTransform(meshModel.GetSceneNode());
+		meshModel.SetModel(model);
+	}
+
+	// Skin matrices of the skinned models (uploaded with the uniforms, skinned on the GPU before the geometry)
+	UpdateSkinning();
+
+	// Depth of the newest finished frame, meshes it hides are not drawn
+	if (m_Settings.OcclusionCulling)
+	{
+		UpdateOcclusionPyramid();
+	}
+	m_OcclusionCulling.ResetStats();
+
+	// Occluders of this frame's view, rasterized before any draw is built
+	if (m_Settings.SoftwareOcclusion)
+	{
+		RenderSoftwareOcclusion();
+	}
+
+	// Build one draw packet for each mesh part, then sort them so consecutive draws share state
+	m_RenderQueue.Clear();
+	uint32_t geometryID = 0;
+	for (size_t i = 0; i < m_ModelList.size(); i++)
+	{
+		// Dynamic offset amount
+		uint32_t dynamicOffset = static_cast<uint32_t>(m_ModelUniformAlignment * i);
+
+		// Distance from the camera to the model origin (sorted front to back)
+		glm::vec4 viewPosition = m_Camera.View * m_ModelList[i].GetModel() * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		float normalizedDepth = -viewPosition.z / m_CameraFarPlane;
+
+		glm::mat4 model = m_ModelList[i].GetModel();
+		for (size_t k = 0; k < m_ModelList[i].GetMeshCount(); k++)
+		{
+			const Mesh& currentMeshPart = m_ModelList[i].GetMesh(k);
+			// Skinned parts leave the bounds of their bind pose, they are never culled
+			uint32_t skinnedMesh = m_PartSkinnedMeshes[geometryID];
+			bool testOcclusion = skinnedMesh == UINT32_MAX;
+			// Occluders aren't tested against themselves (their box is never in front of their own surface)
+			bool softwareOccluded = testOcclusion && m_Settings.SoftwareOcclusion && !m_SoftwareOccluderParts[geometryID] &&
+				m_SoftwareOcclusion.IsOccluded(model, currentMeshPart.GetBoundsMin(), currentMeshPart.GetBoundsMax());
+			if (softwareOccluded || (testOcclusion && m_Settings.OcclusionCulling &&
+				m_OcclusionCulling.IsOccluded(model, currentMeshPart.GetBoundsMin(), currentMeshPart.GetBoundsMax())))
+			{
+				geometryID++;
+				continue;
+			}
+
+			DrawPacket packet = {};
+			packet.VertexBuffer = testOcclusion ? currentMeshPart.GetVertexBuffer() :
+				m_SkinnedMeshes[skinnedMesh].OutputBuffers[m_CurrentFrame];
+			packet.IndexBuffer = currentMeshPart.GetIndexBuffer();
+			packet.IndexCount = static_cast<uint32_t>(currentMeshPart.GetIndexCount());
+			packet.PipelineID = 0;
+			packet.DynamicOffset = dynamicOffset;
+			packet.TextureID = static_cast<uint32_t>(currentMeshPart.GetTextureID());
+			packet.SortKey = RenderQueue::MakeSortKey(packet.PipelineID, static_cast<uint32_t>(i),
+				packet.TextureID, geometryID++, normalizedDepth);
+
+			m_RenderQueue.Submit(packet);
+		}
+	}
+
+	m_RenderQueue.Sort();
+
+	// Gather model data into the transfer space (copied to the frame's dynamic uniform buffer later)
+#if 0
+	size_t Count = 0;
+	for (size_t i = 0; i < m_ModelList.size(); i++)
+	{
+		//const glm::mat4& currModel = m_ModelList[i].GetModel();
+		// get the address and applied an offset
+
+		for (size_t j = 0; j < m_ModelList[i].GetMeshCount(); j++)
+		{
+			auto mesh = m_ModelList[i].GetMesh(j);
+			
+			UniformBufferObjectModel* thisModel = (UniformBufferObjectModel*)((uint64_t)m_ModelTransferSpace + (j * m_ModelUniformAlignment));
+			*thisModel = mesh.GetUniformBufferModel();
+			Count++;
+		} 
+
+	}
+#endif
+
+	for (size_t i = 0; i < m_ModelList.size(); i++)
+	{
+		//const glm::mat4& currModel = m_ModelList[i].GetModel();
+		// get the address and applied an offset
+		glm::mat4* thisModel = (glm::mat4*)((uint64_t)m_ModelTransferSpace + (i * m_ModelUniformAlignment));
+		*thisModel = m_ModelList[i].GetModel();
+	}
+
+	// Bin the lights into the cluster grid of this frame's view
+	m_ClusteredLighting.Cull(m_Lights, m_Camera.View, m_Camera.Projection, m_CameraNearPlane, m_CameraFarPlane);
+}
+
+void VulkanRenderer::UpdateSkinning()
+{
+	TRACE_FUNCTION();
+
+	// One job per skinned model (sampling, blending and the joint hierarchy are independent between models)
+	if (m_SkinnedModels.empty())
+	{
+		return;
+	}
+
+	JobCounter counter;
+	m_JobSystem.ParallelFor(static_cast<uint32_t>(m_SkinnedModels.size()), 1, [this](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			m_ModelList[m_SkinnedModels[i].Model].UpdateSkinMatrices();
+		}
+	}, &counter);
+	m_JobSystem.Wait(counter);
+}
+
+void VulkanRenderer::RenderSoftwareOcclusion()
+{
+	TRACE_FUNCTION();
+
+	struct Candidate
+	{
+		uint32_t Part;
+		float Area;
+		SoftwareOccluder Occluder;
+	};
+
+	// Tagged models first, then the parts covering the most screen, until the triangle budget is used up
+	glm::mat4 viewProjection = m_Camera.Projection * m_Camera.View;
+	std::vector<Candidate> candidates;
+	uint32_t part = 0;
+	for (size_t i = 0; i < m_ModelList.size(); i++)
+	{
+		glm::mat4 model = m_ModelList[i].GetModel();
+		for (size_t k = 0; k < m_ModelList[i].GetMeshCount(); k++, part++)
+		{
+			const Mesh& mesh = m_ModelList[i].GetMesh(k);
+			if (!mesh.CanOcclude())
+			{
+				continue;
+			}
+
+			float area = m_ModelList[i].IsOccluder() ? FLT_MAX :
+				SoftwareOcclusion::GetScreenArea(viewProjection * model, mesh.GetBoundsMin(), mesh.GetBoundsMax());
+			if (area >= SOFTWARE_OCCLUDER_MIN_SCREEN_AREA)
+			{
+				candidates.push_back({ part, area, { &mesh.GetOccluderPositions(), &mesh.GetOccluderIndices(), model } });
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.Area > b.Area; });
+
+	m_SoftwareOccluders.clear();
+	m_SoftwareOccluderParts.assign(part, 0);
+	uint32_t triangles = 0;
+	for (const Candidate& candidate : candidates)
+	{
+		uint32_t meshTriangles = static_cast<uint32_t>(candidate.Occluder.Indices->size() / 3);
+		if (triangles + meshTriangles > SOFTWARE_OCCLUDER_TRIANGLE_BUDGET)
+		{
+			continue;
+		}
+
+		triangles += meshTriangles;
+		m_SoftwareOccluders.push_back(candidate.Occluder);
+		m_SoftwareOccluderParts[candidate.Part] = 1;
+	}
+
+	m_SoftwareOcclusion.Render(m_JobSystem, m_SoftwareOccluders, viewProjection);
+}
 
-		// Depth attachment descriptor write
-		VkWriteDescriptorSet depthWrite = {};
-		depthWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		depthWrite.dstSet = m_InputDescriptorSets[i];
-		depthWrite.dstBinding = 1;
-		depthWrite.dstArrayElement = 0;
-		depthWrite.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-		depthWrite.descriptorCount = 1;
-		depthWrite.pImageInfo = &depthAttachmentDescriptor;
+void VulkanRenderer::UpdateOcclusionPyramid()
+{
+	// Frames finish in order: the finished frame context with the highest frame number has the newest depth. Its
+	// buffer is not written again before the context is recorded again (later in this Draw), so this never waits
+	uint64_t completedValue = 0;
+	vkGetSemaphoreCounterValue(m_MainDevice.LogicalDevice, m_GraphicsTimeline, &completedValue);
 
-		// List of input descriptor set writes
-		std::vector<VkWriteDescriptorSet> setWrites = { colorWrite , depthWrite };
+	const FrameContext* newest = nullptr;
+	for (const FrameContext& frame : m_Frames)
+	{
+		if (frame.TimelineValue <= completedValue && frame.TimelineValue > m_OcclusionCulling.GetStats().PyramidFrame &&
+			frame.HiZExtent.width > 0 && (newest == nullptr || frame.TimelineValue > newest->TimelineValue))
+		{
+			newest = &frame;
+		}
+	}
 
-		// Update descriptor sets
-		vkUpdateDescriptorSets(m_MainDevice.LogicalDevice, static_cast<uint32_t>(setWrites.size()),
-			setWrites.data(), 0, nullptr);
+	if (newest == nullptr)
+	{
+		return;
 	}
+
+	VkDeviceSize size = sizeof(float) * ((newest->HiZExtent.width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE) *
+		((newest->HiZExtent.height + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE);
+
+	void* data;
+	vkMapMemory(m_MainDevice.LogicalDevice, newest->HiZBufferMemory, 0, size, 0, &data);
+	m_OcclusionCulling.UpdatePyramid(static_cast<const float*>(data), newest->HiZExtent.width, newest->HiZExtent.height,
+		newest->HiZViewProjection, newest->TimelineValue);
+	vkUnmapMemory(m_MainDevice.LogicalDevice, newest->HiZBufferMemory);
 }
 
-void VulkanRenderer::UpdateUniformBuffers(uint32_t imageIndex)
+void VulkanRenderer::UpdateUniformBuffers(FrameContext& frame)
 {
+	TRACE_FUNCTION();
 
 	// Copy uniform buffer (view-projection matrix)
 	void* data;
-	vkMapMemory(m_MainDevice.LogicalDevice, m_UniformBufferMemory[imageIndex], 0,
+	vkMapMemory(m_MainDevice.LogicalDevice, frame.UniformBufferMemory, 0,
 		sizeof(Camera), 0, &data);
 	memcpy(data, &m_Camera, sizeof(Camera));
-	vkUnmapMemory(m_MainDevice.LogicalDevice, m_UniformBufferMemory[imageIndex]);
+	vkUnmapMemory(m_MainDevice.LogicalDevice, frame.UniformBufferMemory);
 
-	// copy model data (dynamic uniform buffer)
-	size_t Count = 0;
-#if 0
-	for (size_t i = 0; i < m_ModelList.size(); i++)
+	// copy model data (dynamic uniform buffer), gathered into the transfer space by PrepareFrame
+	size_t Count = m_ModelList.size();
+
+	// Map list of dynamic uniform buffer data (model data)
+	vkMapMemory(m_MainDevice.LogicalDevice, frame.UniformDynamicBufferMemory, 0,
+		m_ModelUniformAlignment * Count, 0, &data);
+	memcpy(data, m_ModelTransferSpace, m_ModelUniformAlignment * Count);
+	vkUnmapMemory(m_MainDevice.LogicalDevice, frame.UniformDynamicBufferMemory);
+
+	// Clustered lighting: header + visible lights, cluster ranges and light index list
+	ClusterHeader header = m_ClusteredLighting.GetHeader();
+	header.SliceParams.z = 1.0f / static_cast<float>(m_RenderExtent.width);
+	header.SliceParams.w = 1.0f / static_cast<float>(m_RenderExtent.height);
+
+	const std::vector<GpuPointLight>& lights = m_ClusteredLighting.GetLights();
+	VkDeviceSize lightsSize = sizeof(GpuPointLight) * lights.size();
+	vkMapMemory(m_MainDevice.LogicalDevice, frame.LightBufferMemory, 0, sizeof(ClusterHeader) + lightsSize, 0, &data);
+	memcpy(data, &header, sizeof(ClusterHeader));
+	if (lightsSize > 0)
 	{
-		//const glm::mat4& currModel = m_ModelList[i].GetModel();
-		// get the address and applied an offset
+		memcpy(static_cast<char*>(data) + sizeof(ClusterHeader), lights.data(), lightsSize);
+	}
+	vkUnmapMemory(m_MainDevice.LogicalDevice, frame.LightBufferMemory);
 
-		for (size_t j = 0; j < m_ModelList[i].GetMeshCount(); j++)
-		{
-			auto mesh = m_ModelList[i].GetMesh(j);
-			
-			UniformBufferObjectModel* thisModel = (UniformBufferObjectModel*)((uint64_t)m_ModelTransferSpace + (j * m_ModelUniformAlignment));
-			*thisModel = mesh.GetUniformBufferModel();
-			Count++;
-		} 
+	const std::vector<ClusterRange>& clusters = m_ClusteredLighting.GetClusters();
+	VkDeviceSize clustersSize = sizeof(ClusterRange) * clusters.size();
+	vkMapMemory(m_MainDevice.LogicalDevice, frame.ClusterBufferMemory, 0, clustersSize, 0, &data);
+	memcpy(data, clusters.data(), clustersSize);
+	vkUnmapMemory(m_MainDevice.LogicalDevice, frame.ClusterBufferMemory);
 
+	const std::vector<uint32_t>& lightIndices = m_ClusteredLighting.GetLightIndices();
+	VkDeviceSize lightIndicesSize = sizeof(uint32_t) * lightIndices.size();
+	if (lightIndicesSize > 0)
+	{
+		vkMapMemory(m_MainDevice.LogicalDevice, frame.LightIndexBufferMemory, 0, lightIndicesSize, 0, &data);
+		memcpy(data, lightIndices.data(), lightIndicesSize);
+		vkUnmapMemory(m_MainDevice.LogicalDevice, frame.LightIndexBufferMemory);
 	}
-#endif
 
-	for (size_t i = 0; i < m_ModelList.size(); i++)
+	// Skin matrices, each skinned model at its joint offset
+	VkDeviceSize jointsSize = sizeof(glm::mat4) * m_SkinJointCount;
+	if (jointsSize > 0)
 	{
-		//const glm::mat4& currModel = m_ModelList[i].GetModel();
-		// get the address and applied an offset
-		glm::mat4* thisModel = (glm::mat4*)((uint64_t)m_ModelTransferSpace + (i * m_ModelUniformAlignment));
-		*thisModel = m_ModelList[i].GetModel();
-		Count++;
+		vkMapMemory(m_MainDevice.LogicalDevice, frame.JointBufferMemory, 0, jointsSize, 0, &data);
+		for (const SkinnedModel& skinnedModel : m_SkinnedModels)
+		{
+			const std::vector<glm::mat4>& skinMatrices = m_ModelList[skinnedModel.Model].GetSkinMatrices();
+			memcpy(static_cast<glm::mat4*>(data) + skinnedModel.JointOffset, skinMatrices.data(), sizeof(glm::mat4) * skinMatrices.size());
+		}
+		vkUnmapMemory(m_MainDevice.LogicalDevice, frame.JointBufferMemory);
 	}
 
-	
-	// Map list of dynamic uniform buffer data (model data)
-	vkMapMemory(m_MainDevice.LogicalDevice, m_UniformDynamicBufferMemory[imageIndex], 0,
-		m_ModelUniformAlignment * Count, 0, &data);
-	memcpy(data, m_ModelTransferSpace, m_ModelUniformAlignment * Count);
-	vkUnmapMemory(m_MainDevice.LogicalDevice, m_UniformDynamicBufferMemory[imageIndex]);
+	m_FrameBytesUploaded = sizeof(Camera) + m_ModelUniformAlignment * Count
+		+ sizeof(ClusterHeader) + lightsSize + clustersSize + lightIndicesSize + jointsSize;
 
 }
 
-void VulkanRenderer::RecordCommands(uint32_t currentImageIndex)
+void VulkanRenderer::RecordCommands(FrameContext& frame, uint32_t currentImageIndex)
 {
+	TRACE_FUNCTION();
+
 	// Info about how to begin each command buffer
 	VkCommandBufferBeginInfo bufferBeginInfo = { };
 	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	// bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;  // buffer can be resubmitted when it has already been submitted and is awaiting
 	
-	// Info about how to beging a render pass (only need for graphical applications)
-	VkRenderPassBeginInfo renderPassBeginInfo = {};
-	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassBeginInfo.renderPass = m_RenderPass;		// Render pass to begin
-	renderPassBeginInfo.renderArea.offset = { 0, 0 };	// start point of render pass in pixel
-	renderPassBeginInfo.renderArea.extent = m_SwapchainExtent;	// size of region to run render pass on (starting at offset)
-	
-	std::array<VkClearValue, 3> clearValues = {};
-	clearValues[0].color = { 0.1f, 0.0f, 0.7f, 1.0f };
-	clearValues[1].color = { 0.20f, 0.10f, 0.40f, 1.0f };
-	clearValues[2].depthStencil.depth = 1.0f;
-	renderPassBeginInfo.pClearValues = clearValues.data();			// list of clear values 
-	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-
-	renderPassBeginInfo.framebuffer = m_SwapChainFramebuffers[currentImageIndex];
+	// Scene resolution of this frame (top left part of the full size attachments)
+	m_RenderExtent = m_DynamicResolution.GetRenderExtent(m_SwapchainExtent);
+	m_RenderGraph.SetRenderArea(m_GeometryPass, m_RenderExtent);
 
 	// Start recording commands to command buffer
-	VkResult result = vkBeginCommandBuffer(m_CommandBuffers[currentImageIndex], &bufferBeginInfo);
+	VkResult result = vkBeginCommandBuffer(frame.CommandBuffer, &bufferBeginInfo);
 	if (result != VK_SUCCESS)
 		throw std::runtime_error("Failed to start recording a Command buffer!");
 
-	// Begin Render Pass
-	vkCmdBeginRenderPass(m_CommandBuffers[currentImageIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	// GPU time of the frame and its passes, read back by ReadGpuFrameTime once the frame is done
+	m_GpuProfiler.BeginFrame(frame.CommandBuffer, m_CurrentFrame);
 
-	// Start first pipeline (Draw)
-	{
-		// Bind pipeline to be used in render pass
-		vkCmdBindPipeline(m_CommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
-		size_t meshCount = 0;
-		// Draw model
-		for (auto& model : m_ModelList)
-		{
-			// Dynamic offset amount
-			uint32_t dynamicOffset = static_cast<uint32_t>(m_ModelUniformAlignment * meshCount);
-			meshCount++;
+	// Skinned vertices of this frame, drawn by every pass of the graph
+	RecordSkinning(frame.CommandBuffer, m_CurrentFrame);
 
-			for (size_t k = 0; k < model.GetMeshCount(); k++)
-			{
-				auto currentMeshPart = model.GetMesh(k);
-				VkBuffer vertexBuffers[] = { currentMeshPart.GetVertexBuffer() };	// Buffer to bind
-				VkDeviceSize offsets[] = { 0 };		// offsets into buffers being bound
-				vkCmdBindVertexBuffers(m_CommandBuffers[currentImageIndex], 0, 1, vertexBuffers, offsets);	// Command to bind vertex buffer before drawing with them
+	if (m_AsyncCompute)
+	{
+		// Geometry, composite (compute queue) and upscale are separate submits, ordered by the timeline semaphores
+		m_RenderGraph.RecordBatch(frame.CommandBuffer, 0, m_CurrentFrame, currentImageIndex);
+		m_GpuProfiler.EndPipelineStatistics(frame.CommandBuffer);
+		result = vkEndCommandBuffer(frame.CommandBuffer);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to stop recording a Command buffer!");
 
-				vkCmdBindIndexBuffer(m_CommandBuffers[currentImageIndex], currentMeshPart.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		result = vkBeginCommandBuffer(frame.ComputeCommandBuffer, &bufferBeginInfo);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to start recording a Command buffer!");
+		m_RenderGraph.RecordBatch(frame.ComputeCommandBuffer, 1, m_CurrentFrame, currentImageIndex);
+		result = vkEndCommandBuffer(frame.ComputeCommandBuffer);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to stop recording a Command buffer!");
 
-				// dynamic offset
+		result = vkBeginCommandBuffer(frame.PresentCommandBuffer, &bufferBeginInfo);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to start recording a Command buffer!");
+		m_RenderGraph.RecordBatch(frame.PresentCommandBuffer, 2, m_CurrentFrame, currentImageIndex);
+		m_GpuProfiler.EndFrame(frame.PresentCommandBuffer);
+		result = vkEndCommandBuffer(frame.PresentCommandBuffer);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to stop recording a Command buffer!");
+		return;
+	}
 
-				std::array<VkDescriptorSet, 2> descriptorSetGroup = { m_DescriptorSets[currentImageIndex],
-																	m_SamplerDescriptorSets[currentMeshPart.GetTextureID()] };
+	// Graphics queue fallback: every pass in the frame's single command buffer (pipeline statistics span the whole frame)
+	m_RenderGraph.RecordBatch(frame.CommandBuffer, 0, m_CurrentFrame, currentImageIndex);
 
-				// Bind Descriptor Sets (uniform, uniform_dynamic)
-				vkCmdBindDescriptorSets(m_CommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS,
-					m_PipelineLayout, 0, static_cast<uint32_t>(descriptorSetGroup.size()),
-					descriptorSetGroup.data(), 1, &dynamicOffset);
+	m_GpuProfiler.EndFrame(frame.CommandBuffer);
 
-				// Execute pipeline
-				vkCmdDrawIndexed(m_CommandBuffers[currentImageIndex], currentMeshPart.GetIndexCount(), 1, 0, 0, 0);
-			}
-		}
+	// Stop recording commands to command buffer
+	result = vkEndCommandBuffer(frame.CommandBuffer);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to stop recording a Command buffer!");
+}
 
-		
+void VulkanRenderer::RecordSkinning(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	// Outside the render graph, which only tracks images
+	if (m_SkinnedMeshes.empty())
+	{
+		return;
 	}
 
-	//  Start second subpass
+	uint32_t gpuScope = m_GpuProfiler.BeginScope(commandBuffer, "Skinning");
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineManager.Get(m_SkinningPipelineID));
+	for (const SkinnedMesh& skinnedMesh : m_SkinnedMeshes)
 	{
-		vkCmdNextSubpass(m_CommandBuffers[currentImageIndex], VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_SkinningPipelineLayout,
+			0, 1, &skinnedMesh.DescriptorSets[frameIndex], 0, nullptr);
 
-		vkCmdBindPipeline(m_CommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_SecondPipeline);
-		vkCmdBindDescriptorSets(m_CommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_SecondPipelineLayout,
-			0, 1, &m_InputDescriptorSets[currentImageIndex], 0, nullptr);
+		PushSkinning pushSkinning = { skinnedMesh.VertexCount, skinnedMesh.JointOffset };
+		vkCmdPushConstants(commandBuffer, m_SkinningPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+			0, sizeof(PushSkinning), &pushSkinning);
 
-		vkCmdDraw(m_CommandBuffers[currentImageIndex], 3, 1, 0, 0);
+		// One thread per vertex
+		vkCmdDispatch(commandBuffer, (skinnedMesh.VertexCount + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, 1, 1);
 	}
 
-	// End Render Pass
-	vkCmdEndRenderPass(m_CommandBuffers[currentImageIndex]);
+	// Skinned vertices are read as vertex attributes from here on
+	VkMemoryBarrier skinningBarrier = {};
+	skinningBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	skinningBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	skinningBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+		1, &skinningBarrier, 0, nullptr, 0, nullptr);
 
-	// Stop recording commands to command buffer
-	result = vkEndCommandBuffer(m_CommandBuffers[currentImageIndex]);
-	if (result != VK_SUCCESS)
-		throw std::runtime_error("Failed to stop recording a Command buffer!");
+	m_GpuProfiler.EndScope(commandBuffer, gpuScope);
+}
+
+void VulkanRenderer::RecordGeometry(VkCommandBuffer commandBuffer)
+{
+	uint32_t gpuScope = m_GpuProfiler.BeginScope(commandBuffer, "Geometry");
+
+	// Viewport and scissor are dynamic, the scene renders to the scaled extent
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(m_RenderExtent.width);
+	viewport.height = static_cast<float>(m_RenderExtent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = m_RenderExtent;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// Record the packets built by PrepareFrame, binding only the state that changes between consecutive draws
+	std::array<VkPipeline, 1> pipelines = { m_PipelineManager.Get(m_GraphicsPipelineID) };
+
+	RenderQueueBindings bindings = {};
+	bindings.PipelineLayout = m_PipelineLayout;
+	bindings.Pipelines = pipelines.data();
+	bindings.FrameDescriptorSet = m_Frames[m_CurrentFrame].DescriptorSet;
+	bindings.TextureDescriptorSet = m_TextureDescriptorSet;
+
+	m_RenderStats = {};
+	m_RenderQueue.Record(commandBuffer, bindings, m_RenderStats);
+
+	m_GpuProfiler.EndScope(commandBuffer, gpuScope);
+}
+
+void VulkanRenderer::RecordLighting(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	// Second subpass of the geometry render pass: one fullscreen triangle, every visible pixel is lit once
+	uint32_t gpuScope = m_GpuProfiler.BeginScope(commandBuffer, "Lighting");
+
+	// Viewport and scissor are still the ones of the geometry subpass (dynamic state survives vkCmdNextSubpass)
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineManager.Get(m_LightingPipelineID));
+
+	// Frame set has the dynamic model buffer, its offset is irrelevant here
+	std::array<VkDescriptorSet, 2> descriptorSets = { m_Frames[m_CurrentFrame].DescriptorSet, m_GBufferDescriptorSets[frameIndex] };
+	uint32_t dynamicOffset = 0;
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_LightingPipelineLayout,
+		0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 1, &dynamicOffset);
+
+	PushLighting pushLighting = {};
+	pushLighting.InverseProjection = glm::inverse(m_Camera.Projection);
+	vkCmdPushConstants(commandBuffer, m_LightingPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT,
+		0, sizeof(PushLighting), &pushLighting);
+
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 
+	m_GpuProfiler.EndScope(commandBuffer, gpuScope);
+}
+
+void VulkanRenderer::RecordComposite(VkCommandBuffer commandBuffer, uint32_t frameIndex, bool timestamps)
+{
+	// Not every compute family can write timestamps
+	uint32_t gpuScope = timestamps ? m_GpuProfiler.BeginScope(commandBuffer, "Composite") : UINT32_MAX;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineManager.Get(m_CompositePipelineID));
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CompositePipelineLayout,
+		0, 1, &m_CompositeDescriptorSets[frameIndex], 0, nullptr);
+
+	PushComposite pushComposite = { m_RenderExtent.width, m_RenderExtent.height };
+	vkCmdPushConstants(commandBuffer, m_CompositePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+		0, sizeof(PushComposite), &pushComposite);
+
+	// One thread per pixel of the render extent
+	vkCmdDispatch(commandBuffer, (m_RenderExtent.width + COMPOSITE_GROUP_SIZE - 1) / COMPOSITE_GROUP_SIZE,
+		(m_RenderExtent.height + COMPOSITE_GROUP_SIZE - 1) / COMPOSITE_GROUP_SIZE, 1);
+
+	// Depth tiles for occlusion culling (one thread per tile, same set and push constant), read by the host later
+	if (m_Settings.OcclusionCulling)
+	{
+		uint32_t tilesX = (m_RenderExtent.width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+		uint32_t tilesY = (m_RenderExtent.height + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineManager.Get(m_HiZPipelineID));
+		vkCmdDispatch(commandBuffer, (tilesX + COMPOSITE_GROUP_SIZE - 1) / COMPOSITE_GROUP_SIZE,
+			(tilesY + COMPOSITE_GROUP_SIZE - 1) / COMPOSITE_GROUP_SIZE, 1);
+
+		VkBufferMemoryBarrier hiZBarrier = {};
+		hiZBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		hiZBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		hiZBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		hiZBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hiZBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hiZBarrier.buffer = m_Frames[frameIndex].HiZBuffer;
+		hiZBarrier.offset = 0;
+		hiZBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			0, nullptr, 1, &hiZBarrier, 0, nullptr);
+
+		m_Frames[frameIndex].HiZExtent = m_RenderExtent;
+		m_Frames[frameIndex].HiZViewProjection = m_Camera.Projection * m_Camera.View;
+	}
+	else
+	{
+		m_Frames[frameIndex].HiZExtent = { 0, 0 };
+	}
+
+	m_GpuProfiler.EndScope(commandBuffer, gpuScope);
+}
+
+void VulkanRenderer::RecordUpscale(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	// Upscale the scene color to the swapchain image (inside the render pass begun by the render graph)
+	uint32_t gpuScope = m_GpuProfiler.BeginScope(commandBuffer, "Upscale");
+
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(m_SwapchainExtent.width);
+	viewport.height = static_cast<float>(m_SwapchainExtent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = m_SwapchainExtent;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineManager.Get(m_UpscalePipelineID));
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_UpscalePipelineLayout,
+		0, 1, &m_UpscaleDescriptorSets[frameIndex], 0, nullptr);
 
+	PushUpscale pushUpscale = {};
+	pushUpscale.UvScale = glm::vec2(
+		static_cast<float>(m_RenderExtent.width) / static_cast<float>(m_SwapchainExtent.width),
+		static_cast<float>(m_RenderExtent.height) / static_cast<float>(m_SwapchainExtent.height));
+	pushUpscale.TextureSize = glm::vec2(static_cast<float>(m_SwapchainExtent.width), static_cast<float>(m_SwapchainExtent.height));
+	vkCmdPushConstants(commandBuffer, m_UpscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT,
+		0, sizeof(PushUpscale), &pushUpscale);
 
-	// vkBeginCommandBuffer();
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+	m_GpuProfiler.EndScope(commandBuffer, gpuScope);
 }
 
 bool VulkanRenderer::CheckInstanceExtensionSupport(std::vector<const char*>* checkExtensions)
@@ -1603,13 +2884,13 @@ bool VulkanRenderer::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
 	if (extensionCount == 0)
-		return false;
+		return GetDeviceExtensions().empty();
 
 	// Populate list of extensions
 	std::vector<VkExtensionProperties> extensions(extensionCount);
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
 
-	for (const auto& deviceExtension : s_DeviceExtensions)
+	for (const auto& deviceExtension : GetDeviceExtensions())
 	{
 		bool hasExtension = false;
 		for (const auto& extension : extensions)
@@ -1646,19 +2927,46 @@ bool VulkanRenderer::CheckDeviceSuitable(VkPhysicalDevice device)
 	VkPhysicalDeviceFeatures deviceFeatures;
 	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
+	// Descriptor indexing features needed by the bindless texture table
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.pNext = &vulkan12Features;
+	vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+	bool descriptorIndexingSupported = vulkan12Features.descriptorIndexing && vulkan12Features.runtimeDescriptorArray &&
+		vulkan12Features.descriptorBindingPartiallyBound && vulkan12Features.descriptorBindingSampledImageUpdateAfterBind;
+	// Frames are synchronized with timeline semaphores
+	bool timelineSemaphoreSupported = vulkan12Features.timelineSemaphore == VK_TRUE;
+
 	QueueFamilyIndices indices = GetQueueFamilies(device);
 
 	bool hasExtensionsSupported = CheckDeviceExtensionSupport(device);
 
-	bool swapChainValid = false;
-	if (hasExtensionsSupported)
+	// No swapchain in headless mode, any device with a graphics queue will do (including CPU drivers like lavapipe)
+	bool swapChainValid = m_Settings.Headless;
+	if (hasExtensionsSupported && !m_Settings.Headless)
 	{
 		SwapChainDetails  swapChainDetails = GetSwapChainDetails(device);
 		swapChainValid = !swapChainDetails.PresentationMode.empty() && !swapChainDetails.Formats.empty();
 	}
 
 	//deviceFeatures.samplerAnisotropy
-	return indices.IsValid() && hasExtensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy;
+	return indices.IsValid() && hasExtensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy && descriptorIndexingSupported &&
+		timelineSemaphoreSupported;
+}
+
+std::vector<const char*> VulkanRenderer::GetDeviceExtensions() const
+{
+	// Headless rendering never presents, so it needs no swapchain extension
+	if (m_Settings.Headless)
+	{
+		return std::vector<const char*>();
+	}
+
+	return s_DeviceExtensions;
 }
 
 QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
@@ -1681,9 +2989,12 @@ QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
 		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
 			indices.GraphicsFamily = index;
 
-		// Check the presentation support
+		// Check the presentation support (headless: nothing is presented, reuse the graphics queue)
 		VkBool32 hasPresentationSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, index, m_Surface, &hasPresentationSupport);
+		if (m_Settings.Headless)
+			hasPresentationSupport = indices.GraphicsFamily == index;
+		else
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, index, m_Surface, &hasPresentationSupport);
 		if (queueFamily.queueCount > 0 && hasPresentationSupport)
 			indices.PresentationFamily = index;
 
@@ -1694,6 +3005,19 @@ QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
 		index++;
 	}
 
+	// Async compute: prefer a family without graphics (runs next to the graphics queue), otherwise share the graphics one
+	for (uint32_t i = 0; i < queueFamilyCount; i++)
+	{
+		if (queueFamilyList[i].queueCount > 0 && (queueFamilyList[i].queueFlags & VK_QUEUE_COMPUTE_BIT)
+			&& !(queueFamilyList[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			indices.ComputeFamily = static_cast<int>(i);
+			break;
+		}
+	}
+	if (indices.ComputeFamily < 0)
+		indices.ComputeFamily = indices.GraphicsFamily;
+
 	return indices;
 }
 
@@ -1750,17 +3074,19 @@ VkSurfaceFormatKHR VulkanRenderer::ChooseBestSurfaceFormat(const std::vector<VkS
 	return formats[0];
 }
 // Mailbox
-VkPresentModeKHR VulkanRenderer::ChooseBestPresentationMode(const std::vector<VkPresentModeKHR>& presentationModes)
+VkPresentModeKHR VulkanRenderer::ChooseBestPresentationMode(const std::vector<VkPresentModeKHR>& presentationModes, VkPresentModeKHR requestedMode)
 {
-	// Look for VK_PRESENT_MODE_MAILBOX_KHR
+	// Look for the requested mode (MAILBOX, IMMEDIATE or FIFO)
 	for (const auto& presentationMode : presentationModes)
 	{
-		if (presentationMode == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (presentationMode == requestedMode)
 		{
 			return presentationMode;
 		}
 	}
 
+	std::cout << "Requested present mode " << requestedMode << " not supported, falling back to FIFO" << std::endl;
+
 
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
@@ -1930,30 +3256,15 @@ VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkIm
 	return imageView;
 }
 
-VkShaderModule VulkanRenderer::CreateShaderModule(const std::vector<char>& code)
+int VulkanRenderer::CreateTextureImage(const std::string& filepath, const uint8_t* encodedData, size_t encodedSize)
 {
-	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
-	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderModuleCreateInfo.codeSize = code.size();
-	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-	VkShaderModule shaderModule;
-	VkResult result = vkCreateShaderModule(m_MainDevice.LogicalDevice, &shaderModuleCreateInfo, nullptr, &shaderModule);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create shader module!");
-	}
-
-	return shaderModule;
-}
+	TRACE_FUNCTION();
 
-int VulkanRenderer::CreateTextureImage(const std::string& filepath)
-{
 	// Load image file
 	int width, height;
 	VkDeviceSize imageSize;
 
-	stbi_uc* imageData = LoadTextureFile(filepath, &width, &height, &imageSize);
+	stbi_uc* imageData = LoadTextureFile(filepath, &width, &height, &imageSize, encodedData, encodedSize);
 
 	// Create staging buffer to hold loaded data, ready to copy to device
 	VkBuffer imageStagingBuffer;
@@ -2005,10 +3316,14 @@ int VulkanRenderer::CreateTextureImage(const std::string& filepath)
 	return m_TextureImages.size() - 1;
 }
 
-int VulkanRenderer::CreateTexture(const std::string& filepath)
+int VulkanRenderer::CreateTexture(const std::string& filepath, const uint8_t* encodedData, size_t encodedSize)
 {
+	TRACE_FUNCTION();
+	auto loadStart = std::chrono::high_resolution_clock::now();
+	m_GpuProfiler.BeginUploadBatch(filepath);
+
 	// Create texture image and get is location in array
-	int textureImageLoc = CreateTextureImage(filepath);
+	int textureImageLoc = CreateTextureImage(filepath, encodedData, encodedSize);
 
 	// Create image view and add to list
 	VkImageView imageView = CreateImageView(m_TextureImages[textureImageLoc], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -2017,26 +3332,21 @@ int VulkanRenderer::CreateTexture(const std::string& filepath)
 	// Create descriptor set here
 	int descriptorLoc = CreateTextureDescriptor(imageView);
 
+	m_GpuProfiler.EndUploadBatch();
+	auto loadEnd = std::chrono::high_resolution_clock::now();
+	m_AssetLoadTimes.push_back({ filepath, std::chrono::duration<double, std::milli>(loadEnd - loadStart).count() });
+
 	// Return location of set with texture
 	return descriptorLoc;
 }
 
 int VulkanRenderer::CreateTextureDescriptor(VkImageView textureImage)
 {
-	VkDescriptorSet descriptorSet;
-
-	// Descriptor set allocation info
-	VkDescriptorSetAllocateInfo setAllocateInfo = {};
-	setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocateInfo.descriptorPool = m_SamplerDescriptorPool;
-	setAllocateInfo.descriptorSetCount = 1;
-	setAllocateInfo.pSetLayouts = &m_SamplerDescriptorSetLayout;
-
-	// ALlocate descriptor sets
-	VkResult result = vkAllocateDescriptorSets(m_MainDevice.LogicalDevice, &setAllocateInfo, &descriptorSet);
-	if (result != VK_SUCCESS)
+	// Next free slot of the texture table
+	uint32_t textureIndex = m_TextureCount;
+	if (textureIndex >= m_MaxTextures)
 	{
-		throw std::runtime_error("Failed to allocate texture descriptor sets!");
+		throw std::runtime_error("Failed to add texture, the texture table is full!");
 	}
 
 	// Texture image info
@@ -2049,36 +3359,111 @@ int VulkanRenderer::CreateTextureDescriptor(VkImageView textureImage)
 	// Descriptor write info
 	VkWriteDescriptorSet descriptorWrite = {};
 	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite.dstSet = descriptorSet;
+	descriptorWrite.dstSet = m_TextureDescriptorSet;
 	descriptorWrite.dstBinding = 0;
-	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.dstArrayElement = textureIndex;		// slot in the texture table
 	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	descriptorWrite.descriptorCount = 1;
 	descriptorWrite.pImageInfo = &imageInfo;
 
 
-	// Update new descriptor set
+	// Update the texture table (allowed while the set is bound thanks to update after bind)
 	vkUpdateDescriptorSets(m_MainDevice.LogicalDevice, 1, &descriptorWrite, 0, nullptr);
 
-	// Add descriptor set to list
-	m_SamplerDescriptorSets.push_back(descriptorSet);
+	m_TextureCount++;
+
+	// return texture index (selected in the shader through the material push constant)
+	return static_cast<int>(textureIndex);
+
+}
+
+ModelImport VulkanRenderer::ImportModel(const std::string& filepath, JobSystem& jobSystem)
+{
+	TRACE_FUNCTION();
+	auto importStart = std::chrono::high_resolution_clock::now();
+
+	// Import model 'scene' (one importer per file, so imports can run concurrently)
+	ModelImport modelImport;
+
+	// glTF is read natively (memory mapped, accessors copied straight into the staging buffers later)
+	if (GltfModel::IsGltfFile(filepath))
+	{
+		try
+		{
+			modelImport.Gltf.reset(new GltfModel());
+			modelImport.Gltf->Load(filepath);
+		}
+		catch (const std::exception& e)
+		{
+			modelImport.Gltf.reset();
+			modelImport.Error = "Failed to load model: " + filepath + " (" + e.what() + ")";
+		}
+
+		auto importEnd = std::chrono::high_resolution_clock::now();
+		modelImport.Milliseconds = std::chrono::duration<double, std::milli>(importEnd - importStart).count();
+		return modelImport;
+	}
+
+	// OBJ is parsed natively too (memory mapped, chunks of lines parsed in parallel)
+	if (ObjModel::IsObjFile(filepath))
+	{
+		try
+		{
+			modelImport.Obj.reset(new ObjModel());
+			modelImport.Obj->Load(filepath, jobSystem);
+		}
+		catch (const std::exception& e)
+		{
+			modelImport.Obj.reset();
+			modelImport.Error = "Failed to load model: " + filepath + " (" + e.what() + ")";
+		}
+
+		auto importEnd = std::chrono::high_resolution_clock::now();
+		modelImport.Milliseconds = std::chrono::duration<double, std::milli>(importEnd - importStart).count();
+		return modelImport;
+	}
+
+	modelImport.Importer.reset(new Assimp::Importer());
+	modelImport.Scene = modelImport.Importer->ReadFile(filepath,
+		aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals |
+		aiProcess_LimitBoneWeights);
 
-	// return descriptor set location
-	return m_SamplerDescriptorSets.size() - 1;
+	if (!modelImport.Scene)
+	{
+		modelImport.Error = "Failed to load model: " + filepath;
+	}
 
+	auto importEnd = std::chrono::high_resolution_clock::now();
+	modelImport.Milliseconds = std::chrono::duration<double, std::milli>(importEnd - importStart).count();
+	return modelImport;
 }
 
 void VulkanRenderer::CreateMeshModel(const std::string& filepath)
 {
-	// Import model 'scene'
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(filepath,
-		aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
+	CreateMeshModel(filepath, ImportModel(filepath, m_JobSystem));
+}
+
+void VulkanRenderer::CreateMeshModel(const std::string& filepath, const ModelImport& modelImport)
+{
+	TRACE_FUNCTION();
+	auto loadStart = std::chrono::high_resolution_clock::now();
+
+	if (!modelImport.Scene && !modelImport.Gltf && !modelImport.Obj)
+	{
+		throw std::runtime_error(modelImport.Error);
+	}
 
-	if (!scene)
+	if (modelImport.Gltf)
 	{
-		throw std::runtime_error("Failed to load model: " + filepath);
+		std::vector<Mesh> modelMeshes = LoadGltfMeshes(filepath, *modelImport.Gltf);
+		MeshModel meshModel = MeshModel(modelMeshes);
+		AddMeshModel(meshModel);
+
+		auto loadEnd = std::chrono::high_resolution_clock::now();
+		m_AssetLoadTimes.push_back({ filepath, modelImport.Milliseconds + std::chrono::duration<double, std::milli>(loadEnd - loadStart).count() });
+		return;
 	}
+	const aiScene* scene = modelImport.Scene;
 
 	// Get the directory of model
 	std::string directoryPath;
@@ -2090,7 +3475,7 @@ void VulkanRenderer::CreateMeshModel(const std::string& filepath)
 
 
 	// Get vector of all material with 1:1 ID placement
-	std::vector<std::string> textureNames = MeshModel::LoadMaterials(scene);
+	std::vector<std::string> textureNames = modelImport.Obj ? modelImport.Obj->GetMaterialTextures() : MeshModel::LoadMaterials(scene);
 
 	// Conversion from the materials lists IDS to our Descriptor Array IDS
 	std::vector<int> materialToTextures(textureNames.size());
@@ -2111,22 +3496,237 @@ void VulkanRenderer::CreateMeshModel(const std::string& filepath)
 		}
 	}
 
-	// Load in all our meshes
+	// OBJ meshes are complete already, only their buffers are left to create
+	if (modelImport.Obj)
+	{
+		std::vector<Mesh> modelMeshes;
+		m_GpuProfiler.BeginUploadBatch(filepath);
+		for (ObjMesh& objMesh : modelImport.Obj->GetMeshes())
+		{
+			int textureID = objMesh.Material >= 0 ? materialToTextures[objMesh.Material] : 0;
+			modelMeshes.push_back(Mesh(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, m_GraphicsQueue,
+				m_GraphicsCommandPool, &objMesh.Vertices, &objMesh.Indices, textureID));
+		}
+		m_GpuProfiler.EndUploadBatch();
+
+		MeshModel meshModel = MeshModel(modelMeshes);
+		AddMeshModel(meshModel);
+
+		auto loadEnd = std::chrono::high_resolution_clock::now();
+		m_AssetLoadTimes.push_back({ filepath, modelImport.Milliseconds + std::chrono::duration<double, std::milli>(loadEnd - loadStart).count() });
+		return;
+	}
+
+	// Skeleton from the node hierarchy when any mesh has bones (the bones are added as the meshes load)
+	bool hasBones = false;
+	for (uint32_t i = 0; i < scene->mNumMeshes; i++)
+	{
+		hasBones = hasBones || scene->mMeshes[i]->HasBones();
+	}
+	Skeleton skeleton;
+	if (hasBones)
+	{
+		skeleton = Skeleton::Load(scene);
+	}
+
+	// Load in all our meshes (vertex and index buffer copies timed on the GPU, textures have their own batches)
+	m_GpuProfiler.BeginUploadBatch(filepath);
 	std::vector<Mesh> modelMeshes = MeshModel::LoadNode(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, m_GraphicsQueue,
-		m_GraphicsCommandPool, scene->mRootNode, scene, materialToTextures);
+		m_GraphicsCommandPool, scene->mRootNode, scene, materialToTextures, hasBones ? &skeleton : nullptr);
+	m_GpuProfiler.EndUploadBatch();
 
 	// Create mesh model and add to list
 	MeshModel meshModel = MeshModel(modelMeshes);
+	if (!skeleton.BoneJoints.empty())
+	{
+		meshModel.SetSkeleton(skeleton, AnimationClip::Load(scene, skeleton));
+	}
+	AddMeshModel(meshModel);
+
+	// Includes the import and the textures of the model (also listed on their own)
+	auto loadEnd = std::chrono::high_resolution_clock::now();
+	m_AssetLoadTimes.push_back({ filepath, modelImport.Milliseconds + std::chrono::duration<double, std::milli>(loadEnd - loadStart).count() });
+}
+
+void VulkanRenderer::AddMeshModel(MeshModel& meshModel)
+{
+	// The model uniform buffers and their transfer space only hold MAX_OBJECTS matrices
+	if (m_ModelList.size() >= MAX_OBJECTS)
+	{
+		meshModel.DestroyMeshModel();
+		throw std::runtime_error("Failed to add a model, the scene already has the maximum of " + std::to_string(MAX_OBJECTS) + " models!");
+	}
+
+	meshModel.SetSceneNode(m_SceneGraph.CreateNode());
+	m_ModelTransforms.Add();
 	m_ModelList.push_back(meshModel);
+	CreateSkinnedMeshes(static_cast<uint32_t>(m_ModelList.size() - 1));
+}
+
+std::vector<Mesh> VulkanRenderer::LoadGltfMeshes(const std::string& filepath, const GltfModel& gltf)
+{
+	TRACE_FUNCTION();
+
+	// One texture per image (materials can share them), created before the mesh batch as they time their own uploads
+	const std::vector<GltfImage>& images = gltf.GetImages();
+	std::vector<int> imageToTextures(images.size(), -1);
+	for (const GltfPrimitive& primitive : gltf.GetPrimitives())
+	{
+		int32_t image = gltf.GetMaterialImage(primitive.Material);
+		if (image < 0 || imageToTextures[image] >= 0)
+		{
+			continue;
+		}
+
+		if (images[image].Data)
+		{
+			imageToTextures[image] = CreateTexture(filepath + ":image" + std::to_string(image), images[image].Data, images[image].Size);
+		}
+		else
+		{
+			imageToTextures[image] = CreateTexture(images[image].Path);
+		}
+	}
+
+	// Vertices and indices are gathered from the mapped buffers straight into the staging memory
+	std::vector<Mesh> modelMeshes;
+	modelMeshes.reserve(gltf.GetPrimitives().size());
+	m_GpuProfiler.BeginUploadBatch(filepath);
+	for (const GltfPrimitive& primitive : gltf.GetPrimitives())
+	{
+		if (primitive.IndexCount == 0)
+		{
+			continue;
+		}
+
+		MeshSource source;
+		source.VertexCount = primitive.VertexCount;
+		source.IndexCount = primitive.IndexCount;
+		source.BoundsMin = primitive.BoundsMin;
+		source.BoundsMax = primitive.BoundsMax;
+		source.WriteVertices = [&gltf, &primitive](Vertex* vertices) { gltf.WriteVertices(primitive, vertices); };
+		source.WriteIndices = [&gltf, &primitive](uint32_t* indices) { gltf.WriteIndices(primitive, indices); };
+		source.WritePositions = [&gltf, &primitive](glm::vec3* positions) { gltf.WritePositions(primitive, positions); };
+
+		// Texture 0 is the default texture
+		int32_t image = gltf.GetMaterialImage(primitive.Material);
+		int textureID = image >= 0 ? imageToTextures[image] : 0;
+
+		modelMeshes.push_back(Mesh(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, m_GraphicsQueue,
+			m_GraphicsCommandPool, source, textureID));
+	}
+	m_GpuProfiler.EndUploadBatch();
+
+	return modelMeshes;
+}
+
+void VulkanRenderer::CreateSkinnedMeshes(uint32_t meshObjectIndex)
+{
+	MeshModel& meshModel = m_ModelList[meshObjectIndex];
+	if (!meshModel.IsSkinned())
+	{
+		m_PartSkinnedMeshes.insert(m_PartSkinnedMeshes.end(), meshModel.GetMeshCount(), UINT32_MAX);
+		return;
+	}
+
+	// The model's skin matrices go after those of the models loaded before it
+	uint32_t jointCount = static_cast<uint32_t>(meshModel.GetSkeleton().BoneJoints.size());
+	if (m_SkinJointCount + jointCount > MAX_SKIN_JOINTS)
+	{
+		throw std::runtime_error("Too many skinned joints!");
+	}
+	SkinnedModel skinnedModel = { meshObjectIndex, m_SkinJointCount };
+	m_SkinnedModels.push_back(skinnedModel);
+	m_SkinJointCount += jointCount;
+
+	for (size_t k = 0; k < meshModel.GetMeshCount(); k++)
+	{
+		const Mesh& mesh = meshModel.GetMesh(k);
+		if (!mesh.IsSkinned())
+		{
+			m_PartSkinnedMeshes.push_back(UINT32_MAX);
+			continue;
+		}
+		if (m_SkinnedMeshes.size() >= MAX_SKINNED_MESHES)
+		{
+			throw std::runtime_error("Too many skinned meshes!");
+		}
+
+		SkinnedMesh skinnedMesh = {};
+		skinnedMesh.Model = meshObjectIndex;
+		skinnedMesh.Part = static_cast<uint32_t>(k);
+		skinnedMesh.JointOffset = skinnedModel.JointOffset;
+		skinnedMesh.VertexCount = static_cast<uint32_t>(mesh.GetVertexCount());
+		skinnedMesh.OutputBuffers.resize(m_Frames.size());
+		skinnedMesh.OutputBufferMemory.resize(m_Frames.size());
+
+		// Skinned vertices of each frame in flight, written by the skinning dispatch and drawn as the vertex buffer
+		VkDeviceSize outputSize = sizeof(Vertex) * skinnedMesh.VertexCount;
+		for (size_t i = 0; i < m_Frames.size(); i++)
+		{
+			CreateBuffer(m_MainDevice.PhysicalDevice, m_MainDevice.LogicalDevice, outputSize,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&skinnedMesh.OutputBuffers[i], &skinnedMesh.OutputBufferMemory[i]);
+		}
+
+		std::vector<VkDescriptorSetLayout> setLayouts(m_Frames.size(), m_SkinningDescriptorSetLayout);
+		skinnedMesh.DescriptorSets.resize(m_Frames.size());
+
+		VkDescriptorSetAllocateInfo setAllocateInfo = {};
+		setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setAllocateInfo.descriptorPool = m_SkinningDescriptorPool;
+		setAllocateInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+		setAllocateInfo.pSetLayouts = setLayouts.data();
+
+		VkResult result = vkAllocateDescriptorSets(m_MainDevice.LogicalDevice, &setAllocateInfo, skinnedMesh.DescriptorSets.data());
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate Skinning Descriptor Sets!");
+		}
+
+		for (size_t i = 0; i < m_Frames.size(); i++)
+		{
+			std::array<VkDescriptorBufferInfo, 4> bufferInfos = {};
+			bufferInfos[0].buffer = mesh.GetVertexBuffer();
+			bufferInfos[1].buffer = mesh.GetSkinBuffer();
+			bufferInfos[2].buffer = m_Frames[i].JointBuffer;
+			bufferInfos[3].buffer = skinnedMesh.OutputBuffers[i];
+
+			std::array<VkWriteDescriptorSet, 4> setWrites = {};
+			for (uint32_t b = 0; b < setWrites.size(); b++)
+			{
+				bufferInfos[b].offset = 0;
+				bufferInfos[b].range = VK_WHOLE_SIZE;
+
+				setWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				setWrites[b].dstSet = skinnedMesh.DescriptorSets[i];
+				setWrites[b].dstBinding = b;
+				setWrites[b].dstArrayElement = 0;
+				setWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				setWrites[b].descriptorCount = 1;
+				setWrites[b].pBufferInfo = &bufferInfos[b];
+			}
+
+			vkUpdateDescriptorSets(m_MainDevice.LogicalDevice, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+		}
+
+		m_PartSkinnedMeshes.push_back(static_cast<uint32_t>(m_SkinnedMeshes.size()));
+		m_SkinnedMeshes.push_back(skinnedMesh);
+	}
 }
 
-stbi_uc* VulkanRenderer::LoadTextureFile(const std::string& fileName, int* width, int* height, VkDeviceSize* imageSize)
+stbi_uc* VulkanRenderer::LoadTextureFile(const std::string& fileName, int* width, int* height, VkDeviceSize* imageSize,
+	const uint8_t* encodedData, size_t encodedSize)
 {
+	TRACE_FUNCTION();
+
 	// number of channels image uses
 	int channels;
 
 	// load pixel data 
-	stbi_uc* image = stbi_load(fileName.c_str(), width, height, &channels, STBI_rgb_alpha);
+	stbi_uc* image = encodedData
+		? stbi_load_from_memory(encodedData, static_cast<int>(encodedSize), width, height, &channels, STBI_rgb_alpha)
+		: stbi_load(fileName.c_str(), width, height, &channels, STBI_rgb_alpha);
 
 	if (!image)
 	{
@@ -2171,6 +3771,21 @@ void VulkanRenderer::GetPhysicalDevice()
 
 	m_MinUniformBufferOffset = deviceProperties.limits.minUniformBufferOffsetAlignment;
 
+	// Update after bind limits decide how large the texture table can be
+	VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties = {};
+	descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 deviceProperties2 = {};
+	deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	deviceProperties2.pNext = &descriptorIndexingProperties;
+	vkGetPhysicalDeviceProperties2(m_MainDevice.PhysicalDevice, &deviceProperties2);
+
+	m_MaxTextures = std::min({ static_cast<uint32_t>(MAX_TEXTURES),
+		descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+		descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+		descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+
 
 	
 }
@@ -18,6 +18,11 @@
 #include <set>
 #include <algorithm>
 #include <array>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <deque>
+#include <functional>
 
 // stb_image
 #include <stb_image.h>
@@ -25,6 +30,21 @@
 
 #include "Mesh.h"
 #include "MeshModel.h"
+#include "RenderQueue.h"
+#include "PipelineManager.h"
+#include "DynamicResolution.h"
+#include "GpuProfiler.h"
+#include "Trace.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include "RenderGraph.h"
+#include "ClusteredLighting.h"
+#include "OcclusionCulling.h"
+#include "SoftwareOcclusion.h"
+#include "SceneGraph.h"
+#include "TransformStore.h"
+#include "GltfModel.h"
+#include "ObjModel.h"
 #include "Utils.h"
 
 
@@ -35,6 +55,77 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+// Load time of one model or texture file
+struct AssetLoadTime
+{
+	std::string Path;
+	double Milliseconds;
+};
+
+// Assimp scene (or native glTF / OBJ model) of a model file, imported on any thread (GPU resources are created later on the main thread)
+struct ModelImport
+{
+	std::unique_ptr<Assimp::Importer> Importer;		// owns the scene
+	const aiScene* Scene = nullptr;
+	std::unique_ptr<GltfModel> Gltf;				// .gltf and .glb files, instead of the scene
+	std::unique_ptr<ObjModel> Obj;					// .obj files, instead of the scene
+	double Milliseconds = 0.0;
+	std::string Error;								// set instead of throwing (jobs must not throw)
+};
+
+// CPU time spent in the parts of the last Draw call
+struct FrameTimings
+{
+	double PrepareMs = 0.0;		// draw list and model transforms (before any wait)
+	double WaitMs = 0.0;		// frame timeline wait, acquire and swapchain image wait
+	double FrameWaitMs = 0.0;	// frame timeline wait only
+	double AcquireWaitMs = 0.0;	// acquire and swapchain image wait
+	double RecordMs = 0.0;		// command recording and uniform updates
+	double SubmitMs = 0.0;		// queue submit and present
+};
+
+// Runtime renderer configuration
+struct RendererSettings
+{
+	uint32_t FramesInFlight = DEFAULT_FRAMES_IN_FLIGHT;			// frames recorded ahead of the GPU (latency vs throughput)
+	VkPresentModeKHR PresentMode = VK_PRESENT_MODE_MAILBOX_KHR;	// falls back to FIFO when not supported
+
+	// Dynamic resolution: the scene is rendered at a scale picked from the GPU frame time, then upscaled
+	bool DynamicResolution = true;
+	float GpuFrameBudgetMs = 14.0f;			// leaves headroom under a 60 Hz frame
+	float MinRenderScale = 0.5f;
+	float MaxRenderScale = 1.0f;
+
+	// Async compute: composite on a separate compute queue, overlapping the next frame's geometry.
+	// Falls back to the graphics queue without a compute family separate from the graphics one.
+	bool AsyncCompute = true;
+
+	// Deferred shading: the geometry pass writes a G-buffer (albedo, normal) and a second subpass of the same render pass
+	// lights every visible pixel once from input attachments (the G-buffer stays in tile memory on tilers)
+	bool DeferredShading = false;
+
+	// Occlusion culling: meshes hidden behind the depth of the newest finished frame are not drawn. The depth is read
+	// back a few frames late, the bounds are reprojected into that frame. Off by default: without a second test against
+	// the current frame's depth, meshes uncovered by a moving occluder or camera appear a few frames late
+	bool OcclusionCulling = false;
+
+	// Software occlusion: large meshes (and tagged models) are rasterized on the CPU into a small depth buffer every
+	// frame and the other meshes are tested against it. No read back, so no latency, but occluders are approximate
+	bool SoftwareOcclusion = false;
+
+	// Headless: render into offscreen images instead of a window swapchain (no window, surface or presentation)
+	bool Headless = false;
+	VkExtent2D HeadlessExtent = { 1280, 720 };
+	uint32_t HeadlessImageCount = 2;		// offscreen images, cycled through like swapchain images
+
+	// Models loaded by Init, in order (index used by UpdateModel)
+	std::vector<std::string> Models = {
+		"src/Models/Sora/Sora.obj",
+		"src/Models/Cactuar/cactuar.obj",
+		"src/Models/Sora/Sora.obj"
+	};
+};
+
 class VulkanRenderer
 {
 public:
@@ -48,25 +139,73 @@ public:
 	};
 
 public:
-	int Init(GLFWwindow* window);
+	// window may be nullptr in headless mode
+	int Init(GLFWwindow* window, const RendererSettings& settings = RendererSettings());
 
+	// Local transform of the model's scene node (the model matrix when the node has no parent)
 	void UpdateModel(uint32_t meshObjectIndex, glm::mat4& newModel);
+	// Batched UpdateModel from translation, rotation and scale (composed with SIMD when the frame is prepared)
+	void UpdateModels(const uint32_t* meshObjectIndices, const ModelTransform* transforms, uint32_t count);
+	// Every model gets a root node on load, parent it to other nodes to move it with them
+	SceneGraph& GetSceneGraph() { return m_SceneGraph; }
+	uint32_t GetModelNode(uint32_t meshObjectIndex) const { return m_ModelList[meshObjectIndex].GetSceneNode(); }
+	// Model always used as an occluder by software occlusion (otherwise picked when large on screen)
+	void SetOccluder(uint32_t meshObjectIndex, bool occluder);
+	uint32_t GetModelCount() const { return static_cast<uint32_t>(m_ModelList.size()); }
+
+	// Skinned models: clip (and blend) sampled when the frame is prepared, the caller advances the times.
+	// Models without clips keep their bind pose
+	void SetAnimation(uint32_t meshObjectIndex, const AnimationState& animationState);
+	uint32_t GetAnimationCount(uint32_t meshObjectIndex) const { return static_cast<uint32_t>(m_ModelList[meshObjectIndex].GetAnimationCount()); }
+
+	// Point lights (world space), binned into clusters every frame. Up to MAX_LIGHTS
+	uint32_t AddLight(const PointLight& light);
+	void UpdateLight(uint32_t lightIndex, const PointLight& light);
+	uint32_t GetLightCount() const { return static_cast<uint32_t>(m_Lights.size()); }
+	// Light binning of the last prepared frame
+	const ClusterStats& GetClusterStats() const { return m_ClusteredLighting.GetStats(); }
+	// Occlusion tests of the last prepared frame
+	const OcclusionStats& GetOcclusionStats() const { return m_OcclusionCulling.GetStats(); }
+	const SoftwareOcclusionStats& GetSoftwareOcclusionStats() const { return m_SoftwareOcclusion.GetStats(); }
 
 	void Draw();
+
+	// Change the depth range shown by the composite pass (pipeline permutation compiled in the background)
+	void SetDepthVisualizationRange(float lowerBound, float upperBound);
+
+	// State change counts of the last recorded frame
+	const RenderQueueStats& GetRenderStats() const { return m_RenderStats; }
+	// Current scene resolution scale and the smoothed GPU frame time it was picked from
+	float GetRenderScale() const { return m_DynamicResolution.GetScale(); }
+	float GetGpuFrameTime() const { return m_DynamicResolution.GetSmoothedGpuTime(); }
+	// Composite pass runs on a separate compute queue (frames are presented one Draw later)
+	bool IsAsyncComputeEnabled() const { return m_AsyncCompute; }
+
+	// Timings of the last Draw and of every asset loaded so far
+	const FrameTimings& GetLastFrameTimings() const { return m_FrameTimings; }
+	const std::vector<AssetLoadTime>& GetAssetLoadTimes() const { return m_AssetLoadTimes; }
+	// Rolling history of the per frame timings and counters (cheap, always on)
+	FrameStats& GetFrameStats() { return m_FrameStats; }
+	const FrameStats& GetFrameStats() const { return m_FrameStats; }
+	// GPU times of the last frame whose results are available (a few frames late) and of every upload batch
+	const GpuFrameStats& GetGpuFrameStats() const { return m_GpuProfiler.GetLastFrameStats(); }
+	const std::vector<GpuUploadTime>& GetGpuUploadTimes() const { return m_GpuProfiler.GetUploadTimes(); }
+
+	// Headless only: write the last rendered offscreen image to a binary PPM file (waits for the GPU)
+	bool SaveLastFrame(const std::string& filepath);
 	void CleanUp();
 
 private:
 	// Create functions
 	void CreateInstance();
 	void CreateLogicalDevice();
+	void CreatePipelineCache();
 	void CreateSurface();
 	void CreateSwapChain();
-	void CreateRenderPass();
+	void CreateOffscreenImages();
+	void BuildRenderGraph();
 	void CreateDescriptorSetLayout();
 	void CreateGraphicsPipeline();
-	void CreateDepthBufferImage();
-	void CreateColorBufferImage();
-	void CreateFramebuffers();
 	void CreateCommandPool();
 	void CreateCommandBuffers();
 	void CreateSynchronization();
@@ -76,12 +215,35 @@ private:
 	void CreateUniformBuffers();
 	void CreateDescriptorPool();
 	void CreateDescriptorSets();
-	void CreateInputDescriptorSets();
+	void CreateCompositeDescriptorSets();
+	void CreateUpscaleDescriptorSets();
+	void CreateGBufferDescriptorSets();
 
-	void UpdateUniformBuffers(uint32_t imageIndex);
+	void PrepareFrame();
+	void UpdateOcclusionPyramid();
+	void RenderSoftwareOcclusion();
+	void UpdateSkinning();
+	void UpdateUniformBuffers(FrameContext& frame);
+	void ReadGpuFrameTime();
 
 	// Record functions
-	void RecordCommands(uint32_t currentImageIndex);
+	void RecordCommands(FrameContext& frame, uint32_t currentImageIndex);
+	void RecordSkinning(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+	void RecordGeometry(VkCommandBuffer commandBuffer);
+	void RecordLighting(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+	void RecordComposite(VkCommandBuffer commandBuffer, uint32_t frameIndex, bool timestamps);
+	void RecordUpscale(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+	// Submit functions
+	// Final submit of the frame deferred by async compute, present = false only completes it (shutdown)
+	void SubmitPendingPresent(bool present = true);
+	void Present(FrameContext& frame, uint32_t imageIndex);
+
+	// Timeline functions
+	void WaitForGraphicsTimeline(uint64_t value);
+	// Run `destroy` once the GPU is done with every frame recorded so far
+	void DeferDestroy(std::function<void()> destroy);
+	void FlushDeferredDestroys(bool all);
 
 	// Get functions
 	void GetPhysicalDevice();
@@ -90,10 +252,14 @@ private:
 	void AllocateDynamicBufferTransferSpace();
 
 	// Support functions
+	// -- Pipeline cache functions
+	void SavePipelineCache();
+	bool IsPipelineCacheCompatible(const std::vector<char>& cacheData);
 	// -- Check functions
 	bool CheckInstanceExtensionSupport(std::vector<const char*>* checkExtensions);
 	bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
 	bool CheckDeviceSuitable(VkPhysicalDevice device);
+	std::vector<const char*> GetDeviceExtensions() const;
 	// -- getter functions
 	QueueFamilyIndices GetQueueFamilies(VkPhysicalDevice device);
 	SwapChainDetails GetSwapChainDetails(VkPhysicalDevice device);
@@ -101,7 +267,7 @@ private:
 
 	// -- pick functions
 	VkSurfaceFormatKHR ChooseBestSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats);
-	VkPresentModeKHR ChooseBestPresentationMode(const std::vector< VkPresentModeKHR>& presentationModes);
+	VkPresentModeKHR ChooseBestPresentationMode(const std::vector< VkPresentModeKHR>& presentationModes, VkPresentModeKHR requestedMode);
 	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
 	VkFormat ChooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags);
 
@@ -112,21 +278,34 @@ private:
 	VkImage CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
 		VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory* imageMemory);
 	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-	VkShaderModule CreateShaderModule(const std::vector<char>& code);
 
-	int CreateTextureImage(const std::string& filepath);
-	int CreateTexture(const std::string& filepath);
+	// Encoded data (an image embedded in a model) is decoded instead of the file, filepath only names it
+	int CreateTextureImage(const std::string& filepath, const uint8_t* encodedData = nullptr, size_t encodedSize = 0);
+	int CreateTexture(const std::string& filepath, const uint8_t* encodedData = nullptr, size_t encodedSize = 0);
 	int CreateTextureDescriptor(VkImageView textureImage);
 
 	void CreateMeshModel(const std::string& filepath);
+	void CreateMeshModel(const std::string& filepath, const ModelImport& modelImport);
+	void CreateSkinnedMeshes(uint32_t meshObjectIndex);
+	void AddMeshModel(MeshModel& meshModel);
+	std::vector<Mesh> LoadGltfMeshes(const std::string& filepath, const GltfModel& gltf);
+	// Large files are parsed with jobs of jobSystem (which may be running this import as a job itself)
+	static ModelImport ImportModel(const std::string& filepath, JobSystem& jobSystem);
 
 	// Loader-functions
-	stbi_uc* LoadTextureFile(const std::string& fileName, int* width, int* height, VkDeviceSize* imageSize);
+	stbi_uc* LoadTextureFile(const std::string& fileName, int* width, int* height, VkDeviceSize* imageSize,
+		const uint8_t* encodedData = nullptr, size_t encodedSize = 0);
 
 private:
 	GLFWwindow* m_Window;
+	RendererSettings m_Settings;
+
+	// Shared worker pool (asset imports, pipeline compiles)
+	JobSystem m_JobSystem;
 
-	int m_CurrentFrame = 0;
+	// Per frame in flight resources, cycled through with m_CurrentFrame
+	std::vector<FrameContext> m_Frames;
+	uint32_t m_CurrentFrame = 0;
 
 	// Scene objects
 	std::vector<Mesh> m_MeshList;
@@ -136,51 +315,137 @@ private:
 		glm::mat4 View;
 
 	} m_Camera;
+	float m_CameraNearPlane = 0.1f;
+	float m_CameraFarPlane = 100.0f;
+
+	// Transform hierarchy, world transforms of the model nodes are the model matrices
+	SceneGraph m_SceneGraph;
+	// Transforms set by UpdateModels (one entry per model), composed into the local transforms of the model nodes
+	TransformStore m_ModelTransforms;
+
+	// Point lights and their per-frame cluster binning
+	std::vector<PointLight> m_Lights;
+	ClusteredLighting m_ClusteredLighting;
+
+	// Depth pyramid of the newest finished frame
+	OcclusionCulling m_OcclusionCulling;
+
+	// Occluders rasterized on the CPU this frame (one flag per mesh part, in model order)
+	SoftwareOcclusion m_SoftwareOcclusion;
+	std::vector<SoftwareOccluder> m_SoftwareOccluders;
+	std::vector<uint8_t> m_SoftwareOccluderParts;
+
+	// Skinned mesh parts, skinned once per frame by a compute dispatch into a per-frame vertex buffer that every later
+	// pass draws. The skin matrices of all skinned models share the frame's joint buffer
+	struct SkinnedModel
+	{
+		uint32_t Model;
+		uint32_t JointOffset;		// first skin matrix in the joint buffer
+	};
+	struct SkinnedMesh
+	{
+		uint32_t Model;
+		uint32_t Part;
+		uint32_t JointOffset;
+		uint32_t VertexCount;
+		std::vector<VkBuffer> OutputBuffers;			// per frame in flight
+		std::vector<VkDeviceMemory> OutputBufferMemory;
+		std::vector<VkDescriptorSet> DescriptorSets;
+	};
+	std::vector<SkinnedModel> m_SkinnedModels;
+	std::vector<SkinnedMesh> m_SkinnedMeshes;
+	std::vector<uint32_t> m_PartSkinnedMeshes;		// skinned mesh of every mesh part (in model order), UINT32_MAX = static
+	uint32_t m_SkinJointCount = 0;
+
+	// Draw packets of the current frame, sorted by state
+	RenderQueue m_RenderQueue;
+	RenderQueueStats m_RenderStats;
+	FrameTimings m_FrameTimings;
+	std::vector<AssetLoadTime> m_AssetLoadTimes;
+	FrameStats m_FrameStats;
+	std::chrono::high_resolution_clock::time_point m_LastDrawStart;
+	bool m_HasDrawn = false;
+	uint64_t m_FrameBytesUploaded = 0;
 
 	// -- Vulkan components
 	VkInstance m_Instance;
 	Devices m_MainDevice;
 	VkQueue m_GraphicsQueue;
 	VkQueue m_PresentationQueue;
+	VkQueue m_ComputeQueue;
+
+	// Frame synchronization: one timeline semaphore per queue, signalled with the frame number by the frame's
+	// last submit on that queue. Frame contexts, swapchain images and deferred destroys wait for a frame number.
+	VkSemaphore m_GraphicsTimeline = VK_NULL_HANDLE;	// frame number, signalled once the whole frame is done
+	uint64_t m_FrameNumber = 0;							// last frame recorded (frame numbers start at 1)
+	std::deque<std::pair<uint64_t, std::function<void()>>> m_DeferredDestroys;
+
+	// Async compute (see RendererSettings::AsyncCompute)
+	bool m_AsyncCompute = false;
+	bool m_ComputeTimestamps = false;					// compute family supports timestamps (Composite scope)
+	VkSemaphore m_ComputeTimeline = VK_NULL_HANDLE;		// frame number, signalled once the frame's composite is done
+	// Upscale and present of the last frame, submitted after the next frame's geometry so the composite overlaps it
+	struct PendingPresent
+	{
+		bool Valid = false;
+		uint32_t FrameIndex = 0;
+		uint32_t ImageIndex = 0;
+		uint64_t FrameNumber = 0;
+	} m_PendingPresent;
 
 	VkSurfaceKHR m_Surface;
 	VkSwapchainKHR m_Swapchain;
 
-	std::vector<SwapChainImage> m_SwapChainImages;
-	std::vector<VkFramebuffer> m_SwapChainFramebuffers;
-	std::vector<VkCommandBuffer> m_CommandBuffers;
-
-	// Color buffer image
-	std::vector<VkImage> m_ColorBufferImage;
-	std::vector<VkDeviceMemory> m_ColorBufferImageMemory;
-	std::vector<VkImageView> m_ColorBufferImageView;
-	// depth buffer image
-	std::vector<VkImage> m_DepthBufferImage;
-	std::vector<VkDeviceMemory> m_DepthBufferImageMemory;
-	std::vector<VkImageView> m_DepthBufferImageView;
-	VkFormat m_DepthBufferFormat;
+	std::vector<SwapChainImage> m_SwapChainImages;			// offscreen images in headless mode
+	std::vector<VkDeviceMemory> m_OffscreenImageMemory;		// headless only (swapchain images are owned by the swapchain)
+	uint32_t m_NextOffscreenImage = 0;
+	uint32_t m_LastImageIndex = 0;
+
+	// Render graph: passes, their images (one copy per frame in flight) and the barriers between them
+	RenderGraph m_RenderGraph;
+	uint32_t m_ColorBufferImage;			// scene pass color
+	uint32_t m_DepthBufferImage;
+	uint32_t m_SceneColorImage;				// output of the composite pass at the dynamic resolution, sampled by the upscale pass
+	uint32_t m_SwapchainGraphImage;			// imported swapchain (or offscreen) images
+	uint32_t m_AlbedoImage = UINT32_MAX;	// deferred G-buffer, transient (only read in the lighting subpass)
+	uint32_t m_NormalImage = UINT32_MAX;
+	uint32_t m_GeometryPass;
+	uint32_t m_LightingPass = UINT32_MAX;	// deferred only
+	uint32_t m_CompositePass;
+	uint32_t m_UpscalePass;
+
+	// Dynamic resolution
+	DynamicResolution m_DynamicResolution;
+	VkExtent2D m_RenderExtent;				// scene resolution of the frame being recorded
+
+	// GPU timestamps and pipeline statistics (per frame in flight)
+	GpuProfiler m_GpuProfiler;
+	bool m_PipelineStatisticsSupported = false;
 
 	// Texture sampler
 	VkSampler m_TextureSampler;
+	VkSampler m_UpscaleSampler;
+	VkSampler m_CompositeSampler;		// nearest, the composite pass reads single texels
 
 	// - Descriptors
 	VkDescriptorSetLayout m_DescriptorSetLayout;
 	VkDescriptorSetLayout m_SamplerDescriptorSetLayout;
-	VkDescriptorSetLayout m_InputDescriptorSetLayout;
+	VkDescriptorSetLayout m_CompositeDescriptorSetLayout;
+	VkDescriptorSetLayout m_UpscaleDescriptorSetLayout;
+	VkDescriptorSetLayout m_GBufferDescriptorSetLayout = VK_NULL_HANDLE;		// deferred only
+	VkDescriptorSetLayout m_SkinningDescriptorSetLayout;
 	
 	VkDescriptorPool m_DescriptorPool;
 	VkDescriptorPool m_SamplerDescriptorPool;
-	VkDescriptorPool m_InputDescriptorPool;
-
-	std::vector<VkDescriptorSet> m_DescriptorSets;
-	std::vector<VkDescriptorSet> m_SamplerDescriptorSets;
-	std::vector<VkDescriptorSet> m_InputDescriptorSets;
+	VkDescriptorPool m_CompositeDescriptorPool;
+	VkDescriptorPool m_UpscaleDescriptorPool;
+	VkDescriptorPool m_GBufferDescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorPool m_SkinningDescriptorPool;
 
-	std::vector<VkBuffer> m_UniformBuffers;
-	std::vector<VkDeviceMemory> m_UniformBufferMemory;
-
-	std::vector<VkBuffer> m_UniformDynamicBuffers;
-	std::vector<VkDeviceMemory> m_UniformDynamicBufferMemory;
+	VkDescriptorSet m_TextureDescriptorSet;		// bindless texture table (set 1)
+	std::vector<VkDescriptorSet> m_CompositeDescriptorSets;
+	std::vector<VkDescriptorSet> m_UpscaleDescriptorSets;
+	std::vector<VkDescriptorSet> m_GBufferDescriptorSets;		// G-buffer input attachments, per frame in flight
 
 	VkDeviceSize m_MinUniformBufferOffset;
 	size_t m_ModelUniformAlignment;
@@ -193,24 +458,34 @@ private:
 	std::vector<VkImage> m_TextureImages;
 	std::vector<VkDeviceMemory> m_TextureImageMemory;
 	std::vector<VkImageView> m_TextureImageViews;
+	uint32_t m_TextureCount = 0;				// used slots of the texture table
+	uint32_t m_MaxTextures = MAX_TEXTURES;		// texture table size, clamped to the device limits
 
 	// -- Pipeline
-	VkPipeline m_GraphicsPipeline;
+	VkPipelineCache m_PipelineCache = VK_NULL_HANDLE;		// persisted to disk between runs
+	PipelineManager m_PipelineManager;
+
+	uint32_t m_GraphicsPipelineID;
 	VkPipelineLayout m_PipelineLayout;
-	VkRenderPass m_RenderPass;
 
-	VkPipeline m_SecondPipeline;
-	VkPipelineLayout m_SecondPipelineLayout;
+	uint32_t m_CompositePipelineID;			// compute pipeline
+	PipelineDesc m_CompositePipelineDesc;
+	VkPipelineLayout m_CompositePipelineLayout;
+	uint32_t m_HiZPipelineID;				// compute, shares the composite layout
+
+	uint32_t m_UpscalePipelineID;
+	VkPipelineLayout m_UpscalePipelineLayout;
+
+	uint32_t m_LightingPipelineID;			// deferred only
+	VkPipelineLayout m_LightingPipelineLayout = VK_NULL_HANDLE;
+
+	uint32_t m_SkinningPipelineID;			// compute
+	VkPipelineLayout m_SkinningPipelineLayout;
 
 	// -- Pools
-	VkCommandPool m_GraphicsCommandPool;
+	VkCommandPool m_GraphicsCommandPool;		// one-off transfers (meshes, textures)
 
 	// Utilities
 	VkFormat m_SwapchainImageFormat;
 	VkExtent2D m_SwapchainExtent;
-	
-	// - Synchronization
-	std::vector<VkSemaphore> m_SemaphoresImageAvailable;
-	std::vector<VkSemaphore> m_SemaphoresRenderFinished;
-	std::vector<VkFence> m_DrawFences;
 };
\ No newline at end of file
@@ -5,8 +5,14 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
 
 #include "VulkanRenderer.h"
+#include "Benchmark.h"
+#include "Trace.h"
 
 static GLFWwindow* g_Window; // global var
 static VulkanRenderer g_VulkanRenderer;
@@ -23,21 +29,358 @@ void initWindow(std::string wname = "test window", const int width = 800, const
 	g_Window = glfwCreateWindow(width, height, wname.c_str(), nullptr, nullptr);
 }
 
-int main()
+struct AppSettings
 {
+	RendererSettings Renderer;
+
+	// Headless runs render a fixed number of frames and optionally save the last one
+	uint32_t RenderFrames = 300;
+	std::string OutputFile;
+
+	// Benchmark runs (scene file set = benchmark mode, the Benchmark configuration turns it on by default)
+#ifdef BENCHMARK_BUILD
+	std::string BenchmarkScene = "src/Scenes/benchmark.scene";
+#else
+	std::string BenchmarkScene;
+#endif
+	uint32_t WarmupFrames = 100;
+	uint32_t MeasuredFrames = 1000;
+	std::string ResultsFile = "benchmark_results.json";
+
+	// CPU trace zones written on exit (needs a build with ENABLE_TRACING)
+	std::string TraceFile;
+
+	// Point lights orbiting the scene (clustered lighting)
+	uint32_t LightCount = 256;
+};
+
+// Demo lights, in their position at angle 0 (updateScene orbits them around the y axis)
+static std::vector<PointLight> g_DemoLights;
+// Scene nodes the demo models hang from, turned by updateScene (the models keep their local transform)
+static uint32_t g_SpinPivot = SceneGraph::InvalidNode;
+static uint32_t g_OrbitPivot = SceneGraph::InvalidNode;
+
+// Command line: --frames <count> --present <fifo|mailbox|immediate> --gpu-budget <ms, 0 = fixed resolution>
+//				 --headless <width>x<height> --render-frames <count> --output <file.ppm>
+//				 --benchmark <scene file> --warmup <count> --measure <count> --results <file.json>
+//				 --trace <file.json> --async-compute <on|off> --lights <count> --deferred <on|off>
+//				 --occlusion <on|off> --software-occlusion <on|off>
+AppSettings parseSettings(int argc, char** argv)
+{
+	AppSettings appSettings;
+	RendererSettings& settings = appSettings.Renderer;
+
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--frames") == 0)
+		{
+			settings.FramesInFlight = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--present") == 0)
+		{
+			const char* mode = argv[++i];
+			if (strcmp(mode, "fifo") == 0)
+				settings.PresentMode = VK_PRESENT_MODE_FIFO_KHR;
+			else if (strcmp(mode, "mailbox") == 0)
+				settings.PresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			else if (strcmp(mode, "immediate") == 0)
+				settings.PresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			else
+				std::cout << "Unknown present mode '" << mode << "', using default" << std::endl;
+		}
+		else if (strcmp(argv[i], "--gpu-budget") == 0)
+		{
+			float budget = static_cast<float>(atof(argv[++i]));
+			settings.DynamicResolution = budget > 0.0f;
+			if (settings.DynamicResolution)
+				settings.GpuFrameBudgetMs = budget;
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+		{
+			unsigned int width = 0, height = 0;
+			if (sscanf(argv[++i], "%ux%u", &width, &height) == 2 && width > 0 && height > 0)
+			{
+				settings.Headless = true;
+				settings.HeadlessExtent = { width, height };
+			}
+			else
+			{
+				std::cout << "Invalid headless extent '" << argv[i] << "', expected <width>x<height>" << std::endl;
+			}
+		}
+		else if (strcmp(argv[i], "--render-frames") == 0)
+		{
+			appSettings.RenderFrames = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--output") == 0)
+		{
+			appSettings.OutputFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			appSettings.BenchmarkScene = argv[++i];
+		}
+		else if (strcmp(argv[i], "--warmup") == 0)
+		{
+			appSettings.WarmupFrames = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--measure") == 0)
+		{
+			appSettings.MeasuredFrames = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--results") == 0)
+		{
+			appSettings.ResultsFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--trace") == 0)
+		{
+			appSettings.TraceFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--async-compute") == 0)
+		{
+			settings.AsyncCompute = strcmp(argv[++i], "off") != 0;
+		}
+		else if (strcmp(argv[i], "--lights") == 0)
+		{
+			appSettings.LightCount = static_cast<uint32_t>(std::min(std::max(0, atoi(argv[++i])), static_cast<int>(MAX_LIGHTS)));
+		}
+		else if (strcmp(argv[i], "--deferred") == 0)
+		{
+			settings.DeferredShading = strcmp(argv[++i], "off") != 0;
+		}
+		else if (strcmp(argv[i], "--occlusion") == 0)
+		{
+			settings.OcclusionCulling = strcmp(argv[++i], "off") != 0;
+		}
+		else if (strcmp(argv[i], "--software-occlusion") == 0)
+		{
+			settings.SoftwareOcclusion = strcmp(argv[++i], "off") != 0;
+		}
+	}
+
+	return appSettings;
+}
+
+// Rings of small coloured lights around the models (deterministic, so headless and benchmark runs match)
+void addDemoLights(uint32_t count)
+{
+	g_DemoLights.clear();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float ring = static_cast<float>(i % 8);
+		float turn = glm::radians(137.5f * static_cast<float>(i));		// golden angle, spreads the lights evenly
+
+		PointLight light;
+		light.Position = glm::vec3(1.0f + 0.5f * ring, -0.5f + 0.4f * static_cast<float>((i / 8) % 8), 0.0f);
+		light.Position = glm::vec3(glm::rotate(glm::mat4(1.0f), turn, { 0.0f, 1.0f, 0.0f }) * glm::vec4(light.Position, 1.0f));
+		light.Radius = 1.5f;
+		light.Color = glm::vec3(0.5f + 0.5f * std::sin(turn), 0.5f + 0.5f * std::sin(turn + 2.1f), 0.5f + 0.5f * std::sin(turn + 4.2f));
+		light.Intensity = 2.0f;
+
+		g_DemoLights.push_back(light);
+		g_VulkanRenderer.AddLight(light);
+	}
+}
+
+// Models 0 and 2 turn together, model 1 orbits the other way
+void setupScene()
+{
+	SceneGraph& sceneGraph = g_VulkanRenderer.GetSceneGraph();
+	g_SpinPivot = sceneGraph.CreateNode();
+	g_OrbitPivot = sceneGraph.CreateNode();
+
+	sceneGraph.SetParent(g_VulkanRenderer.GetModelNode(0), g_SpinPivot);
+	sceneGraph.SetLocalTransform(g_VulkanRenderer.GetModelNode(0), glm::scale(glm::mat4(1.0f), { 0.5f, 0.5f, 0.5f }));
+	sceneGraph.SetParent(g_VulkanRenderer.GetModelNode(1), g_OrbitPivot);
+	sceneGraph.SetLocalTransform(g_VulkanRenderer.GetModelNode(1), glm::translate(glm::mat4(1.0f), { 2.0f, 1.0f, 0.0f })
+		* glm::scale(glm::mat4(1.0f), { 0.06f, 0.06f, 0.06f }));
+	sceneGraph.SetParent(g_VulkanRenderer.GetModelNode(2), g_SpinPivot);
+	sceneGraph.SetLocalTransform(g_VulkanRenderer.GetModelNode(2), glm::translate(glm::mat4(1.0f), { 4.0f, 0.0f, 0.0f })
+		* glm::scale(glm::mat4(1.0f), { 0.20f, 0.20f, 0.20f }));
+}
+
+void updateScene(float angle)
+{
+	for (uint32_t i = 0; i < g_DemoLights.size(); i++)
+	{
+		PointLight light = g_DemoLights[i];
+		light.Position = glm::vec3(glm::rotate(glm::mat4(1.0f), glm::radians(angle), { 0.0f, 1.0f, 0.0f }) * glm::vec4(light.Position, 1.0f));
+		g_VulkanRenderer.UpdateLight(i, light);
+	}
+
+	SceneGraph& sceneGraph = g_VulkanRenderer.GetSceneGraph();
+	sceneGraph.SetLocalTransform(g_SpinPivot, glm::rotate(glm::mat4(1.0f), glm::radians(-angle), { 0.0f, 1.0f, 0.0f }));
+	sceneGraph.SetLocalTransform(g_OrbitPivot, glm::rotate(glm::mat4(1.0f), glm::radians(angle), { 0.0f, 1.0f, 0.0f }));
+}
+
+// Skinned models with clips play their first one, looped (sampling wraps the time)
+void animateModels(float time)
+{
+	for (uint32_t i = 0; i < g_VulkanRenderer.GetModelCount(); i++)
+	{
+		if (g_VulkanRenderer.GetAnimationCount(i) > 0)
+		{
+			AnimationState animationState;
+			animationState.Time = time;
+			g_VulkanRenderer.SetAnimation(i, animationState);
+		}
+	}
+}
+
+// Lower end of the depth range shown on the right half of the screen ([ and ] move it, 1 is the far plane)
+static float g_DepthLowerBound = 0.98f;
+
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	if (action != GLFW_PRESS && action != GLFW_REPEAT)
+		return;
+
+	float lowerBound = g_DepthLowerBound;
+	if (key == GLFW_KEY_LEFT_BRACKET)
+		lowerBound = std::max(lowerBound - 0.005f, 0.0f);
+	else if (key == GLFW_KEY_RIGHT_BRACKET)
+		lowerBound = std::min(lowerBound + 0.005f, 0.995f);
+
+	if (lowerBound == g_DepthLowerBound)
+		return;
+
+	// The composite keeps its current permutation until the new one has compiled in the background
+	g_DepthLowerBound = lowerBound;
+	g_VulkanRenderer.SetDepthVisualizationRange(g_DepthLowerBound, 1.0f);
+	std::cout << "Depth range [" << g_DepthLowerBound << ", 1]" << std::endl;
+}
+
+// Open in chrome://tracing or ui.perfetto.dev
+void writeTrace(const AppSettings& appSettings)
+{
+	if (appSettings.TraceFile.empty())
+		return;
+
+	if (!Trace::IsEnabled())
+		std::cout << "Tracing is compiled out, build with ENABLE_TRACING to record zones" << std::endl;
+	else if (Trace::WriteChromeTrace(appSettings.TraceFile))
+		std::cout << "Trace written to '" << appSettings.TraceFile << "'" << std::endl;
+	else
+		std::cout << "Failed to write trace to '" << appSettings.TraceFile << "'" << std::endl;
+}
+
+// No window system at all: fixed time step, so every run renders the same frames
+int runHeadless(const AppSettings& appSettings)
+{
+	if (g_VulkanRenderer.Init(nullptr, appSettings.Renderer) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+	setupScene();
+	addDemoLights(appSettings.LightCount);
+
+	const float timeStep = 1.0f / 60.0f;
+	float angle = 0.0f;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (uint32_t frame = 0; frame < appSettings.RenderFrames; frame++)
+	{
+		angle += 50 * timeStep;
+		if (angle > 360.0f)
+			angle -= 360.f;
+
+		updateScene(angle);
+		animateModels((frame + 1) * timeStep);
+		g_VulkanRenderer.Draw();
+	}
+
+	if (!appSettings.OutputFile.empty() && !g_VulkanRenderer.SaveLastFrame(appSettings.OutputFile))
+	{
+		std::cout << "Failed to save frame to '" << appSettings.OutputFile << "'" << std::endl;
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>(endTime - startTime).count();
+	std::cout << "Headless: " << appSettings.RenderFrames << " frames at " << appSettings.Renderer.HeadlessExtent.width << "x"
+		<< appSettings.Renderer.HeadlessExtent.height << " in " << seconds << "s  / FPS: " << appSettings.RenderFrames / seconds << std::endl;
+
+	writeTrace(appSettings);
+	g_VulkanRenderer.CleanUp();
+	return 0;
+}
+
+// Fixed scene and timestep, timings written as JSON (windowed or headless)
+int runBenchmark(AppSettings& appSettings)
+{
+	BenchmarkScene scene;
+	try
+	{
+		scene = BenchmarkScene::Load(appSettings.BenchmarkScene);
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	appSettings.Renderer.Models.clear();
+	for (const BenchmarkModel& model : scene.Models)
+	{
+		appSettings.Renderer.Models.push_back(model.Path);
+	}
+
+	if (!appSettings.Renderer.Headless)
+		initWindow("Benchmark", 1000, 750);
+
+	if (g_VulkanRenderer.Init(appSettings.Renderer.Headless ? nullptr : g_Window, appSettings.Renderer) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+	addDemoLights(appSettings.LightCount);
+
+	Benchmark benchmark(appSettings.WarmupFrames, appSettings.MeasuredFrames);
+	benchmark.Run(g_VulkanRenderer, scene, appSettings.Renderer.Headless ? nullptr : g_Window);
+
+	int exitCode = 0;
+	if (benchmark.WriteResults(appSettings.ResultsFile, scene, g_VulkanRenderer))
+	{
+		std::cout << "Benchmark results written to '" << appSettings.ResultsFile << "'" << std::endl;
+	}
+	else
+	{
+		std::cout << "Failed to write benchmark results to '" << appSettings.ResultsFile << "'" << std::endl;
+		exitCode = EXIT_FAILURE;
+	}
+
+	writeTrace(appSettings);
+	g_VulkanRenderer.CleanUp();
+	if (!appSettings.Renderer.Headless)
+	{
+		glfwDestroyWindow(g_Window);
+		glfwTerminate();
+	}
+
+	return exitCode;
+}
+
+int main(int argc, char** argv)
+{
+	TRACE_THREAD_NAME("Main");
+
+	AppSettings appSettings = parseSettings(argc, argv);
+	if (!appSettings.BenchmarkScene.empty())
+		return runBenchmark(appSettings);
+	if (appSettings.Renderer.Headless)
+		return runHeadless(appSettings);
+
 	// Create window
 	initWindow("Main window", 1000, 750);
 
 	// Create vulkan renderer instance
-	if (g_VulkanRenderer.Init(g_Window) == EXIT_FAILURE)
+	if (g_VulkanRenderer.Init(g_Window, appSettings.Renderer) == EXIT_FAILURE)
 		return EXIT_FAILURE;
-
+	setupScene();
+	addDemoLights(appSettings.LightCount);
+	glfwSetKeyCallback(g_Window, keyCallback);
 
 	float angle = 0.0f;
 	float deltaTime = 0.0f;
 	float lastTime = 0.0f;
 
-	glm::mat4 modelMatrix;
+	// Summary of the last second of frames, once per second
+	const double statsInterval = 1.0;
+
 	// lopp until closed
 	while (!glfwWindowShouldClose(g_Window))
 	{
@@ -51,27 +394,25 @@ int main()
 		if (angle > 360.0f)
 			angle -= 360.f;
 		 
-		modelMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(-angle), { 0.0f, 1.0f, 0.0f })
-			* glm::scale(glm::mat4(1.0f), { 0.5f, 0.5f, 0.5f });
-		g_VulkanRenderer.UpdateModel(0, modelMatrix);
-		modelMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(angle), { 0.0f, 1.0f, 0.0f })* glm::translate(glm::mat4(1.0f), { 2.0f, 1.0f, 0.0f })
-			* glm::scale(glm::mat4(1.0f), { 0.06f, 0.06f, 0.06f });
-		g_VulkanRenderer.UpdateModel(1, modelMatrix);
-		modelMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(-angle), { 0.0f, 1.0f, 0.0f }) * glm::translate(glm::mat4(1.0f), { 4.0f, 0.0f, 0.0f })
-			* glm::scale(glm::mat4(1.0f), { 0.20f, 0.20f, 0.20f });
-		g_VulkanRenderer.UpdateModel(2, modelMatrix);
+		updateScene(angle);
+		animateModels(currentTime);
 
 		g_VulkanRenderer.Draw();
-		std::cout << "Delta time: " << deltaTime << "s" << "  / FPS: " << 1.0 / deltaTime << std::endl;
+
+		FrameStats& frameStats = g_VulkanRenderer.GetFrameStats();
+		uint32_t statsWindow = static_cast<uint32_t>(std::max(1.0, statsInterval / std::max(deltaTime, 0.001f)));
+		frameStats.LogSummary(std::cout, statsInterval, statsWindow);
 	}
 
 	
 
+	// Renderer first, it still owns the window's surface and swapchain
+	writeTrace(appSettings);
+	g_VulkanRenderer.CleanUp();
+
 	// destroy glfw window and stop glfw
 	glfwDestroyWindow(g_Window);
 	glfwTerminate();
 
-	g_VulkanRenderer.CleanUp();
-
 	return 0;
 }
\ No newline at end of file